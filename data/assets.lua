@@ -2,26 +2,95 @@ Assets = {
   Scripts = {},
   Fonts = {},
   Shaders = {},
+
+  -- Declarations of all the assets, by kind and ID. Each declaration can have:
+  --   Lazy = true    -- Don't load at startup, load on first access to Assets.<Kind>.<ID>
+  --   Depends = {Scripts = {...}, Fonts = {...}} -- Assets to load before this one
+  -- NOTE: Lazy scripts that get loaded after startup can't declare new globals.
+  Manifest = {
+    Scripts = {},
+    Fonts = {},
+  },
 }
 
+-- Loads the asset `id` of `kind` ("Scripts" or "Fonts") after its dependencies.
+-- Unless `immediate` is true, the asset is only submitted to the engine's loader.
+function Assets:Load (kind, id, immediate)
+   local entry = self.Manifest[kind][id]
+   if entry == nil then
+      error("Asset " .. kind .. "." .. id .. " is not declared", 2)
+   end
+
+   local asset = rawget(self[kind], id)
+   if asset ~= nil then
+      return asset
+   end
+
+   if entry.Loading then
+      error("Asset " .. kind .. "." .. id .. " depends on itself", 2)
+   end
+   entry.Loading = true
+
+   for dep_kind, dep_ids in pairs(entry.Depends or {}) do
+      for _, dep_id in ipairs(dep_ids) do
+         self:Load(dep_kind, dep_id, immediate)
+      end
+   end
+
+   if kind == "Scripts" then
+      self.Scripts[id] = {}
+      Engine.Functions.AssetLoadScript(self.Scripts[id], entry.ScriptPath, immediate)
+   elseif kind == "Fonts" then
+      local font_size = 3 * entry.FontScreenSize
+      local scaling_factor = 1/500
+
+      self.Fonts[id] = {}
+      Engine.Functions.AssetLoadTrueTypeFont(self.Fonts[id], entry.FontPath,
+                                             font_size, scaling_factor,
+                                             entry.VertexPath, entry.FragmentPath,
+                                             function (font)
+                                                local _, y_min, y_max = Engine.Functions.RenderGetTextDimensions(font, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz")
+                                                font.YMin = y_min
+                                                font.YMax = y_max
+                                             end,
+                                             immediate)
+   end
+
+   entry.Loading = nil
+   return self[kind][id]
+end
+
+-- Lazy assets are loaded the first time they are looked up
+for _, kind in ipairs({"Scripts", "Fonts"}) do
+   setmetatable(Assets[kind], {
+                   __index = function (t, id)
+                      if Assets.Manifest[kind][id] == nil then
+                         return nil
+                      end
+                      return Assets:Load(kind, id, true)
+                   end
+   })
+end
 
 function Assets:Script (table)
-   self.Scripts[table.ID] = {}
-   Engine.Functions.AssetLoadScript(self.Scripts[table.ID], table.ScriptPath)
+   self.Manifest.Scripts[table.ID] = table
+   if not table.Lazy then
+      self:Load("Scripts", table.ID)
+   end
 end
 
 function Assets:TrueTypeFont (table)
-  local font_size = 3 * table.FontScreenSize
-  local scaling_factor = 1/500
-
-  self.Fonts[table.ID] = {}
-  Engine.Functions.AssetLoadTrueTypeFont(self.Fonts[table.ID], table.FontPath,
-                                         font_size, scaling_factor,
-                                         table.VertexPath, table.FragmentPath)
+   self.Manifest.Fonts[table.ID] = table
+   if not table.Lazy then
+      self:Load("Fonts", table.ID)
+   end
+end
 
-  local _, y_min, y_max = Engine.Functions.RenderGetTextDimensions(self.Fonts[table.ID], "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz")
-  self.Fonts[table.ID].YMin = y_min
-  self.Fonts[table.ID].YMax = y_max
+-- Compiles scripts that are loaded through `require` in the background
+function Assets:Prefetch (paths)
+   for _, path in ipairs(paths) do
+      Engine.Functions.AssetPrefetchScript(path)
+   end
 end
 
 Assets:TrueTypeFont{
@@ -34,15 +103,31 @@ Assets:TrueTypeFont{
 
 Assets:Script{
    ID = "Vector",
-   ScriptPath = "data/scripts/lib/vector.lua"
+   ScriptPath = "data/scripts/lib/vector.lua",
+   Lazy = true,
 }
 
 Assets:Script{
    ID = "Color",
-   ScriptPath = "data/scripts/lib/color.lua"
+   ScriptPath = "data/scripts/lib/color.lua",
+   Lazy = true,
 }
 
 Assets:Script{
    ID = "Loop",
-   ScriptPath = "data/scripts/loop.lua"
+   ScriptPath = "data/scripts/loop.lua",
+   Depends = {Scripts = {"Vector", "Color"}, Fonts = {"Mono"}},
+}
+
+-- Command modules are left out, since they are only loaded when first run
+Assets:Prefetch{
+   "data/scripts/tutorial.lua",
+   "data/scripts/command/command.lua",
+   "data/scripts/command/_complete.lua",
+   "data/scripts/command/_getopt.lua",
+   "data/scripts/command/_job.lua",
+   "data/scripts/command/_pipeline.lua",
+   "data/scripts/command/_tutorial.lua",
+   "data/scripts/lib/fs.lua",
+   "data/scripts/lib/table.lua",
 }
@@ -0,0 +1,120 @@
+-- Benchmark of the filesystem and the commands, run by the engine (with --fs-bench=INODES) in a
+-- Lua state of its own, without a window. Trees of 1k, 10k, ... inodes, up to the number asked
+-- for, are built by lib/fixture.lua; on each, a standard mix of commands is run on directories
+-- and files picked at random, and the latency of every command and the memory taken by the
+-- tree are reported.
+package.path = "data/scripts/?.lua;" .. package.path
+
+local fs = require "lib/fs"
+local fixture = require "lib/fixture"
+local getopt = require "command/_getopt"
+local command = require "command/command"
+
+local runs = 256 -- Times each command is run on every tree
+
+-- Runs the command in `words` until it is done, as a pipeline would
+local function call (words)
+   local co = coroutine.create(command.find(words[1]).call)
+   local ok, err = coroutine.resume(co, getopt.parse(words))
+   while ok and coroutine.status(co) ~= "dead" do
+      ok, err = coroutine.resume(co)
+   end
+   if not ok then
+      error(err)
+   end
+end
+
+-- The mix of commands, each of which is run on the (absolute) path of a directory and the path
+-- of a file, both picked at random, in the `run`th run
+local mix = {
+   {"insert", function (tree, directory, file, run)
+       tree:insert(directory .. "bench" .. run, "f")
+   end},
+   {"cd", function (tree, directory, file, run)
+       tree:cd(directory)
+   end},
+   {"ls", function (tree, directory, file, run)
+       call({"ls", directory})
+   end},
+   {"mv", function (tree, directory, file, run)
+       call({"mv", file, directory})
+   end},
+   {"glob", function (tree, directory, file, run)
+       tree:glob(directory .. "*a*")
+   end},
+}
+
+-- Returns the value below which `fraction` of the (sorted) `samples` are
+local function percentile (samples, fraction)
+   return samples[math.max(1, math.ceil(#samples * fraction))]
+end
+
+-- Builds a tree of `inodes` inodes and runs the mix on it. Returns the lines of the report.
+local function measure (inodes, seed)
+   local clock = Engine.Functions.BenchClock
+   local out = {}
+
+   local tree = fs.new()
+   Game.FS = tree
+
+   local start = clock()
+   local result = fixture.generate(tree, tree.root, {seed = seed, inodes = inodes})
+   local built = clock() - start
+
+   collectgarbage("collect")
+   table.insert(out, string.format("%d inodes (%d directories, %d files): built in %.1f ms, " ..
+                                      "%.2f MB in the filesystem, %.2f MB of Lua",
+                                   inodes, result.directories, result.files, built / 1000,
+                                   tree.vfs:memory() / (1024 * 1024),
+                                   collectgarbage("count") / 1024))
+
+   local random = fixture.random(seed)
+   local directories = result.sample.directories
+   local files = result.sample.files
+   if #directories == 0 then
+      directories = {tree.root}
+   end
+
+   for _, entry in ipairs(mix) do
+      local samples = {}
+      for run = 1, runs do
+         local directory = tree:path(directories[random(#directories)])
+         local file = #files > 0 and tree:path(files[random(#files)]) or directory
+
+         start = clock()
+         entry[2](tree, directory, file, run)
+         samples[run] = clock() - start
+      end
+
+      table.sort(samples)
+      table.insert(out, string.format("  %-6s median %8.2f us   p99 %8.2f us   max %8.2f us",
+                                      entry[1], percentile(samples, 0.5),
+                                      percentile(samples, 0.99), samples[#samples]))
+   end
+
+   Game.FS = nil
+   return out
+end
+
+Bench = {
+   -- Runs the benchmark on trees of up to `inodes` inodes, built from `seed`. Returns the lines
+   -- of the report.
+   Run = function (inodes, seed)
+      local sizes = {}
+      local size = 1000
+      while size < inodes do
+         table.insert(sizes, size)
+         size = size * 10
+      end
+      table.insert(sizes, inodes)
+
+      local out = {}
+      for _, count in ipairs(sizes) do
+         for _, line in ipairs(measure(count, seed)) do
+            table.insert(out, line)
+         end
+         collectgarbage("collect")
+      end
+      return out
+   end,
+}
@@ -0,0 +1,117 @@
+-- Completes the word being typed at the end of a command line: as the name of a command if it
+-- is the first word of a pipeline, and as a path otherwise. The names of the commands are kept
+-- in a sorted array, and the engine keeps the names in every directory sorted as well, so
+-- completing costs a binary search and a step per candidate, however many commands or files
+-- there are.
+
+local complete = {}
+complete.__index = complete
+
+local list_limit = 64 -- Most candidates listed
+local list_columns = 8 -- Candidates per line
+
+-- Returns the longest prefix of both `a` and `b`
+local function common_prefix (a, b)
+   local length = 0
+   while length < #a and length < #b and
+      string.byte(a, length + 1) == string.byte(b, length + 1) do
+      length = length + 1
+   end
+   return string.sub(a, 1, length)
+end
+
+-- Returns the index of the first of `names` (sorted) that doesn't sort before `prefix`
+local function lower_bound (names, prefix)
+   local low, high = 1, #names + 1
+   while low < high do
+      local middle = math.floor((low + high) / 2)
+      if names[middle] < prefix then
+         low = middle + 1
+      else
+         high = middle
+      end
+   end
+   return low
+end
+
+-- Creates a completer for the filesystem `fs` and the commands in the arrays of names passed
+-- after it
+function complete.new (fs, ...)
+   local c = setmetatable({}, complete)
+   c.fs = fs
+   c.names = {}
+
+   local seen = {}
+   for _, names in ipairs({...}) do
+      for _, name in ipairs(names) do
+         if not seen[name] then
+            seen[name] = true
+            table.insert(c.names, name)
+         end
+      end
+   end
+   table.sort(c.names)
+
+   return c
+end
+
+-- Completes `prefix` as the name of a command, returning what filesystem:complete does
+function complete:command (prefix, limit)
+   local names = {}
+   local first = lower_bound(self.names, prefix)
+   local last = first - 1
+   while self.names[last + 1] ~= nil and
+      string.sub(self.names[last + 1], 1, #prefix) == prefix do
+      last = last + 1
+      if #names < limit then
+         table.insert(names, self.names[last])
+      end
+   end
+
+   if last < first then
+      return names, 0, prefix
+   end
+   return names, last - first + 1, common_prefix(self.names[first], self.names[last])
+end
+
+-- Completes the last word of `line`. Returns the completed line, and the lines listing the
+-- candidates if there is more than one and the word can't be extended any further.
+function complete:line (line)
+   local head, word = string.match(line, "^(.-)([^%s|&<>]*)$")
+
+   local candidates, count, common
+   if string.match(head, "^%s*$") or string.match(head, "[|&]%s*$") then
+      candidates, count, common = self:command(word, list_limit)
+   else
+      candidates, count, common = self.fs:complete(word, list_limit)
+   end
+
+   if count == 0 then
+      return line, nil
+   elseif count == 1 then
+      local completed = candidates[1]
+      if string.sub(completed, -1) ~= "/" then
+         completed = completed .. " "
+      end
+      return head .. completed, nil
+   elseif #common > #word then
+      return head .. common, nil
+   end
+
+   -- Only the last component of each path is listed
+   for i, candidate in ipairs(candidates) do
+      candidates[i] = string.match(candidate, "([^/]*/?)$")
+   end
+
+   local list = {}
+   for i = 1, #candidates, list_columns do
+      table.insert(list, table.concat(candidates, "  ", i, math.min(i + list_columns - 1,
+                                                                    #candidates)))
+   end
+   if count > #candidates then
+      table.insert(list, "(" .. (count - #candidates) .. " more)")
+   end
+   return line, list
+end
+
+return complete
@@ -0,0 +1,285 @@
+-- Runs the jobs of the terminal. A job is what was typed in before a & (or at the end of the
+-- line): pipelines (a | b) that are run one after the other (&&). Jobs started with & run in the
+-- background with the prompt up; the one in the foreground holds the prompt back until it is
+-- done.
+--
+-- Jobs are time-sliced. Every update, the engine meters them with a count hook, and they take
+-- turns (in each of which a job prints a line or gives way) until the slice of instructions and
+-- time is spent; the rest is picked up in the next update. A job can only give way when its
+-- command yields (Lua 5.1 can't yield from a hook, or from inside the iterators and metamethods
+-- a command goes through), so commands that do a lot of work should yield as they go.
+
+local pipeline = require "command/_pipeline"
+local getopt = require "command/_getopt"
+
+local job = {}
+job.__index = job
+
+-- Returns the command line that runs `groups` (as split by job:spawn)
+local function describe (groups)
+   local pipelines = {}
+   for _, stages in ipairs(groups) do
+      local commands = {}
+      for _, stage in ipairs(stages) do
+         local command = table.concat(stage.words, " ")
+         if stage.input ~= nil then
+            command = command .. " < " .. stage.input
+         elseif stage.heredoc then
+            command = command .. " << " .. stage.heredoc_marker
+         end
+         if stage.output ~= nil then
+            command = command .. (stage.output_append and " >> " or " > ") .. stage.output
+         end
+         table.insert(commands, command)
+      end
+      table.insert(pipelines, table.concat(commands, " | "))
+   end
+   return table.concat(pipelines, " && ")
+end
+
+-- Returns the line `jobs` prints for `j` ("+" marks the newest job and "-" the one before,
+-- leaving out the job `current`)
+local function status (self, j, state, current)
+   local others = {}
+   for _, k in ipairs(self.jobs) do
+      if k ~= current then
+         table.insert(others, k)
+      end
+   end
+
+   local mark = " "
+   if j == others[#others] then
+      mark = "+"
+   elseif j == others[#others - 1] then
+      mark = "-"
+   end
+
+   local text = j.text
+   if j.background then
+      text = text .. " &"
+   end
+
+   return "[" .. j.id .. "]" .. mark .. "  " .. state .. "  " .. text
+end
+
+-- Commands run by the scheduler itself, which take the job running them and the words of the
+-- command, and return the lines to print, or nil and an error message. They leave out the job
+-- running them.
+local builtins = {
+   ["jobs"] = function (self, current, words)
+      local out = {}
+      for _, j in ipairs(self.jobs) do
+         if j ~= current then
+            table.insert(out, status(self, j, "Running", current))
+         end
+      end
+      return out
+   end,
+
+   ["fg"] = function (self, current, words)
+      local parse, err = getopt.parse(words)
+      if parse == nil then
+         return nil, err
+      end
+
+      local j = self:find(parse.args[1], current)
+      if j == nil then
+         return nil, "fg: no such job"
+      end
+
+      j.background = false
+      return {j.text}
+   end,
+
+   ["kill"] = function (self, current, words)
+      local parse, err = getopt.parse(words)
+      if parse == nil then
+         return nil, err
+      end
+      if #parse.args == 0 then
+         return nil, "kill: no job given"
+      end
+
+      local out = {}
+      for _, spec in ipairs(parse.args) do
+         local j = self:find(spec, current)
+         if j == nil then
+            return nil, "kill: " .. spec .. ": no such job"
+         end
+
+         table.insert(out, status(self, j, "Terminated", current))
+         self:remove(j)
+         j.killed = true
+      end
+      return out
+   end,
+}
+
+-- Creates a scheduler with no jobs, running commands on the file system `fs`. The shell's own
+-- commands (like cd) are in `shell`, which maps their names to functions taking the words of
+-- the command and returning the lines to print, or nil and an error message. They, like the
+-- scheduler's (jobs, fg and kill), are only run when they are all there is to a pipeline.
+function job.new (fs, shell)
+   local s = setmetatable({}, job)
+   s.fs = fs
+   s.shell = shell
+   s.jobs = {} -- Jobs, oldest first
+   return s
+end
+
+-- Returns the names of the commands run by the shell and the scheduler
+function job:builtins ()
+   local names = {}
+   for name in pairs(self.shell) do
+      table.insert(names, name)
+   end
+   for name in pairs(builtins) do
+      table.insert(names, name)
+   end
+   return names
+end
+
+-- Adds a job that runs `groups` (arrays of the stages of Game.Parse, one per pipeline) and
+-- returns it
+function job:spawn (groups, background)
+   local id = 1
+   for _, j in ipairs(self.jobs) do
+      if j.id >= id then
+         id = j.id + 1
+      end
+   end
+
+   local j = {
+      id = id,
+      text = describe(groups),
+      groups = groups, -- Pipelines still to be started
+      pipeline = nil, -- Pipeline that is running
+      background = background,
+   }
+   table.insert(self.jobs, j)
+   return j
+end
+
+-- Returns the job with the ID in `spec` ("2" or "%2"), or the newest one if `spec` is nil,
+-- leaving out the job `except`
+function job:find (spec, except)
+   local id = nil
+   if spec ~= nil then
+      id = tonumber(string.match(spec, "^%%?(%d+)$"))
+      if id == nil then
+         return nil
+      end
+   end
+
+   for i = #self.jobs, 1, -1 do
+      local j = self.jobs[i]
+      if j ~= except and (id == nil or j.id == id) then
+         return j
+      end
+   end
+   return nil
+end
+
+-- Removes the job `j`
+function job:remove (j)
+   for i, k in ipairs(self.jobs) do
+      if k == j then
+         table.remove(self.jobs, i)
+         return
+      end
+   end
+end
+
+-- Returns the job in the foreground, if there is one
+function job:foreground ()
+   for _, j in ipairs(self.jobs) do
+      if not j.background then
+         return j
+      end
+   end
+   return nil
+end
+
+-- Runs `j` for a turn (in which it prints a line, gives way, or starts or finishes a pipeline),
+-- adding whatever it prints to `out`
+local function step (self, j, out)
+   if j.pipeline == nil then
+      if #j.groups == 0 then
+         j.done = true
+         return
+      end
+
+      local stages = table.remove(j.groups, 1)
+      local name = stages[1].words[1]
+      if #stages == 1 and name ~= nil and (self.shell[name] or builtins[name]) then
+         local lines, err
+         if self.shell[name] ~= nil then
+            lines, err = self.shell[name](stages[1].words)
+         else
+            lines, err = builtins[name](self, j, stages[1].words)
+         end
+
+         if lines == nil then
+            lines = {err}
+            j.groups = {}
+         end
+         for _, line in ipairs(lines) do
+            table.insert(out, line)
+         end
+         return
+      end
+
+      j.pipeline = pipeline.new(stages, self.fs)
+   end
+
+   local lines, done = j.pipeline:step(1)
+   for _, line in ipairs(lines) do
+      table.insert(out, line)
+   end
+
+   if done then
+      if j.pipeline.failed then
+         j.groups = {}
+      end
+      j.pipeline = nil
+   end
+end
+
+-- Lets the jobs take turns until `instructions` Lua instructions or `microseconds` have been
+-- spent, or there are no jobs left. Returns the lines they printed.
+function job:run (instructions, microseconds)
+   local out = {}
+   if #self.jobs == 0 then
+      return out
+   end
+
+   Engine.Functions.JobBudget(instructions, microseconds)
+   repeat
+      -- A job can kill others, so the turns go over a copy of the list
+      local turns = {}
+      for i, j in ipairs(self.jobs) do
+         turns[i] = j
+      end
+
+      for _, j in ipairs(turns) do
+         if not j.killed then
+            step(self, j, out)
+
+            if j.done then
+               self:remove(j)
+               if j.background then
+                  table.insert(out, status(self, j, "Done"))
+               end
+            end
+         end
+
+         if Engine.Functions.JobExhausted() then
+            break
+         end
+      end
+   until #self.jobs == 0 or Engine.Functions.JobExhausted()
+
+   return out
+end
+
+return job
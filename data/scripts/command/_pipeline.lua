@@ -0,0 +1,177 @@
+-- Runs the stages of a command line (a | b | c) as coroutines. Each stage pulls the lines of the
+-- stage before it through its `input` iterator, so lines flow one at a time, and only as fast
+-- as the terminal takes them from the last stage. Nothing buffers more than a single line.
+--
+-- A command can either yield its lines with coroutine.yield as it goes, or return all of them
+-- in a table at the end. Either way, it returns nil and an error message on failure. Yielding
+-- false gives way (to the other jobs, until the next update) without printing anything, which
+-- a command can do now and then while it works; the stage after it never sees it.
+
+local commands = require "command/command"
+local getopt = require "command/_getopt"
+
+local pipeline = {}
+pipeline.__index = pipeline
+
+-- Returns an iterator over the lines yielded by `body`, which is run as a coroutine, giving
+-- false whenever it gives way. Errors are added to `errors`.
+local function producer (body, errors)
+   local co = coroutine.create(body)
+
+   return function ()
+      if coroutine.status(co) == "dead" then
+         return nil
+      end
+
+      local success, line = coroutine.resume(co)
+      if not success then
+         table.insert(errors, line)
+         return nil
+      end
+
+      return line
+   end
+end
+
+-- Returns an iterator over the lines of `lines` (made by producer), skipping the times it gave
+-- way. Since Lua 5.1 can't yield from inside a for loop's iterator, only the last stage of a
+-- pipeline can pass them on.
+local function readable (lines)
+   return function ()
+      local line
+      repeat
+         line = lines()
+      until line ~= false
+      return line
+   end
+end
+
+-- Returns the function that runs `stage` (one entry of Game.Parse), reading `input`
+local function run (stage, input, fs, errors)
+   local words = stage.words
+   local module = nil
+   if words[1] ~= nil then
+      module = commands.find(words[1])
+   end
+
+   if stage.input ~= nil then
+      local err
+      input, err = fs:lines(stage.input)
+      if input == nil then
+         return function () table.insert(errors, err) end
+      end
+   elseif stage.heredoc then
+      -- The last entry of heredoc_str is the line on which the marker was typed
+      local index = 0
+      input = function ()
+         index = index + 1
+         if index < #stage.heredoc_str then
+            return stage.heredoc_str[index]
+         end
+      end
+   end
+
+   return function ()
+      if words[1] == nil then
+         table.insert(errors, "Invalid command")
+         return
+      elseif module == nil then
+         table.insert(errors, "Error: command \"" .. words[1] .. "\" not found")
+         return
+      end
+
+      -- Each command module can list the letters of its options that take a value
+      local parse, err = getopt.parse(words, module.options)
+      if parse == nil then
+         table.insert(errors, err)
+         return
+      end
+      parse.input = input
+
+      local out
+      out, err = module.call(parse)
+      if out == nil then
+         if err ~= nil then
+            table.insert(errors, err)
+         end
+      elseif type(out) == "table" then
+         for _, line in ipairs(out) do
+            coroutine.yield(line)
+         end
+      end
+   end
+end
+
+-- Returns the function that writes the lines of `lines` into the file `path` (> or >>)
+local function redirect (lines, path, append, fs, errors)
+   return function ()
+      local inode, err = fs:open(path, append)
+      if inode == nil then
+         table.insert(errors, err)
+         return
+      end
+
+      for line in lines do
+         fs.vfs:append(inode, line, "\n")
+         coroutine.yield(false)
+      end
+   end
+end
+
+-- Sets up the pipeline of `stages` (entries of Game.Parse, all but the first piped into), which
+-- doesn't run until lines are taken from it with pipeline:step
+function pipeline.new (stages, fs)
+   local p = setmetatable({}, pipeline)
+   p.errors = {}
+   p.failed = false
+   p.done = false
+
+   local output = nil
+   for _, stage in ipairs(stages) do
+      local input = nil
+      if output ~= nil then
+         input = readable(output)
+      end
+
+      output = producer(run(stage, input, fs, p.errors), p.errors)
+      if stage.output ~= nil then
+         output = producer(redirect(readable(output), stage.output, stage.output_append, fs,
+                                    p.errors),
+                           p.errors)
+      end
+   end
+   p.output = output
+
+   return p
+end
+
+-- Runs the pipeline for `count` turns, in each of which its last stage prints a line or gives
+-- way (error messages come on top). Returns the lines and whether it has finished.
+function pipeline:step (count)
+   local out = {}
+
+   for _ = 1, count do
+      if self.done then
+         break
+      end
+
+      local line = self.output()
+      if line == nil then
+         self.done = true
+      end
+
+      -- The stages hold on to self.errors, so it is emptied rather than replaced
+      while #self.errors > 0 do
+         table.insert(out, table.remove(self.errors, 1))
+         self.failed = true
+      end
+
+      if line then
+         table.insert(out, line)
+      end
+   end
+
+   return out, self.done
+end
+
+return pipeline
@@ -2,16 +2,65 @@ local getopt = require "command/_getopt"
 
 local t = {}
 
+-- Number of the step in progress, counting from 1 (t.finish counts as a step too)
+t.index = 0
+
+-- Has the last step been reached?
+t.finished = false
+
+-- Steps before this one were done in an earlier session, so they are passed over
+local resume_index = 0
+
+-- Checkpoint of Game.FS taken at the start of the current step
+local checkpoint = nil
+
+-- Takes a new checkpoint in place of the one of the previous step
+local function save ()
+   if checkpoint ~= nil then
+      Game.FS:release(checkpoint)
+   end
+   checkpoint = Game.FS:checkpoint()
+end
+
 function t.step (command, instructions)
+   t.index = t.index + 1
+   if t.index < resume_index then
+      return
+   end
+
+   save()
+   local expected = getopt.parse(command)
    local input = coroutine.yield(instructions)
 
-   while getopt.compare(getopt.parse(command), getopt.parse(input)) == false do
+   while getopt.compare(expected, getopt.parse(input) or {}) == false do
       input = coroutine.yield()
    end
 end
 
 function t.finish (instructions)
+   t.index = t.index + 1
+   t.finished = true
+   if checkpoint ~= nil then
+      Game.FS:release(checkpoint)
+      checkpoint = nil
+   end
    coroutine.yield(instructions)
 end
 
+-- Puts the filesystem back the way it was at the start of the current step. Returns false if
+-- there is no step in progress.
+function t.reset ()
+   if checkpoint == nil then
+      return false
+   end
+   Game.FS:restore(checkpoint)
+   return true
+end
+
+-- Makes the tutorial, once it is started, pass over the steps before the `index`th (which were
+-- done in an earlier session) without yielding
+function t.resume (index)
+   resume_index = index
+end
+
 return t
@@ -0,0 +1,27 @@
+local cat = {}
+
+function cat.call (tbl)
+   if #tbl.args == 0 then
+      if tbl.input ~= nil then
+         for line in tbl.input do
+            coroutine.yield(line)
+         end
+      end
+      return true
+   end
+
+   for _, path in ipairs(tbl.args) do
+      local lines, err = Game.FS:lines(path)
+      if lines == nil then
+         return nil, err
+      end
+
+      for line in lines do
+         coroutine.yield(line)
+      end
+   end
+
+   return true
+end
+
+return cat
@@ -1,11 +1,32 @@
 package.path = "data/scripts/command/?.lua;" .. package.path
 
+-- Modules implementing each command, loaded when the command is first looked up
+local modules = {
+   ["mv"] = "mv",
+   ["cp"] = "cp",
+   ["cat"] = "cat",
+   ["echo"] = "echo",
+   ["ls"] = "ls",
+   ["mkdir"] = "mkdir",
+   ["touch"] = "touch",
+}
+
 local command = {}
 
-command["mv"] = require "mv"
-command["echo"] = require "echo"
-command["ls"] = require "ls"
-command["mkdir"] = require "mkdir"
-command["touch"] = require "touch"
+-- Names of the commands, sorted (for completion)
+command.names = {}
+for name in pairs(modules) do
+   table.insert(command.names, name)
+end
+table.sort(command.names)
+
+-- Returns the module implementing the command `name` (loading it the first time), or nil if
+-- there is no such command
+function command.find (name)
+   if modules[name] == nil then
+      return nil
+   end
+   return require(modules[name])
+end
 
 return command
@@ -0,0 +1,28 @@
+local cp = {}
+
+function cp.call (tbl)
+   local fs = Game.FS
+
+   if #tbl.args < 2 then
+      return nil, "Usage: cp SOURCE... DESTINATION"
+   end
+
+   local dest_path = tbl.args[#tbl.args]
+   if #tbl.args > 2 then
+      local dest = fs:lookup(dest_path)
+      if dest == nil or fs:kind(dest) ~= "d" then
+         return nil, "\"" .. dest_path .. "\" is not a directory"
+      end
+   end
+
+   for i = 1, #tbl.args - 1 do
+      local success, err = fs:copy(tbl.args[i], dest_path)
+      if not success then
+         return nil, err
+      end
+   end
+
+   return {}
+end
+
+return cp
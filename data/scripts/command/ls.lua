@@ -1,110 +1,66 @@
 local ls = {}
 
+local columns = 8 -- Names per line
+
 function ls.call (tbl)
-   local src = {}
-   for i = 1, #tbl.args do
-      if tbl.args[1]:sub(1, 1) == "/" then
-         table.insert(src, {["path"] = tbl.args[i]})
-      else
-         table.insert(src, {["path"] = Game.FS:path(Game.FS.pwd) .. tbl.args[i]})
-      end
+   local fs = Game.FS
+   local paths = tbl.args
+   if #paths == 0 then
+      paths = {"."}
    end
 
-   if #tbl.args == 0 then
-      table.insert(src, {["path"] = Game.FS:path(Game.FS.pwd)})
+   local src = {}
+   for _, path in ipairs(paths) do
+      local inode, err = fs:lookup(path)
+      if inode == nil then
+         return nil, err
+      end
+      table.insert(src, {["path"] = path, ["inode"] = inode})
    end
 
-   for j = 1, #src do
-      local parts, err = Game.FS.segments(src[j].path)
-      local root = Game.FS.inode
-      local parent = root
-      local grandparent = nil
-      local grandparent_child_num
-
-      if parts ~= nil then
-         for _, p in ipairs(parts) do
-            local child = nil
-            local i = 1
-            while child == nil and i <= #parent.children do
-               if parent.children[i].name == p then
-                  child = parent.children[i]
-                  grandparent_child_num = i
-               end
-               i = i + 1
-            end
+   local line = ""
+   local count = 0
 
-            if child == nil then
-               return nil, "Path \"" .. src[j].path .. "\" doesn't exist"
-            elseif child.kind ~= "d" and j < #src then
-               return nil, "\"" .. src[j].path .. "\" is an invalid path"
-            else
-               grandparent = parent
-               parent = child
-            end
-         end
-      else
-         return nil, err
+   local function flush ()
+      if count > 0 then
+         coroutine.yield(line)
       end
-
-      src[j].inode = parent
-      src[j].parent = grandparent
-      src[j].parent_child_num = grandparent_child_num
+      line = ""
+      count = 0
    end
 
-   local accum = 0
-   local accum_max=  8
-   local out = {}
-   local space_optional = ""
+   local function add (name)
+      if count > 0 then
+         line = line .. " "
+      end
+      line = line .. name
+      count = count + 1
+      if count >= columns then
+         flush()
+      end
+   end
 
    for i = 1, #src do
-      table.insert(out, "")
-
       if i > 1 then
-         table.insert(out, "")
+         coroutine.yield("")
       end
 
-      if src[i].inode.kind == "d" then
-         if #src > 1 and src[i].inode.kind == "d" then
-            out[#out] = out[#out] .. src[i].inode.name .. ":"
-            accum = 0
-            table.insert(out, "")
+      if fs:kind(src[i].inode) == "d" then
+         if #src > 1 then
+            coroutine.yield(src[i].path .. ":")
          end
 
-         for j = 1, #src[i].inode.children do
-            if accum ~= 0 then
-               space_optional = " "
-            else
-               space_optional = ""
-            end
-            out[#out] = out[#out] .. space_optional .. src[i].inode.children[j].name
-            accum = accum + 1
-            if accum >= accum_max then
-               accum = 0
-               table.insert(out, "")
-            end
+         for _, name in fs:children(src[i].inode) do
+            add(name)
          end
       else
-         if accum ~= 0 then
-            space_optional = " "
-         else
-            space_optional = ""
-         end
-         out[#out] = out[#out] .. space_optional .. src[i].inode.name
-         accum = accum + 1
-         if accum >= accum_max then
-            accum = 0
-            table.insert(out, "")
-         end
+         add(fs:name(src[i].inode))
       end
 
-      accum = 0
-   end
-
-   if out[#out] == "" then
-      table.remove(out, #out)
+      flush()
    end
 
-   return out
+   return true
 end
 
 return ls
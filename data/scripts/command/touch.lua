@@ -1,28 +1,16 @@
-package.path = "data/scripts/lib/?.lua;" .. package.path
+local touch = {}
 
-local inode = require "inode"
-
-local mkdir = {}
-
-function mkdir.call (tbl)
-   local src = {}
-
-   for i = 1, #tbl.args do
-      if tbl.args[1]:sub(1, 1) == "/" then
-         table.insert(src, {["path"] = tbl.args[i]})
-      else
-         table.insert(src, {["path"] = Game.FS:path(Game.FS.pwd) .. tbl.args[i]})
+function touch.call (tbl)
+   for _, path in ipairs(tbl.args) do
+      if Game.FS:lookup(path) == nil then
+         local inode, err = Game.FS:insert(path, "f")
+         if inode == nil then
+            return nil, err
+         end
       end
    end
 
-   for i = 1, #src do
-      local parts = Game.FS.segments(src[i].path)
-      local name = parts[#parts]
-      local success, err = Game.FS:insert(inode.new(name, "f"), "/")
-      if not success then
-         return {err}
-      end
-   end
+   return {}
 end
 
-return mkdir
+return touch
@@ -0,0 +1,75 @@
+-- Runs a learner session without a window, for the headless host (--host=DIRECTORY; see
+-- host_script.c). The engine gives every session a Lua state of its own, runs the game's loop
+-- in it (without ever rendering), and has this file type in the lines of the session's input
+-- file, one by one, whenever the shell is ready for one, as if they came from the keyboard.
+package.path = "data/scripts/?.lua;" .. package.path
+
+dofile("data/scripts/loop.lua")
+local steps = require "command/_tutorial"
+
+local tick_period = 1000000 / 60 -- Microseconds simulated by each update
+local tick_limit = 60 * 60 * 10 -- Most updates a session is run for (ten minutes of game time)
+
+local input = {} -- Lines to type in
+local typed = 0 -- Number of lines typed in so far
+local ticks = 0 -- Number of updates run so far
+local exited = false -- Did the session run exit?
+
+Host = {
+   -- Reads the input of the session from the file at `path` and starts the game. Returns nil
+   -- and an error message if the file can't be read.
+   Start = function (path)
+      local file, err = io.open(path, "r")
+      if file == nil then
+         return nil, err
+      end
+      for line in file:lines() do
+         table.insert(input, (string.gsub(line, "\r$", "")))
+      end
+      file:close()
+
+      Loop.Init()
+      return true
+   end,
+
+   -- Runs the session for up to `count` updates. Returns true once it is over: all of its
+   -- input has been typed in and every job it started is done, it exited, or it ran out of
+   -- updates.
+   Run = function (count)
+      for _ = 1, count do
+         local ready = (Game.Jobs:foreground() == nil)
+         if exited or ticks >= tick_limit or
+            (ready and typed == #input and #Game.Jobs.jobs == 0) then
+            return true
+         end
+
+         local events = {}
+         if ready and typed < #input then
+            typed = typed + 1
+            events = {
+               {Device = "Text", Type = "Text", Text = input[typed]},
+               {Device = "Text", Type = "Control", Control = "Enter"},
+            }
+         end
+
+         ticks = ticks + 1
+         if not Loop.Update(tick_period, events) then
+            exited = true
+         end
+      end
+      return false
+   end,
+
+   -- Returns how far the session got
+   Report = function ()
+      return {
+         lines = #input, -- Lines in the input file
+         typed = typed, -- Lines typed in
+         ticks = ticks, -- Updates run
+         step = steps.index, -- Tutorial step reached
+         finished = steps.finished, -- Was the tutorial finished?
+         exited = exited, -- Did the session exit (rather than run out of input)?
+         timeout = (ticks >= tick_limit), -- Did it run out of updates?
+      }
+   end,
+}
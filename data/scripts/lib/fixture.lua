@@ -0,0 +1,129 @@
+-- Builds synthetic filesystem trees for tests and benchmarks. The same seed and options always
+-- build the same tree, since the random numbers come from a generator of our own (Park-Miller)
+-- rather than math.random, whose sequence depends on the C library.
+local fixture = {}
+
+-- Options of fixture.generate, and their defaults
+fixture.defaults = {
+   seed = 1,
+   inodes = 1000, -- Inodes to create (besides the directory the tree is built in)
+   depth = 6, -- Deepest level of directories below it
+   fanout = 16, -- Average number of children of a directory
+   directories = 0.2, -- Chance of a child being a directory (when it isn't at the deepest level)
+   name_min = 1, -- Shortest name
+   name_max = 12, -- Longest name
+   name_skew = 2, -- Lengths are name_min + (name_max - name_min) * x^name_skew, x in [0, 1)
+   size_min = 0, -- Fewest bytes in a file
+   size_max = 64, -- Most bytes in a file
+   sample = 256, -- Directories and files to pick out for the caller to work on
+}
+
+local name_characters = "abcdefghijklmnopqrstuvwxyz0123456789_."
+local contents = string.rep("The quick brown fox jumps over the lazy dog.\n", 64)
+
+-- Returns a generator of random numbers from `seed`. Called with `n`, it returns an integer in
+-- [1, n]; called without, a number in [0, 1).
+function fixture.random (seed)
+   -- NOTE(naman): 16807 * (2^31 - 2) < 2^53, so the products are exact in a double.
+   local state = (math.floor(seed) % 2147483646) + 1
+   return function (n)
+      state = (state * 16807) % 2147483647
+      if n == nil then
+         return (state - 1) / 2147483646
+      end
+      return (state % n) + 1
+   end
+end
+
+-- Returns a random name made of `length` characters, which doesn't start with a "."
+local function name (random, length)
+   local characters = {}
+   for i = 1, length do
+      local c = random(#name_characters - (i == 1 and 1 or 0))
+      characters[i] = string.sub(name_characters, c, c)
+   end
+   return table.concat(characters)
+end
+
+-- Builds a tree in the directory `root` (an inode) of the filesystem `fs` (see lib/fs.lua), as
+-- described by `options` (see fixture.defaults; missing ones take their default). Directories
+-- are filled breadth first until there are `options.inodes` inodes. Returns the number of
+-- directories and files created, and `options.sample` of each, picked at random.
+function fixture.generate (fs, root, options)
+   local o = {}
+   for k, v in pairs(fixture.defaults) do
+      o[k] = v
+   end
+   for k, v in pairs(options or {}) do
+      o[k] = v
+   end
+
+   local random = fixture.random(o.seed)
+   local vfs = fs.vfs
+
+   local result = {directories = 0, files = 0, sample = {directories = {}, files = {}}}
+
+   -- Keeps a random sample of the inodes seen so far (reservoir sampling)
+   local function pick (sample, seen, inode)
+      if #sample < o.sample then
+         table.insert(sample, inode)
+      else
+         local slot = random(seen)
+         if slot <= o.sample then
+            sample[slot] = inode
+         end
+      end
+   end
+
+   -- Directories still to be filled, from queue[head] to queue[tail]
+   local queue = {{root, 0}}
+   local head, tail = 1, 1
+   local created = 0
+   while created < o.inodes do
+      if head > tail then
+         -- The tree is as deep as it can get, so it grows wider from the top
+         queue, head, tail = {{root, 0}}, 1, 1
+      end
+
+      local directory, level = queue[head][1], queue[head][2]
+      queue[head] = nil
+      head = head + 1
+
+      local children = random(2 * o.fanout - 1)
+      for _ = 1, math.min(children, o.inodes - created) do
+         local kind = "f"
+         if level < o.depth and random() < o.directories then
+            kind = "d"
+         end
+
+         local length = o.name_min + math.floor((o.name_max - o.name_min + 1) *
+                                                random() ^ o.name_skew)
+         local inode = vfs:insert(directory, name(random, length), kind)
+         if inode == nil then
+            -- NOTE(naman): Short names run out quickly, so a name that is taken gets a suffix
+            -- that no other generated name has.
+            inode = vfs:insert(directory, name(random, length) .. "~" .. created, kind)
+         end
+         created = created + 1
+
+         if kind == "d" then
+            result.directories = result.directories + 1
+            pick(result.sample.directories, result.directories, inode)
+            tail = tail + 1
+            queue[tail] = {inode, level + 1}
+         else
+            local size = o.size_min + random(o.size_max - o.size_min + 1) - 1
+            while size > 0 do
+               vfs:append(inode, string.sub(contents, 1, size))
+               size = size - math.min(size, #contents)
+            end
+            result.files = result.files + 1
+            pick(result.sample.files, result.files, inode)
+         end
+      end
+   end
+
+   return result
+end
+
+return fixture
@@ -1,113 +1,226 @@
+-- Wrapper around the engine's filesystem (Engine.Functions.VFSNew), which keeps track of the
+-- working directory. Inodes are IDs, paths can be absolute or relative to the working directory.
 local filesystem = {}
 filesystem.__index = filesystem
 
-function filesystem.new (inode_lib)
-    local fs = setmetatable({}, filesystem)
-    fs.inode = inode_lib.new("", "d")
-
-    return fs
-end
-
-function filesystem.segments (path)
-   if path == "/" then return {} end
-   local parts = {}
-   for part in path:gmatch("[^/]+") do
-      table.insert(parts, part)
-   end
-   local i = 1
-   while i <= #parts do
-      if parts[i] == "." then
-         table.remove(parts, i)
-      elseif parts[i] == ".." then
-         table.remove(parts, i)
-         i = i - 1
-         if i < 1 then
-            return nil, "Invalid path \"" .. path .. "\""
-         end
-         table.remove(parts, i)
-      else
-         i = i + 1
+function filesystem.new ()
+   local fs = setmetatable({}, filesystem)
+   fs.vfs = Engine.Functions.VFSNew()
+   fs.root = fs.vfs:root()
+   fs.pwd = fs.root
+   fs.checkpoints = {} -- Working directory at each checkpoint, by number
+
+   return fs
+end
+
+-- Returns the inode at `path`, or nil and an error message
+function filesystem:lookup (path)
+   return self.vfs:lookup(path, self.pwd)
+end
+
+-- Returns the path of `inode` (the paths of directories end with "/")
+function filesystem:path (inode)
+   return self.vfs:path(inode)
+end
+
+function filesystem:name (inode)
+   local name = self.vfs:stat(inode)
+   return name
+end
+
+-- Returns "f" for files and "d" for directories
+function filesystem:kind (inode)
+   local _, kind = self.vfs:stat(inode)
+   return kind
+end
+
+-- Iterates over the children of the directory `inode`, as: id, name, kind
+function filesystem:children (inode)
+   return self.vfs:children(inode)
+end
+
+-- Completes the path `word`. Returns the paths it can be completed to (the first `limit` of
+-- them, in sorted order and with a "/" after directories), how many there are, and the longest
+-- path that all of them start with.
+function filesystem:complete (word, limit)
+   local dir, base = string.match(word, "^(.*/)([^/]*)$")
+   local inode = self.pwd
+   if dir == nil then
+      dir, base = "", word
+   else
+      inode = self:lookup(dir)
+      if inode == nil then
+         return {}, 0, word
       end
    end
 
-   return parts
+   local paths, count, common = self.vfs:complete(inode, base, limit)
+   for i, name in ipairs(paths) do
+      paths[i] = dir .. name
+   end
+   return paths, count, dir .. common
 end
 
-function filesystem:path (inode)
-   local path = ""
-   local cur = inode
-
-   repeat
-      path = cur.name .. "/" ..  path
-      cur = cur.parent
-   until cur == nil
-
-   return path
-end
-
-function filesystem:insert (inode, parent_path)
-   local parts, err = self.segments(parent_path)
-   local root = self.inode
-   local parent = root
-
-   if parts ~= nil then
-      for _, p in ipairs(parts) do
-         local child = nil
-         local i = 1
-         while child == nil and i <= #parent.children do
-            if parent.children[i].name == p then
-               child = parent.children[i]
-            end
-            i = i + 1
-         end
-
-         if child == nil then
-            return false, "Parent \"" .. parent_path .. "\" doesn't exist"
-         elseif child.kind ~= "d" then
-            return false, "\"" .. parent_path .. "\" is not a directory"
-         else
-            parent = child
-         end
+-- Expands the glob pattern `pattern` (see glob.c). Returns the paths that match, in sorted
+-- order (the first `limit` of them), which is empty if none do.
+function filesystem:glob (pattern, limit)
+   return self.vfs:glob(pattern, self.pwd, limit)
+end
+
+-- Creates a `kind` ("f" or "d") at `path`, whose parent directory must exist
+function filesystem:insert (path, kind)
+   local parent, name = self.vfs:split(path, self.pwd)
+   if parent == nil then
+      return nil, name
+   end
+
+   return self.vfs:insert(parent, name, kind)
+end
+
+-- Moves `src_path` into the directory `dest_path`, or renames it to `dest_path` (replacing the
+-- file that might be there)
+function filesystem:move (src_path, dest_path)
+   local src, err = self:lookup(src_path)
+   if src == nil then
+      return nil, err
+   end
+
+   local dest = self:lookup(dest_path)
+   if dest ~= nil and self:kind(dest) == "d" then
+      return self.vfs:move(src, dest, self:name(src))
+   end
+
+   local parent, name = self.vfs:split(dest_path, self.pwd)
+   if parent == nil then
+      return nil, name
+   end
+
+   if dest ~= nil then
+      if dest == src then
+         return true
+      elseif self:kind(src) == "d" then
+         return nil, "Can't overwrite \"" .. dest_path .. "\" with a directory"
       end
-   else
-      return false, err
+      self.vfs:remove(dest)
    end
 
-   inode.parent = parent
-   table.insert(parent.children, inode)
+   return self.vfs:move(src, parent, name)
+end
+
+-- Returns an iterator over the lines of the file at `path`, or nil and an error message
+function filesystem:lines (path)
+   local inode, err = self:lookup(path)
+   if inode == nil then
+      return nil, err
+   end
+
+   return self.vfs:lines(inode)
+end
+
+-- Returns the file at `path` for writing, creating it if needed. The file is emptied first,
+-- unless `append` is true.
+function filesystem:open (path, append)
+   local inode = self:lookup(path)
+   if inode == nil then
+      return self:insert(path, "f")
+   elseif not append then
+      local success, err = self.vfs:truncate(inode)
+      if not success then
+         return nil, err
+      end
+   end
+
+   return inode
+end
+
+-- Writes `lines` (a table of strings, each followed by a newline) to the file at `path`, as
+-- filesystem:open does
+function filesystem:write (path, lines, append)
+   local inode, err = self:open(path, append)
+   if inode == nil then
+      return nil, err
+   end
+
+   for _, line in ipairs(lines) do
+      self.vfs:append(inode, line, "\n")
+   end
 
    return true
 end
 
-function filesystem:cd (path)
-   local parts, err = self.segments(path)
-   local root = self.inode
-   local parent = root
-
-   if parts ~= nil then
-      for _, p in ipairs(parts) do
-         local child = nil
-         local i = 1
-         while child == nil and i <= #parent.children do
-            if parent.children[i].name == p then
-               child = parent.children[i]
-            end
-            i = i + 1
-         end
-
-         if child == nil then
-            return false, "Directory \"" .. p .. "\" doesn't exist"
-         elseif child.kind ~= "d" then
-            return false, "\"" .. child.name .. "\" is not a directory"
-         else
-            parent = child
-         end
+-- Copies the file `src_path` into the directory `dest_path`, or to the file `dest_path`
+-- (replacing its contents). The contents are shared until either file is written to.
+function filesystem:copy (src_path, dest_path)
+   local src, err = self:lookup(src_path)
+   if src == nil then
+      return nil, err
+   elseif self:kind(src) == "d" then
+      return nil, "\"" .. src_path .. "\" is a directory"
+   end
+
+   local dest = self:lookup(dest_path)
+   if dest ~= nil and self:kind(dest) == "d" then
+      local parent = dest
+      dest = self.vfs:lookup(self:name(src), parent)
+      if dest == nil then
+         dest, err = self.vfs:insert(parent, self:name(src), "f")
       end
-   else
+   elseif dest == nil then
+      dest, err = self:insert(dest_path, "f")
+   end
+   if dest == nil then
+      return nil, err
+   elseif dest == src then
+      return nil, "\"" .. src_path .. "\" and \"" .. dest_path .. "\" are the same file"
+   end
+
+   return self.vfs:copy(src, dest)
+end
+
+-- Removes `path` (and everything under it, if `recursive`)
+function filesystem:remove (path, recursive)
+   local inode, err = self:lookup(path)
+   if inode == nil then
+      return nil, err
+   end
+
+   local success, err = self.vfs:remove(inode, recursive)
+   if success and not self.vfs:valid(self.pwd) then
+      self.pwd = self.root
+   end
+
+   return success, err
+end
+
+-- Takes a checkpoint of the tree and the working directory. Taking one costs the same whatever
+-- the size of the tree. Returns its number, for filesystem:restore and filesystem:release.
+function filesystem:checkpoint ()
+   local checkpoint = self.vfs:checkpoint()
+   self.checkpoints[checkpoint] = self.pwd
+   return checkpoint
+end
+
+-- Puts the tree and the working directory back the way they were at `checkpoint`, which stays
+-- (the ones taken after it are released)
+function filesystem:restore (checkpoint)
+   self.vfs:restore(checkpoint)
+   self.pwd = self.checkpoints[checkpoint]
+end
+
+-- Releases `checkpoint` and the ones taken after it, keeping the changes made since
+function filesystem:release (checkpoint)
+   self.vfs:release(checkpoint)
+end
+
+function filesystem:cd (path)
+   local inode, err = self:lookup(path)
+   if inode == nil then
       return false, err
+   elseif self:kind(inode) ~= "d" then
+      return false, "\"" .. path .. "\" is not a directory"
    end
 
-   Game.FS.pwd = parent
+   self.pwd = inode
 
    return true
 end
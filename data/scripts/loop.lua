@@ -1,66 +1,141 @@
 package.path = "data/scripts/?.lua;" .. package.path
 
-local command = require "command/command"
 local tutorial = require "tutorial"
-local lex = require "lib/lex"
-local inode = require "lib/inode"
 local fs = require "lib/fs"
 local getopt = require "command/_getopt"
-local commands = require "command/command"
+local job = require "command/_job"
+local command = require "command/command"
+local complete = require "command/_complete"
+local steps = require "command/_tutorial"
 require "lib/table"
 
+local job_instructions_per_tick = 2000000 -- Lua instructions the jobs can run per update
+local job_microseconds_per_tick = 4000 -- Time the jobs can take per update
+local scrollback_lines = 100000 -- Lines kept in the scrollback
+local scrollback_bytes = 4 * 1024 * 1024 -- Bytes of text kept in the scrollback
+local glob_matches = 10000 -- Paths a glob pattern can expand to
+local session_period = 2000000 -- Microseconds between saves of the session (if it changed)
+
+-- Saves the session (the engine writes it out in the background), so that the game picks up
+-- where it left off when it is started again
+local function save_session ()
+   Engine.Functions.SessionSave(Game.FS.vfs, Game.Text, Game.Tutorial_Text, {
+      pwd = Game.FS:path(Game.FS.pwd),
+      line = Game.Line,
+      tutorial = steps.index,
+   })
+   Game.Session_Changed = false
+end
+
 Loop = {
    Init = function ()
-      Game.Result = true -- The return value of Loop
+      Game.Result = true -- The return value of Loop.Update
 
       Game.Messages = {} -- System messages
       Game.Line = "" -- The line of text being typed in currently
-      -- prompt can be a string or nil (in case of output strings)
-      Game.Text = {{["prompt"] = "", ["text"] = ""}} -- The text that might be need to rendered this frame
+      -- Lines typed in (with their prompt) and printed (without one); the last is the one being
+      -- typed in. Only the newest lines are kept, and only those on the screen are rendered.
+      Game.Text = Engine.Functions.ScrollbackNew(scrollback_lines, scrollback_bytes)
+      Game.Text:push("", "")
 
       Game.Here_Doc = false -- Are we in heredoc mode?
       Game.Parse_Complete = false -- Has the entirety of command been inserted and parsed?
-      Game.Parse = {{["args"] = ""}} -- Contains parse of the entire inserted command, each entrylike:
+      Game.Parse = {{["words"] = {}}} -- Contains parse of the entire inserted command, each entrylike:
       -- {["sequence"] = true/false (&&),
+      --  ["pipe"] = true/false (|),
       --  ["background"] = true/false (&),
+      --  ["job"] = true/false (after a &),
       --  ["output"] = filename (>/>>),
       --  ["output_append"] = true/false (>>),
       --  ["input"] = filename (<),
       --  ["heredoc"] = true/false (<<),
       --  ["heredoc_str"] = {"","",...} (<<),
-      --  ["args"] = command
+      --  ["words"] = {"command", "arg", ...}
       -- }
 
       Game.Output = nil -- Contains the output of any command
 
-      Game.FS = fs.new(inode)
-      Game.FS.pwd = Game.FS.inode
-      Game.FS:insert(inode.new("vmlinux1", "f"), "/")
-      Game.FS:insert(inode.new("vmlinuz2", "f"), "/")
-      Game.FS:insert(inode.new("home", "d"), "/")
-      Game.FS:insert(inode.new("tmp", "d"), "/")
-      Game.FS:insert(inode.new("temp_file.nvidia", "f"), "/tmp/")
-      Game.FS:insert(inode.new("user", "d"), "/home/")
+      Game.FS = fs.new()
+      Game.FS:insert("/vmlinux1", "f")
+      Game.FS:insert("/vmlinuz2", "f")
+      Game.FS:insert("/home", "d")
+      Game.FS:insert("/tmp", "d")
+      Game.FS:insert("/tmp/temp_file.nvidia", "f")
+      Game.FS:insert("/home/user", "d")
 
       Game.Prompt = "user@cs699 " .. Game.FS:path(Game.FS.pwd) .. " $ "
       Game.Prompt_Show = true
 
+      -- Commands run by the shell itself, rather than as part of a pipeline
+      local shell = {
+         ["exit"] = function (words)
+            Game.Result = false
+            return {}
+         end,
+
+         ["reset"] = function (words)
+            if not steps.reset() then
+               return nil, "reset: no tutorial step to reset"
+            end
+            return {"The filesystem is back to how it was at the start of this step."}
+         end,
+
+         ["cd"] = function (words)
+            local parse = getopt.parse(words)
+            if parse ~= nil and #parse.args >= 1 then
+               local success, err = Game.FS:cd(parse.args[1])
+               if not success then
+                  return nil, err
+               end
+            end
+            return {}
+         end,
+      }
+      Game.Jobs = job.new(Game.FS, shell) -- Jobs that are running
+      Game.Complete = complete.new(Game.FS, command.names, Game.Jobs:builtins()) -- Tab completion
+
       Game.Cursor_Visible = true
       Game.Cursor_Toggle_At = 500000
       Game.Cursor_Time_Left = Game.Cursor_Toggle_At
 
-      Game.Tutorial_Text = {""} -- Tutorial text
+      Game.Sounds = { -- IDs of the audio samples
+         Click = Engine.Functions.AudioSinusoidal(2000, 0.03, 200),
+         Hum = Engine.Functions.AudioSinusoidal(60, 1),
+      }
+      if Game.Sounds.Hum ~= nil then
+         Engine.Functions.AudioPlay(Game.Sounds.Hum, 0.03, true)
+      end
+
+      Game.Tutorial_Text = Engine.Functions.ScrollbackNew(scrollback_lines, scrollback_bytes)
+      Game.Tutorial_Text:push("")
+
+      -- The session saved when the game was last closed (if there is one) takes the place of
+      -- the filesystem and the scrollbacks, and the tutorial passes over the steps done in it
+      local session = Engine.Functions.SessionLoad(Game.FS.vfs, Game.Text, Game.Tutorial_Text)
+      if session ~= nil then
+         Game.FS.pwd = Game.FS:lookup(session.pwd or "/") or Game.FS.root
+         Game.Line = session.line or ""
+         steps.resume(session.tutorial or 0)
+      end
+      Game.Session_Changed = false -- Has anything been typed in or run since the last save?
+      Game.Session_Time_Left = session_period
+
+      local subsystem = Engine.Functions.MemoryAttribute("tutorial")
       Game.Tutorial = coroutine.create(tutorial.tutorial)
       Game.Tutorial_In_Progress = true
       Game.Tutorial_In_Progress, Game.Tutorial_Text_Current = coroutine.resume(Game.Tutorial)
-      if Game.Tutorial_Text_Current ~= nil then
+      Engine.Functions.MemoryAttribute(subsystem)
+      -- The restored tutorial text already ends with the instructions of the current step
+      if Game.Tutorial_Text_Current ~= nil and session == nil then
          for i = 1, #Game.Tutorial_Text_Current do
-            table.insert(Game.Tutorial_Text, Game.Tutorial_Text_Current[i])
+            Game.Tutorial_Text:push(Game.Tutorial_Text_Current[i])
          end
       end
    end,
 
-   Loop = function (last_frame_time, events)
+   -- Called at a fixed tick, with the microseconds simulated by each tick (dt) and the events
+   -- that came in since the last update. Returns false to quit.
+   Update = function (dt, events)
       Game.Result = true
       Game.Prompt = "user@cs699 " .. Game.FS:path(Game.FS.pwd) .. " $ "
 
@@ -80,12 +155,14 @@ Loop = {
          end
       end
 
-      local y_min, y_max = Assets.Fonts.Mono.YMin, Assets.Fonts.Mono.YMax
-      local y_dim = y_max - y_min
       local newline = false
 
       for _, msg in ipairs(messages) do -- Process the text input and convert it into line input
          if msg.Type == "Text" then
+            Game.Session_Changed = true
+            if Game.Sounds.Click ~= nil then
+               Engine.Functions.AudioPlay(Game.Sounds.Click, 0.25)
+            end
             if msg.Text ~= nil then
                Game.Line = Game.Line .. msg.Text
             else
@@ -95,11 +172,26 @@ Loop = {
                   if not newline then
                      Game.Line = string.sub(Game.Line, 1, string.len(Game.Line) - 1)
                   end
+               elseif msg.Control == "Tab" then
+                  if not newline and not Game.Here_Doc and Game.Jobs:foreground() == nil then
+                     local list
+                     Game.Line, list = Game.Complete:line(Game.Line)
+                     if list ~= nil then
+                        Game.Output = Game.Output or {}
+                        for _, line in ipairs(list) do
+                           table.insert(Game.Output, line)
+                        end
+                     end
+                  end
                end
             end
          end
       end
 
+      if newline and Game.Jobs:foreground() ~= nil then
+         newline = false -- Lines can't be entered until the job in the foreground is done
+      end
+
       if Game.Here_Doc == true then
          Game.Prompt_Show = false
       else
@@ -136,33 +228,66 @@ Loop = {
             end
          else -- Parsing
             local parse = Game.Parse
-            local pos = 1
-            local token, pos = lex.NextToken(Game.Line, pos)
-            while token ~= "" do
-               if token == "&" then
+            local tokens, kinds = Engine.Functions.ShellTokenize(Game.Line)
+
+            -- Returns a glob pattern as a plain word, without the backslashes that make its
+            -- wildcards literal
+            local function literal (pattern)
+               return (string.gsub(pattern, "\\(.)", "%1"))
+            end
+
+            -- Returns the word after the operator at index i (the target of a redirection),
+            -- which is never expanded
+            local function target (i)
+               if kinds[i + 1] == "word" then
+                  return tokens[i + 1], i + 2
+               elseif kinds[i + 1] == "glob" then
+                  return literal(tokens[i + 1]), i + 2
+               end
+               return "", i + 1
+            end
+
+            local i = 1
+            while i <= #tokens do
+               local kind = kinds[i]
+               if kind == "&" then
                   parse[#parse].background = true
-               elseif token == "&&" then
-                  table.insert(parse, {["args"] = ""})
+                  table.insert(parse, {["words"] = {}})
+                  parse[#parse].job = true
+                  i = i + 1
+               elseif kind == "&&" then
+                  table.insert(parse, {["words"] = {}})
                   parse[#parse].sequence = true
-               elseif token == ">" then
-                  parse[#parse].output, pos = lex.NextToken(Game.Line, pos)
-                  parse[#parse].output_append = false
-               elseif token == ">>" then
-                  parse[#parse].output, pos = lex.NextToken(Game.Line, pos)
-                  parse[#parse].output_append = true
-               elseif token == "<" then
-                  parse[#parse].input, pos = lex.NextToken(Game.Line, pos)
-               elseif token == "<<" then
+                  i = i + 1
+               elseif kind == "|" then
+                  table.insert(parse, {["words"] = {}})
+                  parse[#parse].pipe = true
+                  i = i + 1
+               elseif kind == ">" or kind == ">>" then
+                  parse[#parse].output, i = target(i)
+                  parse[#parse].output_append = (kind == ">>")
+               elseif kind == "<" then
+                  parse[#parse].input, i = target(i)
+               elseif kind == "<<" then
                   parse[#parse].heredoc = true
                   parse[#parse].heredoc_todo = true
                   parse[#parse].heredoc_str = {""}
-                  parse[#parse].heredoc_marker, pos = lex.NextToken(Game.Line, pos)
+                  parse[#parse].heredoc_marker, i = target(i)
                   Game.Here_Doc = true
+               elseif kind == "glob" then
+                  -- A pattern that matches nothing is passed on as it is
+                  local paths = Game.FS:glob(tokens[i], glob_matches)
+                  if #paths == 0 then
+                     paths = {literal(tokens[i])}
+                  end
+                  for _, path in ipairs(paths) do
+                     table.insert(parse[#parse].words, path)
+                  end
+                  i = i + 1
                else
-                  parse[#parse].args = parse[#parse].args .. " " .. token
+                  table.insert(parse[#parse].words, tokens[i])
+                  i = i + 1
                end
-
-            token, pos = lex.NextToken(Game.Line, pos)
             end
             Game.Parse = parse
             Game.Parse_Complete = true
@@ -170,51 +295,51 @@ Loop = {
       end
 
       if Game.Parse_Complete == true and Game.Here_Doc == false then
-         local parse, parse_error = getopt.parse(Game.Parse[1].args)
-         if parse == nil then
-            Game.Output = {parse_error}
-         else
-            -- local command = Game.Parse[1].args:gmatch("%S+")()
-            local command = parse.command
-
-            if command == nil then
-               Game.Output = {"Invalid command"}
-            elseif command == "" then
-            elseif command == "exit" then
-               Game.Result = false
-            elseif command == "cd" then
-               local success, err
-               if #parse.args >= 1 then
-                  if parse.args[1]:sub(1, 1) == "/" then
-                     success, err = Game.FS:cd(parse.args[1])
-                  else
-                     success, err = Game.FS:cd(Game.FS:path(Game.FS.pwd) .. parse.args[1])
-                  end
-
-                  if not success then
-                     Game.Output = {err}
-                  end
+         -- Split the stages into jobs (at each &), made of pipelines (a | b) that are run one
+         -- after the other (&&)
+         local groups = {}
+         for i, stage in ipairs(Game.Parse) do
+            if stage.pipe and #groups > 0 then
+               table.insert(groups[#groups], stage)
+            else
+               if stage.job and #groups > 0 then
+                  local background = Game.Jobs:spawn(groups, true)
+                  Game.Output = Game.Output or {}
+                  table.insert(Game.Output, "[" .. background.id .. "]")
+                  groups = {}
                end
-            elseif commands[command] ~= nil then
-               local out, err = commands[command].call(parse)
-               if out == nil then
-                  Game.Output = {err}
-               else
-                  Game.Output = out
+               if stage.job and i == #Game.Parse and #stage.words == 0 then
+                  break -- Nothing after the last &
                end
-            else
-               Game.Output = {"Error: command \"" .. command .. "\" not found"}
+               table.insert(groups, {stage})
             end
          end
+         if #groups > 0 then
+            Game.Jobs:spawn(groups, false)
+         end
 
-         Game.Parse = {{["args"] = ""}}
+         Game.Parse = {{["words"] = {}}}
          Game.Parse_Complete = false
+      end
+
+      do -- Jobs
+         local subsystem = Engine.Functions.MemoryAttribute("commands")
+         local out = Game.Jobs:run(job_instructions_per_tick, job_microseconds_per_tick)
+         Engine.Functions.MemoryAttribute(subsystem)
+         if #out > 0 then
+            Game.Output = Game.Output or {}
+            for _, line in ipairs(out) do
+               table.insert(Game.Output, line)
+            end
+         end
+
+         if Game.Jobs:foreground() ~= nil then
+            Game.Prompt_Show = false
+         end
 
-         -- Game.Output = {}
-         -- local out = table.show(Game.FS.inode)
-         -- for line in out:gmatch("[^\n]+") do
-         --    table.insert(Game.Output, line)
-         -- end
+         if #out > 0 or #Game.Jobs.jobs > 0 then
+            Game.Session_Changed = true
+         end
       end
 
       if Game.Here_Doc == true or Game.Prompt_Show == false then
@@ -225,36 +350,32 @@ Loop = {
 
 
       do -- Game.Text
-         Game.Text[#Game.Text].text = Game.Line
-         local prompt = nil
-         if Game.Prompt_Show then
-            Game.Text[#Game.Text].prompt = Game.Prompt
-            prompt = Game.Prompt
+         -- The last line is the one being typed in; output (which can keep coming in over many
+         -- ticks while a job runs) goes above it
+         local _, prompt = Game.Text:last()
+         Game.Text:pop()
+         if newline then
+            Game.Text:push(Game.Line, prompt)
          end
 
          if Game.Output ~= nil then
             for _, l in ipairs(Game.Output) do
-               table.insert(Game.Text, {["prompt"] = nil, ["text"] = l})
+               Game.Text:push(l)
             end
             Game.Output = nil
          end
 
-         if newline then
-            table.insert(Game.Text, {["prompt"] = prompt, ["text"] = ""})
-         end
-
-         if #Game.Text > math.floor(2/y_dim) then
-            local diff = #Game.Text - math.floor(2/y_dim)
-            for i = 1, diff do
-               table.remove(Game.Text, i)
-            end
-         end
-
+         local current = newline and "" or Game.Line
          if Game.Cursor_Visible == true then
-            Game.Text[#Game.Text].text = Game.Text[#Game.Text].text .. "_"
+            current = current .. "_"
+         end
+         if Game.Prompt_Show then
+            Game.Text:push(current, Game.Prompt)
+         else
+            Game.Text:push(current)
          end
 
-         Game.Cursor_Time_Left = Game.Cursor_Time_Left - last_frame_time
+         Game.Cursor_Time_Left = Game.Cursor_Time_Left - dt
          if Game.Cursor_Time_Left <= 0 then
             if Game.Cursor_Visible == true then
                Game.Cursor_Visible = false
@@ -266,123 +387,11 @@ Loop = {
          end
       end
 
-      do -- Convert Line input into renderable text and render it
-         local render_text = {}
-
-         local line_extra = 0
-         for line_num, line_tab in ipairs(Game.Text) do
-            local line = line_tab.text
-            local prompt = line_tab.prompt
-            local word = ""
-            local x = 0
-
-            local function chars(str)
-               local strc = {}
-               for i = 1, #str do
-                  table.insert(strc, string.sub(str, i, i))
-               end
-               return strc
-            end
-
-            table.insert(render_text, {["prompt"] = prompt, ["text"] = "", ["x"] = 0})
-
-            if prompt ~= nil then
-               render_text[#render_text].prompt = prompt
-               x = Engine.Functions.RenderGetTextDimensions(Assets.Fonts.Mono, prompt)
-               render_text[#render_text].x = x
-               prompt = ""
-            end
-            word = ""
-            local line_char = chars(line)
-
-            for i = 1, #line do
-               local c = line_char[i]
-
-               if c == " " then
-                  if word == "" then
-                     local x_inc = Engine.Functions.RenderGetTextDimensions(Assets.Fonts.Mono,
-                                                                            " ")
-                     x = x + x_inc
-                     if x >= 1 then
-                        table.insert(render_text, {["prompt"] = prompt, ["text"] = " "})
-                        x = 0
-                     else
-                        render_text[#render_text].text = render_text[#render_text].text .. " "
-                     end
-                  else
-                     local x_inc = Engine.Functions.RenderGetTextDimensions(Assets.Fonts.Mono,
-                                                                            word)
-                     if x + x_inc >= 1 then
-                        x = 0
-                        table.insert(render_text, {["prompt"] = prompt, ["text"] = word})
-                     else
-                        render_text[#render_text].text = render_text[#render_text].text .. word
-                     end
-
-                     x = x + x_inc
-
-                     local x_inc = Engine.Functions.RenderGetTextDimensions(Assets.Fonts.Mono,
-                                                                            " ")
-                     if x + x_inc >= 1 then
-                        table.insert(render_text, {["prompt"] = prompt, ["text"] = ""})
-                        x = 0
-                     else
-                        render_text[#render_text].text = render_text[#render_text].text .. " "
-                     end
-                     x = x + x_inc
-
-                     word  = ""
-                  end
-               else
-                  word = word .. c
-               end
-            end
-
-            if word ~= "" then
-               local x_inc = Engine.Functions.RenderGetTextDimensions(Assets.Fonts.Mono, word)
-               if x + x_inc >= 1 then
-                  x = 0
-                  table.insert(render_text, {["prompt"] = prompt, ["text"] = word})
-               else
-                  render_text[#render_text].text = render_text[#render_text].text .. word
-               end
-               x = x + x_inc
-            end
-         end
-
-         local render_text_begin = 1
-         local render_upper_bound = math.floor(2/y_dim) - 1
-         if #render_text > render_upper_bound then
-            local diff = #render_text - render_upper_bound
-            render_text_begin = diff
-         end
-
-         for i = render_text_begin, #render_text do
-            if render_text[i].prompt ~= nil then
-               Engine.Functions.RenderText(Assets.Fonts.Mono, render_text[i].prompt,
-                                           Vector(0, 1 - (i - render_text_begin + 1) * y_dim, 0),
-                                           Color(0.11, 1, 0.39, 1))
-            end
-
-            local text_color
-            if render_text[i].prompt ~= nil then
-               text_color = Color(0.11, 1, 0.09, 1)
-            else
-               text_color = Color(0.41, 1, 0.09, 1)
-            end
-            Engine.Functions.RenderText(Assets.Fonts.Mono, render_text[i].text,
-                                        Vector(render_text[i].x,
-                                               1 - (i - render_text_begin + 1) * y_dim,
-                                               0),
-                                        text_color)
-         end
-      end
-
-
-
       do -- Process tutorial text
          if newline then
+            local subsystem = Engine.Functions.MemoryAttribute("tutorial")
             Game.Tutorial_In_Progress, Game.Tutorial_Text_Current = coroutine.resume(Game.Tutorial, Game.Line)
+            Engine.Functions.MemoryAttribute(subsystem)
          else
             Game.Tutorial_Text_Current = nil
          end
@@ -393,120 +402,55 @@ Loop = {
 
          if Game.Tutorial_Text_Current ~= nil then
             for i = 1, #Game.Tutorial_Text_Current do
-               table.insert(Game.Tutorial_Text, Game.Tutorial_Text_Current[i])
-            end
-         end
-
-         if #Game.Tutorial_Text > math.floor(2/y_dim) then
-            local diff = #Game.Tutorial_Text - math.floor(2/y_dim)
-            for i = 1, diff do
-               table.remove(Game.Tutorial_Text, i)
+               Game.Tutorial_Text:push(Game.Tutorial_Text_Current[i])
             end
          end
       end
 
-      do -- Convert tutorial text into renderable text and render it
-         local render_text = {}
+      do -- Finalize
+         if newline then
+            Game.Line = ""
+         end
 
-         local line_extra = 0
-         for line_num, line in ipairs(Game.Tutorial_Text) do
-            local word = ""
-            local x = -1
+         Game.Messages = {}
+      end
 
-            local function chars(str)
-               local strc = {}
-               for i = 1, #str do
-                  table.insert(strc, string.sub(str, i, i))
-               end
-               return strc
+      do -- Session
+         Game.Session_Time_Left = Game.Session_Time_Left - dt
+         if Game.Session_Time_Left <= 0 then
+            if Game.Session_Changed then
+               save_session()
             end
+            Game.Session_Time_Left = session_period
+         end
+      end
 
-            local line_char = chars(line)
-
-            table.insert(render_text, "")
-
-            for i = 1, #line do
-               local c = line_char[i]
-
-               if c == " " then
-                  if word == "" then
-                     local x_inc = Engine.Functions.RenderGetTextDimensions(Assets.Fonts.Mono,
-                                                                            " ")
-                     x = x + x_inc
-                     if x >= 0 then
-                        table.insert(render_text, " ")
-                        x = -1
-                     else
-                        render_text[#render_text] = render_text[#render_text] .. " "
-                     end
-                  else
-                     local x_inc = Engine.Functions.RenderGetTextDimensions(Assets.Fonts.Mono,
-                                                                            word)
-                     if x + x_inc >= 0 then
-                        x = -1
-                        table.insert(render_text, word)
-                     else
-                        render_text[#render_text] = render_text[#render_text] .. word
-                     end
-
-                     x = x + x_inc
-
-                     local x_inc = Engine.Functions.RenderGetTextDimensions(Assets.Fonts.Mono,
-                                                                            " ")
-                     if x + x_inc >= 0 then
-                        table.insert(render_text, "")
-                        x = -1
-                     else
-                        render_text[#render_text] = render_text[#render_text] .. " "
-                     end
-                     x = x + x_inc
+      return Game.Result
+   end,
 
-                     word  = ""
-                  end
-               else
-                  word = word .. c
-               end
-            end
+   -- Called once when the game is closed
+   Quit = function ()
+      save_session()
+   end,
 
-            if word ~= "" then
-               local x_inc = Engine.Functions.RenderGetTextDimensions(Assets.Fonts.Mono, word)
-               if x + x_inc >= 0 then
-                  x = -1
-                  table.insert(render_text, {["prompt"] = prompt, ["text"] = word})
-               else
-                  render_text[#render_text] = render_text[#render_text] .. word
-               end
-               x = x + x_inc
-            end
-         end
+   -- Called once per rendered frame, with how far (in [0, 1]) the present is between the last
+   -- update and the next one
+   Render = function (alpha)
+      local y_min, y_max = Assets.Fonts.Mono.YMin, Assets.Fonts.Mono.YMax
+      local y_dim = y_max - y_min
 
-         local render_text_begin = 1
-         local render_upper_bound = math.floor(2/y_dim) - 1
-         if #render_text > render_upper_bound then
-            local diff = #render_text - render_upper_bound
-            render_text_begin = diff
-         end
+      local rows = math.floor(2/y_dim) - 1
 
-         for i = render_text_begin, #render_text do
-            -- local text_color = Color(0.41, 1, 0.09, 1)
-            local text_color = Color(0.09, 0.41, 1, 1)
-            Engine.Functions.RenderText(Assets.Fonts.Mono, render_text[i],
-                                        Vector(-1,
-                                               1 - (i - render_text_begin + 1) * y_dim,
-                                               0),
-                                        text_color)
-         end
+      do -- Render the lines typed in and printed on the right half
+         Game.Text:render(Assets.Fonts.Mono, 0, 1, rows, y_dim,
+                          Color(0.41, 1, 0.09, 1), -- Output
+                          Color(0.11, 1, 0.39, 1), -- Prompt
+                          Color(0.11, 1, 0.09, 1)) -- Input
       end
 
-      do -- Finalize
-         if newline then
-            Game.Line = ""
-         end
-
-         Game.Messages = {}
+      do -- Render the tutorial text on the left half
+         Game.Tutorial_Text:render(Assets.Fonts.Mono, -1, 0, rows, y_dim,
+                                   Color(0.09, 0.41, 1, 1))
       end
-
-
-      return Game.Result
    end,
 }
@@ -7,7 +7,9 @@ function tutorial.tutorial ()
          "Directories can be navigated by using \"cd\" command.",
          "    Please change to home directory by entering:",
          "",
-         "            cd home"
+         "            cd home",
+         "",
+         "(If something goes wrong in a step, \"reset\" undoes it.)"
    })
 
    t.step("cd ..", {
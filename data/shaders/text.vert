@@ -1,7 +1,7 @@
 #version 330 core
 
-in vec2 position;
-in vec2 tex_coord;
+layout (location = 0) in vec2 position;
+layout (location = 1) in vec2 tex_coord;
 
 out vec2 Tex_coord;
 
@@ -7,6 +7,42 @@
  * @brief Functions for assets loading
  */
 
+/**
+* @brief This function creates a GLSL shader program from already read sources.
+*
+* @param vertex_path Path of vertex shader (used to name the program)
+* @param fragment_path Path of fragment shader (used to name the program)
+* @param vertex_src Source of vertex shader
+* @param fragment_src Source of fragment shader
+* @param program Used to return the GLSL program handle
+*
+* @return success/failure
+*/
+internal_function
+B32 assetCreateShader (char *vertex_path, char *fragment_path,
+                       char *vertex_src, char *fragment_src,
+                       GLuint *program)
+{
+    Size name_length = strlen(vertex_path) + strlen(fragment_path) + 2;
+    Char *name = malloc(name_length);
+    snprintf(name, name_length, "%s+%s", vertex_path, fragment_path);
+
+    S32 program_temp = openglShaderCreate(name, vertex_src, fragment_src);
+    free(name);
+
+    if (program_temp < 0) {
+        logConsole(LOG_LEVEL_CRITICAL,
+                   LOG_CHANNEL_SCRIPT,
+                   "Couldn't load shaders %s and %s",
+                   vertex_path, fragment_path);
+        return false;
+    }
+
+    *program = (GLuint)program_temp;
+
+    return true;
+}
+
 /**
 * @brief This function load the GLSL shaders assets for visual effetcs.
 *
@@ -36,34 +72,213 @@ B32 assetLoadShader (char* vertex_path,
         return false;
     }
 
-    S32 program_temp = 0;
-    if ((program_temp = openglShaderCreate(vertex_src, fragment_src)) < 0) {
-        logConsole(LOG_LEVEL_CRITICAL,
-                   LOG_CHANNEL_SCRIPT,
-                   "Couldn't load shaders %s and %s",
-                   vertex_path, fragment_path);
+    B32 result = assetCreateShader(vertex_path, fragment_path,
+                                   vertex_src, fragment_src,
+                                   program);
 
-        free(vertex_src);
-        free(fragment_src);
+    free(vertex_src);
+    free(fragment_src);
+
+    return result;
+}
+
+/**
+* @brief Growable buffer used to collect the output of lua_dump
+*/
+typedef struct Asset_Chunk_Buffer {
+    Byte *data; /**< Dumped bytecode */
+    Size size; /**< Bytes written into @ref data */
+    Size capacity; /**< Bytes allocated for @ref data */
+} Asset_Chunk_Buffer;
+
+/**
+* @brief Writer function passed to lua_dump
+*
+* Appends the piece of bytecode produced by lua_dump to the @ref Asset_Chunk_Buffer
+* passed in @p user_data.
+*
+* @param l Lua context
+* @param piece Piece of bytecode
+* @param piece_size Size of @p piece
+* @param user_data Buffer to append to
+*
+* @return Execution status (0 on success)
+*/
+internal_function
+Sint assetChunkWriter (lua_State *l, const void *piece, Size piece_size, void *user_data)
+{
+    unused_variable(l);
+    Asset_Chunk_Buffer *buffer = user_data;
+
+    if ((buffer->size + piece_size) > buffer->capacity) {
+        Size capacity = (buffer->capacity * 2) + piece_size;
+        Byte *data = realloc(buffer->data, capacity);
+        if (data == NULL) {
+            return 1;
+        }
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
 
+    memcpy(buffer->data + buffer->size, piece, piece_size);
+    buffer->size += piece_size;
+
+    return 0;
+}
+
+/**
+* @brief This function loads compiled Lua bytecode.
+*
+* @param game The Lua context in which the chunk is loaded
+* @param script_path Path of Lua script source file the bytecode was compiled from
+* @param bytecode Bytecode
+* @param bytecode_size Size of @p bytecode
+*
+* @return Execution status (the chunk or the error message is left on the stack)
+*/
+internal_function
+B32 assetLoadScriptBytecode (lua_State *game,
+                             const Char *script_path,
+                             const Byte *bytecode, Size bytecode_size)
+{
+    Size chunk_name_length = strlen(script_path) + 2;
+    Char *chunk_name = malloc(chunk_name_length);
+    snprintf(chunk_name, chunk_name_length, "@%s", script_path);
+    Sint status = luaL_loadbuffer(game, (const Char*)bytecode, bytecode_size, chunk_name);
+    free(chunk_name);
+
+    return (status == 0);
+}
+
+/**
+* @brief This function compiles Lua source into bytecode, going through the bytecode cache.
+*
+* If the cache has bytecode for @p script_path that was compiled from exactly @p script_src,
+* that bytecode is returned. Otherwise the source is compiled in @p compiler and its bytecode
+* is written to the cache for the next run. Since this doesn't modify any state apart from
+* the stack of @p compiler, it can be run on any thread that owns its @p compiler.
+*
+* @param compiler The Lua context used for compilation
+* @param script_path Path of Lua script source file
+* @param script_src Source of Lua script
+* @param script_size Size of @p script_src
+* @param bytecode_size Returns the size of the bytecode
+*
+* @return Bytecode (to be freed by the caller), NULL on failure with the error message left
+*         on the top of the stack of @p compiler
+*/
+internal_function
+Byte* assetCompileScriptBytecode (lua_State *compiler,
+                                  const Char *script_path,
+                                  const Char *script_src, Size script_size,
+                                  Size *bytecode_size)
+{
+    U64 key = cacheHash(LUA_RELEASE, strlen(LUA_RELEASE), CACHE_HASH_SEED);
+    key = cacheHash(script_src, script_size, key);
+
+    Size chunk_name_length = strlen(script_path) + 2;
+    Char *chunk_name = malloc(chunk_name_length);
+    snprintf(chunk_name, chunk_name_length, "@%s", script_path);
+
+    if (global_cache.mode == CACHE_MODE_COMPARE) {
+        U64 counter = SDL_GetPerformanceCounter();
+        luaL_loadbuffer(compiler, script_src, script_size, chunk_name);
+        lua_pop(compiler, 1);
+        cacheRecord(false, 0, timeMicrosecondsElapsed(&counter));
+    }
+
+    U64 counter = SDL_GetPerformanceCounter();
+
+    Byte *bytecode = cacheRead("script", script_path, key, bytecode_size);
+    if (bytecode != NULL) {
+        if (global_cache.mode == CACHE_MODE_COMPARE) {
+            cacheRecord(true, timeMicrosecondsElapsed(&counter), 0);
+        }
+        free(chunk_name);
+        return bytecode;
+    }
+
+    if (luaL_loadbuffer(compiler, script_src, script_size, chunk_name)) {
+        free(chunk_name);
+        return NULL;
+    }
+    free(chunk_name);
+
+    Asset_Chunk_Buffer buffer = {0};
+    if (lua_dump(compiler, assetChunkWriter, &buffer) != 0) {
+        free(buffer.data);
+        lua_pop(compiler, 1);
+        lua_pushfstring(compiler, "couldn't dump bytecode of %s", script_path);
+        return NULL;
+    }
+    lua_pop(compiler, 1);
+
+    cacheWrite("script", script_path, key, buffer.data, buffer.size);
+
+    if (global_cache.mode == CACHE_MODE_COMPARE) {
+        cacheRecord(false, timeMicrosecondsElapsed(&counter), 0);
+    }
+
+    *bytecode_size = buffer.size;
+    return buffer.data;
+}
+
+/**
+* @brief This function compiles Lua source, going through the bytecode cache.
+*
+* The source is turned into bytecode by @ref assetCompileScriptBytecode and then loaded. If
+* the cached bytecode is rejected by Lua, the cache is bypassed and the source is compiled
+* directly. Like luaL_loadbuffer, the compiled chunk (or the error message) is left on the
+* top of the stack.
+*
+* @param game The Lua context in which the chunk is loaded
+* @param script_path Path of Lua script source file
+* @param script_src Source of Lua script
+* @param script_size Size of @p script_src
+*
+* @return Execution status
+*/
+internal_function
+B32 assetCompileScript (lua_State *game,
+                        const Char *script_path,
+                        const Char *script_src, Size script_size)
+{
+    Size bytecode_size = 0;
+    Byte *bytecode = assetCompileScriptBytecode(game, script_path,
+                                                script_src, script_size,
+                                                &bytecode_size);
+    if (bytecode == NULL) {
         return false;
     }
 
-    *program = (GLuint)program_temp;
+    if (assetLoadScriptBytecode(game, script_path, bytecode, bytecode_size)) {
+        free(bytecode);
+        return true;
+    }
+    free(bytecode);
 
-    free(vertex_src);
-    free(fragment_src);
+    logConsole(LOG_LEVEL_WARN,
+               LOG_CHANNEL_ASSETS,
+               "Cached bytecode for %s rejected: %s",
+               script_path,
+               lua_tostring(game, -1));
+    lua_pop(game, 1);
 
-    return true;
+    Size chunk_name_length = strlen(script_path) + 2;
+    Char *chunk_name = malloc(chunk_name_length);
+    snprintf(chunk_name, chunk_name_length, "@%s", script_path);
+    Sint status = luaL_loadbuffer(game, script_src, script_size, chunk_name);
+    free(chunk_name);
 
+    return (status == 0);
 }
 
 /**
 * @brief This function load the Lua script for gameplay code.
 *
 * It reads the Lua script file at @p script_path and compiles it into
-* a Lua context @p game. If any errors occur during compilation, it also
-* takes care of them.
+* a Lua context @p game (see @ref assetCompileScript). If any errors occur during
+* compilation, it also takes care of them.
 *
 * @param game The Lua context in which the scripts will be run
 * @param script_path Path of Lua script source file
@@ -75,10 +290,11 @@ internal_function
 B32 assetLoadScript (lua_State *game,
                      char *script_path)
 {
-    char *script_src = (Char*)fileRead(script_path, NULL);
-    if (script_path == NULL) return false;
+    Size script_size = 0;
+    char *script_src = (Char*)fileRead(script_path, &script_size);
+    if (script_src == NULL) return false;
 
-    if (luaL_loadstring(game, script_src) ||
+    if ((assetCompileScript(game, script_path, script_src, script_size) == false) ||
         lua_pcall(game, 0, 0, 0)) {
         logConsole(LOG_LEVEL_CRITICAL,
                    LOG_CHANNEL_SCRIPT,
@@ -97,74 +313,168 @@ B32 assetLoadScript (lua_State *game,
 }
 
 /**
-* @brief This function load a TTF font and bakes it into a bitmap.
+* @brief This function bakes a TTF font into a bitmap, going through the font atlas cache.
 *
-* It load the font file and using stb_truetype library, bakes the vector
-* font into a bitmap that can be rendered using OpenGL's native capabilities
-* to render textured quads.
+* The cache entry is keyed by the hash of the font file and by all the parameters that
+* affect the baking. On a hit, the cached bitmap and character table are copied out and the
+* rasterization is skipped entirely. On a miss, the font is baked using stb_truetype and
+* the result is written to the cache.
 *
 * @param font_path Path of the font file
 * @param font_size Point size of rendered font
-* @param vert_path Path of vertex shader used for text rendering
-* @param frag_path Path of fragment shader used for text rendering
-* @param bitmap_width Width opf baked bitmap
-* @param bitmap_height Heifght of baked bitmap
+* @param bitmap_width Width of baked bitmap
+* @param bitmap_height Height of baked bitmap
 * @param char_first First renderable character
 * @param char_num Total number of renderable characters
+* @param bitmap Returns the baked bitmap (@p bitmap_width x @p bitmap_height bytes)
+* @param baked_char Returns the baked character table (@p char_num entries)
+*
+* @return Execution status
+*/
+internal_function
+B32 assetBakeTrueTypeFont (Char *font_path, U32 font_size,
+                           U32 bitmap_width, U32 bitmap_height,
+                           U32 char_first, U32 char_num,
+                           U8 *bitmap, stbtt_bakedchar *baked_char)
+{
+    Size ttf_size = 0;
+    U8 *ttf_buffer = fileRead(font_path, &ttf_size);
+    if (ttf_buffer == NULL) {
+        return false;
+    }
+
+    Size bitmap_size = sizeof(*bitmap) * bitmap_width * bitmap_height;
+    Size table_size = sizeof(*baked_char) * char_num;
+
+    U32 parameters[] = {font_size, bitmap_width, bitmap_height, char_first, char_num};
+    U64 key = cacheHash(ttf_buffer, ttf_size, CACHE_HASH_SEED);
+    key = cacheHash(parameters, sizeof(parameters), key);
+
+    Char entry_name[512] = {0};
+    snprintf(entry_name, sizeof(entry_name), "%s:%u:%ux%u:%u+%u",
+             font_path, font_size, bitmap_width, bitmap_height, char_first, char_num);
+
+    if (global_cache.mode == CACHE_MODE_COMPARE) {
+        U64 counter = SDL_GetPerformanceCounter();
+        stbtt_BakeFontBitmap(ttf_buffer, 0,
+                             (F32)font_size,
+                             bitmap,
+                             (int)bitmap_width, (int)bitmap_height,
+                             (int)char_first, (int)char_num,
+                             baked_char);
+        cacheRecord(false, 0, timeMicrosecondsElapsed(&counter));
+    }
+
+    U64 counter = SDL_GetPerformanceCounter();
+
+    Size cached_size = 0;
+    Byte *cached = cacheRead("font", entry_name, key, &cached_size);
+    if ((cached != NULL) && (cached_size == (bitmap_size + table_size))) {
+        memcpy(bitmap, cached, bitmap_size);
+        memcpy(baked_char, cached + bitmap_size, table_size);
+        free(cached);
+        free(ttf_buffer);
+
+        if (global_cache.mode == CACHE_MODE_COMPARE) {
+            cacheRecord(false, timeMicrosecondsElapsed(&counter), 0);
+        }
+
+        return true;
+    }
+    free(cached);
+
+    stbtt_BakeFontBitmap(ttf_buffer, 0,
+                         (F32)font_size,
+                         bitmap,
+                         (int)bitmap_width, (int)bitmap_height,
+                         (int)char_first, (int)char_num,
+                         baked_char);
+
+    free(ttf_buffer);
+
+    if (global_cache.mode != CACHE_MODE_OFF) {
+        Byte *entry = malloc(bitmap_size + table_size);
+        memcpy(entry, bitmap, bitmap_size);
+        memcpy(entry + bitmap_size, baked_char, table_size);
+        cacheWrite("font", entry_name, key, entry, bitmap_size + table_size);
+        free(entry);
+    }
+
+    if (global_cache.mode == CACHE_MODE_COMPARE) {
+        cacheRecord(false, timeMicrosecondsElapsed(&counter), 0);
+    }
+
+    return true;
+}
+
+/**
+* @brief Structure describing a loaded TTF font
+*
+* This contains everything that the renderer needs to know about a font, and is copied into
+* the Lua table representing the font by @ref assetSetTrueTypeFontFields.
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Asset_Font {
+    Char *font_path; /**< Path of the font file */
+    U32 font_size; /**< Point size of rendered font */
+    F32 scaling_factor; /**< Scaling factor applied to quads */
+    F32 x_scaling; /**< Horizontal scaling constant (aspect ratio of the window) */
+    Char *vert_path; /**< Path of vertex shader used for text rendering */
+    Char *frag_path; /**< Path of fragment shader used for text rendering */
+    U32 bitmap_width; /**< Width of baked bitmap */
+    U32 bitmap_height; /**< Height of baked bitmap */
+    U32 char_first; /**< First renderable character */
+    U32 char_num; /**< Total number of renderable characters */
+    stbtt_bakedchar *baked_char; /**< Baked character table */
+    GLuint vao; /**< Vertex Array Object */
+    GLuint vbo; /**< Vertex Buffer Object */
+    GLuint program; /**< Handle for compiled shader */
+    GLuint texture; /**< Handle for texture stored GPU side */
+} Asset_Font;
+#pragma clang diagnostic pop
+
+/**
+* @brief This function uploads a baked font bitmap to the GPU.
+*
+* It sets up the vertex layout of the text quads in @p vao and uploads the @p bitmap
+* baked by @ref assetBakeTrueTypeFont into a texture, so that the font can be rendered using
+* OpenGL's native capabilities to render textured quads.
+*
+* @param bitmap Baked bitmap
+* @param bitmap_width Width of baked bitmap
+* @param bitmap_height Height of baked bitmap
 * @param vao Vertex Array Object
 * @param vbo Vertex Buffer Object
-* @param baked_char Baked bitmap
-* @param program Returns handle for compiled shader
 * @param texture Returns handle for texture stored GPU side
 *
 * @return Execution status
 */
-
 internal_function
-B32 assetLoadTrueTypeFont (Char *font_path, U32 font_size,
-                           Char *vert_path, Char *frag_path,
-                           U32 bitmap_width, U32 bitmap_height,
-                           U32 char_first, U32 char_num,
-                           GLuint vao, GLuint vbo,
-                           stbtt_bakedchar **baked_char,
-                           GLuint *program, GLuint *texture)
+B32 assetUploadTrueTypeFont (U8 *bitmap,
+                             U32 bitmap_width, U32 bitmap_height,
+                             GLuint vao, GLuint vbo,
+                             GLuint *texture)
 {
     glBindVertexArray(vao);
 
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
 
-    assetLoadShader(vert_path, frag_path, program);
-    glUseProgram(*program);
-
-    GLint pos_attrib = glGetAttribLocation(*program, "position");
-    glVertexAttribPointer((GLuint)pos_attrib,
+    // NOTE(naman): The attribute locations are fixed in the shader, so that the program
+    // doesn't need to be linked yet (see openglShaderCreate).
+    glVertexAttribPointer(0,
                           2,
                           GL_FLOAT, GL_FALSE,
                           4 * sizeof(float),
                           0);
-    glEnableVertexAttribArray((GLuint)pos_attrib);
+    glEnableVertexAttribArray(0);
 
-    GLint tex_attrib = glGetAttribLocation(*program, "tex_coord");
-    glVertexAttribPointer((GLuint)tex_attrib,
+    glVertexAttribPointer(1,
                           2,
                           GL_FLOAT, GL_FALSE,
                           4 * sizeof(float),
                           (void*)(2*sizeof(GLfloat)));
-    glEnableVertexAttribArray((GLuint)tex_attrib);
-
-    U8 *ttf_buffer = fileRead(font_path, NULL);
-
-    U8 *bitmap = malloc(sizeof(*bitmap) * bitmap_width * bitmap_height);
-    *baked_char = malloc(sizeof(**baked_char) * char_num);
-
-    stbtt_BakeFontBitmap(ttf_buffer, 0,
-                         font_size,
-                         bitmap,
-                         (int)bitmap_width, (int)bitmap_height,
-                         (int)char_first, (int)char_num,
-                         *baked_char);
-
-    free(ttf_buffer);
+    glEnableVertexAttribArray(1);
 
     glGenTextures(1, texture);
     glBindTexture(GL_TEXTURE_2D, *texture);
@@ -179,8 +489,7 @@ B32 assetLoadTrueTypeFont (Char *font_path, U32 font_size,
                  bitmap);
     glGenerateMipmap(GL_TEXTURE_2D);
 
-    glUniform1i(glGetUniformLocation(*program, "font_bitmap"), 0);
-    free(bitmap);
+    // NOTE(naman): The sampler uniform "font_bitmap" defaults to texture unit 0
 
     glBindTexture(GL_TEXTURE_2D, 0);
     glBindVertexArray(0);
@@ -188,3 +497,65 @@ B32 assetLoadTrueTypeFont (Char *font_path, U32 font_size,
 
     return true;
 }
+
+/**
+* @brief This function copies the description of a loaded font into a Lua table.
+*
+* @param l Lua context
+* @param index Stack index of the table representing the font
+* @param font Loaded font
+*/
+internal_function
+void assetSetTrueTypeFontFields (lua_State *l, Sint index, Asset_Font *font)
+{
+    if (index < 0) {
+        index = lua_gettop(l) + index + 1;
+    }
+
+    lua_pushstring(l, font->font_path);
+    lua_setfield(l, index, "FontPath");
+
+    lua_pushnumber(l, font->font_size);
+    lua_setfield(l, index, "FontSize");
+
+    lua_pushnumber(l, (F64)font->scaling_factor);
+    lua_setfield(l, index, "ScalingFactor");
+
+    lua_pushnumber(l, (F64)font->x_scaling);
+    lua_setfield(l, index, "XScaling");
+
+    lua_pushstring(l, font->vert_path);
+    lua_setfield(l, index, "VertexPath");
+
+    lua_pushstring(l, font->frag_path);
+    lua_setfield(l, index, "FragmentPath");
+
+
+    lua_pushnumber(l, font->bitmap_width);
+    lua_setfield(l, index, "BitmapWidth");
+
+    lua_pushnumber(l, font->bitmap_height);
+    lua_setfield(l, index, "BitmapHeight");
+
+    lua_pushnumber(l, font->char_first);
+    lua_setfield(l, index, "CharacterFirst");
+
+    lua_pushnumber(l, font->char_num);
+    lua_setfield(l, index, "CharacterCount");
+
+
+    lua_pushlightuserdata(l, font->baked_char);
+    lua_setfield(l, index, "CharacterTable");
+
+    lua_pushnumber(l, font->vao);
+    lua_setfield(l, index, "VAO");
+
+    lua_pushnumber(l, font->vbo);
+    lua_setfield(l, index, "VBO");
+
+    lua_pushnumber(l, font->program);
+    lua_setfield(l, index, "Program");
+
+    lua_pushnumber(l, font->texture);
+    lua_setfield(l, index, "Texture");
+}
@@ -8,10 +8,13 @@
  */
 
 /**
-* @brief Lua injected function which calls @ref assetLoadScript
+* @brief Lua injected function which loads a script through the loader
 *
-* This function is called from Lua and is used to call into @ref assetLoadScript using
-* proper parameters.
+* This function is called from Lua and submits the script to the asset loader, which compiles
+* it on a worker thread. The script is run (and its path stored in the table passed as the
+* first argument) once the main thread retires it, in the order of the calls.
+* If the optional third argument is true, the script is instead compiled and run before
+* returning (this is used to resolve lazy assets on first use).
 *
 * @param l Lua context
 *
@@ -20,126 +23,192 @@
 internal_function
 Sint scriptAssetLoadScript (lua_State *l)
 {
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wincompatible-pointer-types-discards-qualifiers"
-    lua_State *game = lua_topointer(l, lua_upvalueindex(1));
-    char *script_path = luaL_checkstring(l, 2);
-#pragma clang diagnostic pop
-
-    if (assetLoadScript(game, script_path) == false) {
-        logConsole(LOG_LEVEL_CRITICAL,
-                   LOG_CHANNEL_ASSETS,
-                   "Couldn't load script %s",
-                   script_path);
-        // TODO(naman): Quit gracefully
-        global_game_is_running = false;
-    }
+    luaL_checktype(l, 1, LUA_TTABLE);
+    const Char *script_path = luaL_checkstring(l, 2);
+
+    Loader_Job *job = loaderJobCreate(LOADER_JOB_SCRIPT, true);
+    job->path = loaderCopyString(script_path);
 
-    lua_pushstring(l, script_path);
-    lua_setfield(l, 1, "ScriptPath");
+    lua_pushvalue(l, 1);
+    job->table_ref = luaL_ref(l, LUA_REGISTRYINDEX);
+
+    if (lua_toboolean(l, 3)) {
+        loaderRunImmediately(l, job);
+    } else {
+        loaderSubmit(job);
+    }
 
     return 0;
 }
 
 /**
-* @brief Lua injected function which calls @ref assetLoadTrueTypeFont
+* @brief Lua injected function which compiles a script ahead of it being required
 *
-* This function is called from Lua and is used to call into @ref assetLoadTrueTypeFont using
-* proper parameters.
+* This function is called from Lua with the path of a script that will later be loaded
+* through `require`. The script is compiled on a worker thread, so that `require` only has
+* to load the finished bytecode.
 *
 * @param l Lua context
 *
 * @return Execution status
 */
 internal_function
-int scriptAssetLoadTrueTypeFont (lua_State *l)
+Sint scriptAssetPrefetchScript (lua_State *l)
 {
-    System *system = lua_topointer(l, lua_upvalueindex(1));
-
-    Char *font_path = luaL_checkstring(l, 2);
-    U32 font_size = (U32)luaL_checknumber(l, 3);
-    F32 scaling_factor = (F32)luaL_checknumber(l, 4);
-    Char *vert_path = luaL_checkstring(l, 5);
-    Char *frag_path = luaL_checkstring(l, 6);
-
-    F32 x_scaling = (F32)system->window.height/(F32)system->window.width;
-
-    // x_scaling = 1;
-    // TODO: Is there any way to automate this to prevent manually
-    // checking if the bitmap fits?
-    U32 bitmap_height = 512;
-    U32 bitmap_width = 512;
-
-    U32 char_first = 32;
-    U32 char_num = 95;  // ASCII 32..126 is 95 glyphs
-
-    stbtt_bakedchar *baked_char = NULL;
-
-    U32 vao = 0, vbo = 0, texture = 0, program = 0;
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-
-    if (assetLoadTrueTypeFont(font_path, font_size,
-                              vert_path, frag_path,
-                              bitmap_width, bitmap_height,
-                              char_first, char_num,
-                              vao, vbo,
-                              &baked_char,
-                              &program, &texture) == false) {
-        logConsole(LOG_LEVEL_CRITICAL,
-                   LOG_CHANNEL_ASSETS,
-                   "Couldn't load TTF %s",
-                   font_path);
-        global_game_is_running = false;
-    }
-
-
-    lua_pushstring(l, font_path);
-    lua_setfield(l, 1, "FontPath");
+    const Char *script_path = luaL_checkstring(l, 1);
 
-    lua_pushnumber(l, font_size);
-    lua_setfield(l, 1, "FontSize");
+    Loader_Job *job = loaderJobCreate(LOADER_JOB_SCRIPT, false);
+    job->path = loaderCopyString(script_path);
 
-    lua_pushnumber(l, (F64)scaling_factor);
-    lua_setfield(l, 1, "ScalingFactor");
+    loaderSubmit(job);
 
-    lua_pushnumber(l, (F64)x_scaling);
-    lua_setfield(l, 1, "XScaling");
-
-    lua_pushstring(l, vert_path);
-    lua_setfield(l, 1, "VertexPath");
+    return 0;
+}
 
-    lua_pushstring(l, frag_path);
-    lua_setfield(l, 1, "FragmentPath");
+/**
+* @brief Lua searcher for `require` which loads modules through @ref assetCompileScript
+*
+* This function replaces the standard Lua file searcher in `package.loaders`. It looks up
+* the module in `package.path` the same way the standard searcher does, but compiles it
+* through the bytecode cache (or takes the bytecode prefetched by
+* @ref scriptAssetPrefetchScript).
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+int scriptAssetSearchScript (lua_State *l)
+{
+    const Char *module_name = luaL_checkstring(l, 1);
+    const Char *name = luaL_gsub(l, module_name, ".", "/"); // name
+
+    lua_getfield(l, LUA_GLOBALSINDEX, "package"); // name package
+    lua_getfield(l, -1, "path"); // name package path
+    const Char *templates = lua_tostring(l, -1);
+    if (templates == NULL) {
+        return luaL_error(l, "'package.path' must be a string");
+    }
 
+    lua_pushliteral(l, ""); // name package path errors
+
+    while (*templates != '\0') {
+        const Char *end = strchr(templates, ';');
+        if (end == NULL) {
+            end = templates + strlen(templates);
+        }
+
+        if (end != templates) {
+            lua_pushlstring(l, templates, (Size)(end - templates)); // ... errors template
+            Char *file_path = luaL_gsub(l, lua_tostring(l, -1), "?", name);
+            // ... errors template file_path
+            lua_remove(l, -2); // ... errors file_path
+
+            Size bytecode_size = 0;
+            Byte *bytecode = loaderTakePrefetched(file_path, &bytecode_size);
+            if (bytecode != NULL) {
+                B32 loaded = assetLoadScriptBytecode(l, file_path, bytecode, bytecode_size);
+                free(bytecode);
+                if (loaded) {
+                    return 1;
+                }
+                lua_pop(l, 1); // ... errors file_path
+            }
+
+            SDL_RWops *rwops = SDL_RWFromFile(file_path, "rb");
+            if (rwops != NULL) {
+                SDL_RWclose(rwops);
+
+                Size script_size = 0;
+                Char *script_src = (Char*)fileRead(file_path, &script_size);
+                if (script_src == NULL) {
+                    return luaL_error(l, "error reading module '%s' from file '%s'",
+                                      module_name, file_path);
+                }
+
+                B32 compiled = assetCompileScript(l, file_path, script_src, script_size);
+                free(script_src);
+                // ... errors file_path <chunk>
+                if (compiled == false) {
+                    return luaL_error(l, "error loading module '%s' from file '%s':\n\t%s",
+                                      module_name, file_path, lua_tostring(l, -1));
+                }
+
+                return 1;
+            }
+
+            lua_pushfstring(l, "\n\tno file '%s'", file_path); // ... errors file_path error
+            lua_remove(l, -2); // ... errors error
+            lua_concat(l, 2); // ... errors
+        }
+
+        templates = (*end == ';') ? (end + 1) : end;
+    }
 
-    lua_pushnumber(l, bitmap_width);
-    lua_setfield(l, 1, "BitmapWidth");
+    return 1;
+}
 
-    lua_pushnumber(l, bitmap_height);
-    lua_setfield(l, 1, "BitmapHeight");
+/**
+* @brief Lua injected function which loads a TTF font through the loader
+*
+* This function is called from Lua and submits the font to the asset loader, which bakes it
+* on a worker thread. Once the main thread has uploaded it, the fields describing the font
+* are set in the table passed as the first argument, and the optional callback passed as the
+* seventh argument is called with that table. If the optional eighth argument is true, the
+* font is instead baked and uploaded before returning (this is used to resolve lazy assets on
+* first use).
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+int scriptAssetLoadTrueTypeFont (lua_State *l)
+{
+    System *system = lua_topointer(l, lua_upvalueindex(1));
 
-    lua_pushnumber(l, char_first);
-    lua_setfield(l, 1, "CharacterFirst");
+    luaL_checktype(l, 1, LUA_TTABLE);
+    const Char *font_path = luaL_checkstring(l, 2);
+    U32 font_size = (U32)luaL_checknumber(l, 3);
+    F32 scaling_factor = (F32)luaL_checknumber(l, 4);
+    const Char *vert_path = luaL_checkstring(l, 5);
+    const Char *frag_path = luaL_checkstring(l, 6);
+    if (lua_isnoneornil(l, 7) == false) {
+        luaL_checktype(l, 7, LUA_TFUNCTION);
+    }
 
-    lua_pushnumber(l, char_num);
-    lua_setfield(l, 1, "CharacterCount");
+    Loader_Job *job = loaderJobCreate(LOADER_JOB_FONT, true);
+    Asset_Font *font = &job->font;
 
+    font->font_path = loaderCopyString(font_path);
+    font->font_size = font_size;
+    font->scaling_factor = scaling_factor;
+    font->x_scaling = (F32)system->window.height/(F32)system->window.width;
+    font->vert_path = loaderCopyString(vert_path);
+    font->frag_path = loaderCopyString(frag_path);
 
-    lua_pushlightuserdata(l, baked_char);
-    lua_setfield(l, 1, "CharacterTable");
+    // x_scaling = 1;
+    // TODO: Is there any way to automate this to prevent manually
+    // checking if the bitmap fits?
+    font->bitmap_height = 512;
+    font->bitmap_width = 512;
 
-    lua_pushnumber(l, vao);
-    lua_setfield(l, 1, "VAO");
+    font->char_first = 32;
+    font->char_num = 95;  // ASCII 32..126 is 95 glyphs
 
-    lua_pushnumber(l, vbo);
-    lua_setfield(l, 1, "VBO");
+    lua_pushvalue(l, 1);
+    job->table_ref = luaL_ref(l, LUA_REGISTRYINDEX);
 
-    lua_pushnumber(l, program);
-    lua_setfield(l, 1, "Program");
+    if (lua_isnoneornil(l, 7) == false) {
+        lua_pushvalue(l, 7);
+        job->callback_ref = luaL_ref(l, LUA_REGISTRYINDEX);
+    }
 
-    lua_pushnumber(l, texture);
-    lua_setfield(l, 1, "Texture");
+    if (lua_toboolean(l, 8)) {
+        loaderRunImmediately(l, job);
+    } else {
+        loaderSubmit(job);
+    }
 
     return 0;
 }
@@ -0,0 +1,1240 @@
+/**
+ * These functions implement the audio mixer. The audio device pulls samples through a callback
+ * that runs on SDL's audio thread, and which mixes a fixed pool of voices, each playing one of
+ * the samples that were loaded (and converted to the device's format) up front.
+ *
+ * The game thread never locks the audio device: it controls the voices by pushing commands into
+ * a lock-free single-producer single-consumer queue, which the callback drains before mixing.
+ *
+ * Long tracks are streamed instead: a decoder thread decodes them (WAV or Ogg Vorbis) a chunk at
+ * a time, converts each chunk to the device's format and writes it into a fixed-size ring
+ * buffer, from which the callback mixes them. So a track only ever takes a few hundred KB of
+ * memory, however long it is.
+ *
+ * @file audio.c
+ * @author Team Octal
+ * @brief Functions for audio mixing
+ */
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+#define AUDIO_MAX_VOICES 32 /* Voices that can play at the same time */
+#define AUDIO_MAX_SAMPLES 64 /* Samples that can be loaded */
+#define AUDIO_COMMAND_QUEUE_SIZE 256 /* Must be a power of two */
+#define AUDIO_CALLBACK_FRAMES 1600 /* Frames requested from the device per callback */
+#define AUDIO_TAU 6.28318530717958647692
+#define AUDIO_STREAM_RING_FRAMES 65536 /* Must be a power of two (~1.4 s at 48 kHz) */
+#define AUDIO_STREAM_CHUNK_FRAMES 4096 /* Frames decoded at a time */
+#define AUDIO_DECODER_PERIOD 10 /* Milliseconds between checks of the streams by the decoder */
+
+/**
+* @brief Enumeration of the commands sent from the game thread to the mixer
+*/
+enum Audio_Command_Kind {
+    AUDIO_COMMAND_PLAY, /**< Start playing a sample on a new voice */
+    AUDIO_COMMAND_PLAY_STREAM, /**< Start playing a stream on a new voice */
+    AUDIO_COMMAND_STOP, /**< Stop a voice */
+    AUDIO_COMMAND_SET_GAIN, /**< Change the gain of a voice */
+};
+
+/**
+* @brief Enumeration of the file formats that can be streamed
+*/
+enum Audio_Stream_Kind {
+    AUDIO_STREAM_WAV,
+    AUDIO_STREAM_OGG,
+};
+
+/**
+* @brief Track being streamed
+*
+* The decoder side (everything but the ring buffer's read position) belongs to whoever fills the
+* stream: the game thread until the stream is handed to the decoder thread, the decoder thread
+* after that. The stream is freed by the decoder thread once the mixer releases it.
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Audio_Stream {
+    struct Audio_Stream *next; /**< Next stream in the decoder's list */
+
+    enum Audio_Stream_Kind kind; /**< Format of the file */
+    FILE *file; /**< File (for WAV) */
+    long data_offset; /**< Offset of the samples in @ref file (for WAV) */
+    U32 data_size; /**< Size of the samples in @ref file (for WAV) */
+    U32 data_position; /**< Bytes of samples read from @ref file (for WAV) */
+    stb_vorbis *vorbis; /**< Decoder (for Ogg) */
+    B32 loop; /**< Does the track loop? */
+
+    SDL_AudioCVT cvt; /**< Conversion from the file's format to the mixer's */
+    void *chunk; /**< Buffer into which chunks are decoded and converted */
+    U32 frame_size; /**< Bytes per frame in the file's format */
+    U32 chunk_output_frames; /**< Most frames a converted chunk can have */
+    U32 channels; /**< Samples per frame in the mixer's format */
+
+    S16 *ring; /**< Ring buffer of converted frames */
+    SDL_atomic_t ring_write; /**< Frames written into @ref ring (by the decoder) */
+    SDL_atomic_t ring_read; /**< Frames read from @ref ring (by the mixer) */
+    SDL_atomic_t finished; /**< Has the whole track been written into @ref ring? */
+    SDL_atomic_t released; /**< Is the mixer done with the stream? */
+} Audio_Stream;
+#pragma clang diagnostic pop
+
+/**
+* @brief Command sent from the game thread to the mixer
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Audio_Command {
+    enum Audio_Command_Kind kind; /**< What to do */
+    U32 voice; /**< ID of the voice (assigned by the game thread) */
+    U32 sample; /**< Sample to play (for @ref AUDIO_COMMAND_PLAY) */
+    Audio_Stream *stream; /**< Stream to play (for @ref AUDIO_COMMAND_PLAY_STREAM) */
+    S16 gain; /**< Gain in Q15 fixed point */
+    B32 loop; /**< Should the sample loop (for @ref AUDIO_COMMAND_PLAY) */
+} Audio_Command;
+#pragma clang diagnostic pop
+
+/**
+* @brief Sample loaded into memory, in the format of the mixer
+*/
+typedef struct Audio_Sample {
+    S16 *data; /**< Interleaved frames */
+    U32 frame_count; /**< Number of frames in @ref data */
+} Audio_Sample;
+
+/**
+* @brief Voice of the mixer, playing a single sample
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Audio_Voice {
+    U32 id; /**< ID of the voice (0 if the voice is free) */
+    U32 sample; /**< Sample being played */
+    Audio_Stream *stream; /**< Stream being played (NULL if a sample is being played) */
+    U32 position; /**< Next frame of the sample to be mixed */
+    S16 gain; /**< Gain in Q15 fixed point */
+    B32 loop; /**< Does the sample loop? */
+} Audio_Voice;
+#pragma clang diagnostic pop
+
+/**
+* @brief State of a mixer
+*
+* The samples and the producer's side of the queue belong to the game thread; the voices and
+* the consumer's side of the queue belong to the audio thread.
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Audio_Mixer {
+    U32 frequency; /**< Frames per second */
+    U32 channels; /**< Samples per frame */
+
+    Audio_Sample samples[AUDIO_MAX_SAMPLES]; /**< Loaded samples */
+    U32 sample_count; /**< Number of samples in @ref samples */
+
+    Audio_Command commands[AUDIO_COMMAND_QUEUE_SIZE]; /**< Queue of commands */
+    SDL_atomic_t command_write; /**< Number of commands pushed (written by the game thread) */
+    SDL_atomic_t command_read; /**< Number of commands popped (written by the audio thread) */
+    U32 next_voice; /**< ID to give to the next voice */
+    U32 dropped_commands; /**< Commands dropped because the queue was full */
+
+    Audio_Voice voices[AUDIO_MAX_VOICES]; /**< Voices */
+    SDL_atomic_t dropped_voices; /**< Plays dropped because all voices were busy */
+    SDL_atomic_t stream_underruns; /**< Callbacks in which a stream ran out of frames */
+} Audio_Mixer;
+#pragma clang diagnostic pop
+
+/**
+* @brief State of the audio subsystem
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+global_variable struct Audio_State {
+    Audio_Mixer *mixer; /**< Mixer feeding the audio device (NULL if there is none) */
+
+    SDL_Thread *decoder; /**< Thread that fills the streams */
+    SDL_mutex *decoder_mutex; /**< Protects everything below */
+    SDL_cond *decoder_wake; /**< Signalled when there is a new stream */
+    Audio_Stream *streams; /**< Streams being filled */
+    B32 decoder_quit; /**< Should the decoder thread exit? */
+} global_audio;
+#pragma clang diagnostic pop
+
+/**
+* @brief Function to convert a gain to Q15 fixed point
+*
+* @param gain Gain (clamped to [0, 1])
+*
+* @return Gain in Q15
+*/
+internal_function
+S16 audioGainFixed (F32 gain)
+{
+    if (gain < 0.0f) {
+        gain = 0.0f;
+    } else if (gain > 1.0f) {
+        gain = 1.0f;
+    }
+
+    return (S16)(gain * 32767.0f);
+}
+
+/**
+* @brief Function to set up a mixer
+*
+* @param mixer Mixer
+* @param frequency Frames per second
+* @param channels Samples per frame
+*/
+internal_function
+void audioMixerInit (Audio_Mixer *mixer, U32 frequency, U32 channels)
+{
+    memset(mixer, 0, sizeof(*mixer));
+    mixer->frequency = frequency;
+    mixer->channels = channels;
+    mixer->next_voice = 1;
+}
+
+/**
+* @brief Function to free all the samples of a mixer
+*
+* The mixer must not be running (i.e. the audio device must have been closed).
+*
+* @param mixer Mixer
+*/
+internal_function
+void audioMixerFree (Audio_Mixer *mixer)
+{
+    for (U32 i = 0; i < mixer->sample_count; ++i) {
+        free(mixer->samples[i].data);
+    }
+    mixer->sample_count = 0;
+}
+
+/**
+* @brief Function to add a sample to the mixer
+*
+* @param mixer Mixer
+* @param data Interleaved frames in the mixer's format (owned by the mixer after this)
+* @param frame_count Number of frames
+* @param sample Returns the ID of the sample
+*
+* @return success/failure
+*/
+internal_function
+B32 audioSampleAdd (Audio_Mixer *mixer, S16 *data, U32 frame_count, U32 *sample)
+{
+    if ((mixer->sample_count == AUDIO_MAX_SAMPLES) || (frame_count == 0)) {
+        free(data);
+        return false;
+    }
+
+    // NOTE(naman): The audio thread only looks at a sample after it receives a command that
+    // refers to it, and pushing that command publishes the sample.
+    *sample = mixer->sample_count;
+    mixer->samples[mixer->sample_count].data = data;
+    mixer->samples[mixer->sample_count].frame_count = frame_count;
+    mixer->sample_count++;
+
+    return true;
+}
+
+/**
+* @brief Function to create a sinusoidal sample with an exponential decay
+*
+* Without decay, the length is rounded to a whole number of cycles, so that the sample can be
+* looped without a click.
+*
+* @param mixer Mixer
+* @param frequency Frequency of the wave (Hz)
+* @param seconds Length of the sample
+* @param decay Rate of decay of the amplitude (per second)
+* @param sample Returns the ID of the sample
+*
+* @return success/failure
+*/
+internal_function
+B32 audioSampleSinusoidal (Audio_Mixer *mixer, F64 frequency, F64 seconds, F64 decay,
+                           U32 *sample)
+{
+    if ((frequency <= 0) || (seconds <= 0)) {
+        return false;
+    }
+
+    F64 frames = seconds * (F64)mixer->frequency;
+    if (decay <= 0) {
+        F64 cycles = round(seconds * frequency);
+        frames = round(((cycles > 0) ? cycles : 1) * (F64)mixer->frequency / frequency);
+    }
+
+    U32 frame_count = (U32)frames;
+    S16 *data = malloc(sizeof(*data) * frame_count * mixer->channels);
+
+    for (U32 i = 0; i < frame_count; ++i) {
+        F64 t = (F64)i / (F64)mixer->frequency;
+        F64 value = sin(AUDIO_TAU * frequency * t);
+        if (decay > 0) {
+            value *= exp(-decay * t);
+        }
+
+        for (U32 c = 0; c < mixer->channels; ++c) {
+            data[(i * mixer->channels) + c] = (S16)(value * 32767.0);
+        }
+    }
+
+    return audioSampleAdd(mixer, data, frame_count, sample);
+}
+
+/**
+* @brief Function to load a WAV file as a sample, converting it to the mixer's format
+*
+* @param mixer Mixer
+* @param path Path of the WAV file
+* @param sample Returns the ID of the sample
+*
+* @return success/failure
+*/
+internal_function
+B32 audioSampleLoadWAV (Audio_Mixer *mixer, const Char *path, U32 *sample)
+{
+    SDL_AudioSpec spec = {0};
+    Uint8 *wav = NULL;
+    Uint32 wav_size = 0;
+
+    if (SDL_LoadWAV(path, &spec, &wav, &wav_size) == NULL) {
+        logConsole(LOG_LEVEL_ERROR,
+                   LOG_CHANNEL_AUDIO,
+                   "Couldn't load %s: %s",
+                   path, SDL_GetError());
+        return false;
+    }
+
+    SDL_AudioCVT cvt;
+    if (SDL_BuildAudioCVT(&cvt,
+                          spec.format, spec.channels, (Sint)spec.freq,
+                          AUDIO_S16SYS, (Uint8)mixer->channels, (Sint)mixer->frequency) < 0) {
+        logConsole(LOG_LEVEL_ERROR,
+                   LOG_CHANNEL_AUDIO,
+                   "Can't convert %s: %s",
+                   path, SDL_GetError());
+        SDL_FreeWAV(wav);
+        return false;
+    }
+
+    cvt.len = (Sint)wav_size;
+    cvt.buf = malloc(wav_size * (Size)cvt.len_mult);
+    memcpy(cvt.buf, wav, wav_size);
+    SDL_FreeWAV(wav);
+
+    if (SDL_ConvertAudio(&cvt) < 0) {
+        logConsole(LOG_LEVEL_ERROR,
+                   LOG_CHANNEL_AUDIO,
+                   "Couldn't convert %s: %s",
+                   path, SDL_GetError());
+        free(cvt.buf);
+        return false;
+    }
+
+    U32 frame_count = (U32)cvt.len_cvt / (U32)(sizeof(S16) * mixer->channels);
+    S16 *data = NULL;
+    memcpy(&data, &cvt.buf, sizeof(data)); // NOTE(naman): Avoids a cast that increases alignment
+
+    return audioSampleAdd(mixer, data, frame_count, sample);
+}
+
+/**
+* @brief Function to read a little-endian integer from a byte array
+*
+* @param bytes Bytes
+* @param size Number of bytes (at most 4)
+*
+* @return Integer
+*/
+internal_function
+U32 audioReadLittleEndian (const Byte *bytes, U32 size)
+{
+    U32 result = 0;
+    for (U32 i = 0; i < size; ++i) {
+        result |= (U32)bytes[i] << (8 * i);
+    }
+    return result;
+}
+
+/**
+* @brief Function to open a WAV file for streaming
+*
+* @param stream Stream
+* @param path Path of the file
+* @param spec Returns the format of the file
+*
+* @return success/failure
+*/
+internal_function
+B32 audioStreamOpenWAV (Audio_Stream *stream, const Char *path, SDL_AudioSpec *spec)
+{
+    stream->file = fopen(path, "rb");
+    if (stream->file == NULL) {
+        return false;
+    }
+
+    Byte header[12];
+    if ((fread(header, 1, sizeof(header), stream->file) != sizeof(header)) ||
+        (memcmp(header, "RIFF", 4) != 0) || (memcmp(header + 8, "WAVE", 4) != 0)) {
+        return false;
+    }
+
+    B32 found_format = false;
+    while (true) {
+        Byte chunk[8];
+        if (fread(chunk, 1, sizeof(chunk), stream->file) != sizeof(chunk)) {
+            return false;
+        }
+        U32 chunk_size = audioReadLittleEndian(chunk + 4, 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            Byte format[40] = {0};
+            U32 format_size = (chunk_size < sizeof(format)) ? chunk_size : sizeof(format);
+            if ((format_size < 16) ||
+                (fread(format, 1, format_size, stream->file) != format_size)) {
+                return false;
+            }
+
+            U32 tag = audioReadLittleEndian(format, 2);
+            if ((tag == 0xFFFE) && (format_size >= 26)) { // WAVE_FORMAT_EXTENSIBLE
+                tag = audioReadLittleEndian(format + 24, 2);
+            }
+            U32 bits = audioReadLittleEndian(format + 14, 2);
+
+            if ((tag == 1) && (bits == 8)) {
+                spec->format = AUDIO_U8;
+            } else if ((tag == 1) && (bits == 16)) {
+                spec->format = AUDIO_S16LSB;
+            } else if ((tag == 1) && (bits == 32)) {
+                spec->format = AUDIO_S32LSB;
+            } else if ((tag == 3) && (bits == 32)) {
+                spec->format = AUDIO_F32LSB;
+            } else {
+                return false;
+            }
+            spec->channels = (Uint8)audioReadLittleEndian(format + 2, 2);
+            spec->freq = (Sint)audioReadLittleEndian(format + 4, 4);
+            found_format = true;
+
+            fseek(stream->file, (long)(chunk_size - format_size + (chunk_size & 1)), SEEK_CUR);
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (found_format == false) {
+                return false;
+            }
+            stream->data_offset = ftell(stream->file);
+            stream->data_size = chunk_size;
+            stream->data_position = 0;
+            return true;
+        } else {
+            fseek(stream->file, (long)(chunk_size + (chunk_size & 1)), SEEK_CUR);
+        }
+    }
+}
+
+/**
+* @brief Function to open an Ogg Vorbis file for streaming
+*
+* @param stream Stream
+* @param path Path of the file
+* @param spec Returns the format of the decoded samples
+*
+* @return success/failure
+*/
+internal_function
+B32 audioStreamOpenOgg (Audio_Stream *stream, const Char *path, SDL_AudioSpec *spec)
+{
+    Sint error = 0;
+    stream->vorbis = stb_vorbis_open_filename(path, &error, NULL);
+    if (stream->vorbis == NULL) {
+        return false;
+    }
+
+    stb_vorbis_info info = stb_vorbis_get_info(stream->vorbis);
+    spec->format = AUDIO_S16SYS;
+    spec->channels = (Uint8)info.channels;
+    spec->freq = (Sint)info.sample_rate;
+
+    return true;
+}
+
+/**
+* @brief Function to free a stream
+*
+* @param stream Stream
+*/
+internal_function
+void audioStreamFree (Audio_Stream *stream)
+{
+    if (stream->file != NULL) {
+        fclose(stream->file);
+    }
+    if (stream->vorbis != NULL) {
+        stb_vorbis_close(stream->vorbis);
+    }
+    free(stream->chunk);
+    free(stream->ring);
+    free(stream);
+}
+
+/**
+* @brief Function to open a file for streaming into a mixer
+*
+* Files whose name ends in `.ogg` are decoded as Ogg Vorbis, all others as WAV.
+*
+* @param mixer Mixer
+* @param path Path of the file
+* @param loop Should the track loop?
+*
+* @return Stream (NULL if the file couldn't be opened)
+*/
+internal_function
+Audio_Stream* audioStreamOpen (Audio_Mixer *mixer, const Char *path, B32 loop)
+{
+    Audio_Stream *stream = calloc(1, sizeof(*stream));
+    stream->loop = loop;
+    stream->channels = mixer->channels;
+
+    SDL_AudioSpec spec = {0};
+    Size path_length = strlen(path);
+    B32 opened = false;
+    if ((path_length > 4) && (strcmp(path + path_length - 4, ".ogg") == 0)) {
+        stream->kind = AUDIO_STREAM_OGG;
+        opened = audioStreamOpenOgg(stream, path, &spec);
+    } else {
+        stream->kind = AUDIO_STREAM_WAV;
+        opened = audioStreamOpenWAV(stream, path, &spec);
+    }
+
+    if ((opened == false) || (spec.channels == 0) || (spec.freq <= 0)) {
+        logConsole(LOG_LEVEL_ERROR,
+                   LOG_CHANNEL_AUDIO,
+                   "Couldn't open %s for streaming",
+                   path);
+        audioStreamFree(stream);
+        return NULL;
+    }
+
+    if (SDL_BuildAudioCVT(&stream->cvt,
+                          spec.format, spec.channels, spec.freq,
+                          AUDIO_S16SYS, (Uint8)mixer->channels, (Sint)mixer->frequency) < 0) {
+        logConsole(LOG_LEVEL_ERROR,
+                   LOG_CHANNEL_AUDIO,
+                   "Can't convert %s: %s",
+                   path, SDL_GetError());
+        audioStreamFree(stream);
+        return NULL;
+    }
+
+    stream->frame_size = (U32)(SDL_AUDIO_BITSIZE(spec.format) / 8) * spec.channels;
+    Size chunk_size = (Size)AUDIO_STREAM_CHUNK_FRAMES * stream->frame_size;
+    stream->chunk = malloc(chunk_size * (Size)stream->cvt.len_mult);
+    stream->chunk_output_frames = (U32)(((F64)chunk_size * stream->cvt.len_ratio) /
+                                        (F64)(sizeof(S16) * mixer->channels)) + 1;
+    stream->ring = malloc(sizeof(*stream->ring) * AUDIO_STREAM_RING_FRAMES * mixer->channels);
+
+    return stream;
+}
+
+/**
+* @brief Function to decode the next chunk of a stream (in the file's format)
+*
+* @param stream Stream
+*
+* @return Number of frames decoded into the stream's chunk buffer (0 at the end of the file)
+*/
+internal_function
+U32 audioStreamRead (Audio_Stream *stream)
+{
+    switch (stream->kind) {
+    case AUDIO_STREAM_WAV: {
+        U32 size = AUDIO_STREAM_CHUNK_FRAMES * stream->frame_size;
+        if (size > stream->data_size - stream->data_position) {
+            size = stream->data_size - stream->data_position;
+        }
+        size = (U32)fread(stream->chunk, 1, size, stream->file);
+        stream->data_position += size;
+        return size / stream->frame_size;
+    }
+
+    case AUDIO_STREAM_OGG: {
+        Sint channels = (Sint)(stream->frame_size / sizeof(S16));
+        return (U32)stb_vorbis_get_samples_short_interleaved(stream->vorbis, channels,
+                                                             stream->chunk,
+                                                             channels * AUDIO_STREAM_CHUNK_FRAMES);
+    }
+    }
+
+    return 0;
+}
+
+/**
+* @brief Function to go back to the start of a stream's file
+*
+* @param stream Stream
+*/
+internal_function
+void audioStreamRewind (Audio_Stream *stream)
+{
+    switch (stream->kind) {
+    case AUDIO_STREAM_WAV: {
+        fseek(stream->file, stream->data_offset, SEEK_SET);
+        stream->data_position = 0;
+    } break;
+
+    case AUDIO_STREAM_OGG: {
+        stb_vorbis_seek_start(stream->vorbis);
+    } break;
+    }
+}
+
+/**
+* @brief Function to decode as many chunks of a stream as its ring buffer has space for
+*
+* @param stream Stream
+*/
+internal_function
+void audioStreamFill (Audio_Stream *stream)
+{
+    while (SDL_AtomicGet(&stream->finished) == 0) {
+        U32 write = (U32)SDL_AtomicGet(&stream->ring_write);
+        U32 read = (U32)SDL_AtomicGet(&stream->ring_read);
+        if (AUDIO_STREAM_RING_FRAMES - (write - read) < stream->chunk_output_frames) {
+            break;
+        }
+
+        U32 frames = audioStreamRead(stream);
+        if ((frames == 0) && stream->loop) {
+            audioStreamRewind(stream);
+            frames = audioStreamRead(stream);
+        }
+        if (frames == 0) {
+            SDL_AtomicSet(&stream->finished, 1);
+            break;
+        }
+
+        U32 size = frames * stream->frame_size;
+        if (stream->cvt.needed) {
+            stream->cvt.buf = stream->chunk;
+            stream->cvt.len = (Sint)size;
+            SDL_ConvertAudio(&stream->cvt);
+            size = (U32)stream->cvt.len_cvt;
+        }
+
+        const S16 *converted = stream->chunk;
+        U32 count = size / (U32)(sizeof(S16) * stream->channels);
+        U32 offset = write & (AUDIO_STREAM_RING_FRAMES - 1);
+        U32 first = AUDIO_STREAM_RING_FRAMES - offset;
+        if (first > count) {
+            first = count;
+        }
+
+        memcpy(stream->ring + (offset * stream->channels), converted,
+               sizeof(S16) * first * stream->channels);
+        memcpy(stream->ring, converted + (first * stream->channels),
+               sizeof(S16) * (count - first) * stream->channels);
+
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&stream->ring_write, (Sint)(write + count));
+    }
+}
+
+/**
+* @brief Function run by the decoder thread, which keeps the ring buffers of all streams full
+*
+* @param data Unused
+*
+* @return Unused
+*/
+internal_function
+Sint audioDecoder (void *data)
+{
+    unused_variable(data);
+
+    SDL_LockMutex(global_audio.decoder_mutex);
+    while (global_audio.decoder_quit == false) {
+        Audio_Stream **link = &global_audio.streams;
+        while (*link != NULL) {
+            Audio_Stream *stream = *link;
+            if (SDL_AtomicGet(&stream->released)) {
+                *link = stream->next;
+                audioStreamFree(stream);
+            } else {
+                audioStreamFill(stream);
+                link = &stream->next;
+            }
+        }
+
+        SDL_CondWaitTimeout(global_audio.decoder_wake, global_audio.decoder_mutex,
+                            AUDIO_DECODER_PERIOD);
+    }
+    SDL_UnlockMutex(global_audio.decoder_mutex);
+
+    return 0;
+}
+
+/**
+* @brief Function to push a command to the mixer (called from the game thread)
+*
+* @param mixer Mixer
+* @param command Command
+*
+* @return success/failure (if the queue is full)
+*/
+internal_function
+B32 audioCommandPush (Audio_Mixer *mixer, Audio_Command command)
+{
+    Sint write = SDL_AtomicGet(&mixer->command_write);
+    Sint read = SDL_AtomicGet(&mixer->command_read);
+
+    if ((U32)(write - read) >= AUDIO_COMMAND_QUEUE_SIZE) {
+        mixer->dropped_commands++;
+        return false;
+    }
+
+    mixer->commands[(U32)write & (AUDIO_COMMAND_QUEUE_SIZE - 1)] = command;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&mixer->command_write, write + 1);
+
+    return true;
+}
+
+/**
+* @brief Function to give a command that starts a voice its ID, and push it
+*
+* @param mixer Mixer
+* @param command Command (@ref AUDIO_COMMAND_PLAY or @ref AUDIO_COMMAND_PLAY_STREAM)
+*
+* @return ID of the voice (0 if the command couldn't be pushed)
+*/
+internal_function
+U32 audioVoiceStart (Audio_Mixer *mixer, Audio_Command command)
+{
+    command.voice = mixer->next_voice;
+
+    if (audioCommandPush(mixer, command) == false) {
+        return 0;
+    }
+
+    mixer->next_voice++;
+    if (mixer->next_voice == 0) {
+        mixer->next_voice = 1;
+    }
+
+    return command.voice;
+}
+
+/**
+* @brief Function to start playing a sample
+*
+* @param mixer Mixer
+* @param sample ID of the sample
+* @param gain Gain (in [0, 1])
+* @param loop Should the sample loop until stopped?
+*
+* @return ID of the voice (0 if it couldn't be played)
+*/
+internal_function
+U32 audioPlay (Audio_Mixer *mixer, U32 sample, F32 gain, B32 loop)
+{
+    if (sample >= mixer->sample_count) {
+        return 0;
+    }
+
+    Audio_Command command = {0};
+    command.kind = AUDIO_COMMAND_PLAY;
+    command.sample = sample;
+    command.gain = audioGainFixed(gain);
+    command.loop = loop;
+
+    return audioVoiceStart(mixer, command);
+}
+
+/**
+* @brief Function to start streaming a file
+*
+* The first chunks are decoded right away, so that the track starts without a gap; the rest is
+* decoded by the decoder thread.
+*
+* @param mixer Mixer (must be @ref global_audio.mixer, which the decoder thread fills)
+* @param path Path of the file (WAV or Ogg Vorbis)
+* @param gain Gain (in [0, 1])
+* @param loop Should the track loop until stopped?
+*
+* @return ID of the voice (0 if it couldn't be played)
+*/
+internal_function
+U32 audioStreamPlay (Audio_Mixer *mixer, const Char *path, F32 gain, B32 loop)
+{
+    if (global_audio.decoder == NULL) {
+        return 0;
+    }
+
+    Audio_Stream *stream = audioStreamOpen(mixer, path, loop);
+    if (stream == NULL) {
+        return 0;
+    }
+    audioStreamFill(stream);
+
+    Audio_Command command = {0};
+    command.kind = AUDIO_COMMAND_PLAY_STREAM;
+    command.stream = stream;
+    command.gain = audioGainFixed(gain);
+    command.loop = loop;
+
+    U32 voice = audioVoiceStart(mixer, command);
+    if (voice == 0) {
+        audioStreamFree(stream);
+        return 0;
+    }
+
+    SDL_LockMutex(global_audio.decoder_mutex);
+    stream->next = global_audio.streams;
+    global_audio.streams = stream;
+    SDL_CondSignal(global_audio.decoder_wake);
+    SDL_UnlockMutex(global_audio.decoder_mutex);
+
+    return voice;
+}
+
+/**
+* @brief Function to stop a voice
+*
+* @param mixer Mixer
+* @param voice ID of the voice
+*/
+internal_function
+void audioStop (Audio_Mixer *mixer, U32 voice)
+{
+    Audio_Command command = {0};
+    command.kind = AUDIO_COMMAND_STOP;
+    command.voice = voice;
+
+    audioCommandPush(mixer, command);
+}
+
+/**
+* @brief Function to change the gain of a voice
+*
+* @param mixer Mixer
+* @param voice ID of the voice
+* @param gain Gain (in [0, 1])
+*/
+internal_function
+void audioSetGain (Audio_Mixer *mixer, U32 voice, F32 gain)
+{
+    Audio_Command command = {0};
+    command.kind = AUDIO_COMMAND_SET_GAIN;
+    command.voice = voice;
+    command.gain = audioGainFixed(gain);
+
+    audioCommandPush(mixer, command);
+}
+
+/**
+* @brief Function to find the voice with a given ID (called from the audio thread)
+*
+* @param mixer Mixer
+* @param id ID of the voice (0 to find a free voice)
+*
+* @return Voice (NULL if not found)
+*/
+internal_function
+Audio_Voice* audioVoiceFind (Audio_Mixer *mixer, U32 id)
+{
+    for (U32 i = 0; i < AUDIO_MAX_VOICES; ++i) {
+        if (mixer->voices[i].id == id) {
+            return &mixer->voices[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+* @brief Function to free a voice (called from the audio thread)
+*
+* @param voice Voice
+*/
+internal_function
+void audioVoiceRelease (Audio_Voice *voice)
+{
+    if (voice->stream != NULL) {
+        SDL_AtomicSet(&voice->stream->released, 1);
+        voice->stream = NULL;
+    }
+    voice->id = 0;
+}
+
+/**
+* @brief Function to apply all the pending commands (called from the audio thread)
+*
+* @param mixer Mixer
+*/
+internal_function
+void audioCommandsApply (Audio_Mixer *mixer)
+{
+    Sint read = SDL_AtomicGet(&mixer->command_read);
+    Sint write = SDL_AtomicGet(&mixer->command_write);
+    SDL_MemoryBarrierAcquire();
+
+    for (; read != write; ++read) {
+        Audio_Command *command = &mixer->commands[(U32)read & (AUDIO_COMMAND_QUEUE_SIZE - 1)];
+
+        switch (command->kind) {
+        case AUDIO_COMMAND_PLAY: {
+            Audio_Voice *voice = audioVoiceFind(mixer, 0);
+            if (voice == NULL) {
+                SDL_AtomicAdd(&mixer->dropped_voices, 1);
+                break;
+            }
+            voice->id = command->voice;
+            voice->sample = command->sample;
+            voice->stream = NULL;
+            voice->position = 0;
+            voice->gain = command->gain;
+            voice->loop = command->loop;
+        } break;
+
+        case AUDIO_COMMAND_PLAY_STREAM: {
+            Audio_Voice *voice = audioVoiceFind(mixer, 0);
+            if (voice == NULL) {
+                SDL_AtomicAdd(&mixer->dropped_voices, 1);
+                SDL_AtomicSet(&command->stream->released, 1);
+                break;
+            }
+            voice->id = command->voice;
+            voice->stream = command->stream;
+            voice->gain = command->gain;
+        } break;
+
+        case AUDIO_COMMAND_STOP: {
+            Audio_Voice *voice = audioVoiceFind(mixer, command->voice);
+            if (voice != NULL) {
+                audioVoiceRelease(voice);
+            }
+        } break;
+
+        case AUDIO_COMMAND_SET_GAIN: {
+            Audio_Voice *voice = audioVoiceFind(mixer, command->voice);
+            if (voice != NULL) {
+                voice->gain = command->gain;
+            }
+        } break;
+        }
+    }
+
+    SDL_AtomicSet(&mixer->command_read, read);
+}
+
+/**
+* @brief Function to add scaled samples into a buffer, saturating on overflow
+*
+* @param out Buffer being mixed into
+* @param in Samples to add
+* @param count Number of samples (not frames)
+* @param gain Gain in Q15 fixed point
+*/
+internal_function
+void audioMixAdd (S16 *out, const S16 *in, U32 count, S16 gain)
+{
+    U32 i = 0;
+
+#if defined(__SSE2__)
+    __m128i g = _mm_set1_epi16(gain);
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(const void*)(in + i));
+        __m128i lo = _mm_mullo_epi16(x, g);
+        __m128i hi = _mm_mulhi_epi16(x, g);
+        __m128i first = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+        __m128i second = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15);
+        __m128i scaled = _mm_packs_epi32(first, second);
+
+        __m128i *o = (__m128i*)(void*)(out + i);
+        _mm_storeu_si128(o, _mm_adds_epi16(_mm_loadu_si128(o), scaled));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        S32 mixed = (S32)out[i] + (((S32)in[i] * gain) >> 15);
+        if (mixed > INT16_MAX) {
+            mixed = INT16_MAX;
+        } else if (mixed < INT16_MIN) {
+            mixed = INT16_MIN;
+        }
+        out[i] = (S16)mixed;
+    }
+}
+
+/**
+* @brief Function to mix a voice playing a stream into a buffer (called from the audio thread)
+*
+* @param mixer Mixer
+* @param voice Voice
+* @param out Buffer of interleaved frames
+* @param frame_count Number of frames in @p out
+*/
+internal_function
+void audioMixStream (Audio_Mixer *mixer, Audio_Voice *voice, S16 *out, U32 frame_count)
+{
+    Audio_Stream *stream = voice->stream;
+
+    // NOTE(naman): The decoder marks the stream finished after its last write, so this has to
+    // be checked before the write position is read.
+    B32 finished = (SDL_AtomicGet(&stream->finished) != 0);
+    U32 read = (U32)SDL_AtomicGet(&stream->ring_read);
+    U32 write = (U32)SDL_AtomicGet(&stream->ring_write);
+    SDL_MemoryBarrierAcquire();
+
+    U32 count = write - read;
+    if (count > frame_count) {
+        count = frame_count;
+    }
+
+    U32 offset = read & (AUDIO_STREAM_RING_FRAMES - 1);
+    U32 first = AUDIO_STREAM_RING_FRAMES - offset;
+    if (first > count) {
+        first = count;
+    }
+
+    audioMixAdd(out, stream->ring + (offset * mixer->channels),
+                first * mixer->channels, voice->gain);
+    audioMixAdd(out + (first * mixer->channels), stream->ring,
+                (count - first) * mixer->channels, voice->gain);
+
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&stream->ring_read, (Sint)(read + count));
+
+    if (count < frame_count) {
+        if (finished) {
+            audioVoiceRelease(voice);
+        } else {
+            SDL_AtomicAdd(&mixer->stream_underruns, 1);
+        }
+    }
+}
+
+/**
+* @brief Function to mix all the voices into a buffer (called from the audio thread)
+*
+* @param mixer Mixer
+* @param out Buffer of interleaved frames
+* @param frame_count Number of frames in @p out
+*/
+internal_function
+void audioMix (Audio_Mixer *mixer, S16 *out, U32 frame_count)
+{
+    audioCommandsApply(mixer);
+
+    memset(out, 0, sizeof(*out) * frame_count * mixer->channels);
+
+    for (U32 i = 0; i < AUDIO_MAX_VOICES; ++i) {
+        Audio_Voice *voice = &mixer->voices[i];
+        if (voice->id == 0) {
+            continue;
+        }
+
+        if (voice->stream != NULL) {
+            audioMixStream(mixer, voice, out, frame_count);
+            continue;
+        }
+
+        Audio_Sample *sample = &mixer->samples[voice->sample];
+        U32 mixed = 0;
+
+        while (mixed < frame_count) {
+            U32 count = sample->frame_count - voice->position;
+            if (count > frame_count - mixed) {
+                count = frame_count - mixed;
+            }
+
+            audioMixAdd(out + (mixed * mixer->channels),
+                        sample->data + (voice->position * mixer->channels),
+                        count * mixer->channels,
+                        voice->gain);
+
+            mixed += count;
+            voice->position += count;
+
+            if (voice->position == sample->frame_count) {
+                if (voice->loop == false) {
+                    audioVoiceRelease(voice);
+                    break;
+                }
+                voice->position = 0;
+            }
+        }
+    }
+}
+
+/**
+* @brief Callback through which the audio device pulls samples
+*
+* @param userdata Mixer
+* @param stream Buffer to fill
+* @param length Size of @p stream in bytes
+*/
+internal_function
+void audioCallback (void *userdata, Uint8 *stream, Sint length)
+{
+    Audio_Mixer *mixer = userdata;
+    U32 frame_count = (U32)length / (U32)(sizeof(S16) * mixer->channels);
+
+    audioMix(mixer, (S16*)(void*)stream, frame_count);
+}
+
+/**
+* @brief Function to create the mixer that will feed the audio device
+*
+* The device is to be opened with @ref audioCallback as its callback and @ref global_audio.mixer
+* as its userdata, in signed 16-bit native-endian format, and then started with
+* @ref audioStart.
+*/
+internal_function
+void audioInit (void)
+{
+    global_audio.mixer = malloc(sizeof(*global_audio.mixer));
+    audioMixerInit(global_audio.mixer, 48000, 2);
+}
+
+/**
+* @brief Function to start feeding an audio device from the mixer
+*
+* @param device Audio device
+* @param spec Specification that the audio device was opened with
+*/
+internal_function
+void audioStart (SDL_AudioDeviceID device, SDL_AudioSpec *spec)
+{
+    audioMixerInit(global_audio.mixer, (U32)spec->freq, spec->channels);
+    SDL_PauseAudioDevice(device, 0);
+
+    global_audio.decoder_mutex = SDL_CreateMutex();
+    global_audio.decoder_wake = SDL_CreateCond();
+    global_audio.decoder = SDL_CreateThread(audioDecoder, "Audio Decoder", NULL);
+    if (global_audio.decoder == NULL) {
+        logConsole(LOG_LEVEL_WARN,
+                   LOG_CHANNEL_AUDIO,
+                   "Audio decoder thread not created, streaming is disabled: %s",
+                   SDL_GetError());
+    }
+}
+
+/**
+* @brief Function to stop the audio device and free everything the mixer holds
+*
+* @param device Audio device
+*/
+internal_function
+void audioShutdown (SDL_AudioDeviceID device)
+{
+    SDL_CloseAudioDevice(device);
+
+    if (global_audio.decoder != NULL) {
+        SDL_LockMutex(global_audio.decoder_mutex);
+        global_audio.decoder_quit = true;
+        SDL_CondSignal(global_audio.decoder_wake);
+        SDL_UnlockMutex(global_audio.decoder_mutex);
+
+        SDL_WaitThread(global_audio.decoder, NULL);
+        global_audio.decoder = NULL;
+    }
+
+    while (global_audio.streams != NULL) {
+        Audio_Stream *stream = global_audio.streams;
+        global_audio.streams = stream->next;
+        audioStreamFree(stream);
+    }
+
+    if (global_audio.decoder_mutex != NULL) {
+        SDL_DestroyCond(global_audio.decoder_wake);
+        SDL_DestroyMutex(global_audio.decoder_mutex);
+    }
+
+    Audio_Mixer *mixer = global_audio.mixer;
+    if (mixer == NULL) {
+        return;
+    }
+
+    if (SDL_AtomicGet(&mixer->stream_underruns) > 0) {
+        logConsole(LOG_LEVEL_WARN,
+                   LOG_CHANNEL_AUDIO,
+                   "Streams ran dry in %d callbacks",
+                   SDL_AtomicGet(&mixer->stream_underruns));
+    }
+
+    if ((mixer->dropped_commands > 0) || (SDL_AtomicGet(&mixer->dropped_voices) > 0)) {
+        logConsole(LOG_LEVEL_WARN,
+                   LOG_CHANNEL_AUDIO,
+                   "Dropped %u commands (queue full) and %d plays (no free voice)",
+                   mixer->dropped_commands,
+                   SDL_AtomicGet(&mixer->dropped_voices));
+    }
+
+    audioMixerFree(mixer);
+    free(mixer);
+    global_audio.mixer = NULL;
+}
+
+/**
+* @brief Function to measure the cost of mixing, without an audio device
+*
+* It renders the given length of audio in callback-sized pieces, with a looping hum and a
+* steady stream of clicks that keeps most of the voices busy, and records how long each
+* callback took.
+*
+* @param seconds Length of audio to render
+*/
+internal_function
+void audioBenchmark (F64 seconds)
+{
+    Audio_Mixer *mixer = malloc(sizeof(*mixer));
+    audioMixerInit(mixer, 48000, 2);
+
+    U32 click = 0;
+    U32 hum = 0;
+    audioSampleSinusoidal(mixer, 2000.0, 0.25, 30.0, &click);
+    audioSampleSinusoidal(mixer, 60.0, 1.0, 0.0, &hum);
+    audioPlay(mixer, hum, 0.1f, true);
+
+    S16 *buffer = malloc(sizeof(*buffer) * AUDIO_CALLBACK_FRAMES * mixer->channels);
+    U32 callbacks = (U32)((seconds * (F64)mixer->frequency) / AUDIO_CALLBACK_FRAMES);
+    F64 budget = (1000000.0 * AUDIO_CALLBACK_FRAMES) / (F64)mixer->frequency;
+
+    F64 total = 0;
+    for (U32 i = 0; i < callbacks; ++i) {
+        for (U32 j = 0; j < 4; ++j) {
+            audioPlay(mixer, click, 0.2f, false);
+        }
+
+        U64 counter = SDL_GetPerformanceCounter();
+        audioCallback(mixer, (Uint8*)buffer,
+                      (Sint)(sizeof(*buffer) * AUDIO_CALLBACK_FRAMES * mixer->channels));
+        F64 elapsed = timeMicrosecondsElapsed(&counter);
+
+        profileRecord(PROFILE_AUDIO_CALLBACK, elapsed);
+        total += elapsed;
+    }
+
+    logConsole(LOG_LEVEL_INFO,
+               LOG_CHANNEL_AUDIO,
+               "Mixed %u callbacks of %u frames (%s): %.2f us per callback, %.4f%% of the %.0f us budget",
+               callbacks, AUDIO_CALLBACK_FRAMES,
+#if defined(__SSE2__)
+               "SSE2",
+#else
+               "scalar",
+#endif
+               (callbacks > 0) ? (total / (F64)callbacks) : 0.0,
+               (callbacks > 0) ? ((100.0 * total) / ((F64)callbacks * budget)) : 0.0,
+               budget);
+
+    free(buffer);
+    audioMixerFree(mixer);
+    free(mixer);
+}
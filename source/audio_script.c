@@ -0,0 +1,158 @@
+/**
+ * These functions are called from Lua and are used to hook into the audio mixer that is
+ * implemented in the engine.
+ *
+ * @file audio_script.c
+ * @author Team Octal
+ * @brief Lua functions for audio
+ */
+
+/**
+* @brief Lua injected function which creates a sinusoidal sample
+*
+* This function is called from Lua with the frequency (Hz), length (seconds) and optionally the
+* rate of decay (per second) of the wave. It returns the ID of the sample, or nil if it
+* couldn't be created.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptAudioSinusoidal (lua_State *l)
+{
+    F64 frequency = luaL_checknumber(l, 1);
+    F64 seconds = luaL_checknumber(l, 2);
+    F64 decay = luaL_optnumber(l, 3, 0);
+
+    U32 sample = 0;
+    if ((global_audio.mixer == NULL) ||
+        (audioSampleSinusoidal(global_audio.mixer, frequency, seconds, decay, &sample) == false)) {
+        lua_pushnil(l);
+        return 1;
+    }
+
+    lua_pushnumber(l, sample);
+    return 1;
+}
+
+/**
+* @brief Lua injected function which loads a WAV file as a sample
+*
+* This function is called from Lua with the path of the file, and returns the ID of the sample,
+* or nil if it couldn't be loaded.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptAudioLoadSample (lua_State *l)
+{
+    const Char *path = luaL_checkstring(l, 1);
+
+    U32 sample = 0;
+    if ((global_audio.mixer == NULL) ||
+        (audioSampleLoadWAV(global_audio.mixer, path, &sample) == false)) {
+        lua_pushnil(l);
+        return 1;
+    }
+
+    lua_pushnumber(l, sample);
+    return 1;
+}
+
+/**
+* @brief Lua injected function which starts playing a sample
+*
+* This function is called from Lua with the ID of the sample and optionally its gain (in
+* [0, 1], 1 by default) and whether it should loop. It returns the ID of the voice playing it
+* (0 if it couldn't be played), to be passed to @ref scriptAudioStop and
+* @ref scriptAudioSetGain.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptAudioPlay (lua_State *l)
+{
+    U32 sample = (U32)luaL_checknumber(l, 1);
+    F32 gain = (F32)luaL_optnumber(l, 2, 1);
+    B32 loop = (B32)lua_toboolean(l, 3);
+
+    U32 voice = 0;
+    if (global_audio.mixer != NULL) {
+        voice = audioPlay(global_audio.mixer, sample, gain, loop);
+    }
+
+    lua_pushnumber(l, voice);
+    return 1;
+}
+
+/**
+* @brief Lua injected function which starts streaming a track
+*
+* This function is called from Lua with the path of a WAV or Ogg Vorbis file and optionally its
+* gain (in [0, 1], 1 by default) and whether it should loop. The file is decoded in the
+* background as it plays, so it can be of any length. It returns the ID of the voice playing it
+* (0 if it couldn't be played).
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptAudioStream (lua_State *l)
+{
+    const Char *path = luaL_checkstring(l, 1);
+    F32 gain = (F32)luaL_optnumber(l, 2, 1);
+    B32 loop = (B32)lua_toboolean(l, 3);
+
+    U32 voice = 0;
+    if (global_audio.mixer != NULL) {
+        voice = audioStreamPlay(global_audio.mixer, path, gain, loop);
+    }
+
+    lua_pushnumber(l, voice);
+    return 1;
+}
+
+/**
+* @brief Lua injected function which stops a voice
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptAudioStop (lua_State *l)
+{
+    U32 voice = (U32)luaL_checknumber(l, 1);
+
+    if (global_audio.mixer != NULL) {
+        audioStop(global_audio.mixer, voice);
+    }
+
+    return 0;
+}
+
+/**
+* @brief Lua injected function which changes the gain of a voice
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptAudioSetGain (lua_State *l)
+{
+    U32 voice = (U32)luaL_checknumber(l, 1);
+    F32 gain = (F32)luaL_checknumber(l, 2);
+
+    if (global_audio.mixer != NULL) {
+        audioSetGain(global_audio.mixer, voice, gain);
+    }
+
+    return 0;
+}
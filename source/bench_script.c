@@ -0,0 +1,95 @@
+/**
+ * These functions run the benchmark of the filesystem and the commands (data/scripts/bench.lua)
+ * in a Lua state of its own, which has none of the engine but the filesystem and the shell, so
+ * that it can run without a window, audio or assets.
+ *
+ * @file bench_script.c
+ * @author Team Octal
+ * @brief Lua functions for the benchmark of the filesystem
+ */
+
+/**
+* @brief Lua injected function which returns the time in microseconds
+*
+* The time is only meaningful relative to other calls.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptBenchClock (lua_State *l)
+{
+    F64 counter = (F64)SDL_GetPerformanceCounter();
+    F64 freq = (F64)SDL_GetPerformanceFrequency();
+    lua_pushnumber(l, (counter * 1000000.0) / freq);
+    return 1;
+}
+
+/**
+* @brief Function to run the benchmark of the filesystem and log its report
+*
+* @param inodes Number of inodes in the largest tree
+* @param seed Seed of the trees
+*
+* @return Did the benchmark run?
+*/
+internal_function
+B32 scriptBenchFilesystem (U32 inodes, U32 seed)
+{
+    lua_State *l = luaL_newstate();
+    luaL_openlibs(l);
+
+    const luaL_Reg functions[] = {
+        {"VFSNew", scriptVFSNew},
+        {"ShellTokenize", scriptShellTokenize},
+        {"ShellGetOpt", scriptShellGetOpt},
+        {"BenchClock", scriptBenchClock},
+        {NULL, NULL},
+    };
+
+    lua_newtable(l); // Engine
+    lua_newtable(l); // Engine Functions
+    luaL_register(l, NULL, functions);
+    lua_setfield(l, -2, "Functions"); // Engine
+    lua_setglobal(l, "Engine"); // {EMPTY}
+
+    lua_newtable(l); // Game
+    lua_setglobal(l, "Game"); // {EMPTY}
+
+    B32 result = false;
+    if (luaL_dofile(l, "data/scripts/bench.lua")) {
+        logConsole(LOG_LEVEL_CRITICAL,
+                   LOG_CHANNEL_SCRIPT,
+                   "Loading the benchmark failed: %s",
+                   lua_tostring(l, -1));
+        goto end;
+    }
+
+    lua_getglobal(l, "Bench"); // Bench
+    lua_getfield(l, -1, "Run"); // Bench Run
+    lua_pushnumber(l, inodes); // Bench Run inodes
+    lua_pushnumber(l, seed); // Bench Run inodes seed
+    if (lua_pcall(l, 2, 1, 0)) { // Bench <report>
+        logConsole(LOG_LEVEL_CRITICAL,
+                   LOG_CHANNEL_SCRIPT,
+                   "Bench.Run failed: %s",
+                   lua_tostring(l, -1));
+        goto end;
+    }
+
+    Size lines = lua_objlen(l, -1);
+    for (Size i = 1; i <= lines; ++i) {
+        lua_rawgeti(l, -1, (Sint)i); // Bench report <line>
+        logConsole(LOG_LEVEL_INFO,
+                   LOG_CHANNEL_SCRIPT,
+                   "%s",
+                   lua_tostring(l, -1));
+        lua_pop(l, 1); // Bench report
+    }
+    result = true;
+
+ end:
+    lua_close(l);
+    return result;
+}
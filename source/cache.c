@@ -0,0 +1,317 @@
+/**
+ * These functions implement a persistent on-disk cache for data that is expensive to derive
+ * from the assets on every launch (e.g. compiled Lua chunks). Each entry is stored in its own
+ * file in the cache directory and is tagged with a hash of the content it was derived from, so
+ * that stale entries are detected and rebuilt transparently.
+ *
+ * @file cache.c
+ * @author Team Octal
+ * @brief Functions for the on-disk asset cache
+ */
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC   0x4843544FU /* "OTCH" */
+#define CACHE_VERSION 1U
+#define CACHE_HASH_SEED 0xCBF29CE484222325ULL
+
+/**
+* @brief Enumeration of the modes in which the cache can operate
+*/
+enum Cache_Mode {
+    CACHE_MODE_OFF, /**< Never read or write cache entries */
+    CACHE_MODE_ON, /**< Read cache entries, write them on a miss */
+    CACHE_MODE_COMPARE, /**< Like @ref CACHE_MODE_ON, but also time the uncached path */
+};
+
+/**
+* @brief Header stored at the beginning of every cache entry
+*/
+typedef struct Cache_Header {
+    U32 magic; /**< Always @ref CACHE_MAGIC */
+    U32 version; /**< Always @ref CACHE_VERSION */
+    U64 key; /**< Hash of the content this entry was derived from */
+    U64 size; /**< Size of the payload that follows the header */
+} Cache_Header;
+
+/**
+* @brief State of the cache subsystem
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+global_variable struct Cache_State {
+    enum Cache_Mode mode; /**< Mode in which the cache operates */
+    Char *directory; /**< Directory containing the cache entries (with trailing separator) */
+    U32 hits; /**< Number of entries found and valid */
+    U32 misses; /**< Number of entries missing or stale */
+    F64 cached_time; /**< Microseconds spent loading through the cache (compare mode) */
+    F64 uncached_time; /**< Microseconds spent loading from the original assets (compare mode) */
+    SDL_SpinLock lock; /**< Protects the statistics, since assets are loaded from many threads */
+} global_cache = {CACHE_MODE_ON, NULL, 0, 0, 0, 0, 0};
+#pragma clang diagnostic pop
+
+/**
+* @brief Function to hash a block of memory
+*
+* This computes the 64-bit FNV-1a hash of @p size bytes at @p data. Passing the result of a
+* previous call as @p seed allows to hash several blocks as if they were one.
+*
+* @param data Memory to hash
+* @param size Size of @p data in bytes
+* @param seed Starting value of the hash (use @ref CACHE_HASH_SEED for a fresh hash)
+*
+* @return Hash of the memory
+*/
+internal_function
+U64 cacheHash (const void *data, Size size, U64 seed)
+{
+    const U8 *bytes = data;
+    U64 hash = seed;
+
+    for (Size i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+
+    return hash;
+}
+
+/**
+* @brief Function to update the statistics of the cache
+*
+* This can be called from any thread.
+*
+* @param hit Was an entry found (ignored if both the times are non-zero)?
+* @param cached_time Microseconds spent loading an asset through the cache
+* @param uncached_time Microseconds spent loading an asset without the cache
+*/
+internal_function
+void cacheRecord (B32 hit, F64 cached_time, F64 uncached_time)
+{
+    SDL_AtomicLock(&global_cache.lock);
+    if ((cached_time > 0) || (uncached_time > 0)) {
+        global_cache.cached_time += cached_time;
+        global_cache.uncached_time += uncached_time;
+    } else if (hit) {
+        global_cache.hits++;
+    } else {
+        global_cache.misses++;
+    }
+    SDL_AtomicUnlock(&global_cache.lock);
+}
+
+/**
+* @brief Function to initialize the cache subsystem
+*
+* This finds (and creates, if needed) the directory in which the cache entries are stored.
+* If no such directory can be made, the cache gets turned off.
+*
+* @return success/failure
+*/
+internal_function
+B32 cacheInit (void)
+{
+    if (global_cache.mode == CACHE_MODE_OFF) {
+        return true;
+    }
+
+    Char *pref_path = SDL_GetPrefPath("Octal", "CS699");
+    if (pref_path == NULL) {
+        logConsole(LOG_LEVEL_WARN,
+                   LOG_CHANNEL_ASSETS,
+                   "Cache disabled, no writable directory: %s",
+                   SDL_GetError());
+        global_cache.mode = CACHE_MODE_OFF;
+        return false;
+    }
+
+    Size length = strlen(pref_path) + strlen("cache/") + 1;
+    global_cache.directory = malloc(length);
+    strcpy(global_cache.directory, pref_path);
+    strcat(global_cache.directory, "cache/");
+    SDL_free(pref_path);
+
+    struct stat dir_stat;
+    if ((stat(global_cache.directory, &dir_stat) != 0) &&
+        (mkdir(global_cache.directory, 0755) != 0)) {
+        logConsole(LOG_LEVEL_WARN,
+                   LOG_CHANNEL_ASSETS,
+                   "Cache disabled, couldn't create %s",
+                   global_cache.directory);
+        free(global_cache.directory);
+        global_cache.directory = NULL;
+        global_cache.mode = CACHE_MODE_OFF;
+        return false;
+    }
+
+    logConsole(LOG_LEVEL_INFO,
+               LOG_CHANNEL_ASSETS,
+               "Cache directory: %s",
+               global_cache.directory);
+
+    return true;
+}
+
+/**
+* @brief Function to compute the path of a cache entry
+*
+* Entries are named by their @p kind and by a hash of their @p name, so that the same asset
+* always maps to the same file and a rebuilt entry replaces the stale one.
+*
+* @param kind Kind of entry (e.g. "script")
+* @param name Name identifying the entry (e.g. the path of the source asset)
+*
+* @return Path of the entry (to be freed by the caller)
+*/
+internal_function
+Char* cacheEntryPath (const Char *kind, const Char *name)
+{
+    U64 name_hash = cacheHash(name, strlen(name), CACHE_HASH_SEED);
+
+    Size length = strlen(global_cache.directory) + strlen(kind) + 1 + 16 + strlen(".bin") + 1;
+    Char *path = malloc(length);
+    snprintf(path, length, "%s%s-%016llx.bin",
+             global_cache.directory, kind, (unsigned long long)name_hash);
+
+    return path;
+}
+
+/**
+* @brief Function to read a cache entry
+*
+* It reads the entry for @p name and checks that it was derived from content with the hash
+* @p key. Missing, corrupt and stale entries are all reported as a miss.
+*
+* @param kind Kind of entry
+* @param name Name identifying the entry
+* @param key Hash of the content the entry should have been derived from
+* @param size Returns the size of the payload
+*
+* @return Pointer to the payload (to be freed by the caller), NULL on a miss
+*/
+internal_function
+Byte* cacheRead (const Char *kind, const Char *name, U64 key, Size *size)
+{
+    if (global_cache.mode == CACHE_MODE_OFF) {
+        return NULL;
+    }
+
+    Char *path = cacheEntryPath(kind, name);
+    SDL_RWops *rwops = SDL_RWFromFile(path, "rb");
+    free(path);
+
+    if (rwops == NULL) {
+        cacheRecord(false, 0, 0);
+        return NULL;
+    }
+
+    Cache_Header header = {0};
+    Byte *payload = NULL;
+
+    if ((SDL_RWread(rwops, &header, sizeof(header), 1) == 1) &&
+        (header.magic == CACHE_MAGIC) &&
+        (header.version == CACHE_VERSION) &&
+        (header.key == key) &&
+        ((U64)SDL_RWsize(rwops) == (sizeof(header) + header.size))) {
+        payload = malloc((Size)header.size + 1);
+        if ((header.size != 0) &&
+            (SDL_RWread(rwops, payload, (Size)header.size, 1) != 1)) {
+            free(payload);
+            payload = NULL;
+        }
+    }
+
+    SDL_RWclose(rwops);
+
+    if (payload == NULL) {
+        cacheRecord(false, 0, 0);
+        return NULL;
+    }
+
+    cacheRecord(true, 0, 0);
+    if (size != NULL) {
+        *size = (Size)header.size;
+    }
+
+    return payload;
+}
+
+/**
+* @brief Function to write a cache entry
+*
+* The entry is first written to a temporary file which then replaces the old entry, so that
+* other running instances never see a partially written entry.
+*
+* @param kind Kind of entry
+* @param name Name identifying the entry
+* @param key Hash of the content the entry was derived from
+* @param data Payload of the entry
+* @param size Size of the payload
+*
+* @return success/failure
+*/
+internal_function
+B32 cacheWrite (const Char *kind, const Char *name, U64 key, const void *data, Size size)
+{
+    if (global_cache.mode == CACHE_MODE_OFF) {
+        return false;
+    }
+
+    Char *path = cacheEntryPath(kind, name);
+    Size temp_length = strlen(path) + 32;
+    Char *temp_path = malloc(temp_length);
+    snprintf(temp_path, temp_length, "%s.%ld.tmp", path, (long)getpid());
+
+    B32 result = false;
+    SDL_RWops *rwops = SDL_RWFromFile(temp_path, "wb");
+    if (rwops != NULL) {
+        Cache_Header header = {CACHE_MAGIC, CACHE_VERSION, key, size};
+
+        B32 written = ((SDL_RWwrite(rwops, &header, sizeof(header), 1) == 1) &&
+                       ((size == 0) || (SDL_RWwrite(rwops, data, size, 1) == 1)));
+        SDL_RWclose(rwops);
+
+        if (written && (rename(temp_path, path) == 0)) {
+            result = true;
+        } else {
+            remove(temp_path);
+        }
+    }
+
+    if (result == false) {
+        logConsole(LOG_LEVEL_WARN,
+                   LOG_CHANNEL_ASSETS,
+                   "Couldn't write cache entry %s",
+                   path);
+    }
+
+    free(temp_path);
+    free(path);
+
+    return result;
+}
+
+/**
+* @brief Function to log the statistics of the cache
+*
+* In @ref CACHE_MODE_COMPARE, this also logs the time that loading took through the cache
+* and the time it would have taken without it.
+*/
+internal_function
+void cacheLogStatistics (void)
+{
+    logConsole(LOG_LEVEL_INFO,
+               LOG_CHANNEL_ASSETS,
+               "Cache: %u hits, %u misses",
+               global_cache.hits, global_cache.misses);
+
+    if (global_cache.mode == CACHE_MODE_COMPARE) {
+        logConsole(LOG_LEVEL_INFO,
+                   LOG_CHANNEL_ASSETS,
+                   "Cache: %.3f ms with cache, %.3f ms without cache",
+                   global_cache.cached_time / 1000.0,
+                   global_cache.uncached_time / 1000.0);
+    }
+}
@@ -2,6 +2,11 @@
  * These functions are used in debugging any runtime errors that maybe otherwise
  * be hard to fix. Usually, these functions are used in tandem with logging system.
  *
+ * Stack traces are symbolized in-process: libdw (from elfutils) is loaded at runtime the first
+ * time a trace is printed, and the debug information of the program is parsed only once.
+ * Every address that gets symbolized is cached, so repeated traces cost only a lookup. If
+ * libdw is not available, the symbols from the dynamic symbol table are used instead.
+ *
  * @file debug.c
  * @author Team Octal
  * @brief Functions for debugging
@@ -10,50 +15,237 @@
 #include <execinfo.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <dlfcn.h>
+#include <unistd.h>
 
 #define MAX_STACK_FRAMES 64
 
+/* Opaque types and callback table of libdw's Dwfl interface (see elfutils/libdwfl.h) */
+typedef struct Dwfl Dwfl;
+typedef struct Dwfl_Module Dwfl_Module;
+typedef struct Dwfl_Line Dwfl_Line;
+typedef void (*Debug_Function)(void);
+typedef struct Dwfl_Callbacks {
+    Debug_Function find_elf;
+    Debug_Function find_debuginfo;
+    Debug_Function section_address;
+    char **debuginfo_path;
+} Dwfl_Callbacks;
+
+/**
+* @brief Symbolized address, as stored in the cache
+*/
+typedef struct Debug_Symbol {
+    void *address; /**< Address (NULL for an empty slot) */
+    Char *description; /**< Function and source line of the address */
+} Debug_Symbol;
+
+/**
+* @brief State of the debugging subsystem
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+global_variable struct Debug_State {
+    SDL_SpinLock lock; /**< Protects everything below */
+    B32 initialized; /**< Has the symbolizer been initialized? */
+    void *libdw; /**< Handle to libdw (NULL if it couldn't be loaded) */
+    Dwfl *dwfl; /**< Session with the modules of this process */
+    Dwfl_Callbacks callbacks; /**< Callbacks given to libdw (must outlive @ref dwfl) */
+    struct {
+        Dwfl* (*begin) (const Dwfl_Callbacks *callbacks);
+        int (*linux_proc_report) (Dwfl *dwfl, pid_t pid);
+        int (*report_end) (Dwfl *dwfl, void *removed, void *arg);
+        Dwfl_Module* (*addrmodule) (Dwfl *dwfl, U64 address);
+        const char* (*module_addrname) (Dwfl_Module *module, U64 address);
+        Dwfl_Line* (*module_getsrc) (Dwfl_Module *module, U64 address);
+        const char* (*lineinfo) (Dwfl_Line *line, U64 *address, int *linep, int *colp,
+                                 U64 *mtime, U64 *length);
+    } dw; /**< Functions loaded from libdw */
+    Debug_Symbol *symbols; /**< Hash table of symbolized addresses */
+    Size symbol_count; /**< Number of filled slots in @ref symbols */
+    Size symbol_capacity; /**< Number of slots in @ref symbols (a power of two) */
+} global_debug;
+#pragma clang diagnostic pop
+
+/**
+* @brief Function to load a function from a shared library
+*
+* @param library Handle of library
+* @param name Name of function
+* @param function Returns the function (of any function pointer type)
+*
+* @return success/failure
+*/
 internal_function
-int debug_AddressToLine(void *addr)
+B32 debugLoadFunction (void *library, const Char *name, void *function)
 {
-    char addr2line_cmd[512] = {0};
-    sprintf(addr2line_cmd,"addr2line -f -p -e %.256s %p", global_program_name, addr);
+    void *symbol = dlsym(library, name);
+    if (symbol == NULL) {
+        return false;
+    }
+
+    // NOTE(naman): ISO C doesn't allow casting object pointers to function pointers
+    memcpy(function, &symbol, sizeof(symbol));
 
-    /* This will print a nicely formatted string specifying the
-       function and source line of the address */
-    return system(addr2line_cmd);
+    return true;
 }
 
 /**
-* @brief Function to print stack trace for debugging
+* @brief Function to set up the in-process symbolizer
 *
-* This function print the stack trace for the current execution state of program. It skip the
-* first couple of stack frames and also skip the last frame as it usually contains junk.
+* Must be called with the lock held.
 */
 internal_function
-void debugPrintCallStackTrace()
+void debugSymbolizerInit (void)
 {
-    S32 trace_size = 0;
-    char **messages = (char **)NULL;
-    void *stack_traces[MAX_STACK_FRAMES] = {0};
+    global_debug.initialized = true;
+
+    global_debug.libdw = dlopen("libdw.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (global_debug.libdw == NULL) {
+        return;
+    }
+
+    void *lib = global_debug.libdw;
+    if ((debugLoadFunction(lib, "dwfl_begin", &global_debug.dw.begin) == false) ||
+        (debugLoadFunction(lib, "dwfl_linux_proc_report", &global_debug.dw.linux_proc_report) == false) ||
+        (debugLoadFunction(lib, "dwfl_report_end", &global_debug.dw.report_end) == false) ||
+        (debugLoadFunction(lib, "dwfl_addrmodule", &global_debug.dw.addrmodule) == false) ||
+        (debugLoadFunction(lib, "dwfl_module_addrname", &global_debug.dw.module_addrname) == false) ||
+        (debugLoadFunction(lib, "dwfl_module_getsrc", &global_debug.dw.module_getsrc) == false) ||
+        (debugLoadFunction(lib, "dwfl_lineinfo", &global_debug.dw.lineinfo) == false) ||
+        (debugLoadFunction(lib, "dwfl_linux_proc_find_elf", &global_debug.callbacks.find_elf) == false) ||
+        (debugLoadFunction(lib, "dwfl_standard_find_debuginfo", &global_debug.callbacks.find_debuginfo) == false)) {
+        dlclose(lib);
+        global_debug.libdw = NULL;
+        return;
+    }
+
+    global_debug.dwfl = global_debug.dw.begin(&global_debug.callbacks);
+    if (global_debug.dwfl != NULL) {
+        global_debug.dw.linux_proc_report(global_debug.dwfl, getpid());
+        global_debug.dw.report_end(global_debug.dwfl, NULL, NULL);
+    }
+}
+
+/**
+* @brief Function to describe an address as a function and source line
+*
+* @param address Address to symbolize
+* @param fallback Description to use if the address can't be symbolized
+*
+* @return Description (to be freed by the caller)
+*/
+internal_function
+Char* debugDescribeAddress (void *address, const Char *fallback)
+{
+    Char description[512] = {0};
+
+    const Char *function = NULL;
+    const Char *file = NULL;
+    int line = 0;
+
+    if (global_debug.dwfl != NULL) {
+        // NOTE(naman): Return addresses point after the call, so look up the byte before
+        U64 lookup = (U64)(uintptr_t)address - 1;
+        Dwfl_Module *module = global_debug.dw.addrmodule(global_debug.dwfl, lookup);
+        if (module != NULL) {
+            function = global_debug.dw.module_addrname(module, lookup);
+            Dwfl_Line *source = global_debug.dw.module_getsrc(module, lookup);
+            if (source != NULL) {
+                file = global_debug.dw.lineinfo(source, NULL, &line, NULL, NULL, NULL);
+            }
+        }
+    }
+
+    if ((function != NULL) && (file != NULL)) {
+        snprintf(description, sizeof(description), "%s at %s:%d", function, file, line);
+    } else if (function != NULL) {
+        snprintf(description, sizeof(description), "%s", function);
+    } else {
+        snprintf(description, sizeof(description), "%s", fallback);
+    }
+
+    Char *result = malloc(strlen(description) + 1);
+    strcpy(result, description);
+
+    return result;
+}
+
+/**
+* @brief Function to find the description of an address, symbolizing it if not cached
+*
+* Must be called with the lock held.
+*
+* @param address Address to symbolize
+* @param fallback Description to use if the address can't be symbolized
+*
+* @return Description (owned by the cache)
+*/
+internal_function
+const Char* debugSymbolize (void *address, const Char *fallback)
+{
+    if (global_debug.initialized == false) {
+        debugSymbolizerInit();
+    }
 
-    trace_size = backtrace(stack_traces, MAX_STACK_FRAMES);
-    messages = backtrace_symbols(stack_traces, trace_size);
+    if ((global_debug.symbol_count + 1) * 2 > global_debug.symbol_capacity) {
+        Size old_capacity = global_debug.symbol_capacity;
+        Debug_Symbol *old_symbols = global_debug.symbols;
 
-    if (!messages) {
-        printf("Couldn't print stack trace\n");
-        exit(1);
+        global_debug.symbol_capacity = (old_capacity == 0) ? 256 : (old_capacity * 2);
+        global_debug.symbols = calloc(global_debug.symbol_capacity, sizeof(*global_debug.symbols));
+
+        for (Size i = 0; i < old_capacity; ++i) {
+            if (old_symbols[i].address != NULL) {
+                Size slot = ((uintptr_t)old_symbols[i].address >> 2) & (global_debug.symbol_capacity - 1);
+                while (global_debug.symbols[slot].address != NULL) {
+                    slot = (slot + 1) & (global_debug.symbol_capacity - 1);
+                }
+                global_debug.symbols[slot] = old_symbols[i];
+            }
+        }
+        free(old_symbols);
     }
 
-    /* skip the first couple stack frames (as they are this function and
-       our handler) and also skip the last frame as it's (always?) junk. */
-    // for (i = 3; i < (trace_size - 1); ++i)
-    // we'll use this for now so you can see what's going on
-    for (S32 i = 0; i < trace_size; ++i) {
-        if (debug_AddressToLine(stack_traces[i]) != 0) {
-            printf("  error determining line # for: %s\n", messages[i]);
+    Size slot = ((uintptr_t)address >> 2) & (global_debug.symbol_capacity - 1);
+    while (global_debug.symbols[slot].address != NULL) {
+        if (global_debug.symbols[slot].address == address) {
+            return global_debug.symbols[slot].description;
         }
+        slot = (slot + 1) & (global_debug.symbol_capacity - 1);
+    }
+
+    global_debug.symbols[slot].address = address;
+    global_debug.symbols[slot].description = debugDescribeAddress(address, fallback);
+    global_debug.symbol_count++;
+
+    return global_debug.symbols[slot].description;
+}
+
+/**
+* @brief Function to print stack trace for debugging
+*
+* This function logs the stack trace for the current execution state of program, with the
+* function and source line of every frame. It skips its own frame.
+*/
+internal_function
+void debugPrintCallStackTrace (void)
+{
+    void *stack_traces[MAX_STACK_FRAMES] = {0};
+
+    S32 trace_size = backtrace(stack_traces, MAX_STACK_FRAMES);
+    char **messages = backtrace_symbols(stack_traces, trace_size);
+
+    SDL_AtomicLock(&global_debug.lock);
+    for (S32 i = 1; i < trace_size; ++i) {
+        const Char *description = debugSymbolize(stack_traces[i],
+                                                 (messages != NULL) ? messages[i] : "??");
+        logConsole(LOG_LEVEL_ERROR,
+                   LOG_CHANNEL_LOG,
+                   "  #%d %p in %s",
+                   i - 1, stack_traces[i], description);
     }
+    SDL_AtomicUnlock(&global_debug.lock);
 
     free(messages);
 }
@@ -0,0 +1,466 @@
+/**
+ * These functions expand glob patterns (with the wildcards *, ? and [...]) against the
+ * simulated filesystem. A pattern is compiled once into a list of segments, one per component
+ * of the path, and every segment into a short program of operations that a name is matched
+ * against. Segments without wildcards are looked up directly in the hash table of the
+ * directory, so they never cost more than one probe; and segments that start with literal
+ * characters only look at the children whose names start with them, which are found by binary
+ * search in the directory's sorted array.
+ *
+ * A backslash makes the character after it literal. A name starting with '.' is only matched
+ * by a segment that starts with a literal '.'.
+ *
+ * @file glob.c
+ * @author Team Octal
+ * @brief Functions for expanding glob patterns against the simulated filesystem
+ */
+
+/**
+* @brief Enumeration of the operations of a compiled segment
+*/
+enum Glob_Op_Kind {
+    GLOB_OP_CHAR, /**< Matches one given character */
+    GLOB_OP_ANY_CHAR, /**< Matches any one character (?) */
+    GLOB_OP_ANY_STRING, /**< Matches any number of characters (*) */
+    GLOB_OP_CLASS, /**< Matches one character of a class ([...]) */
+};
+
+/**
+* @brief Operation of a compiled segment
+*/
+typedef struct Glob_Op {
+    enum Glob_Op_Kind kind; /**< Kind of operation */
+    U32 argument; /**< Character (for GLOB_OP_CHAR) or index of the class (for GLOB_OP_CLASS) */
+} Glob_Op;
+
+/**
+* @brief Set of characters matched by a [...]
+*/
+typedef struct Glob_Class {
+    U8 bits[32]; /**< One bit per character */
+} Glob_Class;
+
+/**
+* @brief Compiled component of a pattern
+*/
+typedef struct Glob_Segment {
+    B32 literal; /**< Has the segment no wildcards? */
+    U32 text_offset; /**< Offset in @ref Glob.text of the literal characters the segment starts
+                          with (all of them, if it is @ref literal) */
+    U32 text_length; /**< Number of those characters */
+    U32 op_first; /**< Index in @ref Glob.ops of the first operation after them */
+    U32 op_count; /**< Number of operations after them */
+} Glob_Segment;
+
+/**
+* @brief Compiled pattern
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Glob {
+    B32 absolute; /**< Does the pattern start at the root? */
+    B32 directories_only; /**< Does the pattern end with a '/'? */
+
+    Glob_Segment *segments; /**< Segments, in order */
+    U32 segment_count; /**< Number of segments */
+    Glob_Op *ops; /**< Operations of all the segments */
+    U32 op_count; /**< Number of operations */
+    Glob_Class *classes; /**< Classes of all the segments */
+    U32 class_count; /**< Number of classes */
+    Char *text; /**< Literal characters of all the segments (with escapes removed) */
+    U32 text_length; /**< Number of characters in @ref text */
+} Glob;
+#pragma clang diagnostic pop
+
+/**
+* @brief Callback for every path matching a pattern
+*
+* @param userdata Pointer passed to @ref globExpand
+* @param path Path (not NUL-terminated)
+* @param length Length of @p path
+*
+* @return Should the expansion go on?
+*/
+typedef B32 (*Glob_Callback) (void *userdata, const Char *path, Size length);
+
+/**
+* @brief State of an expansion
+*/
+typedef struct Glob_Walk {
+    Char *path; /**< Path matched so far */
+    Size length; /**< Length of @ref path */
+    Size capacity; /**< Number of characters in @ref path */
+    Glob_Callback callback; /**< Called for every path that matches */
+    void *userdata; /**< Passed to @ref callback */
+} Glob_Walk;
+
+/**
+* @brief Function to parse a [...] class
+*
+* @param pattern Pattern
+* @param length Length of @p pattern
+* @param start Offset of the '['
+* @param set Returns the class
+* @param end Returns the offset after the closing ']'
+*
+* @return Is there a closing ']'? (If not, the '[' is a literal character.)
+*/
+internal_function
+B32 globClassParse (const Char *pattern, Size length, Size start, Glob_Class *set, Size *end)
+{
+    memset(set, 0, sizeof(*set));
+
+    Size i = start + 1;
+    B32 negate = false;
+    if ((i < length) && ((pattern[i] == '!') || (pattern[i] == '^'))) {
+        negate = true;
+        i++;
+    }
+
+    // NOTE(naman): A ']' right after the '[' (or the '!') is a member, not the end.
+    B32 first = true;
+    while ((i < length) && ((pattern[i] != ']') || first)) {
+        first = false;
+
+        // NOTE(naman): A class can't match the separator, so it doesn't go past one either.
+        if (pattern[i] == '/') {
+            return false;
+        }
+
+        if ((pattern[i] == '\\') && (i + 1 < length)) {
+            i++;
+        }
+        U8 low = (U8)pattern[i++];
+        U8 high = low;
+
+        if ((i + 1 < length) && (pattern[i] == '-') &&
+            (pattern[i + 1] != ']') && (pattern[i + 1] != '/')) {
+            i++;
+            if ((pattern[i] == '\\') && (i + 1 < length)) {
+                i++;
+            }
+            high = (U8)pattern[i++];
+        }
+
+        for (U32 c = low; c <= high; ++c) {
+            set->bits[c >> 3] |= (U8)(1u << (c & 7));
+        }
+    }
+
+    if (i >= length) {
+        return false;
+    }
+
+    if (negate) {
+        for (Size b = 0; b < sizeof(set->bits); ++b) {
+            set->bits[b] = (U8)~set->bits[b];
+        }
+    }
+
+    *end = i + 1;
+    return true;
+}
+
+/**
+* @brief Function to compile a pattern
+*
+* @param glob Returns the compiled pattern (to be freed with @ref globFree)
+* @param pattern Pattern
+* @param length Length of @p pattern
+*/
+internal_function
+void globCompile (Glob *glob, const Char *pattern, Size length)
+{
+    memset(glob, 0, sizeof(*glob));
+
+    // NOTE(naman): Every segment, operation, class and literal character takes up at least one
+    // character of the pattern, so none of the arrays can overflow.
+    Size capacity = length + 1;
+    glob->segments = malloc(capacity * sizeof(*glob->segments));
+    glob->ops = malloc(capacity * sizeof(*glob->ops));
+    glob->classes = malloc(capacity * sizeof(*glob->classes));
+    glob->text = malloc(capacity);
+
+    glob->absolute = (length > 0) && (pattern[0] == '/');
+    glob->directories_only = (length > 0) && (pattern[length - 1] == '/');
+
+    Size i = 0;
+    while (i < length) {
+        if (pattern[i] == '/') {
+            i++;
+            continue;
+        }
+
+        Glob_Segment *segment = &glob->segments[glob->segment_count++];
+        segment->literal = true;
+        segment->text_offset = glob->text_length;
+        segment->text_length = 0;
+        segment->op_first = glob->op_count;
+        segment->op_count = 0;
+
+        while ((i < length) && (pattern[i] != '/')) {
+            Glob_Op op = {0};
+            B32 literal = false;
+
+            if ((pattern[i] == '\\') && (i + 1 < length)) {
+                op.argument = (U8)pattern[i + 1];
+                literal = true;
+                i += 2;
+            } else if (pattern[i] == '*') {
+                op.kind = GLOB_OP_ANY_STRING;
+                i++;
+            } else if (pattern[i] == '?') {
+                op.kind = GLOB_OP_ANY_CHAR;
+                i++;
+            } else if ((pattern[i] == '[') &&
+                       globClassParse(pattern, length, i, &glob->classes[glob->class_count], &i)) {
+                op.kind = GLOB_OP_CLASS;
+                op.argument = glob->class_count++;
+            } else {
+                op.argument = (U8)pattern[i];
+                literal = true;
+                i++;
+            }
+
+            // NOTE(naman): Literal characters before the first wildcard go into the text of the
+            // segment, so that they can be looked up instead of matched.
+            if (literal && segment->literal) {
+                glob->text[glob->text_length++] = (Char)op.argument;
+                segment->text_length++;
+            } else {
+                if (literal) {
+                    op.kind = GLOB_OP_CHAR;
+                }
+                // NOTE(naman): A run of *s matches the same as a single one.
+                if ((op.kind != GLOB_OP_ANY_STRING) || (segment->op_count == 0) ||
+                    (glob->ops[glob->op_count - 1].kind != GLOB_OP_ANY_STRING)) {
+                    glob->ops[glob->op_count++] = op;
+                    segment->op_count++;
+                }
+                segment->literal = false;
+            }
+        }
+    }
+}
+
+/**
+* @brief Function to free a compiled pattern
+*
+* @param glob Compiled pattern
+*/
+internal_function
+void globFree (Glob *glob)
+{
+    free(glob->segments);
+    free(glob->ops);
+    free(glob->classes);
+    free(glob->text);
+    memset(glob, 0, sizeof(*glob));
+}
+
+/**
+* @brief Function to match a name against the operations of a segment
+*
+* A * that fails to match is retried one character further on; since only the last * is ever
+* retried, this takes at most (length of the name) x (number of operations) steps.
+*
+* @param glob Compiled pattern
+* @param segment Segment
+* @param name Name, without the literal characters the segment starts with
+* @param length Length of @p name
+*
+* @return Does the name match?
+*/
+internal_function
+B32 globMatch (Glob *glob, Glob_Segment *segment, const Char *name, Size length)
+{
+    Glob_Op *ops = glob->ops + segment->op_first;
+    U32 count = segment->op_count;
+
+    U32 op = 0;
+    Size n = 0;
+    U32 star_op = UINT32_MAX;
+    Size star_n = 0;
+
+    while (n < length) {
+        if (op < count) {
+            U8 c = (U8)name[n];
+            B32 matched = false;
+
+            switch (ops[op].kind) {
+            case GLOB_OP_CHAR:
+                matched = (ops[op].argument == c);
+                break;
+            case GLOB_OP_ANY_CHAR:
+                matched = true;
+                break;
+            case GLOB_OP_CLASS:
+                matched = (glob->classes[ops[op].argument].bits[c >> 3] >> (c & 7)) & 1;
+                break;
+            case GLOB_OP_ANY_STRING:
+                star_op = op;
+                star_n = n;
+                op++;
+                continue;
+            }
+
+            if (matched) {
+                op++;
+                n++;
+                continue;
+            }
+        }
+
+        if (star_op == UINT32_MAX) {
+            return false;
+        }
+
+        op = star_op + 1;
+        n = ++star_n;
+    }
+
+    while ((op < count) && (ops[op].kind == GLOB_OP_ANY_STRING)) {
+        op++;
+    }
+
+    return op == count;
+}
+
+/**
+* @brief Function to add a name to the path matched so far
+*
+* @param walk State of the expansion
+* @param name Name
+* @param length Length of @p name
+*/
+internal_function
+void globWalkAppend (Glob_Walk *walk, const Char *name, Size length)
+{
+    B32 separator = (walk->length > 0) && (walk->path[walk->length - 1] != '/');
+    Size needed = walk->length + (separator ? 1 : 0) + length + 1;
+    if (needed > walk->capacity) {
+        walk->capacity = needed * 2;
+        walk->path = realloc(walk->path, walk->capacity);
+    }
+
+    if (separator) {
+        walk->path[walk->length++] = '/';
+    }
+    memcpy(walk->path + walk->length, name, length);
+    walk->length += length;
+}
+
+/**
+* @brief Function to match the segments of a pattern from one onwards
+*
+* @param vfs Filesystem
+* @param glob Compiled pattern
+* @param segment_index Index of the segment to match
+* @param id ID of the inode matched by the segments before it
+* @param walk State of the expansion
+*
+* @return Should the expansion go on?
+*/
+internal_function
+B32 globWalk (Vfs *vfs, Glob *glob, U32 segment_index, U32 id, Glob_Walk *walk)
+{
+    if (segment_index == glob->segment_count) {
+        if (glob->directories_only) {
+            globWalkAppend(walk, "", 0); // NOTE(naman): Adds just the separator
+        }
+        return walk->callback(walk->userdata, walk->path, walk->length);
+    }
+
+    if (vfs->inodes[id].kind != VFS_KIND_DIRECTORY) {
+        return true;
+    }
+
+    Glob_Segment *segment = &glob->segments[segment_index];
+    const Char *text = glob->text + segment->text_offset;
+    // NOTE(naman): Everything but the last segment has to be a directory, and so does the last
+    // one if the pattern ends with a '/'.
+    B32 directory = (segment_index + 1 < glob->segment_count) || glob->directories_only;
+    Size length = walk->length;
+
+    if (segment->literal) {
+        U32 child = 0;
+        if ((segment->text_length == 1) && (text[0] == '.')) {
+            child = id;
+        } else if ((segment->text_length == 2) && (text[0] == '.') && (text[1] == '.')) {
+            child = vfs->inodes[id].parent;
+        } else {
+            U32 name = 0;
+            if (vfsAtomFind(vfs, text, segment->text_length, &name)) {
+                child = vfsChildFind(vfs, id, name);
+            }
+        }
+
+        if ((child == 0) ||
+            (directory && (vfs->inodes[child].kind != VFS_KIND_DIRECTORY))) {
+            return true;
+        }
+
+        globWalkAppend(walk, text, segment->text_length);
+        B32 go_on = globWalk(vfs, glob, segment_index + 1, child, walk);
+        walk->length = length;
+        return go_on;
+    }
+
+    B32 dot = (segment->text_length > 0) && (text[0] == '.');
+
+    U32 first = 0;
+    U32 count = vfsComplete(vfs, id, text, segment->text_length, &first);
+    for (U32 i = first; i < first + count; ++i) {
+        U32 child = vfs->inodes[id].sorted[i];
+        Vfs_Atom *atom = &vfs->atoms[vfs->inodes[child].name];
+
+        if ((atom->string[0] == '.') && (dot == false)) {
+            continue;
+        }
+        if (directory && (vfs->inodes[child].kind != VFS_KIND_DIRECTORY)) {
+            continue;
+        }
+        if (globMatch(glob, segment, atom->string + segment->text_length,
+                      atom->length - segment->text_length) == false) {
+            continue;
+        }
+
+        globWalkAppend(walk, atom->string, atom->length);
+        B32 go_on = globWalk(vfs, glob, segment_index + 1, child, walk);
+        walk->length = length;
+        if (go_on == false) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+* @brief Function to find the paths that match a pattern
+*
+* The paths are passed to the callback in sorted order, and are relative when the pattern is.
+*
+* @param vfs Filesystem
+* @param cwd ID of the directory that relative patterns start from
+* @param glob Compiled pattern
+* @param callback Called for every path that matches, until it returns false
+* @param userdata Passed to @p callback
+*/
+internal_function
+void globExpand (Vfs *vfs, U32 cwd, Glob *glob, Glob_Callback callback, void *userdata)
+{
+    Glob_Walk walk = {0};
+    walk.callback = callback;
+    walk.userdata = userdata;
+
+    if (glob->absolute) {
+        globWalkAppend(&walk, "/", 1);
+    }
+
+    if (glob->segment_count > 0) {
+        globWalk(vfs, glob, 0, glob->absolute ? VFS_ROOT : cwd, &walk);
+    }
+
+    free(walk.path);
+}
@@ -0,0 +1,541 @@
+/**
+ * These functions run many learner sessions at once without a window (--host=DIRECTORY), for
+ * grading and dashboards. Every file in the directory is the input of a session: the lines
+ * typed into its terminal. Every session gets a Lua state of its own, with its own filesystem,
+ * scrollbacks and tutorial, in which data/scripts/host.lua runs the game's loop (without ever
+ * rendering) and types in the input.
+ *
+ * The sessions are run by a pool of worker threads. A worker takes the session at the head of
+ * a queue, runs it for a slice of updates and puts it back at the tail, so that a Lua state is
+ * only ever used by one thread at a time, all the sessions make progress together, and the
+ * workers only touch shared state once per slice. A session's Lua state is created by the
+ * worker that first runs it, and closed as soon as it is over.
+ *
+ * @file host_script.c
+ * @author Team Octal
+ * @brief Functions for running sessions without a window
+ */
+
+#include <dirent.h>
+
+#define HOST_SLICE_TICKS 60 /* Updates a session is run for before it goes back in the queue */
+#define HOST_MAX_WORKERS 64
+
+/**
+* @brief Session run by the host
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Host_Session {
+    struct Host_Session *next; /**< Next session in the queue */
+    Char *name; /**< Name of the input file */
+    Char *path; /**< Path of the input file */
+    lua_State *l; /**< Lua state (NULL until the session is started, and once it is over) */
+    Session session; /**< Session the Lua state saves to (left without a path, so it never does) */
+    Memory_Lua memory; /**< Accounting of the memory of the Lua state */
+    U64 memory_bytes; /**< Bytes the Lua state had live when the session was over */
+    F64 microseconds; /**< Time spent running the session */
+    U32 lines; /**< Number of lines in the input file */
+    U32 typed; /**< Number of lines typed in */
+    U32 ticks; /**< Number of updates run */
+    U32 step; /**< Tutorial step reached */
+    B32 finished; /**< Was the tutorial finished? */
+    B32 exited; /**< Did the session exit? */
+    B32 timeout; /**< Did the session run out of updates? */
+    Char *error; /**< Error that stopped the session (NULL if none) */
+} Host_Session;
+#pragma clang diagnostic pop
+
+/**
+* @brief State of the host
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+global_variable struct Host_State {
+    SDL_mutex *mutex; /**< Protects everything below */
+    SDL_cond *session_available; /**< Signalled when a session is put back in the queue */
+    SDL_cond *session_completed; /**< Signalled when a session is over */
+    Host_Session *queue_first; /**< Sessions waiting for a worker */
+    Host_Session *queue_last; /**< Last session in the queue */
+    U32 remaining; /**< Number of sessions that aren't over */
+    U64 ticks; /**< Number of updates run, by all sessions */
+} global_host;
+#pragma clang diagnostic pop
+
+/**
+* @brief Function to make a heap copy of a Lua error message
+*
+* @param l Lua context (with the message at the top of the stack)
+*
+* @return Copy of the message (to be freed by the caller)
+*/
+internal_function
+Char* hostCopyError (lua_State *l)
+{
+    const Char *message = lua_tostring(l, -1);
+    if (message == NULL) {
+        message = "(error object is not a string)";
+    }
+
+    Char *copy = malloc(strlen(message) + 1);
+    strcpy(copy, message);
+    return copy;
+}
+
+/**
+* @brief Function to create the Lua state of a session and start it
+*
+* @param session Session
+*
+* @return success/failure (the error is left in the session)
+*/
+internal_function
+B32 hostSessionStart (Host_Session *session)
+{
+    lua_State *l = memoryLuaNewState(&session->memory);
+    luaL_openlibs(l);
+    session->l = l;
+
+    const luaL_Reg functions[] = {
+        {"VFSNew", scriptVFSNew},
+        {"ShellTokenize", scriptShellTokenize},
+        {"ShellGetOpt", scriptShellGetOpt},
+        {"ScrollbackNew", scriptScrollbackNew},
+        {"JobBudget", scriptJobBudget},
+        {"JobExhausted", scriptJobExhausted},
+        {"SessionSave", scriptSessionSave},
+        {"SessionLoad", scriptSessionLoad},
+        {"MemoryAttribute", scriptMemoryAttribute},
+        {"MemoryUsage", scriptMemoryUsage},
+        // NOTE(naman): There is no audio device, so these return no sample and no voice.
+        {"AudioSinusoidal", scriptAudioSinusoidal},
+        {"AudioPlay", scriptAudioPlay},
+        {"Log", scriptLog},
+        {NULL, NULL},
+    };
+
+    lua_newtable(l); // Engine
+    lua_newtable(l); // Engine Functions
+    luaL_register(l, NULL, functions);
+    lua_setfield(l, -2, "Functions"); // Engine
+    lua_setglobal(l, "Engine"); // {EMPTY}
+
+    lua_newtable(l); // Game
+    lua_setglobal(l, "Game"); // {EMPTY}
+
+    scriptSessionSet(l, &session->session);
+    memoryAttribute(l, MEMORY_SUBSYSTEM_LOOP);
+
+    if (luaL_dofile(l, "data/scripts/host.lua")) {
+        session->error = hostCopyError(l);
+        return false;
+    }
+
+    lua_getglobal(l, "Host"); // Host
+    lua_getfield(l, -1, "Start"); // Host Start
+    lua_pushstring(l, session->path); // Host Start path
+    if (lua_pcall(l, 1, 2, 0)) { // Host <result> <error>
+        session->error = hostCopyError(l);
+        return false;
+    }
+    if (lua_toboolean(l, -2) == false) {
+        session->error = hostCopyError(l);
+        return false;
+    }
+    lua_settop(l, 0);
+
+    return true;
+}
+
+/**
+* @brief Function to read the report of a session and close its Lua state
+*
+* @param session Session
+*/
+internal_function
+void hostSessionStop (Host_Session *session)
+{
+    lua_State *l = session->l;
+
+    lua_settop(l, 0);
+    lua_getglobal(l, "Host"); // Host
+    lua_getfield(l, -1, "Report"); // Host Report
+    if ((lua_isfunction(l, -1) == false) || lua_pcall(l, 0, 1, 0)) { // Host <report>
+        if (session->error == NULL) {
+            session->error = hostCopyError(l);
+        }
+    } else {
+        lua_getfield(l, -1, "lines");
+        session->lines = (U32)lua_tonumber(l, -1);
+        lua_getfield(l, -2, "typed");
+        session->typed = (U32)lua_tonumber(l, -1);
+        lua_getfield(l, -3, "ticks");
+        session->ticks = (U32)lua_tonumber(l, -1);
+        lua_getfield(l, -4, "step");
+        session->step = (U32)lua_tonumber(l, -1);
+        lua_getfield(l, -5, "finished");
+        session->finished = (B32)lua_toboolean(l, -1);
+        lua_getfield(l, -6, "exited");
+        session->exited = (B32)lua_toboolean(l, -1);
+        lua_getfield(l, -7, "timeout");
+        session->timeout = (B32)lua_toboolean(l, -1);
+    }
+
+    session->memory_bytes = memoryTotal(&session->memory).bytes;
+    lua_close(l);
+    session->l = NULL;
+}
+
+/**
+* @brief Function to run a session for a slice of updates
+*
+* @param session Session
+*
+* @return Is the session over?
+*/
+internal_function
+B32 hostSessionRun (Host_Session *session)
+{
+    U64 counter = SDL_GetPerformanceCounter();
+
+    B32 over = false;
+    if ((session->l == NULL) && (hostSessionStart(session) == false)) {
+        over = true;
+    } else {
+        lua_State *l = session->l;
+        lua_getglobal(l, "Host"); // Host
+        lua_getfield(l, -1, "Run"); // Host Run
+        lua_pushnumber(l, HOST_SLICE_TICKS); // Host Run count
+        if (lua_pcall(l, 1, 1, 0)) { // Host <over>
+            session->error = hostCopyError(l);
+            over = true;
+        } else {
+            over = (B32)lua_toboolean(l, -1);
+        }
+        lua_settop(l, 0);
+    }
+
+    if (over && (session->l != NULL)) {
+        hostSessionStop(session);
+    }
+
+    session->microseconds += timeMicrosecondsElapsed(&counter);
+
+    return over;
+}
+
+/**
+* @brief Entry point of the worker threads
+*
+* @param data Unused
+*
+* @return Exit status of thread
+*/
+internal_function
+Sint hostWorker (void *data)
+{
+    unused_variable(data);
+
+    SDL_LockMutex(global_host.mutex);
+    while (true) {
+        while ((global_host.queue_first == NULL) && (global_host.remaining > 0)) {
+            SDL_CondWait(global_host.session_available, global_host.mutex);
+        }
+
+        if (global_host.remaining == 0) {
+            break;
+        }
+
+        Host_Session *session = global_host.queue_first;
+        global_host.queue_first = session->next;
+        if (global_host.queue_first == NULL) {
+            global_host.queue_last = NULL;
+        }
+        session->next = NULL;
+
+        SDL_UnlockMutex(global_host.mutex);
+        U32 ticks = session->ticks;
+        B32 over = hostSessionRun(session);
+        SDL_LockMutex(global_host.mutex);
+
+        // NOTE(naman): The count of updates of a session is only read from its report, so
+        // the ones of a session still running are added once it is over.
+        if (over) {
+            global_host.ticks += session->ticks - ticks;
+            global_host.remaining--;
+            SDL_CondSignal(global_host.session_completed);
+            if (global_host.remaining == 0) {
+                SDL_CondBroadcast(global_host.session_available);
+            }
+        } else {
+            if (global_host.queue_last == NULL) {
+                global_host.queue_first = session;
+            } else {
+                global_host.queue_last->next = session;
+            }
+            global_host.queue_last = session;
+            SDL_CondSignal(global_host.session_available);
+        }
+    }
+    SDL_UnlockMutex(global_host.mutex);
+
+    return 0;
+}
+
+/**
+* @brief Function to compare the names of two sessions (for qsort)
+*
+* @param a Pointer to a session
+* @param b Pointer to another session
+*
+* @return Order of the sessions
+*/
+internal_function
+Sint hostSessionCompare (const void *a, const void *b)
+{
+    const Host_Session *session_a = a;
+    const Host_Session *session_b = b;
+    return strcmp(session_a->name, session_b->name);
+}
+
+/**
+* @brief Function to make a session for every file in a directory
+*
+* Files whose names start with a "." are left out.
+*
+* @param directory Path of the directory
+* @param count Returns the number of sessions
+*
+* @return Sessions, sorted by name (to be freed by the caller), NULL if the directory couldn't
+*         be read
+*/
+internal_function
+Host_Session* hostSessionsFind (const Char *directory, U32 *count)
+{
+    DIR *dir = opendir(directory);
+    if (dir == NULL) {
+        return NULL;
+    }
+
+    Host_Session *sessions = NULL;
+    U32 capacity = 0;
+    *count = 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        Size length = strlen(directory) + 1 + strlen(entry->d_name) + 1;
+        Char *path = malloc(length);
+        snprintf(path, length, "%s/%s", directory, entry->d_name);
+
+        struct stat file_stat;
+        if ((stat(path, &file_stat) != 0) || (S_ISREG(file_stat.st_mode) == false)) {
+            free(path);
+            continue;
+        }
+
+        if (*count == capacity) {
+            capacity = (capacity == 0) ? 64 : (capacity * 2);
+            sessions = realloc(sessions, sizeof(*sessions) * capacity);
+        }
+
+        Host_Session *session = &sessions[(*count)++];
+        memset(session, 0, sizeof(*session));
+        session->path = path;
+        session->name = malloc(strlen(entry->d_name) + 1);
+        strcpy(session->name, entry->d_name);
+    }
+    closedir(dir);
+
+    if (*count > 0) {
+        qsort(sessions, *count, sizeof(*sessions), hostSessionCompare);
+    }
+
+    return sessions;
+}
+
+/**
+* @brief Function to write the report of every session to a file, as tab-separated values
+*
+* @param path Path of the file
+* @param sessions Sessions
+* @param count Number of sessions
+*
+* @return success/failure
+*/
+internal_function
+B32 hostReportWrite (const Char *path, Host_Session *sessions, U32 count)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        logConsole(LOG_LEVEL_ERROR,
+                   LOG_CHANNEL_SCRIPT,
+                   "Couldn't write host report %s",
+                   path);
+        return false;
+    }
+
+    fprintf(file, "session\tlines\ttyped\tupdates\tstep\tfinished\texited\ttimeout\tms\t"
+            "kib\tallocations\terror\n");
+    for (U32 i = 0; i < count; ++i) {
+        Host_Session *session = &sessions[i];
+        fprintf(file, "%s\t%u\t%u\t%u\t%u\t%d\t%d\t%d\t%.3f\t%.1f\t%llu\t",
+                session->name, session->lines, session->typed, session->ticks, session->step,
+                session->finished ? 1 : 0, session->exited ? 1 : 0, session->timeout ? 1 : 0,
+                session->microseconds / 1000.0, (F64)session->memory_bytes / 1024.0,
+                (unsigned long long)memoryTotal(&session->memory).allocations);
+
+        // NOTE(naman): Error messages can span lines, which would break up the record.
+        for (const Char *c = session->error; (c != NULL) && (*c != '\0'); ++c) {
+            fputc(((*c == '\n') || (*c == '\t')) ? ' ' : *c, file);
+        }
+        fputc('\n', file);
+    }
+
+    fclose(file);
+    return true;
+}
+
+/**
+* @brief Function to run a session for every file in a directory, and report on them
+*
+* Progress is logged every second; once every session is over, a line is logged for each of
+* them, along with the total throughput.
+*
+* @param directory Directory holding the input files
+* @param worker_count Number of worker threads (negative to pick automatically)
+* @param report_path Path of the file to write the reports to (NULL for none)
+*
+* @return Did every session run (whether or not it finished the tutorial)?
+*/
+internal_function
+B32 scriptHostRun (const Char *directory, Sint worker_count, const Char *report_path)
+{
+    U32 count = 0;
+    Host_Session *sessions = hostSessionsFind(directory, &count);
+    if (sessions == NULL) {
+        logConsole(LOG_LEVEL_CRITICAL,
+                   LOG_CHANNEL_SCRIPT,
+                   "Couldn't read any sessions from %s",
+                   directory);
+        return false;
+    }
+
+    if (worker_count < 0) {
+        worker_count = SDL_GetCPUCount();
+    }
+    if (worker_count < 1) {
+        worker_count = 1;
+    }
+    if (worker_count > HOST_MAX_WORKERS) {
+        worker_count = HOST_MAX_WORKERS;
+    }
+    if ((U32)worker_count > count) {
+        worker_count = (Sint)count;
+    }
+
+    global_host.mutex = SDL_CreateMutex();
+    global_host.session_available = SDL_CreateCond();
+    global_host.session_completed = SDL_CreateCond();
+    global_host.remaining = count;
+    global_host.ticks = 0;
+    for (U32 i = 0; i < count; ++i) {
+        sessions[i].next = (i + 1 < count) ? &sessions[i + 1] : NULL;
+    }
+    global_host.queue_first = (count > 0) ? &sessions[0] : NULL;
+    global_host.queue_last = (count > 0) ? &sessions[count - 1] : NULL;
+
+    logConsole(LOG_LEVEL_INFO,
+               LOG_CHANNEL_SCRIPT,
+               "Host: running %u sessions from %s on %d threads",
+               count, directory, worker_count);
+
+    U64 start = SDL_GetPerformanceCounter();
+
+    SDL_Thread *workers[HOST_MAX_WORKERS] = {0};
+    Sint started = 0;
+    for (Sint i = 0; i < worker_count; ++i) {
+        workers[started] = SDL_CreateThread(hostWorker, "Host", NULL);
+        if (workers[started] == NULL) {
+            logConsole(LOG_LEVEL_WARN,
+                       LOG_CHANNEL_SCRIPT,
+                       "Couldn't create host thread: %s",
+                       SDL_GetError());
+            continue;
+        }
+        started++;
+    }
+
+    if (started == 0) { // Run everything on this thread instead
+        hostWorker(NULL);
+    }
+
+    SDL_LockMutex(global_host.mutex);
+    while (global_host.remaining > 0) {
+        SDL_CondWaitTimeout(global_host.session_completed, global_host.mutex, 1000);
+        logConsole(LOG_LEVEL_INFO,
+                   LOG_CHANNEL_SCRIPT,
+                   "Host: %u of %u sessions over",
+                   count - global_host.remaining, count);
+    }
+    SDL_UnlockMutex(global_host.mutex);
+
+    for (Sint i = 0; i < started; ++i) {
+        SDL_WaitThread(workers[i], NULL);
+    }
+
+    F64 elapsed = timeMicrosecondsElapsed(&start);
+
+    B32 result = true;
+    F64 busy = 0;
+    for (U32 i = 0; i < count; ++i) {
+        Host_Session *session = &sessions[i];
+        busy += session->microseconds;
+
+        if (session->error != NULL) {
+            result = false;
+            logConsole(LOG_LEVEL_ERROR,
+                       LOG_CHANNEL_SCRIPT,
+                       "%s: failed after %u updates: %s",
+                       session->name, session->ticks, session->error);
+        } else {
+            logConsole(LOG_LEVEL_INFO,
+                       LOG_CHANNEL_SCRIPT,
+                       "%s: typed %u of %u lines in %u updates, tutorial step %u%s%s "
+                       "(%.2f ms, %.1f KiB of Lua memory)",
+                       session->name, session->typed, session->lines, session->ticks,
+                       session->step, session->finished ? " (finished)" : "",
+                       session->timeout ? ", out of updates" : "",
+                       session->microseconds / 1000.0, (F64)session->memory_bytes / 1024.0);
+        }
+    }
+
+    logConsole(LOG_LEVEL_INFO,
+               LOG_CHANNEL_SCRIPT,
+               "Host: %u sessions, %llu updates in %.1f ms on %d threads "
+               "(%.0f updates/s, %.0f%% of the threads' time spent in sessions)",
+               count, (unsigned long long)global_host.ticks, elapsed / 1000.0, worker_count,
+               (elapsed > 0) ? ((F64)global_host.ticks * 1000000.0 / elapsed) : 0.0,
+               (elapsed > 0) ? (100.0 * busy / (elapsed * (F64)worker_count)) : 0.0);
+
+    if (report_path != NULL) {
+        hostReportWrite(report_path, sessions, count);
+    }
+
+    for (U32 i = 0; i < count; ++i) {
+        free(sessions[i].name);
+        free(sessions[i].path);
+        free(sessions[i].error);
+    }
+    free(sessions);
+
+    SDL_DestroyCond(global_host.session_completed);
+    SDL_DestroyCond(global_host.session_available);
+    SDL_DestroyMutex(global_host.mutex);
+    memset(&global_host, 0, sizeof(global_host));
+
+    return result;
+}
@@ -0,0 +1,61 @@
+/**
+ * These functions meter the work done by the jobs of the terminal (the commands it runs), so
+ * that the scheduler can hand each update a fixed slice of instructions and time, and carry on
+ * in the next update with whatever is left. A job is never interrupted midway; it checks the
+ * budget every time it produces a line and gives way once it is spent.
+ *
+ * @file job.c
+ * @author Team Octal
+ * @brief Functions for metering the jobs of the terminal
+ */
+
+#define JOB_HOOK_PERIOD 1000 /* Lua instructions between checks of the budget */
+
+/**
+* @brief Budget of the slice the jobs are running in
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Job_Budget {
+    S64 instructions; /**< Lua instructions left */
+    U64 deadline; /**< Performance counter value at which time runs out */
+    B32 exhausted; /**< Has the budget been spent? */
+} Job_Budget;
+#pragma clang diagnostic pop
+
+/**
+* @brief Function to start a new slice
+*
+* @param budget Budget
+* @param instructions Lua instructions that can be run
+* @param microseconds Time that can be spent
+*/
+internal_function
+void jobBudgetSet (Job_Budget *budget, S64 instructions, F64 microseconds)
+{
+    U64 freq = SDL_GetPerformanceFrequency();
+
+    budget->instructions = instructions;
+    budget->deadline = SDL_GetPerformanceCounter() + (U64)((microseconds * (F64)freq) / 1000000.0);
+    budget->exhausted = (instructions <= 0) || (microseconds <= 0);
+}
+
+/**
+* @brief Function to take some instructions out of the budget
+*
+* @param budget Budget
+* @param instructions Lua instructions that have been run
+*
+* @return Has the budget been spent?
+*/
+internal_function
+B32 jobBudgetCharge (Job_Budget *budget, S64 instructions)
+{
+    budget->instructions -= instructions;
+
+    if ((budget->instructions <= 0) || (SDL_GetPerformanceCounter() >= budget->deadline)) {
+        budget->exhausted = true;
+    }
+
+    return budget->exhausted;
+}
@@ -0,0 +1,91 @@
+/**
+ * These functions are called from Lua and are used to meter the jobs of the terminal with a
+ * count hook. The budget of every Lua state is kept in its registry, so states don't share it.
+ *
+ * @file job_script.c
+ * @author Team Octal
+ * @brief Lua functions for metering the jobs of the terminal
+ */
+
+global_variable Char script_job_budget_key; /* Address used as the registry key of the budget */
+
+/**
+* @brief Function to get the budget of a Lua state
+*
+* @param l Lua context
+*
+* @return Budget (NULL if it hasn't been set yet)
+*/
+internal_function
+Job_Budget* scriptJobGetBudget (lua_State *l)
+{
+    lua_pushlightuserdata(l, &script_job_budget_key);
+    lua_rawget(l, LUA_REGISTRYINDEX);
+    Job_Budget *budget = lua_touserdata(l, -1);
+    lua_pop(l, 1);
+    return budget;
+}
+
+/**
+* @brief Count hook which takes the instructions run out of the budget
+*
+* @param l Lua context
+* @param ar Activation record (unused)
+*/
+internal_function
+void scriptJobHook (lua_State *l, lua_Debug *ar)
+{
+    unused_variable(ar);
+
+    Job_Budget *budget = scriptJobGetBudget(l);
+    if ((budget != NULL) && (budget->exhausted == false)) {
+        jobBudgetCharge(budget, JOB_HOOK_PERIOD);
+    }
+}
+
+/**
+* @brief Lua injected function which starts a new slice for the jobs
+*
+* This function is called from Lua with the number of instructions and microseconds the jobs
+* can use. The count hook is set on the calling coroutine, and every coroutine created from it
+* afterwards inherits it, so the coroutines of the jobs are metered as well.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptJobBudget (lua_State *l)
+{
+    S64 instructions = (S64)luaL_checknumber(l, 1);
+    F64 microseconds = (F64)luaL_checknumber(l, 2);
+
+    Job_Budget *budget = scriptJobGetBudget(l);
+    if (budget == NULL) {
+        lua_pushlightuserdata(l, &script_job_budget_key);
+        budget = lua_newuserdata(l, sizeof(*budget));
+        lua_rawset(l, LUA_REGISTRYINDEX);
+    }
+    jobBudgetSet(budget, instructions, microseconds);
+
+    if (lua_gethook(l) != scriptJobHook) {
+        lua_sethook(l, scriptJobHook, LUA_MASKCOUNT, JOB_HOOK_PERIOD);
+    }
+
+    return 0;
+}
+
+/**
+* @brief Lua injected function which tells whether the slice of the jobs is over
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptJobExhausted (lua_State *l)
+{
+    Job_Budget *budget = scriptJobGetBudget(l);
+    lua_pushboolean(l, (budget == NULL) || budget->exhausted);
+    return 1;
+}
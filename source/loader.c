@@ -0,0 +1,666 @@
+/**
+ * These functions implement the asynchronous asset loader. The expensive parts of loading
+ * an asset (reading files, rasterizing fonts, compiling Lua chunks into bytecode) are done
+ * by a pool of worker threads, while the parts that touch the OpenGL context or the game's
+ * Lua context are done on the main thread when it retires the finished jobs. This way,
+ * the main thread can keep presenting frames while the assets are being loaded.
+ *
+ * @file loader.c
+ * @author Team Octal
+ * @brief Functions for asynchronous asset loading
+ */
+
+#define LOADER_MAX_WORKERS 8
+
+/**
+* @brief Enumeration of the kinds of jobs the loader can do
+*/
+enum Loader_Job_Kind {
+    LOADER_JOB_SCRIPT, /**< Compile a Lua script (and run it on the main thread) */
+    LOADER_JOB_FONT, /**< Bake a TTF font (and upload it on the main thread) */
+};
+
+/**
+* @brief Structure describing a single loading job
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Loader_Job {
+    struct Loader_Job *next; /**< Next job in the queue this job is in */
+    struct Loader_Job *prefetch_next; /**< Next job in the list of prefetched scripts */
+    enum Loader_Job_Kind kind; /**< Kind of job */
+    B32 execute; /**< Should the script be run (as opposed to only being prefetched)? */
+    B32 complete; /**< Has a worker finished this job? */
+    B32 succeeded; /**< Did the worker succeed? */
+    U32 sequence; /**< Order in which scripts have to be run */
+    Sint table_ref; /**< Registry reference to the Lua table representing the asset */
+    Sint callback_ref; /**< Registry reference to the function to call once loaded */
+    Char *path; /**< Path of the script */
+    Char *error; /**< Error message (if the job failed) */
+    Byte *bytecode; /**< Compiled script */
+    Size bytecode_size; /**< Size of @ref bytecode */
+    Asset_Font font; /**< Font being loaded */
+    Char *vert_src; /**< Source of the text vertex shader */
+    Char *frag_src; /**< Source of the text fragment shader */
+    U8 *bitmap; /**< Baked font bitmap */
+} Loader_Job;
+
+/**
+* @brief State of the loader
+*/
+global_variable struct Loader_State {
+    SDL_Thread *workers[LOADER_MAX_WORKERS]; /**< Worker threads */
+    Sint worker_count; /**< Number of worker threads (0 means jobs run inline) */
+    lua_State *inline_compiler; /**< Lua context used to compile when running inline */
+    SDL_mutex *mutex; /**< Protects everything below */
+    SDL_cond *job_available; /**< Signalled when a job is added to the queue */
+    SDL_cond *job_completed; /**< Signalled when a worker completes a job */
+    Loader_Job *queue_first; /**< Jobs waiting for a worker */
+    Loader_Job *queue_last; /**< Last job in the queue */
+    Loader_Job *done_first; /**< Jobs completed by workers (the completion queue) */
+    Loader_Job *done_last; /**< Last job in the completion queue */
+    Loader_Job *prefetched; /**< Scripts compiled ahead of being required */
+    Loader_Job *retiring; /**< Completed scripts waiting for their turn to run */
+    U32 outstanding; /**< Jobs submitted but not yet retired */
+    U32 next_sequence; /**< Sequence number given to the next script to run */
+    U32 retire_sequence; /**< Sequence number of the next script to run */
+    B32 quit; /**< Should the workers exit? */
+} global_loader;
+#pragma clang diagnostic pop
+
+/**
+* @brief Function to make a heap copy of a string
+*
+* @param str String to copy
+*
+* @return Copy of @p str (to be freed by the caller)
+*/
+internal_function
+Char* loaderCopyString (const Char *str)
+{
+    Char *copy = malloc(strlen(str) + 1);
+    strcpy(copy, str);
+    return copy;
+}
+
+/**
+* @brief Function to do the thread-independent part of a job
+*
+* This reads the files the job needs and compiles or bakes them. It doesn't touch any
+* OpenGL or game state, and so can be run on any thread.
+*
+* @param job Job to run
+* @param compiler Lua context owned by the calling thread, used to compile scripts
+*/
+internal_function
+void loaderRunJob (Loader_Job *job, lua_State *compiler)
+{
+    switch (job->kind) {
+        case LOADER_JOB_SCRIPT: {
+            Size script_size = 0;
+            Char *script_src = (Char*)fileRead(job->path, &script_size);
+            if (script_src == NULL) {
+                job->error = loaderCopyString("couldn't read file");
+                break;
+            }
+
+            job->bytecode = assetCompileScriptBytecode(compiler, job->path,
+                                                       script_src, script_size,
+                                                       &job->bytecode_size);
+            free(script_src);
+
+            if (job->bytecode == NULL) {
+                job->error = loaderCopyString(lua_tostring(compiler, -1));
+                lua_pop(compiler, 1);
+                break;
+            }
+
+            job->succeeded = true;
+        } break;
+
+        case LOADER_JOB_FONT: {
+            Asset_Font *font = &job->font;
+
+            job->vert_src = (Char*)fileRead(font->vert_path, NULL);
+            job->frag_src = (Char*)fileRead(font->frag_path, NULL);
+            if ((job->vert_src == NULL) || (job->frag_src == NULL)) {
+                job->error = loaderCopyString("couldn't read shaders");
+                break;
+            }
+
+            job->bitmap = malloc(sizeof(*job->bitmap) * font->bitmap_width * font->bitmap_height);
+            font->baked_char = malloc(sizeof(*font->baked_char) * font->char_num);
+
+            if (assetBakeTrueTypeFont(font->font_path, font->font_size,
+                                      font->bitmap_width, font->bitmap_height,
+                                      font->char_first, font->char_num,
+                                      job->bitmap, font->baked_char) == false) {
+                job->error = loaderCopyString("couldn't bake font");
+                break;
+            }
+
+            job->succeeded = true;
+        } break;
+    }
+}
+
+/**
+* @brief Function to mark a job as completed by a worker
+*
+* Jobs that have to be finished on the main thread are put in the completion queue, from
+* where they are picked up by @ref loaderRetire. Must be called with the mutex held.
+*
+* @param job Job that was completed
+*/
+internal_function
+void loaderCompleteJob (Loader_Job *job)
+{
+    job->complete = true;
+
+    if (job->execute) {
+        if (global_loader.done_last == NULL) {
+            global_loader.done_first = job;
+        } else {
+            global_loader.done_last->next = job;
+        }
+        global_loader.done_last = job;
+    } else {
+        // NOTE(naman): Prefetched scripts stay in the prefetch list until they are required
+        global_loader.outstanding--;
+    }
+
+    SDL_CondBroadcast(global_loader.job_completed);
+}
+
+/**
+* @brief Entry point of the worker threads
+*
+* Each worker owns a Lua context which is only used to compile scripts to bytecode.
+*
+* @param data Unused
+*
+* @return Exit status of thread
+*/
+internal_function
+Sint loaderWorker (void *data)
+{
+    unused_variable(data);
+
+    lua_State *compiler = luaL_newstate();
+
+    SDL_LockMutex(global_loader.mutex);
+    while (true) {
+        while ((global_loader.queue_first == NULL) && (global_loader.quit == false)) {
+            SDL_CondWait(global_loader.job_available, global_loader.mutex);
+        }
+
+        if (global_loader.quit) {
+            break;
+        }
+
+        Loader_Job *job = global_loader.queue_first;
+        global_loader.queue_first = job->next;
+        if (global_loader.queue_first == NULL) {
+            global_loader.queue_last = NULL;
+        }
+        job->next = NULL;
+
+        SDL_UnlockMutex(global_loader.mutex);
+        loaderRunJob(job, compiler);
+        SDL_LockMutex(global_loader.mutex);
+
+        loaderCompleteJob(job);
+    }
+    SDL_UnlockMutex(global_loader.mutex);
+
+    lua_close(compiler);
+
+    return 0;
+}
+
+/**
+* @brief Function to initialize the loader
+*
+* @param worker_count Number of worker threads to start (negative to pick automatically,
+*                     zero to run every job inline at submission)
+*
+* @return success/failure
+*/
+internal_function
+B32 loaderInit (Sint worker_count)
+{
+    if (worker_count < 0) {
+        worker_count = SDL_GetCPUCount() - 1;
+        if (worker_count < 1) worker_count = 1;
+    }
+    if (worker_count > LOADER_MAX_WORKERS) {
+        worker_count = LOADER_MAX_WORKERS;
+    }
+
+    global_loader.mutex = SDL_CreateMutex();
+    global_loader.job_available = SDL_CreateCond();
+    global_loader.job_completed = SDL_CreateCond();
+    global_loader.inline_compiler = luaL_newstate();
+
+    for (Sint i = 0; i < worker_count; ++i) {
+        global_loader.workers[i] = SDL_CreateThread(loaderWorker, "Loader", NULL);
+        if (global_loader.workers[i] == NULL) {
+            logConsole(LOG_LEVEL_WARN,
+                       LOG_CHANNEL_ASSETS,
+                       "Couldn't create loader thread: %s",
+                       SDL_GetError());
+            break;
+        }
+        global_loader.worker_count++;
+    }
+
+    logConsole(LOG_LEVEL_INFO,
+               LOG_CHANNEL_ASSETS,
+               "Loader threads: %d",
+               global_loader.worker_count);
+
+    return true;
+}
+
+/**
+* @brief Function to create a job
+*
+* @param kind Kind of job
+* @param execute Should the result be finished on the main thread (scripts only)?
+*
+* @return New job (to be handed over through @ref loaderSubmit)
+*/
+internal_function
+Loader_Job* loaderJobCreate (enum Loader_Job_Kind kind, B32 execute)
+{
+    Loader_Job *job = calloc(1, sizeof(*job));
+    job->kind = kind;
+    job->execute = execute;
+    job->table_ref = LUA_NOREF;
+    job->callback_ref = LUA_NOREF;
+
+    return job;
+}
+
+/**
+* @brief Function to hand a job over to the workers
+*
+* If there are no workers, the job is run immediately on the calling thread.
+*
+* @param job Job to submit (owned by the loader from now on)
+*/
+internal_function
+void loaderSubmit (Loader_Job *job)
+{
+    SDL_LockMutex(global_loader.mutex);
+
+    global_loader.outstanding++;
+
+    if ((job->kind == LOADER_JOB_SCRIPT) && job->execute) {
+        job->sequence = global_loader.next_sequence++;
+    }
+
+    if (job->execute == false) {
+        job->prefetch_next = global_loader.prefetched;
+        global_loader.prefetched = job;
+    }
+
+    if (global_loader.worker_count == 0) {
+        SDL_UnlockMutex(global_loader.mutex);
+        loaderRunJob(job, global_loader.inline_compiler);
+        SDL_LockMutex(global_loader.mutex);
+
+        loaderCompleteJob(job);
+    } else {
+        if (global_loader.queue_last == NULL) {
+            global_loader.queue_first = job;
+        } else {
+            global_loader.queue_last->next = job;
+        }
+        global_loader.queue_last = job;
+        SDL_CondSignal(global_loader.job_available);
+    }
+
+    SDL_UnlockMutex(global_loader.mutex);
+}
+
+/**
+* @brief Function to find a prefetched script and take its bytecode
+*
+* If the script is still being compiled, this waits for the worker to finish it.
+*
+* @param script_path Path of Lua script source file
+* @param bytecode_size Returns the size of the bytecode
+*
+* @return Bytecode (to be freed by the caller), NULL if the script wasn't prefetched
+*         successfully
+*/
+internal_function
+Byte* loaderTakePrefetched (const Char *script_path, Size *bytecode_size)
+{
+    Byte *bytecode = NULL;
+
+    SDL_LockMutex(global_loader.mutex);
+
+    Loader_Job **link = &global_loader.prefetched;
+    while ((*link != NULL) && (strcmp((*link)->path, script_path) != 0)) {
+        link = &((*link)->prefetch_next);
+    }
+
+    Loader_Job *job = *link;
+    if (job != NULL) {
+        while (job->complete == false) {
+            SDL_CondWait(global_loader.job_completed, global_loader.mutex);
+        }
+
+        // NOTE(naman): The list might have changed while we were waiting
+        link = &global_loader.prefetched;
+        while (*link != job) {
+            link = &((*link)->prefetch_next);
+        }
+        *link = job->prefetch_next;
+    }
+
+    SDL_UnlockMutex(global_loader.mutex);
+
+    if (job != NULL) {
+        if (job->succeeded) {
+            bytecode = job->bytecode;
+            *bytecode_size = job->bytecode_size;
+        } else {
+            free(job->error);
+        }
+        free(job->path);
+        free(job);
+    }
+
+    return bytecode;
+}
+
+/**
+* @brief Function to run a compiled script on the main thread
+*
+* @param game The Lua context in which the script is run
+* @param job Completed script job
+*
+* @return success/failure
+*/
+internal_function
+B32 loaderRetireScript (lua_State *game, Loader_Job *job)
+{
+    lua_rawgeti(game, LUA_REGISTRYINDEX, job->table_ref); // <script>
+    lua_pushstring(game, job->path); // <script> script_path
+    lua_setfield(game, -2, "ScriptPath"); // <script>
+    lua_pop(game, 1); // {EMPTY}
+
+    if (job->succeeded == false) {
+        logConsole(LOG_LEVEL_CRITICAL,
+                   LOG_CHANNEL_SCRIPT,
+                   "Couldn't load script %s: %s",
+                   job->path, job->error);
+        return false;
+    }
+
+    if (assetLoadScriptBytecode(game, job->path, job->bytecode, job->bytecode_size) == false) {
+        logConsole(LOG_LEVEL_WARN,
+                   LOG_CHANNEL_ASSETS,
+                   "Cached bytecode for %s rejected: %s",
+                   job->path,
+                   lua_tostring(game, -1));
+        lua_pop(game, 1);
+
+        return assetLoadScript(game, job->path);
+    }
+
+    if (lua_pcall(game, 0, 0, 0)) {
+        logConsole(LOG_LEVEL_CRITICAL,
+                   LOG_CHANNEL_SCRIPT,
+                   "Couldn't load script %s: %s",
+                   job->path,
+                   lua_tostring(game, -1));
+        lua_pop(game, 1);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+* @brief Function to upload a baked font on the main thread
+*
+* @param game The Lua context in which the font's table lives
+* @param job Completed font job
+*
+* @return success/failure
+*/
+internal_function
+B32 loaderRetireFont (lua_State *game, Loader_Job *job)
+{
+    Asset_Font *font = &job->font;
+
+    if (job->succeeded == false) {
+        logConsole(LOG_LEVEL_CRITICAL,
+                   LOG_CHANNEL_ASSETS,
+                   "Couldn't load TTF %s: %s",
+                   font->font_path, job->error);
+        return false;
+    }
+
+    glGenVertexArrays(1, &font->vao);
+    glGenBuffers(1, &font->vbo);
+
+    if ((assetCreateShader(font->vert_path, font->frag_path,
+                           job->vert_src, job->frag_src,
+                           &font->program) == false) ||
+        (assetUploadTrueTypeFont(job->bitmap,
+                                 font->bitmap_width, font->bitmap_height,
+                                 font->vao, font->vbo,
+                                 &font->texture) == false)) {
+        logConsole(LOG_LEVEL_CRITICAL,
+                   LOG_CHANNEL_ASSETS,
+                   "Couldn't upload TTF %s",
+                   font->font_path);
+        return false;
+    }
+
+    lua_rawgeti(game, LUA_REGISTRYINDEX, job->table_ref); // <font>
+    assetSetTrueTypeFontFields(game, -1, font);
+
+    if (job->callback_ref != LUA_NOREF) {
+        lua_rawgeti(game, LUA_REGISTRYINDEX, job->callback_ref); // <font> <callback>
+        lua_pushvalue(game, -2); // <font> <callback> <font>
+        if (lua_pcall(game, 1, 0, 0)) { // <font>
+            logConsole(LOG_LEVEL_CRITICAL,
+                       LOG_CHANNEL_SCRIPT,
+                       "Callback of TTF %s failed: %s",
+                       font->font_path,
+                       lua_tostring(game, -1));
+            lua_pop(game, 2);
+            return false;
+        }
+    }
+    lua_pop(game, 1); // {EMPTY}
+
+    return true;
+}
+
+/**
+* @brief Function to free a retired job
+*
+* @param game The Lua context holding the job's references
+* @param job Job to free
+*/
+internal_function
+void loaderFreeJob (lua_State *game, Loader_Job *job)
+{
+    luaL_unref(game, LUA_REGISTRYINDEX, job->table_ref);
+    luaL_unref(game, LUA_REGISTRYINDEX, job->callback_ref);
+
+    free(job->path);
+    free(job->error);
+    free(job->bytecode);
+    free(job->font.font_path);
+    free(job->font.vert_path);
+    free(job->font.frag_path);
+    free(job->vert_src);
+    free(job->frag_src);
+    free(job->bitmap);
+    free(job);
+
+    // NOTE(naman): job->font.baked_char is referred to by the font's table, and so lives on
+}
+
+/**
+* @brief Function to finish the completed jobs on the main thread
+*
+* This takes all the jobs in the completion queue and does the part of the work that needs
+* the OpenGL context or the game's Lua context. Scripts are run in the order in which they
+* were submitted, no matter in which order the workers finish them. If anything fails, the
+* game is stopped.
+*
+* @param game The Lua context in which the assets are loaded
+*/
+internal_function
+void loaderRetire (lua_State *game)
+{
+    SDL_LockMutex(global_loader.mutex);
+    Loader_Job *done = global_loader.done_first;
+    global_loader.done_first = NULL;
+    global_loader.done_last = NULL;
+    SDL_UnlockMutex(global_loader.mutex);
+
+    U32 retired = 0;
+
+    while (done != NULL) {
+        Loader_Job *job = done;
+        done = done->next;
+        job->next = NULL;
+
+        if (job->kind == LOADER_JOB_FONT) {
+            if (loaderRetireFont(game, job) == false) {
+                global_game_is_running = false;
+            }
+            loaderFreeJob(game, job);
+            retired++;
+        } else {
+            Loader_Job **link = &global_loader.retiring;
+            while ((*link != NULL) && ((*link)->sequence < job->sequence)) {
+                link = &((*link)->next);
+            }
+            job->next = *link;
+            *link = job;
+        }
+    }
+
+    while ((global_loader.retiring != NULL) &&
+           (global_loader.retiring->sequence == global_loader.retire_sequence)) {
+        Loader_Job *job = global_loader.retiring;
+        global_loader.retiring = job->next;
+        global_loader.retire_sequence++;
+
+        if (loaderRetireScript(game, job) == false) {
+            global_game_is_running = false;
+        }
+
+        loaderFreeJob(game, job);
+        retired++;
+    }
+
+    SDL_LockMutex(global_loader.mutex);
+    global_loader.outstanding -= retired;
+    SDL_UnlockMutex(global_loader.mutex);
+}
+
+/**
+* @brief Function to do a job entirely on the main thread, bypassing the workers
+*
+* This is used for assets that are loaded lazily on first use, where the caller can't
+* continue until the asset is there. If anything fails, the game is stopped.
+*
+* @param game The Lua context in which the asset is loaded
+* @param job Job to do (freed by this function)
+*
+* @return success/failure
+*/
+internal_function
+B32 loaderRunImmediately (lua_State *game, Loader_Job *job)
+{
+    loaderRunJob(job, global_loader.inline_compiler);
+
+    B32 result = false;
+    switch (job->kind) {
+        case LOADER_JOB_SCRIPT: {
+            result = loaderRetireScript(game, job);
+        } break;
+
+        case LOADER_JOB_FONT: {
+            result = loaderRetireFont(game, job);
+        } break;
+    }
+
+    if (result == false) {
+        global_game_is_running = false;
+    }
+
+    loaderFreeJob(game, job);
+
+    return result;
+}
+
+/**
+* @brief Function to check if all the submitted jobs have been retired
+*
+* @return Is the loader idle?
+*/
+internal_function
+B32 loaderIsIdle (void)
+{
+    SDL_LockMutex(global_loader.mutex);
+    B32 idle = (global_loader.outstanding == 0);
+    SDL_UnlockMutex(global_loader.mutex);
+
+    return idle;
+}
+
+/**
+* @brief Function to drop the prefetched scripts that were never required
+*
+* Must only be called when the loader is idle.
+*/
+internal_function
+void loaderReleasePrefetched (void)
+{
+    SDL_LockMutex(global_loader.mutex);
+    Loader_Job *job = global_loader.prefetched;
+    global_loader.prefetched = NULL;
+    SDL_UnlockMutex(global_loader.mutex);
+
+    while (job != NULL) {
+        Loader_Job *next = job->prefetch_next;
+        free(job->path);
+        free(job->error);
+        free(job->bytecode);
+        free(job);
+        job = next;
+    }
+}
+
+/**
+* @brief Function to stop the worker threads
+*/
+internal_function
+void loaderShutdown (void)
+{
+    SDL_LockMutex(global_loader.mutex);
+    global_loader.quit = true;
+    SDL_CondBroadcast(global_loader.job_available);
+    SDL_UnlockMutex(global_loader.mutex);
+
+    for (Sint i = 0; i < global_loader.worker_count; ++i) {
+        SDL_WaitThread(global_loader.workers[i], NULL);
+    }
+    global_loader.worker_count = 0;
+
+    lua_close(global_loader.inline_compiler);
+    global_loader.inline_compiler = NULL;
+}
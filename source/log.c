@@ -2,11 +2,23 @@
  * These functions are used for logging any data that could be used for debugging, diagnostics
  * or analysis in the future.
  *
+ * Logging is asynchronous: @ref logConsole checks the level of the channel before doing any
+ * work, and then only captures the format string and the raw arguments into a record in a
+ * lock-free ring. A background thread formats the records and writes them in batches to the
+ * console and (optionally) to a rotating log file, so that the threads that log never wait
+ * on terminal or disk I/O.
+ *
  * @file log.c
  * @author Team Octal
  * @brief Functions for logging
  */
 
+#define LOG_RING_SIZE 4096 /* Must be a power of two */
+#define LOG_RECORD_ARGS_SIZE 480
+#define LOG_BATCH_SIZE (64 * 1024)
+#define LOG_FILE_MAX_SIZE (4 * 1024 * 1024)
+#define LOG_FILE_KEEP 3
+
 /**
 * @brief Enumeration of all priority levels of logging
 *
@@ -44,193 +56,822 @@ enum Log_Channel {
 };
 
 /**
-* @brief Function to log console data/information
+* @brief A single log message, as captured by @ref logConsole
 *
-* This function is used for logging console information and other errors and warning messages
-* produced during the game's executions.
+* The message is stored unformatted: the format string is kept as a pointer (it has to be a
+* string literal) and the arguments are packed into @ref args in the order in which they
+* appear in the format. Strings are copied, since they might not outlive the call.
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Log_Record {
+    SDL_atomic_t sequence; /**< Position in the ring for which this slot is ready */
+    U64 counter; /**< Performance counter at the time of logging */
+    enum Log_Level level; /**< Level of the message */
+    enum Log_Channel channel; /**< Channel of the message */
+    const Char *format; /**< Format string of the message */
+    B32 truncated; /**< Did the arguments not fit in @ref args? */
+    Size args_size; /**< Number of bytes used in @ref args */
+    Byte args[LOG_RECORD_ARGS_SIZE]; /**< Packed arguments of the message */
+} Log_Record;
+
+/**
+* @brief State of the logging subsystem
+*/
+global_variable struct Log_State {
+    enum Log_Level channel_level[LOG_CHANNEL_COUNT]; /**< Lowest level logged on each channel */
+    Log_Record *ring; /**< Ring of records waiting to be written */
+    SDL_atomic_t enqueue_position; /**< Next position to be taken by a producer */
+    U32 dequeue_position; /**< Next position to be read by the writer thread */
+    SDL_atomic_t dropped; /**< Number of records dropped because the ring was full */
+    SDL_atomic_t running; /**< Should the writer thread keep running? */
+    SDL_Thread *writer; /**< Thread that formats and writes the records */
+    U64 start_counter; /**< Performance counter at initialization */
+    B32 console; /**< Should messages be written to the console? */
+    Char *file_path; /**< Path of the log file (NULL for no file) */
+    FILE *file; /**< Log file */
+    Size file_size; /**< Bytes written to the current log file */
+} global_log;
+#pragma clang diagnostic pop
+
+/**
+* @brief Enumeration of the types in which arguments are packed into a record
+*/
+enum Log_Arg_Type {
+    LOG_ARG_NONE,
+    LOG_ARG_INT,
+    LOG_ARG_LONG,
+    LOG_ARG_LONG_LONG,
+    LOG_ARG_SIZE,
+    LOG_ARG_INTMAX,
+    LOG_ARG_PTRDIFF,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_LONG_DOUBLE,
+    LOG_ARG_POINTER,
+    LOG_ARG_STRING,
+};
+
+/**
+* @brief Description of a single conversion specification in a format string
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Log_Spec {
+    const Char *begin; /**< Start of the specification (the '%') */
+    const Char *end; /**< One past the conversion character */
+    Sint stars; /**< Number of '*' (width/precision passed as arguments) */
+    enum Log_Arg_Type type; /**< Type of the argument */
+} Log_Spec;
+#pragma clang diagnostic pop
+
+/**
+* @brief Function to parse the next conversion specification in a format string
+*
+* @param format Format string, starting at a '%'
+* @param spec Returns the specification
 */
 internal_function
-B32 logConsole (enum Log_Level level, enum Log_Channel channel,
-               const char *text, ...)
+void logParseSpec (const Char *format, Log_Spec *spec)
 {
-    va_list args;
-    va_start(args, text);
+    const Char *c = format + 1;
+    spec->begin = format;
+    spec->stars = 0;
 
-    SDL_LogPriority priority;
-    if (level == LOG_LEVEL_VERBOSE) priority = SDL_LOG_PRIORITY_VERBOSE;
-    else if (level == LOG_LEVEL_DEBUG) priority = SDL_LOG_PRIORITY_DEBUG;
-    else if (level == LOG_LEVEL_INFO) priority = SDL_LOG_PRIORITY_INFO;
-    else if (level == LOG_LEVEL_WARN) priority = SDL_LOG_PRIORITY_WARN;
-    else if (level == LOG_LEVEL_ERROR) priority = SDL_LOG_PRIORITY_ERROR;
-    else if (level == LOG_LEVEL_CRITICAL) priority = SDL_LOG_PRIORITY_CRITICAL;
-    else priority = SDL_LOG_PRIORITY_INFO;
+    while ((*c != '\0') && (strchr("-+ #0", *c) != NULL)) c++;
+    while ((*c != '\0') && ((*c == '*') || ((*c >= '0') && (*c <= '9')) || (*c == '.'))) {
+        if (*c == '*') spec->stars++;
+        c++;
+    }
 
-    char *channel_name;
+    enum Log_Arg_Type integer = LOG_ARG_INT;
+    B32 long_double = false;
+    if ((c[0] == 'h') && (c[1] == 'h')) {
+        c += 2;
+    } else if (c[0] == 'h') {
+        c += 1;
+    } else if ((c[0] == 'l') && (c[1] == 'l')) {
+        integer = LOG_ARG_LONG_LONG;
+        c += 2;
+    } else if (c[0] == 'l') {
+        integer = LOG_ARG_LONG;
+        c += 1;
+    } else if (c[0] == 'z') {
+        integer = LOG_ARG_SIZE;
+        c += 1;
+    } else if (c[0] == 'j') {
+        integer = LOG_ARG_INTMAX;
+        c += 1;
+    } else if (c[0] == 't') {
+        integer = LOG_ARG_PTRDIFF;
+        c += 1;
+    } else if (c[0] == 'L') {
+        long_double = true;
+        c += 1;
+    }
+
+    switch (*c) {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c': {
+            spec->type = integer;
+        } break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+            spec->type = long_double ? LOG_ARG_LONG_DOUBLE : LOG_ARG_DOUBLE;
+        } break;
+        case 'p': {
+            spec->type = LOG_ARG_POINTER;
+        } break;
+        case 's': {
+            spec->type = LOG_ARG_STRING;
+        } break;
+        default: { // NOTE(naman): "%%", and also "%n" which is never captured
+            spec->type = LOG_ARG_NONE;
+        } break;
+    }
+
+    spec->end = (*c == '\0') ? c : (c + 1);
+}
+
+/**
+* @brief Function to append a value to the packed arguments of a record
+*
+* @param record Record being filled
+* @param data Value
+* @param size Size of value
+*
+* @return success/failure (failure if the value doesn't fit)
+*/
+internal_function
+B32 logPackArg (Log_Record *record, const void *data, Size size)
+{
+    if ((record->args_size + size) > LOG_RECORD_ARGS_SIZE) {
+        record->truncated = true;
+        return false;
+    }
+
+    memcpy(record->args + record->args_size, data, size);
+    record->args_size += size;
+
+    return true;
+}
+
+/**
+* @brief Function to capture the arguments of a message into a record
+*
+* @param record Record being filled (with @ref Log_Record::format already set)
+* @param args Arguments of the message
+*/
+internal_function
+void logCaptureArgs (Log_Record *record, va_list args)
+{
+    for (const Char *c = record->format; (*c != '\0') && (record->truncated == false);) {
+        if (*c != '%') {
+            c++;
+            continue;
+        }
+
+        Log_Spec spec;
+        logParseSpec(c, &spec);
+        c = spec.end;
+
+        for (Sint i = 0; i < spec.stars; ++i) {
+            int star = va_arg(args, int);
+            logPackArg(record, &star, sizeof(star));
+        }
+
+        switch (spec.type) {
+            case LOG_ARG_NONE: {
+            } break;
+            case LOG_ARG_INT: {
+                int value = va_arg(args, int);
+                logPackArg(record, &value, sizeof(value));
+            } break;
+            case LOG_ARG_LONG: {
+                long value = va_arg(args, long);
+                logPackArg(record, &value, sizeof(value));
+            } break;
+            case LOG_ARG_LONG_LONG: {
+                long long value = va_arg(args, long long);
+                logPackArg(record, &value, sizeof(value));
+            } break;
+            case LOG_ARG_SIZE: {
+                size_t value = va_arg(args, size_t);
+                logPackArg(record, &value, sizeof(value));
+            } break;
+            case LOG_ARG_INTMAX: {
+                intmax_t value = va_arg(args, intmax_t);
+                logPackArg(record, &value, sizeof(value));
+            } break;
+            case LOG_ARG_PTRDIFF: {
+                ptrdiff_t value = va_arg(args, ptrdiff_t);
+                logPackArg(record, &value, sizeof(value));
+            } break;
+            case LOG_ARG_DOUBLE: {
+                double value = va_arg(args, double);
+                logPackArg(record, &value, sizeof(value));
+            } break;
+            case LOG_ARG_LONG_DOUBLE: {
+                long double value = va_arg(args, long double);
+                logPackArg(record, &value, sizeof(value));
+            } break;
+            case LOG_ARG_POINTER: {
+                void *value = va_arg(args, void*);
+                logPackArg(record, &value, sizeof(value));
+            } break;
+            case LOG_ARG_STRING: {
+                const Char *value = va_arg(args, const Char*);
+                if (value == NULL) value = "(null)";
+
+                // NOTE(naman): Strings are stored as a length followed by the characters,
+                // and are cut short to fit in the record.
+                Size space = LOG_RECORD_ARGS_SIZE - record->args_size;
+                if (space < sizeof(U16)) {
+                    record->truncated = true;
+                    break;
+                }
+                Size length = strlen(value);
+                if (length > (space - sizeof(U16))) {
+                    length = space - sizeof(U16);
+                }
+                U16 length_stored = (U16)length;
+                logPackArg(record, &length_stored, sizeof(length_stored));
+                logPackArg(record, value, length);
+            } break;
+        }
+    }
+}
+
+/**
+* @brief Function to get the printable name of a channel
+*
+* @param channel Channel
+*
+* @return Name of channel (with a trailing space)
+*/
+internal_function
+const Char* logChannelName (enum Log_Channel channel)
+{
     switch (channel) {
     case LOG_CHANNEL_UNKNOWN:
-        channel_name = "[...] ";
-        break;
+        return "[...] ";
     case LOG_CHANNEL_LOG:
-        channel_name = "[LOG] ";
-        break;
+        return "[LOG] ";
     case LOG_CHANNEL_FILE:
-        channel_name = "[FILE] ";
-        break;
+        return "[FILE] ";
     case LOG_CHANNEL_SCRIPT:
-        channel_name = "[SCRIPT] ";
-        break;
+        return "[SCRIPT] ";
     case LOG_CHANNEL_TIME:
-        channel_name = "[TIME] ";
-        break;
+        return "[TIME] ";
     case LOG_CHANNEL_AUDIO:
-        channel_name = "[AUDIO]: ";
-        break;
+        return "[AUDIO]: ";
     case LOG_CHANNEL_RENDER:
-        channel_name = "[RENDER] ";
-        break;
+        return "[RENDER] ";
     case LOG_CHANNEL_INIT:
-        channel_name = "[INIT] ";
-        break;
+        return "[INIT] ";
     case LOG_CHANNEL_ARG:
-        channel_name = "[ARG] ";
-        break;
+        return "[ARG] ";
     case LOG_CHANNEL_LOOP:
-        channel_name = "[LOOP] ";
-        break;
+        return "[LOOP] ";
     case LOG_CHANNEL_OPENGL:
-        channel_name = "[OpenGL] ";
-        break;
+        return "[OpenGL] ";
     case LOG_CHANNEL_ASSETS:
-        channel_name = "[Assets] ";
-        break;
+        return "[Assets] ";
     case LOG_CHANNEL_COUNT:
-        channel_name = "[**INVALID**] ";
-        break;
+        return "[**INVALID**] ";
+    }
+
+    return "[**INVALID**] ";
+}
+
+/**
+* @brief Function to get the printable name of a level
+*
+* @param level Level
+*
+* @return Name of level
+*/
+internal_function
+const Char* logLevelName (enum Log_Level level)
+{
+    switch (level) {
+    case LOG_LEVEL_VERBOSE:
+        return "VERBOSE";
+    case LOG_LEVEL_DEBUG:
+        return "DEBUG";
+    case LOG_LEVEL_INFO:
+        return "INFO";
+    case LOG_LEVEL_WARN:
+        return "WARN";
+    case LOG_LEVEL_ERROR:
+        return "ERROR";
+    case LOG_LEVEL_CRITICAL:
+        return "CRITICAL";
+    case LOG_LEVEL_COUNT:
+        return "INFO";
+    }
+
+    return "INFO";
+}
+
+/**
+* @brief Function to check if a message would be logged
+*
+* @param level Level of the message
+* @param channel Channel of the message
+*
+* @return Is the message going to be logged?
+*/
+internal_function
+B32 logIsEnabled (enum Log_Level level, enum Log_Channel channel)
+{
+    if ((channel < LOG_CHANNEL_UNKNOWN) || (channel >= LOG_CHANNEL_COUNT)) {
+        channel = LOG_CHANNEL_UNKNOWN;
+    }
+
+    return (level >= global_log.channel_level[channel]);
+}
+
+/**
+* @brief Function to set the lowest level that gets logged
+*
+* @param level Lowest level to log
+* @param channel Channel to which it applies (LOG_CHANNEL_COUNT for all channels)
+*/
+internal_function
+void logSetLevel (enum Log_Level level, enum Log_Channel channel)
+{
+    if (channel == LOG_CHANNEL_COUNT) {
+        for (Sint i = LOG_CHANNEL_UNKNOWN; i < LOG_CHANNEL_COUNT; ++i) {
+            global_log.channel_level[i] = level;
+        }
+    } else {
+        global_log.channel_level[channel] = level;
     }
+}
 
-    Size text_length = strlen(channel_name) + strlen(text) + 1;
-    Char* real_text = malloc(sizeof(*real_text) * text_length);
-    strcpy(real_text, channel_name);
-    strcat(real_text, text);
+/**
+* @brief Function to log console data/information
+*
+* This function is used for logging console information and other errors and warning messages
+* produced during the game's executions. The message is dropped before doing any work if its
+* level is filtered out on its channel. Otherwise, it is captured into the log ring and gets
+* formatted and written by the writer thread.
+*
+* @p text has to be a string literal, since it is only formatted later; to log other strings,
+* pass them as an argument to "%s".
+*/
+internal_function
+B32 logConsole (enum Log_Level level, enum Log_Channel channel,
+               const char *text, ...)
+{
+    if (logIsEnabled(level, channel) == false) {
+        return true;
+    }
+
+    va_list args;
+    va_start(args, text);
+
+    if (SDL_AtomicGet(&global_log.running) == 0) {
+        Char line[1024];
+        Sint header = snprintf(line, sizeof(line), "%s: %s",
+                               logLevelName(level), logChannelName(channel));
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wformat-nonliteral"
+        vsnprintf(line + header, sizeof(line) - (Size)header, text, args);
+#pragma clang diagnostic pop
+        fprintf(stderr, "%s%s", line,
+                ((line[0] != '\0') && (line[strlen(line) - 1] == '\n')) ? "" : "\n");
+        va_end(args);
+        return true;
+    }
 
-    SDL_LogMessageV(SDL_LOG_CATEGORY_APPLICATION, priority, real_text, args);
-    free(real_text);
+    U32 position = (U32)SDL_AtomicGet(&global_log.enqueue_position);
+    Log_Record *record = NULL;
+
+    // NOTE(naman): This is a bounded multi-producer queue; a producer claims a slot by
+    // advancing the enqueue position, and publishes it by bumping the slot's sequence.
+    while (true) {
+        record = &global_log.ring[position & (LOG_RING_SIZE - 1)];
+        U32 sequence = (U32)SDL_AtomicGet(&record->sequence);
+        S32 difference = (S32)(sequence - position);
+
+        if (difference == 0) {
+            if (SDL_AtomicCAS(&global_log.enqueue_position, (int)position, (int)(position + 1))) {
+                break;
+            }
+            position = (U32)SDL_AtomicGet(&global_log.enqueue_position);
+        } else if (difference < 0) {
+            SDL_AtomicAdd(&global_log.dropped, 1);
+            va_end(args);
+            return false;
+        } else {
+            position = (U32)SDL_AtomicGet(&global_log.enqueue_position);
+        }
+    }
+
+    record->counter = SDL_GetPerformanceCounter();
+    record->level = level;
+    record->channel = channel;
+    record->format = text;
+    record->truncated = false;
+    record->args_size = 0;
+    logCaptureArgs(record, args);
     va_end(args);
+
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&record->sequence, (int)(position + 1));
+
     return true;
 }
 
 /**
-* @brief Function to log OpenGL diagnostics
+* @brief Function to format a record into a line of text
 *
-* This function is used for logging 3D rendering debug data and other error and warning messages
-* related to 3D OpenGL graphics.
+* @param record Record to format
+* @param out Buffer to write into
+* @param capacity Size of @p out
 *
-* @param source Information on who sent the diagnostic
-* @param type Kind of diagnostic
-* @param id Unique ID of the diagnostic
-* @param severity Denotes how severe it is
-* @param length Length of the diagnostic message
-* @param message Diagnostic message
-* @param user_param Any user parameters, unused
+* @return Number of characters written (not counting the terminating null)
 */
 internal_function
-void logGLDebugCallback(U32 source, U32 type, U32 id, U32 severity,
-                        S32 length, const Char* message,
-                        const void* user_param)
+Size logFormatRecord (Log_Record *record, Char *out, Size capacity)
 {
-    unused_variable(user_param);
+    F64 seconds = (F64)(record->counter - global_log.start_counter) /
+        (F64)SDL_GetPerformanceFrequency();
 
-    switch (id) {
-        case 131218: { // NOTE(naman): NVIDIA: "shader will be recompiled due to GL state mismatches"
-            return;
-        } break;
-        default: {
-        } break;
+    Sint header = snprintf(out, capacity, "[%10.4f] %s: %s",
+                           seconds,
+                           logLevelName(record->level),
+                           logChannelName(record->channel));
+    Size length = (header > 0) ? (Size)header : 0;
+    if (length >= capacity) length = capacity - 1;
+
+    const Byte *arg = record->args;
+    const Byte *args_end = record->args + record->args_size;
+
+    for (const Char *c = record->format; *c != '\0';) {
+        if (*c != '%') {
+            const Char *next = strchr(c, '%');
+            Size literal = (next == NULL) ? strlen(c) : (Size)(next - c);
+            if (literal > (capacity - 1 - length)) literal = capacity - 1 - length;
+            memcpy(out + length, c, literal);
+            length += literal;
+            c += literal;
+            if (length == (capacity - 1)) break;
+            continue;
+        }
+
+        Log_Spec spec;
+        logParseSpec(c, &spec);
+        c = spec.end;
+
+        // NOTE(naman): The spec is copied with each '*' replaced by the captured value, so
+        // that only one argument ever needs to be passed to snprintf.
+        Char spec_str[64] = {0};
+        Size spec_length = 0;
+        B32 missing = false;
+        for (const Char *s = spec.begin; (s < spec.end) && (spec_length < (sizeof(spec_str) - 16)); ++s) {
+            if (*s == '*') {
+                int star = 0;
+                if ((arg + sizeof(star)) <= args_end) {
+                    memcpy(&star, arg, sizeof(star));
+                    arg += sizeof(star);
+                } else {
+                    missing = true;
+                }
+                spec_length += (Size)snprintf(spec_str + spec_length,
+                                              sizeof(spec_str) - spec_length,
+                                              "%d", star);
+            } else {
+                spec_str[spec_length++] = *s;
+            }
+        }
+
+        Char *dest = out + length;
+        Size space = capacity - length;
+        Sint written = 0;
+
+#define LOG_FORMAT_ARG(TYPE) do {                                       \
+            TYPE value;                                                 \
+            if (missing || ((arg + sizeof(value)) > args_end)) {        \
+                missing = true;                                         \
+                break;                                                  \
+            }                                                           \
+            memcpy(&value, arg, sizeof(value));                         \
+            arg += sizeof(value);                                       \
+            written = snprintf(dest, space, spec_str, value);           \
+        } while (0)
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wformat-nonliteral"
+        switch (spec.type) {
+            case LOG_ARG_NONE: {
+                if (spec.end[-1] == '%') written = snprintf(dest, space, "%%");
+            } break;
+            case LOG_ARG_INT: LOG_FORMAT_ARG(int); break;
+            case LOG_ARG_LONG: LOG_FORMAT_ARG(long); break;
+            case LOG_ARG_LONG_LONG: LOG_FORMAT_ARG(long long); break;
+            case LOG_ARG_SIZE: LOG_FORMAT_ARG(size_t); break;
+            case LOG_ARG_INTMAX: LOG_FORMAT_ARG(intmax_t); break;
+            case LOG_ARG_PTRDIFF: LOG_FORMAT_ARG(ptrdiff_t); break;
+            case LOG_ARG_DOUBLE: LOG_FORMAT_ARG(double); break;
+            case LOG_ARG_LONG_DOUBLE: LOG_FORMAT_ARG(long double); break;
+            case LOG_ARG_POINTER: LOG_FORMAT_ARG(void*); break;
+            case LOG_ARG_STRING: {
+                U16 string_length = 0;
+                if (missing || ((arg + sizeof(string_length)) > args_end)) {
+                    missing = true;
+                    break;
+                }
+                memcpy(&string_length, arg, sizeof(string_length));
+                arg += sizeof(string_length);
+
+                // NOTE(naman): The copied string isn't null terminated, so the precision
+                // is forced (any precision in the original spec is dropped).
+                Char *precision = strchr(spec_str, '.');
+                if (precision != NULL) {
+                    *precision = '\0';
+                } else {
+                    spec_str[spec_length - 1] = '\0';
+                }
+                strcat(spec_str, ".*s");
+                written = snprintf(dest, space, spec_str, (int)string_length, (const Char*)arg);
+                arg += string_length;
+            } break;
+        }
+#pragma clang diagnostic pop
+
+#undef LOG_FORMAT_ARG
+
+        if (missing) {
+            written = snprintf(dest, space, "<?>");
+        }
+
+        if (written > 0) {
+            length += (Size)written;
+            if (length >= capacity) {
+                length = capacity - 1;
+                break;
+            }
+        }
+    }
+
+    if (record->truncated && ((capacity - length) > 4)) {
+        memcpy(out + length, "...", 3);
+        length += 3;
+    }
+
+    // NOTE(naman): Some messages already end in a newline
+    if ((length == 0) || (out[length - 1] != '\n')) {
+        if (length == (capacity - 1)) length--;
+        out[length++] = '\n';
+    }
+    out[length] = '\0';
+
+    return length;
+}
+
+/**
+* @brief Function to rotate the log file once it gets too big
+*
+* The current file is renamed to "<path>.1", the older ones to "<path>.2" and so on, keeping
+* at most @ref LOG_FILE_KEEP old files.
+*/
+internal_function
+void logRotateFile (void)
+{
+    fclose(global_log.file);
+    global_log.file = NULL;
+
+    Size length = strlen(global_log.file_path) + 16;
+    Char *from = malloc(length);
+    Char *to = malloc(length);
+
+    for (Sint i = LOG_FILE_KEEP - 1; i >= 1; --i) {
+        snprintf(from, length, "%s.%d", global_log.file_path, i);
+        snprintf(to, length, "%s.%d", global_log.file_path, i + 1);
+        rename(from, to);
+    }
+    snprintf(to, length, "%s.1", global_log.file_path);
+    rename(global_log.file_path, to);
+
+    free(from);
+    free(to);
+
+    global_log.file = fopen(global_log.file_path, "w");
+    global_log.file_size = 0;
+}
+
+/**
+* @brief Function to write a batch of formatted text to the outputs
+*
+* @param batch Formatted text
+* @param size Size of @p batch
+*/
+internal_function
+void logWriteBatch (const Char *batch, Size size)
+{
+    if (size == 0) {
+        return;
+    }
+
+    if (global_log.console) {
+        fwrite(batch, 1, size, stderr);
+        fflush(stderr);
+    }
+
+    if (global_log.file != NULL) {
+        fwrite(batch, 1, size, global_log.file);
+        fflush(global_log.file);
+        global_log.file_size += size;
+        if (global_log.file_size >= LOG_FILE_MAX_SIZE) {
+            logRotateFile();
+        }
+    }
+}
+
+/**
+* @brief Function to take the next ready record out of the ring
+*
+* This must only be called from one thread at a time.
+*
+* @return The record (to be given back with @ref logReleaseRecord), NULL if the ring is empty
+*/
+internal_function
+Log_Record* logAcquireRecord (void)
+{
+    U32 position = global_log.dequeue_position;
+    Log_Record *record = &global_log.ring[position & (LOG_RING_SIZE - 1)];
+    U32 sequence = (U32)SDL_AtomicGet(&record->sequence);
+
+    if (sequence != (position + 1)) {
+        return NULL;
+    }
+
+    SDL_MemoryBarrierAcquire();
+
+    return record;
+}
+
+/**
+* @brief Function to give a record taken by @ref logAcquireRecord back to the producers
+*
+* @param record Record
+*/
+internal_function
+void logReleaseRecord (Log_Record *record)
+{
+    U32 position = global_log.dequeue_position++;
+    SDL_AtomicSet(&record->sequence, (int)(position + LOG_RING_SIZE));
+}
+
+/**
+* @brief Function to format and write all the records currently in the ring
+*
+* @param batch Buffer of size @ref LOG_BATCH_SIZE to format into
+*
+* @return Number of records written
+*/
+internal_function
+Size logDrain (Char *batch)
+{
+    Size count = 0;
+    Size batch_size = 0;
+    Char line[1024];
+
+    Log_Record *record;
+    while ((record = logAcquireRecord()) != NULL) {
+        Size length = logFormatRecord(record, line, sizeof(line));
+        logReleaseRecord(record);
+        count++;
+
+        if ((batch_size + length) > LOG_BATCH_SIZE) {
+            logWriteBatch(batch, batch_size);
+            batch_size = 0;
+        }
+        memcpy(batch + batch_size, line, length);
+        batch_size += length;
+    }
+
+    Sint dropped = SDL_AtomicSet(&global_log.dropped, 0);
+    if (dropped > 0) {
+        Sint length = snprintf(line, sizeof(line),
+                               "[LOG] %d messages dropped, the log ring was full\n", dropped);
+        if ((batch_size + (Size)length) > LOG_BATCH_SIZE) {
+            logWriteBatch(batch, batch_size);
+            batch_size = 0;
+        }
+        memcpy(batch + batch_size, line, (Size)length);
+        batch_size += (Size)length;
+    }
+
+    logWriteBatch(batch, batch_size);
+
+    return count;
+}
+
+/**
+* @brief Entry point of the writer thread
+*
+* @param data Unused
+*
+* @return Exit status of thread
+*/
+internal_function
+Sint logWriter (void *data)
+{
+    unused_variable(data);
+
+    Char *batch = malloc(LOG_BATCH_SIZE);
+
+    while (SDL_AtomicGet(&global_log.running)) {
+        if (logDrain(batch) == 0) {
+            // NOTE(naman): Producers never signal the writer (that would cost a system call
+            // on the logging thread), so it just sleeps when the ring is empty.
+            SDL_Delay(4);
+        }
+    }
+
+    logDrain(batch);
+    free(batch);
+
+    return 0;
+}
+
+/**
+* @brief Function to start the logging subsystem
+*
+* Until this is called (and after @ref logShutdown), messages are written synchronously.
+*
+* @param console Should messages be written to the console?
+* @param file_path Path of the log file (NULL for no file)
+*
+* @return success/failure
+*/
+internal_function
+B32 logInit (B32 console, const Char *file_path)
+{
+    global_log.console = console;
+    global_log.start_counter = SDL_GetPerformanceCounter();
+
+    if (file_path != NULL) {
+        global_log.file = fopen(file_path, "a");
+        if (global_log.file == NULL) {
+            logConsole(LOG_LEVEL_WARN,
+                       LOG_CHANNEL_LOG,
+                       "Couldn't open log file %s",
+                       file_path);
+        } else {
+            global_log.file_path = malloc(strlen(file_path) + 1);
+            strcpy(global_log.file_path, file_path);
+            fseek(global_log.file, 0, SEEK_END);
+            long file_size = ftell(global_log.file);
+            global_log.file_size = (file_size > 0) ? (Size)file_size : 0;
+        }
     }
 
-    enum Log_Level level;
-    switch (severity) {
-    case GL_DEBUG_SEVERITY_HIGH_ARB:
-        level = LOG_LEVEL_ERROR;
-        break;
-    case GL_DEBUG_SEVERITY_MEDIUM_ARB:
-        level= LOG_LEVEL_WARN;
-        break;
-    case GL_DEBUG_SEVERITY_LOW_ARB:
-        level = LOG_LEVEL_VERBOSE;
-        break;
-    default:
-        level = LOG_LEVEL_VERBOSE;
-        break;
-    }
-
-    char *type_str = NULL;
-    switch (type) {
-    case GL_DEBUG_TYPE_ERROR_ARB:
-        type_str = "(Error) ";
-        break;
-    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR_ARB:
-        type_str = "(Deprecated Warning) ";
-        break;
-    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR_ARB:
-        type_str = "(Undefined Behaviour) ";
-        break;
-    case GL_DEBUG_TYPE_PERFORMANCE_ARB:
-        type_str = "(Performance Warning) ";
-        break;
-    case GL_DEBUG_TYPE_PORTABILITY_ARB:
-        type_str = "(Non-Portable) ";
-        break;
-    case GL_DEBUG_TYPE_OTHER_ARB:
-        type_str = "(Others) ";
-        break;
-    default:
-        type_str = "(Others) ";
-        break;
-    }
-
-    char *source_str = NULL;
-    switch (source) {
-    case GL_DEBUG_SOURCE_API_ARB:
-        source_str = "{GL API}: ";
-        break;
-    case GL_DEBUG_SOURCE_SHADER_COMPILER_ARB:
-        source_str = "{Shader Compiler}: ";
-        break;
-    case GL_DEBUG_SOURCE_WINDOW_SYSTEM_ARB:
-        source_str = "{Window System}: ";
-        break;
-    case GL_DEBUG_SOURCE_THIRD_PARTY_ARB:
-        source_str = "{Third Party}: ";
-        break;
-    case GL_DEBUG_SOURCE_APPLICATION_ARB:
-        source_str = "{Application}: ";
-        break;
-    case GL_DEBUG_SOURCE_OTHER_ARB:
-        source_str = "{Others}: ";
-        break;
-    default:
-        source_str = "{Others}: ";
-        break;
-    }
-
-    Size text_length = strlen(type_str) + strlen(source_str) + (Size)length + 1;
-    Char* real_text = malloc(sizeof(*real_text) * text_length);
-    strcpy(real_text, source_str);
-    strcat(real_text, type_str);
-    strcat(real_text, message);
-
-    logConsole(level,
-               LOG_CHANNEL_OPENGL,
-               real_text);
-    free(real_text);
-
-    if ((type == GL_DEBUG_TYPE_ERROR_ARB) ||
-        (type == GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR_ARB) ||
-        (type == GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR_ARB)) {
-        debugPrintCallStackTrace();
-        SDL_TriggerBreakpoint();
-    }
-
-    return;
+    global_log.ring = calloc(LOG_RING_SIZE, sizeof(*global_log.ring));
+    for (U32 i = 0; i < LOG_RING_SIZE; ++i) {
+        SDL_AtomicSet(&global_log.ring[i].sequence, (int)i);
+    }
+    SDL_AtomicSet(&global_log.enqueue_position, 0);
+    global_log.dequeue_position = 0;
+
+    SDL_AtomicSet(&global_log.running, 1);
+    global_log.writer = SDL_CreateThread(logWriter, "Log Writer", NULL);
+    if (global_log.writer == NULL) {
+        SDL_AtomicSet(&global_log.running, 0);
+        free(global_log.ring);
+        global_log.ring = NULL;
+        logConsole(LOG_LEVEL_WARN,
+                   LOG_CHANNEL_LOG,
+                   "Couldn't create log writer thread, logging synchronously: %s",
+                   SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+/**
+* @brief Function to stop the logging subsystem
+*
+* This writes out all the pending messages before returning.
+*/
+internal_function
+void logShutdown (void)
+{
+    if (global_log.writer == NULL) {
+        return;
+    }
+
+    SDL_AtomicSet(&global_log.running, 0);
+    SDL_WaitThread(global_log.writer, NULL);
+    global_log.writer = NULL;
+
+    // NOTE(naman): The ring is leaked on purpose, since other threads might still be
+    // logging; they see that the writer is gone and log synchronously instead.
+
+    if (global_log.file != NULL) {
+        fclose(global_log.file);
+        global_log.file = NULL;
+    }
 }
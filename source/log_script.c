@@ -22,9 +22,15 @@ int scriptLog (lua_State *l)
 {
     enum Log_Level level = luaL_checknumber(l, 1);
     enum Log_Channel channel = luaL_checknumber(l, 2);
+
+    // NOTE(naman): Filtered out messages are dropped before touching the string
+    if (logIsEnabled(level, channel) == false) {
+        return 0;
+    }
+
     const char *text = luaL_checkstring(l, 3);
 
-    logConsole(level, channel, text);
+    logConsole(level, channel, "%s", text);
 
     return 0;
 }
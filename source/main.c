@@ -45,6 +45,25 @@
 #include "stb/stb_truetype.h"
 #pragma clang diagnostic pop
 
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wreserved-id-macro"
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wconversion"
+#pragma clang diagnostic ignored "-Wdouble-promotion"
+#pragma clang diagnostic ignored "-Wbad-function-cast"
+#pragma clang diagnostic ignored "-Wfloat-equal"
+#pragma clang diagnostic ignored "-Wcomma"
+#pragma clang diagnostic ignored "-Wpadded"
+#pragma clang diagnostic ignored "-Wcast-qual"
+#pragma clang diagnostic ignored "-Wcast-align"
+#pragma clang diagnostic ignored "-Wshadow"
+#pragma clang diagnostic ignored "-Wunused-macros"
+#pragma clang diagnostic ignored "-Wmissing-prototypes"
+#pragma clang diagnostic ignored "-Wextra-semi-stmt"
+#define STB_VORBIS_NO_PUSHDATA_API
+#include "stb/stb_vorbis.c"
+#pragma clang diagnostic pop
+
 #include "external/lua/lua.h"
 #include "external/lua/lauxlib.h"
 #include "external/lua/lualib.h"
@@ -52,6 +71,8 @@
 global_variable char *global_program_name;
 global_variable B32 global_game_is_running;
 
+#define TIME_FRAME_HISTORY 16
+
 typedef struct System_Window System_Window;
 typedef struct System_Audio System_Audio;
 typedef struct System_Time System_Time;
@@ -97,10 +118,8 @@ typedef struct System {
     struct System_Audio {
         SDL_AudioDeviceID audio_device; /**< Handle to audio device */
         SDL_AudioSpec audio_spec; /**< Specifications of the audio device */
-        // TODO(naman): How do we generalize it to all formats (instead of just S16)?
-        S16 *audio_buffer; /**< Memory buffer to store sound sample data */
+        // NOTE(naman): The mixer works in S16, samples and streams are converted to it on load
         U32 bytes_per_sample; /**< Size of each sample in bytes */
-        U32 target_queue_bytes; /**< Latency of audio stream in bytes */
         U32 volume; /**< Sound's loudness level */
     } audio;
 /**
@@ -110,6 +129,15 @@ typedef struct System {
  */
     struct System_Time {
         U64 last_counter; /**< Last computed value of time */
+        F64 frame_period; /**< Microseconds between frames (0 if frames aren't paced) */
+        U64 frame_deadline; /**< Counter value by which the current frame should be done */
+        U64 frame_start; /**< Counter value at which the work on the current frame started */
+        F64 frame_work[TIME_FRAME_HISTORY]; /**< Microseconds of work done in recent frames */
+        U32 frame_work_index; /**< Where the next frame's work goes in @ref frame_work */
+        F64 tick_period; /**< Microseconds simulated by each update */
+        F64 tick_accumulator; /**< Microseconds of real time not yet simulated */
+        U64 tick_count; /**< Number of updates run so far */
+        U32 render_skips; /**< Number of consecutive frames that were not rendered */
     } time;
 /**
  * @brief Structure that contains the state of the control subsystem
@@ -131,18 +159,38 @@ typedef struct System {
 #pragma clang diagnostic pop
 
 
-#include "debug.c"
 #include "log.c"
+#include "debug.c"
+#include "profile.c"
+#include "memory.c"
 #include "time.c"
+#include "file.c"
+#include "cache.c"
 #include "opengl.c"
 #include "render.c"
-#include "file.c"
 #include "assets.c"
+#include "loader.c"
+#include "audio.c"
+#include "vfs.c"
+#include "glob.c"
+#include "shell.c"
+#include "scrollback.c"
+#include "job.c"
+#include "session.c"
 #include "event.c"
 
 #include "log_script.c"
 #include "assets_script.c"
 #include "render_script.c"
+#include "audio_script.c"
+#include "vfs_script.c"
+#include "shell_script.c"
+#include "scrollback_script.c"
+#include "job_script.c"
+#include "memory_script.c"
+#include "session_script.c"
+#include "bench_script.c"
+#include "host_script.c"
 
 /**
 * @brief Entry point of the program
@@ -157,8 +205,126 @@ typedef struct System {
 */
 Sint main (Sint argc, Char *argv[])
 {
-    unused_variable(argc);
     global_program_name = argv[0];
+    U64 startup_counter = SDL_GetPerformanceCounter();
+
+    logSetLevel(LOG_LEVEL_DEBUG, LOG_CHANNEL_COUNT);
+
+    Sint loader_threads = -1;
+    const Char *log_file = NULL;
+    B32 log_console = true;
+    B32 vsync = true;
+    U32 fps_cap = 0;
+    U32 tick_rate = 60;
+    F64 audio_bench = 0;
+    U32 fs_bench = 0;
+    U32 fs_bench_seed = 1;
+    const Char *host = NULL;
+    Sint host_threads = -1;
+    const Char *host_report = NULL;
+#if defined(BUILD_SLOW)
+    enum OpenGL_Debug_Mode gl_debug = OPENGL_DEBUG_SYNC;
+#else
+    enum OpenGL_Debug_Mode gl_debug = OPENGL_DEBUG_OFF;
+#endif
+
+    { // Parse command line arguments
+        for (Sint i = 1; i < argc; ++i) {
+            if (strcmp(argv[i], "--cache=on") == 0) {
+                global_cache.mode = CACHE_MODE_ON;
+            } else if (strcmp(argv[i], "--cache=off") == 0) {
+                global_cache.mode = CACHE_MODE_OFF;
+            } else if (strcmp(argv[i], "--cache=compare") == 0) {
+                global_cache.mode = CACHE_MODE_COMPARE;
+            } else if (strcmp(argv[i], "--session=on") == 0) {
+                global_session.enabled = true;
+            } else if (strcmp(argv[i], "--session=off") == 0) {
+                global_session.enabled = false;
+            } else if (strncmp(argv[i], "--loader-threads=", strlen("--loader-threads=")) == 0) {
+                loader_threads = atoi(argv[i] + strlen("--loader-threads="));
+                if (loader_threads < 0) loader_threads = 0;
+            } else if (strncmp(argv[i], "--log-level=", strlen("--log-level=")) == 0) {
+                const Char *level = argv[i] + strlen("--log-level=");
+                const Char *level_names[] = {"verbose", "debug", "info", "warn", "error", "critical"};
+                B32 found = false;
+                for (Sint j = LOG_LEVEL_VERBOSE; j < LOG_LEVEL_COUNT; ++j) {
+                    if (strcmp(level, level_names[j]) == 0) {
+                        logSetLevel((enum Log_Level)j, LOG_CHANNEL_COUNT);
+                        found = true;
+                    }
+                }
+                if (found == false) {
+                    logConsole(LOG_LEVEL_WARN,
+                               LOG_CHANNEL_ARG,
+                               "Unknown log level: %s", level);
+                }
+            } else if (strncmp(argv[i], "--log-file=", strlen("--log-file=")) == 0) {
+                log_file = argv[i] + strlen("--log-file=");
+            } else if (strcmp(argv[i], "--log-console=off") == 0) {
+                log_console = false;
+            } else if (strcmp(argv[i], "--vsync=on") == 0) {
+                vsync = true;
+            } else if (strcmp(argv[i], "--vsync=off") == 0) {
+                vsync = false;
+            } else if (strncmp(argv[i], "--fps-cap=", strlen("--fps-cap=")) == 0) {
+                Sint cap = atoi(argv[i] + strlen("--fps-cap="));
+                fps_cap = (cap > 0) ? (U32)cap : 0;
+            } else if (strncmp(argv[i], "--tick-rate=", strlen("--tick-rate=")) == 0) {
+                Sint rate = atoi(argv[i] + strlen("--tick-rate="));
+                if (rate > 0) {
+                    tick_rate = (U32)rate;
+                } else {
+                    logConsole(LOG_LEVEL_WARN,
+                               LOG_CHANNEL_ARG,
+                               "Invalid tick rate: %s", argv[i]);
+                }
+            } else if (strncmp(argv[i], "--audio-bench=", strlen("--audio-bench=")) == 0) {
+                audio_bench = atof(argv[i] + strlen("--audio-bench="));
+            } else if (strncmp(argv[i], "--fs-bench=", strlen("--fs-bench=")) == 0) {
+                fs_bench = (U32)strtoul(argv[i] + strlen("--fs-bench="), NULL, 10);
+            } else if (strncmp(argv[i], "--fs-bench-seed=", strlen("--fs-bench-seed=")) == 0) {
+                fs_bench_seed = (U32)strtoul(argv[i] + strlen("--fs-bench-seed="), NULL, 10);
+            } else if (strncmp(argv[i], "--host=", strlen("--host=")) == 0) {
+                host = argv[i] + strlen("--host=");
+            } else if (strncmp(argv[i], "--host-threads=", strlen("--host-threads=")) == 0) {
+                host_threads = atoi(argv[i] + strlen("--host-threads="));
+                if (host_threads < 1) host_threads = 1;
+            } else if (strncmp(argv[i], "--host-report=", strlen("--host-report=")) == 0) {
+                host_report = argv[i] + strlen("--host-report=");
+            } else if (strcmp(argv[i], "--gl-debug=off") == 0) {
+                gl_debug = OPENGL_DEBUG_OFF;
+            } else if (strcmp(argv[i], "--gl-debug=async") == 0) {
+                gl_debug = OPENGL_DEBUG_ASYNC;
+            } else if (strcmp(argv[i], "--gl-debug=sync") == 0) {
+                gl_debug = OPENGL_DEBUG_SYNC;
+            } else {
+                logConsole(LOG_LEVEL_WARN,
+                           LOG_CHANNEL_ARG,
+                           "Ignoring unknown argument: %s", argv[i]);
+            }
+        }
+    }
+
+    logInit(log_console, log_file);
+
+    if (audio_bench > 0) { // Measure the mixer and exit, without opening any device
+        audioBenchmark(audio_bench);
+        profileLogSummary();
+        logShutdown();
+        return 0;
+    }
+
+    if (fs_bench > 0) { // Measure the filesystem and the commands on synthetic trees, and exit
+        B32 ran = scriptBenchFilesystem(fs_bench, fs_bench_seed);
+        logShutdown();
+        return ran ? 0 : -1;
+    }
+
+    if (host != NULL) { // Run the sessions in the directory without a window, and exit
+        B32 ran = scriptHostRun(host, host_threads, host_report);
+        logShutdown();
+        return ran ? 0 : -1;
+    }
 
     { // Initialize SDL
         fprintf(stdout, "Initialising SDL2...\n");
@@ -173,10 +339,6 @@ Sint main (Sint argc, Char *argv[])
         }
 
 
-        for (U32 i = LOG_CHANNEL_UNKNOWN; i < LOG_CHANNEL_COUNT; ++i) {
-            SDL_LogSetPriority((int)i, SDL_LOG_PRIORITY_DEBUG);
-        }
-
         logConsole(LOG_LEVEL_INFO,
                    LOG_CHANNEL_INIT,
                    "SDL Initialised");
@@ -230,6 +392,10 @@ Sint main (Sint argc, Char *argv[])
         }
     }
 
+    cacheInit();
+    sessionInit();
+    loaderInit(loader_threads);
+
     System system = {0};
 
     { // Fill system state
@@ -239,7 +405,9 @@ Sint main (Sint argc, Char *argv[])
             SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
             SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
 
-            SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+            if (gl_debug != OPENGL_DEBUG_OFF) {
+                SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+            }
 
             SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
             SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
@@ -306,6 +474,8 @@ Sint main (Sint argc, Char *argv[])
                        LOG_CHANNEL_INIT,
                        "Glad loaded through SDL 2");
 
+            openglInit();
+
             logConsole(LOG_LEVEL_INFO,
                        LOG_CHANNEL_INIT,
                        "OpenGL Vendor:   %s\n", glGetString(GL_VENDOR));
@@ -319,24 +489,37 @@ Sint main (Sint argc, Char *argv[])
                        LOG_CHANNEL_INIT,
                        "GLSL Version:  %s\n", glGetString(GL_SHADING_LANGUAGE_VERSION));
 
-            if(GLAD_GL_ARB_debug_output) {
-                glDebugMessageCallbackARB(&logGLDebugCallback, NULL);
-            }
-            glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+            openglDebugInit(gl_debug);
 
 
-            logConsole(LOG_LEVEL_INFO,
-                       LOG_CHANNEL_INIT,
-                       "Enabling V-Sync...");
-            if (SDL_GL_SetSwapInterval(-1) == -1) { // Late Swap Tearing
-                logConsole(LOG_LEVEL_WARN,
+            if (vsync) {
+                logConsole(LOG_LEVEL_INFO,
                            LOG_CHANNEL_INIT,
-                           "Late Swap Tearing not enabled: %s", SDL_GetError());
-                if (SDL_GL_SetSwapInterval(1) == -1) { // Normal V-Sync
+                           "Enabling V-Sync...");
+                if (SDL_GL_SetSwapInterval(-1) == -1) { // Late Swap Tearing
                     logConsole(LOG_LEVEL_WARN,
                                LOG_CHANNEL_INIT,
-                               "V-Sync not enabled: %s", SDL_GetError());
+                               "Late Swap Tearing not enabled: %s", SDL_GetError());
+                    if (SDL_GL_SetSwapInterval(1) == -1) { // Normal V-Sync
+                        logConsole(LOG_LEVEL_WARN,
+                                   LOG_CHANNEL_INIT,
+                                   "V-Sync not enabled: %s", SDL_GetError());
+                        vsync = false;
+                    }
+                }
+            } else {
+                SDL_GL_SetSwapInterval(0);
+            }
+
+            { // Set up frame pacing
+                SDL_DisplayMode display_mode = {0};
+                S32 refresh_rate = 0;
+                if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(system.window.window),
+                                              &display_mode) == 0) {
+                    refresh_rate = display_mode.refresh_rate;
                 }
+                timeFrameInit(&system.time, refresh_rate, vsync, fps_cap);
+                timeTickInit(&system.time, tick_rate);
             }
 
             glViewport(0, 0,
@@ -346,6 +529,12 @@ Sint main (Sint argc, Char *argv[])
             glFrontFace(GL_CCW);
             glCullFace(GL_BACK);
 
+            { // Present a blank frame while the rest of the engine starts up
+                glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+                SDL_GL_SwapWindow(system.window.window);
+            }
+
             glEnable(GL_DEPTH_TEST);
             glEnable(GL_CULL_FACE);
             glEnable(GL_BLEND);
@@ -465,10 +654,14 @@ Sint main (Sint argc, Char *argv[])
 
             SDL_AudioSpec audiospec_desired = {0};
 
+            audioInit();
+
             audiospec_desired.freq = 48000;
-            audiospec_desired.format = AUDIO_S16LSB;
+            audiospec_desired.format = AUDIO_S16SYS;
             audiospec_desired.channels = 2;
-            audiospec_desired.samples = 1600;
+            audiospec_desired.samples = AUDIO_CALLBACK_FRAMES;
+            audiospec_desired.callback = audioCallback;
+            audiospec_desired.userdata = global_audio.mixer;
 
             system.audio.audio_device = SDL_OpenAudioDevice(NULL,
                                                             0,
@@ -497,11 +690,6 @@ Sint main (Sint argc, Char *argv[])
 
             system.audio.bytes_per_sample = (SDL_AUDIO_BITSIZE(system.audio.audio_spec.format) *
                                              (system.audio.audio_spec.channels)/8);
-            system.audio.target_queue_bytes = (4 *
-                                               system.audio.audio_spec.samples *
-                                               system.audio.bytes_per_sample);
-            system.audio.audio_buffer = calloc(1, system.audio.target_queue_bytes);
-
 
             logConsole(LOG_LEVEL_INFO,
                        LOG_CHANNEL_INIT,
@@ -520,11 +708,12 @@ Sint main (Sint argc, Char *argv[])
                        "Audio buffer size (samples): %u\n",
                        system.audio.bytes_per_sample);
 
-            SDL_PauseAudioDevice(system.audio.audio_device, 0);
+            audioStart(system.audio.audio_device, &(system.audio.audio_spec));
         }
     }
 
-    lua_State *game_code = luaL_newstate();
+    Memory_Lua game_memory; // Accounting of the memory of game_code
+    lua_State *game_code = memoryLuaNewState(&game_memory);
     luaL_openlibs(game_code);
 
     { // Fill game_code with all code and data
@@ -592,7 +781,8 @@ Sint main (Sint argc, Char *argv[])
                 // SCRIPT_FUNCTION_SYSTEM_UPVALUE(scriptAssetLoadShader);
                 // SCRIPT_FUNCTION_NO_UPVALUE(scriptAssetUnloadShader);
 
-                SCRIPT_FUNCTION_GAME_UPVALUE(scriptAssetLoadScript);
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptAssetLoadScript);
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptAssetPrefetchScript);
 
                 // SCRIPT_FUNCTION_SYSTEM_UPVALUE(scriptAssetLoadTexture);
                 // SCRIPT_FUNCTION_NO_UPVALUE(scriptAssetUnloadTexture);
@@ -611,11 +801,41 @@ Sint main (Sint argc, Char *argv[])
             }
 
             { // Audio System
-                // SCRIPT_FUNCTION_SYSTEM_UPVALUE(scriptAudioSinusoidal);
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptAudioSinusoidal);
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptAudioLoadSample);
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptAudioPlay);
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptAudioStream);
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptAudioStop);
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptAudioSetGain);
             }
 
             { // File System
                 // SCRIPT_FUNCTION_SYSTEM_UPVALUE(scriptFileWriteToBase);
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptVFSNew);
+            }
+
+            { // Shell
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptShellTokenize);
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptShellGetOpt);
+            }
+
+            { // Scrollback
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptScrollbackNew);
+            }
+
+            { // Jobs
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptJobBudget);
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptJobExhausted);
+            }
+
+            { // Memory
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptMemoryAttribute);
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptMemoryUsage);
+            }
+
+            { // Sessions
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptSessionSave);
+                SCRIPT_FUNCTION_NO_UPVALUE(scriptSessionLoad);
             }
 
             { // Log System
@@ -656,13 +876,50 @@ Sint main (Sint argc, Char *argv[])
             lua_pop(game_code, lua_gettop(game_code)); // {EMPTY}
         }
 
+        { // Make `require` compile modules through the bytecode cache
+            lua_getglobal(game_code, "package"); // package
+            lua_getfield(game_code, 1, "loaders"); // package loaders
+            lua_pushcfunction(game_code, scriptAssetSearchScript); // package loaders searcher
+            lua_rawseti(game_code, 2, 2); // package loaders
+            lua_pop(game_code, lua_gettop(game_code)); // {EMPTY}
+        }
+
+        global_game_is_running = true;
+
         { // Load assets
             if (assetLoadScript(game_code, "data/assets.lua") == false) {
                 goto error;
             }
         }
+
+        { // Present loading frames until the loader has finished
+            while (global_game_is_running && (loaderIsIdle() == false)) {
+                SDL_Event event;
+                while (SDL_PollEvent(&event) != 0) {
+                    if ((event.type == SDL_QUIT) ||
+                        ((event.type == SDL_KEYDOWN) && (event.key.keysym.sym == SDLK_ESCAPE))) {
+                        global_game_is_running = false;
+                    }
+                }
+
+                loaderRetire(game_code);
+
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                SDL_GL_SwapWindow(system.window.window);
+            }
+
+            if (global_game_is_running == false) {
+                logConsole(LOG_LEVEL_CRITICAL,
+                           LOG_CHANNEL_ASSETS,
+                           "Loading assets was interrupted");
+                goto error;
+            }
+        }
     }
 
+    memoryAttribute(game_code, MEMORY_SUBSYSTEM_LOOP);
     lua_getglobal(game_code, "Loop");
     lua_getfield(game_code, 1, "Init");
     if (lua_pcall(game_code, 0, 0, 0)) {
@@ -673,6 +930,14 @@ Sint main (Sint argc, Char *argv[])
         goto error;
     }
     lua_pop(game_code, lua_gettop(game_code));
+    memoryAttribute(game_code, MEMORY_SUBSYSTEM_ENGINE);
+
+    loaderReleasePrefetched();
+    cacheLogStatistics();
+    logConsole(LOG_LEVEL_INFO,
+               LOG_CHANNEL_INIT,
+               "Startup took %.3f ms",
+               timeMicrosecondsElapsed(&startup_counter) / 1000.0);
 
     { /* This will make sure that
        * 1) no new global variables can be declared,
@@ -726,19 +991,33 @@ Sint main (Sint argc, Char *argv[])
 
     SDL_StartTextInput();
 
-    global_game_is_running = true;
     logConsole(LOG_LEVEL_INFO,
                LOG_CHANNEL_LOOP,
                "Starting Main Loop");
 
+    lua_newtable(game_code); // <events>
+    Sint events_ref = luaL_ref(game_code, LUA_REGISTRYINDEX);
+
+    U64 lua_allocations = memoryTotal(&game_memory).allocations; // As of the last frame
+
     system.time.last_counter = SDL_GetPerformanceCounter();
     while (global_game_is_running) {
+        // NOTE(naman): Sleep first, so that the input sampled below is as fresh as possible
+        timeFrameBegin(&system.time);
+
         F64 last_frame_time = timeMicrosecondsElapsed(&(system.time.last_counter));
+        U32 ticks = timeTicksDue(&system.time, last_frame_time);
 
         SDL_PumpEvents();
 
+        memoryAttribute(game_code, MEMORY_SUBSYSTEM_ENGINE);
+        loaderRetire(game_code);
+
         { // Event Processing
-            lua_newtable(game_code); // <events>
+            memoryAttribute(game_code, MEMORY_SUBSYSTEM_EVENTS);
+
+            // NOTE(naman): Events are kept until an update runs, even if none runs this frame
+            lua_rawgeti(game_code, LUA_REGISTRYINDEX, events_ref); // <events>
 
             { // Keyboard Events
                 // IMPORTANT: Do not free this pointer
@@ -818,6 +1097,46 @@ Sint main (Sint argc, Char *argv[])
             }
         }
 
+        { // Call Loop.Update once per tick
+            // NOTE(naman): Loop.Render (below) is attributed to the loop as well
+            memoryAttribute(game_code, MEMORY_SUBSYSTEM_LOOP);
+
+            // <events>
+            for (U32 tick = 0; (tick < ticks) && global_game_is_running; ++tick) {
+                lua_getglobal(game_code, "Loop"); // <events> Loop
+                lua_getfield(game_code, -1, "Update"); // <events> Loop Update()
+                lua_pushnumber(game_code, system.time.tick_period); // <events> Loop Update() dt
+                lua_pushvalue(game_code, 1); // <events> Loop Update() dt <events>
+                if (lua_pcall(game_code, 2, 1, 0)) {
+                    logConsole(LOG_LEVEL_CRITICAL,
+                               LOG_CHANNEL_LOOP,
+                               "Loop.Update failed: %s",
+                               lua_tostring(game_code, -1));
+                    goto error;
+                }
+                // <events> Loop result
+                B32 result = (B32)lua_toboolean(game_code, -1);
+                if (result == false) {
+                    global_game_is_running = false;
+                }
+                lua_pop(game_code, 2); // <events>
+
+                if (tick == 0) { // Events go only to the first update
+                    lua_pop(game_code, 1); //
+                    lua_newtable(game_code); // <events>
+                    lua_pushvalue(game_code, -1); // <events> <events>
+                    lua_rawseti(game_code, LUA_REGISTRYINDEX, events_ref); // <events>
+                }
+            }
+            lua_pop(game_code, lua_gettop(game_code));
+        }
+
+        memoryProfile(&game_memory, &lua_allocations);
+
+        if ((global_game_is_running == false) || (timeShouldRender(&system.time) == false)) {
+            continue;
+        }
+
         glClear(GL_COLOR_BUFFER_BIT |
                 GL_DEPTH_BUFFER_BIT);
 
@@ -825,24 +1144,17 @@ Sint main (Sint argc, Char *argv[])
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        { // Call Loop function
-            // <events>
-            lua_getglobal(game_code, "Loop"); // <Events> Loop
-            lua_getfield(game_code, 2, "Loop"); // <Events> Loop Loop()
-            lua_pushnumber(game_code, last_frame_time); // <Events> Loop Loop() last_frame_time
-            lua_pushvalue(game_code, 1); // <Events> Loop Loop() last_frame_time <Events>
-            if (lua_pcall(game_code, 2, LUA_MULTRET, 0)) {
+        { // Call Loop.Render
+            lua_getglobal(game_code, "Loop"); // Loop
+            lua_getfield(game_code, -1, "Render"); // Loop Render()
+            lua_pushnumber(game_code, timeTickAlpha(&system.time)); // Loop Render() alpha
+            if (lua_pcall(game_code, 1, 0, 0)) {
                 logConsole(LOG_LEVEL_CRITICAL,
                            LOG_CHANNEL_LOOP,
-                           "UpdateAndRender failed: %s",
+                           "Loop.Render failed: %s",
                            lua_tostring(game_code, -1));
                 goto error;
             }
-            B32 result = (B32)lua_toboolean(game_code, -1);
-
-            if (result == false) {
-                global_game_is_running = false;
-            }
             lua_pop(game_code, lua_gettop(game_code));
         }
 
@@ -850,11 +1162,13 @@ Sint main (Sint argc, Char *argv[])
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glUseProgram(system.window.xbloom_shader);
+        openglProgramUse(system.window.xbloom_shader);
         glBindVertexArray(system.window.quad_vao);
 //        glDisable(GL_DEPTH_TEST);
         glBindTexture(GL_TEXTURE_2D, system.window.luabuffer_texture);
-        U32 scan_pos = (U32)(((UINT64_MAX - system.time.last_counter) / 2000000) % (U32)system.window.height);
+        // NOTE(naman): The scan line moves with the simulation, by one row every 2 ms
+        U64 scan_rows = (U64)(timeSimulated(&system.time) / 2000.0);
+        U32 scan_pos = (U32)((UINT64_MAX - scan_rows) % (U32)system.window.height);
         glUniform1ui(glGetUniformLocation(system.window.xbloom_shader, "scan_pos"), scan_pos);
         glUniform2i(glGetUniformLocation(system.window.xbloom_shader, "resolution"),
                     system.window.width, system.window.height);
@@ -865,7 +1179,7 @@ Sint main (Sint argc, Char *argv[])
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        glUseProgram(system.window.crt_shader);
+        openglProgramUse(system.window.crt_shader);
         glBindVertexArray(system.window.quad_vao);
         //glDisable(GL_DEPTH_TEST);
         glUniform1ui(glGetUniformLocation(system.window.crt_shader, "scan_pos"), scan_pos);
@@ -881,7 +1195,9 @@ Sint main (Sint argc, Char *argv[])
         glDrawArrays(GL_TRIANGLES, 0, 6);
         glUseProgram(0);
 
+        timeFrameEnd(&system.time);
         SDL_GL_SwapWindow(system.window.window);
+        timeFramePresented(&system.time);
 
 #if 0
         glReadPixels(0, 0, system.window.width, system.window.height, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
@@ -889,8 +1205,29 @@ Sint main (Sint argc, Char *argv[])
 #endif
     }
 
+    { // Call Loop.Quit (if there is one), so that the game can save what it needs to
+        lua_getglobal(game_code, "Loop"); // Loop
+        lua_getfield(game_code, -1, "Quit"); // Loop Quit()
+        if (lua_isfunction(game_code, -1) && lua_pcall(game_code, 0, 0, 0)) {
+            logConsole(LOG_LEVEL_ERROR,
+                       LOG_CHANNEL_LOOP,
+                       "Loop.Quit failed: %s",
+                       lua_tostring(game_code, -1));
+        }
+        lua_pop(game_code, lua_gettop(game_code));
+    }
+
+    sessionShutdown();
+    loaderShutdown();
+    audioShutdown(system.audio.audio_device);
+    openglDebugLogSummary();
+    memoryLogSummary(&game_memory);
+    profileLogSummary();
+    logShutdown();
+
     return 0;
 
  error:
+    logShutdown();
     return -1;
 }
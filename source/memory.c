@@ -0,0 +1,507 @@
+/**
+ * These functions implement the allocator of the game's Lua states. Lua makes a great many
+ * small allocations (strings, tables, closures, the tables of events and the vectors and
+ * colours made every frame), almost all of them of a few dozen bytes; so instead of going to
+ * malloc for every one of them, blocks are handed out from free lists of a fixed set of size
+ * classes, which are kept per thread (so that no lock is ever taken) and carved out of large
+ * arenas.
+ *
+ * An arena is split into pages, and a page only ever holds blocks of one size class made for
+ * one subsystem (which is written at the start of the page). This way blocks need no header:
+ * the page of a block is found by rounding its address down, and Lua passes the size of a
+ * block along when it frees it, which gives its size class. Blocks larger than the largest
+ * class go to malloc, with a small header.
+ *
+ * Every Lua state using the allocator has a @ref Memory_Lua, which keeps the number of live
+ * bytes and blocks (and of allocations made) of each subsystem, and the subsystem running at
+ * the moment, to which new blocks are attributed. A state is only ever used by one thread at a
+ * time, so these need no lock either; blocks freed by another thread than the one that made
+ * them simply join the free lists of that thread.
+ *
+ * @file memory.c
+ * @author Team Octal
+ * @brief Functions implementing the pooled allocator of Lua states
+ */
+
+#define MEMORY_GRANULE 16 /* Size classes are multiples of this (which is also the alignment) */
+#define MEMORY_CLASS_COUNT 32 /* Number of size classes (so the largest is 512 bytes) */
+#define MEMORY_CLASS_MAX (MEMORY_GRANULE * MEMORY_CLASS_COUNT)
+#define MEMORY_PAGE_SIZE (16 * 1024) /* Size (and alignment) of a page */
+#define MEMORY_ARENA_SIZE (1024 * 1024) /* Size of an arena (which is a whole number of pages) */
+
+/**
+* @brief Enumeration of the subsystems to which memory is attributed
+*/
+enum Memory_Subsystem {
+    MEMORY_SUBSYSTEM_ENGINE, /**< Anything not run by the ones below (startup, assets) */
+    MEMORY_SUBSYSTEM_EVENTS, /**< Tables of the events sent to Loop.Update */
+    MEMORY_SUBSYSTEM_LOOP, /**< Loop.Init, Loop.Update and Loop.Render */
+    MEMORY_SUBSYSTEM_COMMANDS, /**< Jobs running commands */
+    MEMORY_SUBSYSTEM_TUTORIAL, /**< The tutorial */
+    MEMORY_SUBSYSTEM_COUNT,
+};
+
+/**
+* @brief Memory used by a subsystem
+*/
+typedef struct Memory_Usage {
+    U64 bytes; /**< Bytes in live blocks */
+    U64 blocks; /**< Number of live blocks */
+    U64 allocations; /**< Number of blocks ever allocated */
+} Memory_Usage;
+
+/**
+* @brief Accounting of a Lua state using the allocator (passed to @ref memoryLuaAlloc)
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Memory_Lua {
+    Memory_Usage usage[MEMORY_SUBSYSTEM_COUNT]; /**< Memory used by each subsystem */
+    enum Memory_Subsystem subsystem; /**< Subsystem to which new blocks are attributed */
+} Memory_Lua;
+#pragma clang diagnostic pop
+
+/**
+* @brief Header at the start of every page (which takes up one granule)
+*/
+typedef struct Memory_Page {
+    U32 subsystem; /**< Subsystem the blocks in the page were made for */
+    U32 size_class; /**< Size class of the blocks in the page */
+    U64 reserved; /**< Pads the header to a granule */
+} Memory_Page;
+
+/**
+* @brief Header of blocks larger than the largest size class (which takes up one granule)
+*/
+typedef struct Memory_Large {
+    U64 subsystem; /**< Subsystem the block was made for */
+    U64 reserved; /**< Pads the header to a granule */
+} Memory_Large;
+
+/**
+* @brief Free block (the link is kept in the block itself)
+*/
+typedef struct Memory_Block {
+    struct Memory_Block *next; /**< Next free block */
+} Memory_Block;
+
+/**
+* @brief Blocks of one size class for one subsystem, ready to be handed out by a thread
+*/
+typedef struct Memory_Bin {
+    Memory_Block *free; /**< Blocks that were freed */
+    Byte *bump; /**< Part of the newest page that hasn't been handed out yet */
+    Byte *bump_end; /**< End of the newest page */
+} Memory_Bin;
+
+/**
+* @brief Free lists and arena of a thread
+*/
+global_variable _Thread_local struct Memory_Thread {
+    Memory_Bin bins[MEMORY_SUBSYSTEM_COUNT][MEMORY_CLASS_COUNT]; /**< Blocks to hand out */
+    Byte *arena; /**< Part of the newest arena that hasn't been split into pages yet */
+    Byte *arena_end; /**< End of the newest arena */
+} memory_thread;
+
+/**
+* @brief State of the allocator shared by all threads
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+global_variable struct Memory_State {
+    U64 arena_bytes; /**< Bytes taken by arenas (which are never given back) */
+    SDL_SpinLock lock; /**< Protects @ref arena_bytes */
+} global_memory;
+#pragma clang diagnostic pop
+
+/**
+* @brief Function to get the printable name of a subsystem
+*
+* The names are also the ones used by Lua.
+*
+* @param subsystem Subsystem
+*
+* @return Name of subsystem
+*/
+internal_function
+const Char* memorySubsystemName (enum Memory_Subsystem subsystem)
+{
+    switch (subsystem) {
+    case MEMORY_SUBSYSTEM_ENGINE:
+        return "engine";
+    case MEMORY_SUBSYSTEM_EVENTS:
+        return "events";
+    case MEMORY_SUBSYSTEM_LOOP:
+        return "loop";
+    case MEMORY_SUBSYSTEM_COMMANDS:
+        return "commands";
+    case MEMORY_SUBSYSTEM_TUTORIAL:
+        return "tutorial";
+    case MEMORY_SUBSYSTEM_COUNT:
+        return "**INVALID**";
+    }
+
+    return "**INVALID**";
+}
+
+/**
+* @brief Function to get the size class of a block
+*
+* @param size Size of the block (at most @ref MEMORY_CLASS_MAX)
+*
+* @return Size class
+*/
+internal_function
+U32 memorySizeClass (Size size)
+{
+    return (size == 0) ? 0 : (U32)((size - 1) / MEMORY_GRANULE);
+}
+
+/**
+* @brief Function to get the page a block (of a size class) is in
+*
+* @param block Block
+*
+* @return Page
+*/
+internal_function
+Memory_Page* memoryPageOf (void *block)
+{
+    return (Memory_Page *)((uintptr_t)block & ~(uintptr_t)(MEMORY_PAGE_SIZE - 1));
+}
+
+/**
+* @brief Function to take a new page from the thread's arena (making a new arena if need be)
+*
+* @param subsystem Subsystem the blocks in the page are for
+* @param size_class Size class of the blocks in the page
+*
+* @return Page, NULL if out of memory
+*/
+internal_function
+Memory_Page* memoryPageNew (enum Memory_Subsystem subsystem, U32 size_class)
+{
+    struct Memory_Thread *thread = &memory_thread;
+
+    if ((Size)(thread->arena_end - thread->arena) < MEMORY_PAGE_SIZE) {
+        void *arena = NULL;
+        if (posix_memalign(&arena, MEMORY_PAGE_SIZE, MEMORY_ARENA_SIZE) != 0) {
+            return NULL;
+        }
+        thread->arena = arena;
+        thread->arena_end = thread->arena + MEMORY_ARENA_SIZE;
+
+        SDL_AtomicLock(&global_memory.lock);
+        global_memory.arena_bytes += MEMORY_ARENA_SIZE;
+        SDL_AtomicUnlock(&global_memory.lock);
+    }
+
+    Memory_Page *page = memoryPageOf(thread->arena);
+    thread->arena += MEMORY_PAGE_SIZE;
+
+    page->subsystem = (U32)subsystem;
+    page->size_class = size_class;
+    page->reserved = 0;
+
+    return page;
+}
+
+/**
+* @brief Function to allocate a block
+*
+* @param memory Accounting of the Lua state
+* @param size Size of the block (more than 0)
+*
+* @return Block, NULL if out of memory
+*/
+internal_function
+void* memoryAllocate (Memory_Lua *memory, Size size)
+{
+    enum Memory_Subsystem subsystem = memory->subsystem;
+    void *block = NULL;
+
+    if (size <= MEMORY_CLASS_MAX) {
+        U32 size_class = memorySizeClass(size);
+        Memory_Bin *bin = &memory_thread.bins[subsystem][size_class];
+        Size class_size = (size_class + 1) * MEMORY_GRANULE;
+
+        if (bin->free != NULL) {
+            block = bin->free;
+            bin->free = bin->free->next;
+        } else {
+            if ((Size)(bin->bump_end - bin->bump) < class_size) {
+                // NOTE(naman): The tail of the old page (less than a block) is never used.
+                Memory_Page *page = memoryPageNew(subsystem, size_class);
+                if (page == NULL) {
+                    return NULL;
+                }
+                bin->bump = (Byte *)page + MEMORY_GRANULE;
+                bin->bump_end = (Byte *)page + MEMORY_PAGE_SIZE;
+            }
+
+            block = bin->bump;
+            bin->bump += class_size;
+        }
+    } else {
+        Byte *large = malloc(MEMORY_GRANULE + size);
+        if (large == NULL) {
+            return NULL;
+        }
+        Memory_Large header = {.subsystem = (U64)subsystem};
+        memcpy(large, &header, sizeof(header));
+        block = large + MEMORY_GRANULE;
+    }
+
+    Memory_Usage *usage = &memory->usage[subsystem];
+    usage->bytes += size;
+    usage->blocks++;
+    usage->allocations++;
+
+    return block;
+}
+
+/**
+* @brief Function to get the subsystem a block was made for
+*
+* @param block Block
+* @param size Size of the block
+*
+* @return Subsystem
+*/
+internal_function
+enum Memory_Subsystem memoryOwner (void *block, Size size)
+{
+    if (size <= MEMORY_CLASS_MAX) {
+        return (enum Memory_Subsystem)memoryPageOf(block)->subsystem;
+    }
+
+    Memory_Large header;
+    memcpy(&header, (Byte *)block - MEMORY_GRANULE, sizeof(header));
+    return (enum Memory_Subsystem)header.subsystem;
+}
+
+/**
+* @brief Function to free a block
+*
+* A block of a size class joins the free list of the calling thread (whichever thread made it).
+*
+* @param memory Accounting of the Lua state
+* @param block Block
+* @param size Size of the block
+*/
+internal_function
+void memoryFree (Memory_Lua *memory, void *block, Size size)
+{
+    enum Memory_Subsystem subsystem = memoryOwner(block, size);
+
+    Memory_Usage *usage = &memory->usage[subsystem];
+    usage->bytes -= size;
+    usage->blocks--;
+
+    if (size <= MEMORY_CLASS_MAX) {
+        Memory_Bin *bin = &memory_thread.bins[subsystem][memorySizeClass(size)];
+        Memory_Block *free_block = block;
+        free_block->next = bin->free;
+        bin->free = free_block;
+    } else {
+        free((Byte *)block - MEMORY_GRANULE);
+    }
+}
+
+/**
+* @brief Allocator of Lua states (a lua_Alloc)
+*
+* @param ud Accounting of the Lua state (@ref Memory_Lua)
+* @param ptr Block to free or resize (NULL to allocate a new one)
+* @param osize Size of @p ptr
+* @param nsize Size wanted (0 to free @p ptr)
+*
+* @return Block, NULL if freed or out of memory
+*/
+internal_function
+void* memoryLuaAlloc (void *ud, void *ptr, Size osize, Size nsize)
+{
+    Memory_Lua *memory = ud;
+
+    if (nsize == 0) {
+        if (ptr != NULL) {
+            memoryFree(memory, ptr, osize);
+        }
+        return NULL;
+    }
+
+    if (ptr == NULL) {
+        return memoryAllocate(memory, nsize);
+    }
+
+    if ((osize <= MEMORY_CLASS_MAX) && (nsize <= MEMORY_CLASS_MAX) &&
+        (memorySizeClass(osize) == memorySizeClass(nsize))) { // The block still fits
+        Memory_Usage *usage = &memory->usage[memoryOwner(ptr, osize)];
+        usage->bytes = usage->bytes - osize + nsize;
+        return ptr;
+    }
+
+    if ((osize > MEMORY_CLASS_MAX) && (nsize > MEMORY_CLASS_MAX)) {
+        enum Memory_Subsystem subsystem = memoryOwner(ptr, osize);
+        Byte *large = realloc((Byte *)ptr - MEMORY_GRANULE, MEMORY_GRANULE + nsize);
+        if (large == NULL) {
+            return NULL;
+        }
+        Memory_Usage *usage = &memory->usage[subsystem];
+        usage->bytes = usage->bytes - osize + nsize;
+        return large + MEMORY_GRANULE;
+    }
+
+    void *block = memoryAllocate(memory, nsize);
+    if (block == NULL) {
+        return NULL;
+    }
+    memcpy(block, ptr, (osize < nsize) ? osize : nsize);
+    memoryFree(memory, ptr, osize);
+
+    return block;
+}
+
+/**
+* @brief Function called by Lua on errors outside of any protected call, before it aborts
+*
+* @param l Lua context
+*
+* @return Unused
+*/
+internal_function
+Sint memoryLuaPanic (lua_State *l)
+{
+    logConsole(LOG_LEVEL_CRITICAL,
+               LOG_CHANNEL_SCRIPT,
+               "Unprotected error in Lua: %s",
+               lua_tostring(l, -1));
+    return 0;
+}
+
+/**
+* @brief Function to create a Lua state that uses the pooled allocator
+*
+* This is the counterpart of luaL_newstate.
+*
+* @param memory Accounting of the state (which has to outlive it)
+*
+* @return Lua context, NULL if out of memory
+*/
+internal_function
+lua_State* memoryLuaNewState (Memory_Lua *memory)
+{
+    memset(memory, 0, sizeof(*memory));
+
+    lua_State *l = lua_newstate(memoryLuaAlloc, memory);
+    if (l != NULL) {
+        lua_atpanic(l, memoryLuaPanic);
+    }
+
+    return l;
+}
+
+/**
+* @brief Function to get the accounting of a Lua state
+*
+* @param l Lua context
+*
+* @return Accounting, NULL if the state doesn't use the pooled allocator
+*/
+internal_function
+Memory_Lua* memoryLuaGet (lua_State *l)
+{
+    void *ud = NULL;
+    if (lua_getallocf(l, &ud) != memoryLuaAlloc) {
+        return NULL;
+    }
+    return ud;
+}
+
+/**
+* @brief Function to change the subsystem to which the blocks of a Lua state are attributed
+*
+* @param l Lua context
+* @param subsystem Subsystem that is starting to run
+*
+* @return Subsystem that was running (to be put back once @p subsystem is done)
+*/
+internal_function
+enum Memory_Subsystem memoryAttribute (lua_State *l, enum Memory_Subsystem subsystem)
+{
+    Memory_Lua *memory = memoryLuaGet(l);
+    if (memory == NULL) {
+        return MEMORY_SUBSYSTEM_ENGINE;
+    }
+
+    enum Memory_Subsystem previous = memory->subsystem;
+    memory->subsystem = subsystem;
+    return previous;
+}
+
+/**
+* @brief Function to get the total of the memory used by all the subsystems of a Lua state
+*
+* @param memory Accounting of the state
+*
+* @return Memory used
+*/
+internal_function
+Memory_Usage memoryTotal (Memory_Lua *memory)
+{
+    Memory_Usage total = {0};
+    for (Sint i = 0; i < MEMORY_SUBSYSTEM_COUNT; ++i) {
+        total.bytes += memory->usage[i].bytes;
+        total.blocks += memory->usage[i].blocks;
+        total.allocations += memory->usage[i].allocations;
+    }
+    return total;
+}
+
+/**
+* @brief Function to record the memory used by a Lua state in the profiler (once per frame)
+*
+* @param memory Accounting of the state
+* @param allocations Number of allocations made by the state as of the last call (updated)
+*/
+internal_function
+void memoryProfile (Memory_Lua *memory, U64 *allocations)
+{
+    for (Sint i = 0; i < MEMORY_SUBSYSTEM_COUNT; ++i) {
+        profileRecord((enum Profile_Counter)(PROFILE_LUA_MEMORY_ENGINE + i),
+                      (F64)memory->usage[i].bytes / 1024.0);
+    }
+
+    U64 total = memoryTotal(memory).allocations;
+    profileRecord(PROFILE_LUA_ALLOCATIONS, (F64)(total - *allocations));
+    *allocations = total;
+}
+
+/**
+* @brief Function to log the memory used by each subsystem of a Lua state
+*
+* @param memory Accounting of the state
+*/
+internal_function
+void memoryLogSummary (Memory_Lua *memory)
+{
+    for (Sint i = 0; i < MEMORY_SUBSYSTEM_COUNT; ++i) {
+        Memory_Usage *usage = &memory->usage[i];
+        logConsole(LOG_LEVEL_INFO,
+                   LOG_CHANNEL_SCRIPT,
+                   "Lua memory (%s): %.1f KiB live in %llu blocks, %llu allocations",
+                   memorySubsystemName((enum Memory_Subsystem)i),
+                   (F64)usage->bytes / 1024.0,
+                   (unsigned long long)usage->blocks,
+                   (unsigned long long)usage->allocations);
+    }
+
+    SDL_AtomicLock(&global_memory.lock);
+    U64 arena_bytes = global_memory.arena_bytes;
+    SDL_AtomicUnlock(&global_memory.lock);
+
+    logConsole(LOG_LEVEL_INFO,
+               LOG_CHANNEL_SCRIPT,
+               "Lua memory arenas: %.1f MiB (all threads)",
+               (F64)arena_bytes / (1024.0 * 1024.0));
+}
@@ -0,0 +1,81 @@
+/**
+ * These functions are called from Lua and are used to attribute the memory of the game's Lua
+ * state to the subsystem running in it, and to query how much each subsystem uses. They do
+ * nothing (and report nothing) in states that don't use the pooled allocator.
+ *
+ * @file memory_script.c
+ * @author Team Octal
+ * @brief Lua functions for accounting the memory of Lua states
+ */
+
+/**
+* @brief Lua injected function which changes the subsystem the new blocks are attributed to
+*
+* This function is called from Lua with the name of the subsystem that is starting to run
+* ("engine", "events", "loop", "commands" or "tutorial"), and returns the name of the one that
+* was running, to be passed back once it is done.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptMemoryAttribute (lua_State *l)
+{
+    const Char *name = luaL_checkstring(l, 1);
+
+    for (Sint i = 0; i < MEMORY_SUBSYSTEM_COUNT; ++i) {
+        enum Memory_Subsystem subsystem = (enum Memory_Subsystem)i;
+        if (strcmp(name, memorySubsystemName(subsystem)) == 0) {
+            lua_pushstring(l, memorySubsystemName(memoryAttribute(l, subsystem)));
+            return 1;
+        }
+    }
+
+    return luaL_argerror(l, 1, "unknown subsystem");
+}
+
+/**
+* @brief Lua injected function which returns the memory used by every subsystem
+*
+* The table returned has a field for each subsystem (and one named "total"), which holds the
+* bytes (`bytes`) and number of blocks (`blocks`) live, and the number of blocks ever
+* allocated (`allocations`). It is nil if the state doesn't use the pooled allocator.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptMemoryUsage (lua_State *l)
+{
+    Memory_Lua *memory = memoryLuaGet(l);
+    if (memory == NULL) {
+        lua_pushnil(l);
+        return 1;
+    }
+
+    // NOTE(naman): The counters are copied first, since building the table allocates.
+    Memory_Usage usage[MEMORY_SUBSYSTEM_COUNT + 1];
+    memcpy(usage, memory->usage, sizeof(memory->usage));
+    usage[MEMORY_SUBSYSTEM_COUNT] = memoryTotal(memory);
+
+    lua_createtable(l, 0, MEMORY_SUBSYSTEM_COUNT + 1); // <usage>
+    for (Sint i = 0; i <= MEMORY_SUBSYSTEM_COUNT; ++i) {
+        lua_createtable(l, 0, 3); // <usage> <subsystem>
+        lua_pushnumber(l, (lua_Number)usage[i].bytes);
+        lua_setfield(l, -2, "bytes");
+        lua_pushnumber(l, (lua_Number)usage[i].blocks);
+        lua_setfield(l, -2, "blocks");
+        lua_pushnumber(l, (lua_Number)usage[i].allocations);
+        lua_setfield(l, -2, "allocations");
+
+        if (i == MEMORY_SUBSYSTEM_COUNT) {
+            lua_setfield(l, -2, "total"); // <usage>
+        } else {
+            lua_setfield(l, -2, memorySubsystemName((enum Memory_Subsystem)i)); // <usage>
+        }
+    }
+
+    return 1;
+}
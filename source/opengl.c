@@ -2,83 +2,583 @@
  * These functions are used to wrap around the OpenGL API in order to provide a higher level
  * abstraction for often used operations.
  *
+ * Shader programs are created asynchronously: @ref openglShaderCreate only issues the compile
+ * and link commands (or loads a cached program binary), and the result is checked the first
+ * time the program is bound through @ref openglProgramUse. This lets the driver compile all
+ * the programs in parallel instead of stalling on each one in turn.
+ *
  * @file opengl.c
  * @author Team Octal
  * @brief Functions for OpenGL API
  */
 
+/**
+* @brief Enumeration of the levels of validation done by the OpenGL driver
+*/
+enum OpenGL_Debug_Mode {
+    OPENGL_DEBUG_OFF, /**< No debug context, no messages */
+    OPENGL_DEBUG_ASYNC, /**< Messages are reported whenever the driver gets to them */
+    OPENGL_DEBUG_SYNC, /**< Messages are reported from within the call that caused them */
+};
+
+/**
+* @brief A kind of debug message reported by the driver, with the number of times it came
+*/
+typedef struct OpenGL_Debug_Message {
+    U32 source; /**< Source of the message */
+    U32 type; /**< Type of the message */
+    U32 id; /**< Id of the message */
+    U32 count; /**< Number of times the message was reported */
+} OpenGL_Debug_Message;
+
+/**
+* @brief Program whose compilation and linking has been issued but not yet checked
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct OpenGL_Pending_Program {
+    GLuint program; /**< Handle to the program */
+    GLuint vert; /**< Handle to the vertex shader */
+    GLuint frag; /**< Handle to the fragment shader */
+    Char *name; /**< Name of the program (used for logging and caching) */
+    U64 key; /**< Cache key of the program */
+    B32 failed; /**< Did the program fail to compile or link? */
+} OpenGL_Pending_Program;
+
+/**
+* @brief State of the OpenGL wrapper
+*/
+global_variable struct OpenGL_State {
+    U64 driver_key; /**< Hash of the vendor, renderer and version strings */
+    B32 binary_cache; /**< Can program binaries be retrieved and loaded? */
+    OpenGL_Pending_Program *pending; /**< Programs that haven't been checked yet */
+    Size pending_count; /**< Number of elements in @ref pending */
+    Size pending_capacity; /**< Number of elements allocated for @ref pending */
+    enum OpenGL_Debug_Mode debug_mode; /**< Level of validation done by the driver */
+    SDL_SpinLock debug_lock; /**< Protects the debug messages */
+    OpenGL_Debug_Message *debug_messages; /**< Kinds of debug messages reported so far */
+    Size debug_message_count; /**< Number of elements in @ref debug_messages */
+    Size debug_message_capacity; /**< Number of elements allocated for @ref debug_messages */
+} global_opengl;
+#pragma clang diagnostic pop
+
+/**
+* @brief Function to count a debug message reported by the driver
+*
+* @param source Source of the message
+* @param type Type of the message
+* @param id Id of the message
+*
+* @return Number of times the message has been reported (including this time)
+*/
+internal_function
+U32 openglDebugCount (U32 source, U32 type, U32 id)
+{
+    U32 count = 0;
+
+    SDL_AtomicLock(&global_opengl.debug_lock);
+
+    for (Size i = 0; i < global_opengl.debug_message_count; ++i) {
+        OpenGL_Debug_Message *debug_message = &global_opengl.debug_messages[i];
+        if ((debug_message->id == id) &&
+            (debug_message->source == source) &&
+            (debug_message->type == type)) {
+            count = ++debug_message->count;
+            break;
+        }
+    }
+
+    if (count == 0) {
+        if (global_opengl.debug_message_count == global_opengl.debug_message_capacity) {
+            global_opengl.debug_message_capacity = (global_opengl.debug_message_capacity * 2) + 16;
+            global_opengl.debug_messages = realloc(global_opengl.debug_messages,
+                                                   global_opengl.debug_message_capacity *
+                                                   sizeof(*global_opengl.debug_messages));
+        }
+
+        OpenGL_Debug_Message *debug_message =
+            &global_opengl.debug_messages[global_opengl.debug_message_count++];
+        debug_message->source = source;
+        debug_message->type = type;
+        debug_message->id = id;
+        debug_message->count = count = 1;
+    }
+
+    SDL_AtomicUnlock(&global_opengl.debug_lock);
+
+    return count;
+}
+
+/**
+* @brief Function to log OpenGL diagnostics
+*
+* This function is used for logging 3D rendering debug data and other error and warning messages
+* related to 3D OpenGL graphics.
+*
+* Repeated messages are deduplicated by their source, type and id: only the first occurrence is
+* logged in full (with a stack trace for errors in synchronous mode), after which the message
+* is counted and logged again every time its count reaches a power of ten. In asynchronous
+* mode this can be called from a driver thread, so it never touches any GL state.
+*
+* @param source Information on who sent the diagnostic
+* @param type Kind of diagnostic
+* @param id Unique ID of the diagnostic
+* @param severity Denotes how severe it is
+* @param length Length of the diagnostic message
+* @param message Diagnostic message
+* @param user_param Any user parameters, unused
+*/
+internal_function
+void openglDebugCallback(U32 source, U32 type, U32 id, U32 severity,
+                         S32 length, const Char* message,
+                         const void* user_param)
+{
+    unused_variable(user_param);
+
+    switch (id) {
+        case 131218: { // NOTE(naman): NVIDIA: "shader will be recompiled due to GL state mismatches"
+            return;
+        } break;
+        default: {
+        } break;
+    }
+
+    enum Log_Level level;
+    switch (severity) {
+    case GL_DEBUG_SEVERITY_HIGH_ARB:
+        level = LOG_LEVEL_ERROR;
+        break;
+    case GL_DEBUG_SEVERITY_MEDIUM_ARB:
+        level= LOG_LEVEL_WARN;
+        break;
+    case GL_DEBUG_SEVERITY_LOW_ARB:
+        level = LOG_LEVEL_VERBOSE;
+        break;
+    default:
+        level = LOG_LEVEL_VERBOSE;
+        break;
+    }
+
+    char *type_str = NULL;
+    switch (type) {
+    case GL_DEBUG_TYPE_ERROR_ARB:
+        type_str = "(Error) ";
+        break;
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR_ARB:
+        type_str = "(Deprecated Warning) ";
+        break;
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR_ARB:
+        type_str = "(Undefined Behaviour) ";
+        break;
+    case GL_DEBUG_TYPE_PERFORMANCE_ARB:
+        type_str = "(Performance Warning) ";
+        break;
+    case GL_DEBUG_TYPE_PORTABILITY_ARB:
+        type_str = "(Non-Portable) ";
+        break;
+    case GL_DEBUG_TYPE_OTHER_ARB:
+        type_str = "(Others) ";
+        break;
+    default:
+        type_str = "(Others) ";
+        break;
+    }
+
+    char *source_str = NULL;
+    switch (source) {
+    case GL_DEBUG_SOURCE_API_ARB:
+        source_str = "{GL API}: ";
+        break;
+    case GL_DEBUG_SOURCE_SHADER_COMPILER_ARB:
+        source_str = "{Shader Compiler}: ";
+        break;
+    case GL_DEBUG_SOURCE_WINDOW_SYSTEM_ARB:
+        source_str = "{Window System}: ";
+        break;
+    case GL_DEBUG_SOURCE_THIRD_PARTY_ARB:
+        source_str = "{Third Party}: ";
+        break;
+    case GL_DEBUG_SOURCE_APPLICATION_ARB:
+        source_str = "{Application}: ";
+        break;
+    case GL_DEBUG_SOURCE_OTHER_ARB:
+        source_str = "{Others}: ";
+        break;
+    default:
+        source_str = "{Others}: ";
+        break;
+    }
+
+    unused_variable(length);
+
+    U32 count = openglDebugCount(source, type, id);
+
+    if (count == 1) {
+        logConsole(level,
+                   LOG_CHANNEL_OPENGL,
+                   "%s%s%s",
+                   source_str, type_str, message);
+
+        if ((global_opengl.debug_mode == OPENGL_DEBUG_SYNC) &&
+            ((type == GL_DEBUG_TYPE_ERROR_ARB) ||
+             (type == GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR_ARB) ||
+             (type == GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR_ARB))) {
+            debugPrintCallStackTrace();
+            SDL_TriggerBreakpoint();
+        }
+    } else if (logIsEnabled(level, LOG_CHANNEL_OPENGL)) {
+        U32 power = 10;
+        while (power < count) power *= 10;
+        if (power == count) {
+            logConsole(level,
+                       LOG_CHANNEL_OPENGL,
+                       "%s%s(repeated %u times) %s",
+                       source_str, type_str, count, message);
+        }
+    }
+
+    return;
+}
+
+/**
+* @brief Function to set up the validation done by the OpenGL driver
+*
+* This must be called after the OpenGL functions have been loaded, with the same mode that was
+* used to pick the context flags.
+*
+* @param mode Level of validation
+*/
+internal_function
+void openglDebugInit (enum OpenGL_Debug_Mode mode)
+{
+    global_opengl.debug_mode = mode;
+
+    if ((mode == OPENGL_DEBUG_OFF) || (GLAD_GL_ARB_debug_output == 0)) {
+        return;
+    }
+
+    glDebugMessageCallbackARB(&openglDebugCallback, NULL);
+
+    if (mode == OPENGL_DEBUG_SYNC) {
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+    } else {
+        glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+    }
+
+    logConsole(LOG_LEVEL_INFO,
+               LOG_CHANNEL_OPENGL,
+               "Debug output enabled (%s)",
+               (mode == OPENGL_DEBUG_SYNC) ? "synchronous" : "asynchronous");
+}
+
+/**
+* @brief Function to log how many times each repeated debug message was reported
+*/
+internal_function
+void openglDebugLogSummary (void)
+{
+    SDL_AtomicLock(&global_opengl.debug_lock);
+    for (Size i = 0; i < global_opengl.debug_message_count; ++i) {
+        OpenGL_Debug_Message *debug_message = &global_opengl.debug_messages[i];
+        if (debug_message->count > 1) {
+            logConsole(LOG_LEVEL_INFO,
+                       LOG_CHANNEL_OPENGL,
+                       "Debug message %u (source 0x%x, type 0x%x) was reported %u times",
+                       debug_message->id, debug_message->source, debug_message->type,
+                       debug_message->count);
+        }
+    }
+    SDL_AtomicUnlock(&global_opengl.debug_lock);
+}
+
+/**
+* @brief Function to initialize the OpenGL wrapper
+*
+* This must be called after the OpenGL functions have been loaded. It lets the driver
+* compile shaders on its own threads (if supported) and computes the part of the program
+* cache key that identifies the driver, so that cached program binaries are automatically
+* rejected after a driver change.
+*/
+internal_function
+void openglInit (void)
+{
+    if (GLAD_GL_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFU); // NOTE(naman): Let the driver decide
+        logConsole(LOG_LEVEL_INFO,
+                   LOG_CHANNEL_OPENGL,
+                   "Parallel shader compilation enabled");
+    }
+
+    GLenum driver_strings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION};
+    global_opengl.driver_key = CACHE_HASH_SEED;
+    for (Size i = 0; i < (sizeof(driver_strings)/sizeof(driver_strings[0])); ++i) {
+        const Char *str = (const Char *)glGetString(driver_strings[i]);
+        if (str != NULL) {
+            global_opengl.driver_key = cacheHash(str, strlen(str) + 1, global_opengl.driver_key);
+        }
+    }
+
+    if (GLAD_GL_ARB_get_program_binary) {
+        GLint format_count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+        global_opengl.binary_cache = (format_count > 0);
+    }
+
+    logConsole(LOG_LEVEL_INFO,
+               LOG_CHANNEL_OPENGL,
+               "Program binary cache %s",
+               global_opengl.binary_cache ? "enabled" : "not supported");
+}
+
+/**
+* @brief Function to log the info log of a shader or program
+*
+* @param name Name of the program
+* @param kind Kind of object (used as a prefix for the message)
+* @param object Handle to the shader or program
+* @param is_program Is @p object a program (as opposed to a shader)?
+*/
+internal_function
+void openglLogInfoLog (const Char *name, const Char *kind, GLuint object, B32 is_program)
+{
+    GLint log_length = 0;
+    if (is_program) {
+        glGetProgramiv(object, GL_INFO_LOG_LENGTH, &log_length);
+    } else {
+        glGetShaderiv(object, GL_INFO_LOG_LENGTH, &log_length);
+    }
+
+    GLchar* log = calloc((Size)log_length + 1, sizeof(*log));
+    if (is_program) {
+        glGetProgramInfoLog(object, log_length, NULL, log);
+    } else {
+        glGetShaderInfoLog(object, log_length, NULL, log);
+    }
+
+    logConsole(LOG_LEVEL_ERROR,
+               LOG_CHANNEL_RENDER,
+               "%s (%s): %s\n",
+               kind, name, log);
+    free(log);
+}
+
+/**
+* @brief Function to load a program from the program binary cache
+*
+* @param name Name of the program
+* @param key Cache key of the program
+*
+* @return Handle to the loaded program, 0 if there was no usable binary
+*/
+internal_function
+GLuint openglProgramLoadBinary (const Char *name, U64 key)
+{
+    if (global_opengl.binary_cache == false) {
+        return 0;
+    }
+
+    Size size = 0;
+    Byte *entry = cacheRead("program", name, key, &size);
+    if (entry == NULL) {
+        return 0;
+    }
+
+    GLuint program = 0;
+    if (size > sizeof(U32)) {
+        U32 format = 0;
+        memcpy(&format, entry, sizeof(format));
+
+        program = glCreateProgram();
+        glProgramBinary(program, format, entry + sizeof(format), (GLsizei)(size - sizeof(format)));
+
+        GLint status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (status == GL_FALSE) {
+            logConsole(LOG_LEVEL_INFO,
+                       LOG_CHANNEL_OPENGL,
+                       "Cached binary of program %s rejected, recompiling",
+                       name);
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    free(entry);
+
+    return program;
+}
+
+/**
+* @brief Function to store a linked program in the program binary cache
+*
+* @param program Handle to the linked program
+* @param name Name of the program
+* @param key Cache key of the program
+*/
+internal_function
+void openglProgramStoreBinary (GLuint program, const Char *name, U64 key)
+{
+    if (global_opengl.binary_cache == false) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    Byte *entry = malloc(sizeof(U32) + (Size)length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, entry + sizeof(U32));
+
+    if (written > 0) {
+        U32 format_stored = format;
+        memcpy(entry, &format_stored, sizeof(format_stored));
+        cacheWrite("program", name, key, entry, sizeof(U32) + (Size)written);
+    }
+
+    free(entry);
+}
+
 /**
 * @brief Function to compile OpenGL shaders
 *
 * This function takes the source of a vertex shader and a fragment shader, and
 * compiles them into a the OpenGL program for graphics rendering.
 *
+* If the program binary cache contains a binary of the same sources made by the same driver,
+* that binary is loaded instead. Otherwise, the compilation and linking is only issued here;
+* the status is checked (and the binary cached) when the program is first used through
+* @ref openglProgramUse.
+*
+* @param name Name of the program (used for logging and caching)
 * @param vert_src Vertex shader source
 * @param frag_src Fragment shader source
 *
 * @return Handle to the compiled program
 */
 internal_function
-GLint openglShaderCreate(const char *const vert_src,
+GLint openglShaderCreate(const char *const name,
+                         const char *const vert_src,
                          const char *const frag_src)
 {
+    U64 key = cacheHash(vert_src, strlen(vert_src) + 1, global_opengl.driver_key);
+    key = cacheHash(frag_src, strlen(frag_src) + 1, key);
+
+    GLuint program = openglProgramLoadBinary(name, key);
+    if (program != 0) {
+        return (GLint)program;
+    }
+
     GLuint vert, frag;
-    GLint vert_status, frag_status, program_status;
 
     vert = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vert, 1, &vert_src, NULL);
     glCompileShader(vert);
-    glGetShaderiv(vert, GL_COMPILE_STATUS, &vert_status);
-    if (vert_status == GL_FALSE) {
-        GLint log_length;
-        glGetShaderiv(vert, GL_INFO_LOG_LENGTH, &log_length);
-        GLchar* log = malloc(sizeof(*log) * ((Size)log_length+1));
-        glGetShaderInfoLog(vert, log_length, NULL, log);
-        logConsole(LOG_LEVEL_ERROR,
-                   LOG_CHANNEL_RENDER,
-                   "Vertex Shader: %s\n",
-                   log);
-        free(log);
-        return -1;
-    }
 
     frag = glCreateShader(GL_FRAGMENT_SHADER);
     glShaderSource(frag, 1, &frag_src, NULL);
     glCompileShader(frag);
-    glGetShaderiv(frag, GL_COMPILE_STATUS, &frag_status);
-    if (frag_status == GL_FALSE) {
-        GLint log_length;
-        glGetShaderiv(frag, GL_INFO_LOG_LENGTH, &log_length);
-        GLchar* log = malloc(sizeof(*log) * ((Size)log_length+1));
-        glGetShaderInfoLog(frag, log_length, NULL, log);
-        logConsole(LOG_LEVEL_ERROR,
-                   LOG_CHANNEL_RENDER,
-                   "Fragment Shader: %s\n",
-                   log);
-        free(log);
+
+    program = glCreateProgram();
+    if (program == 0) {
+        glDeleteShader(vert);
+        glDeleteShader(frag);
         return -1;
     }
 
-    GLuint program = glCreateProgram();
     glAttachShader(program, vert);
     glAttachShader(program, frag);
+    if (global_opengl.binary_cache) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(program);
-    glGetProgramiv(program, GL_LINK_STATUS, &program_status);
-    if (program_status == GL_FALSE) {
-        GLint log_length;
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_length);
-        GLchar* log = malloc(sizeof(*log) * ((Size)log_length+1));
-        glGetProgramInfoLog(program, log_length, NULL, log);
-        logConsole(LOG_LEVEL_ERROR,
-                   LOG_CHANNEL_RENDER,
-                   "Shader Program %d: %s\n",
-                   program, log);
-        free(log);
-        return -1;
+
+    if (global_opengl.pending_count == global_opengl.pending_capacity) {
+        global_opengl.pending_capacity = (global_opengl.pending_capacity * 2) + 8;
+        global_opengl.pending = realloc(global_opengl.pending,
+                                        global_opengl.pending_capacity *
+                                        sizeof(*global_opengl.pending));
     }
 
-    glDeleteShader(vert);
-    glDeleteShader(frag);
+    OpenGL_Pending_Program *pending = &global_opengl.pending[global_opengl.pending_count++];
+    pending->program = program;
+    pending->vert = vert;
+    pending->frag = frag;
+    pending->name = malloc(strlen(name) + 1);
+    strcpy(pending->name, name);
+    pending->key = key;
+    pending->failed = false;
 
     return (GLint)program;
 }
+
+/**
+* @brief Function to bind a program for rendering
+*
+* The first time a program created by @ref openglShaderCreate is used, this waits for
+* its compilation to finish, checks the result and stores the program in the binary cache.
+* After that, it is equivalent to glUseProgram.
+*
+* @param program Handle to the program
+*
+* @return success/failure (a failed program is not bound)
+*/
+internal_function
+B32 openglProgramUse (GLuint program)
+{
+    for (Size i = 0; i < global_opengl.pending_count; ++i) {
+        OpenGL_Pending_Program *pending = &global_opengl.pending[i];
+        if (pending->program != program) {
+            continue;
+        }
+
+        if (pending->failed) {
+            glUseProgram(0);
+            return false;
+        }
+
+        GLint program_status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &program_status);
+
+        if (program_status == GL_FALSE) {
+            GLint vert_status, frag_status;
+            glGetShaderiv(pending->vert, GL_COMPILE_STATUS, &vert_status);
+            glGetShaderiv(pending->frag, GL_COMPILE_STATUS, &frag_status);
+
+            if (vert_status == GL_FALSE) {
+                openglLogInfoLog(pending->name, "Vertex Shader", pending->vert, false);
+            } else if (frag_status == GL_FALSE) {
+                openglLogInfoLog(pending->name, "Fragment Shader", pending->frag, false);
+            } else {
+                openglLogInfoLog(pending->name, "Shader Program", program, true);
+            }
+        } else {
+            openglProgramStoreBinary(program, pending->name, pending->key);
+        }
+
+        glDeleteShader(pending->vert);
+        glDeleteShader(pending->frag);
+
+        if (program_status == GL_FALSE) {
+            // NOTE(naman): Failed programs stay in the list so that every later use
+            // fails the same way instead of binding an unlinked program.
+            pending->vert = 0;
+            pending->frag = 0;
+            pending->failed = true;
+            glUseProgram(0);
+            return false;
+        }
+
+        free(pending->name);
+        global_opengl.pending[i] = global_opengl.pending[--global_opengl.pending_count];
+
+        break;
+    }
+
+    glUseProgram(program);
+
+    return true;
+}
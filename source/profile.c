@@ -0,0 +1,141 @@
+/**
+ * These functions implement a minimal profiler: a fixed set of counters into which the other
+ * subsystems record samples (e.g. how long a frame took), and which are summarized in the log
+ * when the game exits.
+ *
+ * @file profile.c
+ * @author Team Octal
+ * @brief Functions for profiling
+ */
+
+/**
+* @brief Enumeration of all the things that are profiled
+*/
+enum Profile_Counter {
+    PROFILE_FRAME_WORK, /**< Microseconds of work done per frame (excluding pacing) */
+    PROFILE_FRAME_SLEEP, /**< Microseconds slept per frame by the frame scheduler */
+    PROFILE_DEADLINE_MISSED, /**< Microseconds by which a frame missed its deadline */
+    PROFILE_TICKS_PER_FRAME, /**< Number of simulation updates run per frame */
+    PROFILE_TICK_DROPPED, /**< Microseconds of simulation dropped after falling too far behind */
+    PROFILE_RENDER_SKIPPED, /**< Frames not rendered so that the simulation could catch up */
+    PROFILE_AUDIO_CALLBACK, /**< Microseconds taken to mix a callback's worth of audio */
+    // NOTE(naman): These are in the order of enum Memory_Subsystem (see memoryProfile).
+    PROFILE_LUA_MEMORY_ENGINE, /**< KiB of the game's Lua state used by the engine, per frame */
+    PROFILE_LUA_MEMORY_EVENTS, /**< KiB of the game's Lua state used by events, per frame */
+    PROFILE_LUA_MEMORY_LOOP, /**< KiB of the game's Lua state used by the loop, per frame */
+    PROFILE_LUA_MEMORY_COMMANDS, /**< KiB of the game's Lua state used by commands, per frame */
+    PROFILE_LUA_MEMORY_TUTORIAL, /**< KiB of the game's Lua state used by the tutorial, per frame */
+    PROFILE_LUA_ALLOCATIONS, /**< Number of allocations made by the game's Lua state per frame */
+    PROFILE_COUNTER_COUNT,
+};
+
+/**
+* @brief Accumulated samples of a single counter
+*/
+typedef struct Profile_Samples {
+    U64 count; /**< Number of samples */
+    F64 total; /**< Sum of samples */
+    F64 max; /**< Largest sample */
+} Profile_Samples;
+
+/**
+* @brief State of the profiler
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+global_variable struct Profile_State {
+    Profile_Samples samples[PROFILE_COUNTER_COUNT]; /**< Samples of each counter */
+    SDL_SpinLock lock; /**< Protects @ref samples, since samples come from many threads */
+} global_profile;
+#pragma clang diagnostic pop
+
+/**
+* @brief Function to get the printable name of a counter
+*
+* @param counter Counter
+*
+* @return Name of counter
+*/
+internal_function
+const Char* profileCounterName (enum Profile_Counter counter)
+{
+    switch (counter) {
+    case PROFILE_FRAME_WORK:
+        return "Frame work (us)";
+    case PROFILE_FRAME_SLEEP:
+        return "Frame sleep (us)";
+    case PROFILE_DEADLINE_MISSED:
+        return "Missed deadlines (us late)";
+    case PROFILE_TICKS_PER_FRAME:
+        return "Updates per frame";
+    case PROFILE_TICK_DROPPED:
+        return "Dropped simulation (us)";
+    case PROFILE_RENDER_SKIPPED:
+        return "Skipped renders";
+    case PROFILE_AUDIO_CALLBACK:
+        return "Audio callback (us)";
+    case PROFILE_LUA_MEMORY_ENGINE:
+        return "Lua memory, engine (KiB)";
+    case PROFILE_LUA_MEMORY_EVENTS:
+        return "Lua memory, events (KiB)";
+    case PROFILE_LUA_MEMORY_LOOP:
+        return "Lua memory, loop (KiB)";
+    case PROFILE_LUA_MEMORY_COMMANDS:
+        return "Lua memory, commands (KiB)";
+    case PROFILE_LUA_MEMORY_TUTORIAL:
+        return "Lua memory, tutorial (KiB)";
+    case PROFILE_LUA_ALLOCATIONS:
+        return "Lua allocations per frame";
+    case PROFILE_COUNTER_COUNT:
+        return "**INVALID**";
+    }
+
+    return "**INVALID**";
+}
+
+/**
+* @brief Function to record a sample
+*
+* This can be called from any thread.
+*
+* @param counter Counter to which the sample belongs
+* @param value Value of the sample
+*/
+internal_function
+void profileRecord (enum Profile_Counter counter, F64 value)
+{
+    SDL_AtomicLock(&global_profile.lock);
+    Profile_Samples *samples = &global_profile.samples[counter];
+    samples->count++;
+    samples->total += value;
+    if (value > samples->max) {
+        samples->max = value;
+    }
+    SDL_AtomicUnlock(&global_profile.lock);
+}
+
+/**
+* @brief Function to log a summary of all the counters that have samples
+*/
+internal_function
+void profileLogSummary (void)
+{
+    SDL_AtomicLock(&global_profile.lock);
+    Profile_Samples samples[PROFILE_COUNTER_COUNT];
+    memcpy(samples, global_profile.samples, sizeof(samples));
+    SDL_AtomicUnlock(&global_profile.lock);
+
+    for (Sint i = 0; i < PROFILE_COUNTER_COUNT; ++i) {
+        if (samples[i].count == 0) {
+            continue;
+        }
+
+        logConsole(LOG_LEVEL_INFO,
+                   LOG_CHANNEL_TIME,
+                   "%s: %llu samples, mean %.1f, max %.1f",
+                   profileCounterName((enum Profile_Counter)i),
+                   (unsigned long long)samples[i].count,
+                   samples[i].total / (F64)samples[i].count,
+                   samples[i].max);
+    }
+}
@@ -24,6 +24,7 @@
 * @param char_first First renderable character
 * @param char_num Total number of renderable characters
 * @param text Text which needs to be rendered
+* @param text_length Length of @p text
 * @param screen_pos Screen space position of rendered text
 * @param color Color of rendered text
 * @param scale_factor Scaling factor, to be applied on quads
@@ -39,25 +40,24 @@ B32 renderText (GLuint vao, GLuint vbo, GLuint texture, GLuint program,
                 char char_first, char char_num,
                 U32 bitmap_width, U32 bitmap_height,
                 stbtt_bakedchar *baked_char,
-                const char *text,
+                const char *text, Size text_length,
                 Vec3 screen_pos, Vec3 color,
                 F32 scale_factor, F32 x_scaling,
                 F32 *x_ret, F32 *y_min_ret, F32 *y_max_ret)
 {
 
-    Size text_length = strlen(text);
     Size vertices_size = text_length * 6 * 4;
     GLfloat *vertices = malloc(sizeof(*vertices) * vertices_size);
 
     U32 i = 0;
     F32 x = 0, y_min = 0, y_max = 0;
 
-    while (*text) {
-        if ((*text >= char_first) &&
-            (*text < (char_first + char_num))) {
+    for (Size c = 0; c < text_length; ++c) {
+        if ((text[c] >= char_first) &&
+            (text[c] < (char_first + char_num))) {
 
             stbtt_aligned_quad q;
-            stbtt_bakedchar *b = baked_char + ((*text) - char_first);
+            stbtt_bakedchar *b = baked_char + (text[c] - char_first);
             F32 ibw = 1.0f / (bitmap_width);
             F32 ibh = 1.0f / (bitmap_height);
 
@@ -110,7 +110,6 @@ B32 renderText (GLuint vao, GLuint vbo, GLuint texture, GLuint program,
 
             i = i + 24;
         }
-        ++text;
     }
 
     *x_ret = x;
@@ -126,7 +125,7 @@ B32 renderText (GLuint vao, GLuint vbo, GLuint texture, GLuint program,
     free(vertices);
 
     glBindVertexArray(vao);
-    glUseProgram(program);
+    openglProgramUse(program);
     glBindTexture(GL_TEXTURE_2D, texture);
 
     Mat4 translation = mat4Translate2D(vec2New(screen_pos.x,
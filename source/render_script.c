@@ -68,65 +68,106 @@ int scriptRenderGetTextDimensions (lua_State *l)
 }
 
 /**
-* @brief Lua injected function which calls @ref renderText
-*
-* This function is called from Lua and is used to call into @ref renderText using
-* proper parameters.
+* @brief Font, as described by the Lua table of a loaded font
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Script_Font {
+    GLuint vao; /**< Vertex Array Object */
+    GLuint vbo; /**< Vertex Buffer Object */
+    GLuint texture; /**< Handle for texture stored GPU side */
+    GLuint program; /**< Handle for compiled shader */
+    F32 scaling_factor; /**< Scaling factor applied to quads */
+    F32 x_scaling; /**< Horizontal scaling constant (aspect ratio of the window) */
+    U32 char_first; /**< First renderable character */
+    U32 char_num; /**< Total number of renderable characters */
+    U32 bitmap_width; /**< Width of baked bitmap */
+    U32 bitmap_height; /**< Height of baked bitmap */
+    stbtt_bakedchar *baked_char; /**< Baked character table */
+} Script_Font;
+#pragma clang diagnostic pop
+
+/**
+* @brief Function to read the Lua table of a loaded font
 *
 * @param l Lua context
+* @param index Stack index of the table
+* @param font Returns the font
 *
 * @return Execution status
 */
 internal_function
-int scriptRenderText (lua_State *l)
+B32 scriptRenderFont (lua_State *l, Sint index, Script_Font *font)
 {
-    lua_getfield(l, 1, "VAO");
-    GLuint vao = (GLuint)luaL_checknumber(l, -1);
+    if (index < 0) {
+        index = lua_gettop(l) + index + 1;
+    }
 
-    lua_getfield(l, 1, "VBO");
-    GLuint vbo = (GLuint)luaL_checknumber(l, -1);
+    lua_getfield(l, index, "VAO");
+    font->vao = (GLuint)luaL_checknumber(l, -1);
 
-    lua_getfield(l, 1, "Texture");
-    GLuint texture = (GLuint)luaL_checknumber(l, -1);
+    lua_getfield(l, index, "VBO");
+    font->vbo = (GLuint)luaL_checknumber(l, -1);
 
+    lua_getfield(l, index, "Texture");
+    font->texture = (GLuint)luaL_checknumber(l, -1);
 
-    lua_getfield(l, 1, "ScalingFactor");
-    F32 scaling_factor = (F32)luaL_checknumber(l, -1);
+    lua_getfield(l, index, "Program");
+    font->program = (GLuint)luaL_checknumber(l, -1);
 
-    lua_getfield(l, 1, "XScaling");
-    F32 x_scaling = (F32)luaL_checknumber(l, -1);
+    lua_getfield(l, index, "ScalingFactor");
+    font->scaling_factor = (F32)luaL_checknumber(l, -1);
 
-    lua_getfield(l, 1, "FontSize");
-    U32 font_size = (U32)luaL_checknumber(l, -1);
-    unused_variable(font_size);
+    lua_getfield(l, index, "XScaling");
+    font->x_scaling = (F32)luaL_checknumber(l, -1);
 
-    lua_getfield(l, 1, "CharacterFirst");
-    U32 char_first = (U32)luaL_checknumber(l, -1);
+    lua_getfield(l, index, "CharacterFirst");
+    font->char_first = (U32)luaL_checknumber(l, -1);
 
-    lua_getfield(l, 1, "CharacterCount");
-    U32 char_num = (U32)luaL_checknumber(l, -1);
+    lua_getfield(l, index, "CharacterCount");
+    font->char_num = (U32)luaL_checknumber(l, -1);
 
-    lua_getfield(l, 1, "BitmapWidth");
-    U32 bitmap_width = (U32)luaL_checknumber(l, -1);
+    lua_getfield(l, index, "BitmapWidth");
+    font->bitmap_width = (U32)luaL_checknumber(l, -1);
 
-    lua_getfield(l, 1, "BitmapHeight");
-    U32 bitmap_height = (U32)luaL_checknumber(l, -1);
+    lua_getfield(l, index, "BitmapHeight");
+    font->bitmap_height = (U32)luaL_checknumber(l, -1);
 
-    stbtt_bakedchar *baked_char = NULL;
-    lua_getfield(l, 1, "CharacterTable");
-    if (lua_islightuserdata(l, -1)) {
-        baked_char = lua_touserdata(l, -1);
-    } else {
+    lua_getfield(l, index, "CharacterTable");
+    if (lua_islightuserdata(l, -1) == false) {
+        lua_pop(l, 11);
+        return false;
+    }
+    font->baked_char = lua_touserdata(l, -1);
+
+    lua_pop(l, 11);
+    return true;
+}
+
+/**
+* @brief Lua injected function which calls @ref renderText
+*
+* This function is called from Lua and is used to call into @ref renderText using
+* proper parameters.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+int scriptRenderText (lua_State *l)
+{
+    Script_Font font = {0};
+    if (scriptRenderFont(l, 1, &font) == false) {
         logConsole(LOG_LEVEL_CRITICAL,
                    LOG_CHANNEL_ASSETS,
                    "Can't render text: value is not a light user data");
         global_game_is_running = false;
+        return 0;
     }
 
-    lua_getfield(l, 1, "Program");
-    U32 program = (U32)luaL_checknumber(l, -1);
-
-    char *text = luaL_checkstring(l, 2);
+    Size text_length = 0;
+    const char *text = luaL_checklstring(l, 2, &text_length);
 
     Vec3 screen_pos;
 
@@ -163,18 +204,19 @@ int scriptRenderText (lua_State *l)
     lua_pop(l, 1);
 
     F32 x = 0, y_min = 0, y_max = 0;
-    renderText(vao, vbo, texture, program,
-               (Char)char_first, (Char)char_num,
-               bitmap_width, bitmap_height,
-               baked_char,
-               text,
+    renderText(font.vao, font.vbo, font.texture, font.program,
+               (Char)font.char_first, (Char)font.char_num,
+               font.bitmap_width, font.bitmap_height,
+               font.baked_char,
+               text, text_length,
                screen_pos, color,
-               scaling_factor, x_scaling,
+               font.scaling_factor, font.x_scaling,
                &x, &y_min, &y_max);
 
-    lua_pushnumber(l, (lua_Number)x * (lua_Number)scaling_factor * (lua_Number)x_scaling);
-    lua_pushnumber(l, (lua_Number)y_min * (lua_Number)scaling_factor);
-    lua_pushnumber(l, (lua_Number)y_max * (lua_Number)scaling_factor);
+    lua_pushnumber(l, (lua_Number)x * (lua_Number)font.scaling_factor *
+                   (lua_Number)font.x_scaling);
+    lua_pushnumber(l, (lua_Number)y_min * (lua_Number)font.scaling_factor);
+    lua_pushnumber(l, (lua_Number)y_max * (lua_Number)font.scaling_factor);
 
     return 3;
 }
@@ -0,0 +1,389 @@
+/**
+ * These functions implement the scrollback of the terminal: the lines that have been typed in
+ * or printed, of which only the newest ones fit on the screen. Lines are kept in a ring of
+ * fixed capacity, and their text in an arena that is itself used as a ring, so that memory
+ * stays bounded no matter how much is printed; once either is full, the oldest lines are
+ * dropped.
+ *
+ * Every line caches how many rows it takes up once wrapped to the width of its pane, and where
+ * those rows start, so the rows that are on the screen can be found by walking back from the
+ * newest line without looking at the rest. The cache is tagged with a layout epoch that only
+ * changes with the width or the font metrics; lines are (re)wrapped lazily, when they are first
+ * looked at after that. The row starts are kept in a ring too, since only the lines that are on
+ * the screen need them.
+ *
+ * @file scrollback.c
+ * @author Team Octal
+ * @brief Functions for the scrollback of the terminal
+ */
+
+#define SCROLLBACK_NO_PROMPT UINT32_MAX /* Prompt length of lines that have no prompt */
+#define SCROLLBACK_BREAKS 65536 /* Number of row starts kept in the ring */
+
+/**
+* @brief Metrics that wrapping depends on
+*/
+typedef struct Scrollback_Layout {
+    const void *font; /**< Font that @ref advance was taken from */
+    F32 scale; /**< Scaling that @ref advance was taken with */
+    F32 width; /**< Width of the pane in screen space */
+    F32 advance[256]; /**< Width of every character in screen space */
+} Scrollback_Layout;
+
+/**
+* @brief Line of the scrollback
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Scrollback_Line {
+    U64 offset; /**< Offset of the prompt and text in the arena (not wrapped to its size) */
+    U32 prompt_length; /**< Length of the prompt (SCROLLBACK_NO_PROMPT if there is none) */
+    U32 text_length; /**< Length of the text, which follows the prompt */
+    U32 rows; /**< Number of rows the line takes up once wrapped */
+    U32 epoch; /**< Layout epoch that @ref rows and @ref breaks were computed in (0 if never) */
+    U64 breaks; /**< Offset of the starts of the rows after the first in the ring of breaks */
+} Scrollback_Line;
+#pragma clang diagnostic pop
+
+/**
+* @brief Scrollback
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Scrollback {
+    Scrollback_Line *lines; /**< Ring of lines, indexed by line number modulo @ref capacity */
+    U32 capacity; /**< Number of slots in @ref lines */
+    U64 first; /**< Number of the oldest line */
+    U64 end; /**< Number of the line after the newest one */
+
+    Char *arena; /**< Ring of the text of the lines */
+    U64 arena_size; /**< Size of @ref arena */
+    U64 arena_head; /**< Offset at which the next line's text goes (not wrapped) */
+
+    U32 *breaks; /**< Ring of the starts of rows, indexed by offset modulo SCROLLBACK_BREAKS */
+    U64 breaks_head; /**< Offset at which the next line's row starts go (not wrapped) */
+
+    Scrollback_Layout layout; /**< Metrics that lines are wrapped with */
+    U32 epoch; /**< Layout epoch, bumped whenever @ref layout changes (0 if never set) */
+    U64 generation; /**< Incremented whenever a line is added or removed */
+} Scrollback;
+#pragma clang diagnostic pop
+
+/**
+* @brief Function to set up an empty scrollback
+*
+* @param scrollback Scrollback
+* @param capacity Maximum number of lines
+* @param arena_size Maximum number of bytes of text
+*/
+internal_function
+void scrollbackInit (Scrollback *scrollback, U32 capacity, U64 arena_size)
+{
+    memset(scrollback, 0, sizeof(*scrollback));
+
+    scrollback->capacity = capacity;
+    scrollback->lines = calloc(capacity, sizeof(*scrollback->lines));
+    scrollback->arena_size = arena_size;
+    scrollback->arena = malloc(arena_size);
+    scrollback->breaks = calloc(SCROLLBACK_BREAKS, sizeof(*scrollback->breaks));
+}
+
+/**
+* @brief Function to free everything a scrollback holds
+*
+* @param scrollback Scrollback
+*/
+internal_function
+void scrollbackFree (Scrollback *scrollback)
+{
+    free(scrollback->lines);
+    free(scrollback->arena);
+    free(scrollback->breaks);
+    memset(scrollback, 0, sizeof(*scrollback));
+}
+
+/**
+* @brief Function to get a line from its number
+*
+* @param scrollback Scrollback
+* @param number Number of the line (must be in [first, end))
+*
+* @return Line
+*/
+internal_function
+Scrollback_Line* scrollbackLine (Scrollback *scrollback, U64 number)
+{
+    return &scrollback->lines[number % scrollback->capacity];
+}
+
+/**
+* @brief Function to get the text (preceded by the prompt) of a line
+*
+* @param scrollback Scrollback
+* @param line Line
+*
+* @return Prompt and text
+*/
+internal_function
+const Char* scrollbackLineText (Scrollback *scrollback, Scrollback_Line *line)
+{
+    return scrollback->arena + (line->offset % scrollback->arena_size);
+}
+
+/**
+* @brief Function to get the length of a line's prompt (0 if it has none)
+*
+* @param line Line
+*
+* @return Length of prompt
+*/
+internal_function
+U32 scrollbackPromptLength (Scrollback_Line *line)
+{
+    return (line->prompt_length == SCROLLBACK_NO_PROMPT) ? 0 : line->prompt_length;
+}
+
+/**
+* @brief Function to measure text
+*
+* @param layout Metrics
+* @param text Text
+* @param length Length of @p text
+*
+* @return Width of the text in screen space
+*/
+internal_function
+F32 scrollbackMeasure (Scrollback_Layout *layout, const Char *text, Size length)
+{
+    F32 width = 0;
+    for (Size i = 0; i < length; ++i) {
+        width += layout->advance[(U8)text[i]];
+    }
+    return width;
+}
+
+/**
+* @brief Function to find where a row of wrapped text ends
+*
+* Rows are broken after the last space that fits, or in the middle of a word that doesn't fit
+* on a row of its own. Spaces never cause a break, since they are invisible.
+*
+* @param layout Metrics
+* @param text Text
+* @param length Length of @p text
+* @param start Offset in @p text where the row starts
+* @param x Width already taken up on the row (by the prompt)
+*
+* @return Offset in @p text where the next row starts (@p length for the last row)
+*/
+internal_function
+Size scrollbackWrapRow (Scrollback_Layout *layout, const Char *text, Size length,
+                        Size start, F32 x)
+{
+    Size last_break = start;
+
+    for (Size i = start; i < length; ++i) {
+        if (text[i] == ' ') {
+            x += layout->advance[(U8)' '];
+            last_break = i + 1;
+            continue;
+        }
+
+        F32 advance = layout->advance[(U8)text[i]];
+        if ((x + advance > layout->width) && (i > start)) {
+            return (last_break > start) ? last_break : i;
+        }
+        x += advance;
+    }
+
+    return length;
+}
+
+/**
+* @brief Function to check whether the metrics that lines are wrapped with came from a font
+*
+* @param scrollback Scrollback
+* @param font Font (only compared by address)
+* @param scale Scaling applied to the font's advances
+* @param width Width of the pane in screen space
+*
+* @return Are the metrics the same?
+*/
+internal_function
+B32 scrollbackLayoutIs (Scrollback *scrollback, const void *font, F32 scale, F32 width)
+{
+    Scrollback_Layout *layout = &scrollback->layout;
+    // NOTE(naman): The floats are compared bit by bit, since any change at all needs a re-wrap.
+    return ((scrollback->epoch != 0) && (layout->font == font) &&
+            (memcmp(&layout->scale, &scale, sizeof(scale)) == 0) &&
+            (memcmp(&layout->width, &width, sizeof(width)) == 0));
+}
+
+/**
+* @brief Function to change the metrics that lines are wrapped with
+*
+* No line is wrapped here; each one is wrapped again when it is next looked at.
+*
+* @param scrollback Scrollback
+* @param layout Metrics
+*/
+internal_function
+void scrollbackSetLayout (Scrollback *scrollback, Scrollback_Layout *layout)
+{
+    scrollback->layout = *layout;
+    scrollback->epoch++;
+}
+
+/**
+* @brief Function to check whether the row starts of a line are in the ring of breaks
+*
+* @param scrollback Scrollback
+* @param line Line
+*
+* @return Are the row starts cached?
+*/
+internal_function
+B32 scrollbackBreaksValid (Scrollback *scrollback, Scrollback_Line *line)
+{
+    // NOTE(naman): Lines wrapped later write over the row starts of those wrapped earlier.
+    return ((line->epoch == scrollback->epoch) &&
+            (scrollback->breaks_head - line->breaks <= SCROLLBACK_BREAKS));
+}
+
+/**
+* @brief Function to wrap a line, unless it has been wrapped with the current metrics
+*
+* @param scrollback Scrollback (whose layout must be set)
+* @param line Line
+*/
+internal_function
+void scrollbackLayoutLine (Scrollback *scrollback, Scrollback_Line *line)
+{
+    if (scrollbackBreaksValid(scrollback, line)) {
+        return;
+    }
+
+    Scrollback_Layout *layout = &scrollback->layout;
+    const Char *prompt = scrollbackLineText(scrollback, line);
+    U32 prompt_length = scrollbackPromptLength(line);
+    const Char *text = prompt + prompt_length;
+
+    F32 x = scrollbackMeasure(layout, prompt, prompt_length);
+    Size start = 0;
+    U32 rows = 0;
+    line->breaks = scrollback->breaks_head;
+    do {
+        start = scrollbackWrapRow(layout, text, line->text_length, start, x);
+        x = 0;
+        rows++;
+
+        if (start < line->text_length) {
+            scrollback->breaks[scrollback->breaks_head % SCROLLBACK_BREAKS] = (U32)start;
+            scrollback->breaks_head++;
+        }
+    } while (start < line->text_length);
+
+    line->rows = rows;
+    line->epoch = scrollback->epoch;
+}
+
+/**
+* @brief Function to find where a row of a wrapped line ends
+*
+* @param scrollback Scrollback
+* @param line Line (which must have been wrapped with @ref scrollbackLayoutLine)
+* @param row Row
+* @param start Offset in the line's text where @p row starts
+*
+* @return Offset in the line's text where the next row starts
+*/
+internal_function
+Size scrollbackRowEnd (Scrollback *scrollback, Scrollback_Line *line, U32 row, Size start)
+{
+    if (row + 1 >= line->rows) {
+        return line->text_length;
+    }
+
+    if (scrollbackBreaksValid(scrollback, line)) {
+        return scrollback->breaks[(line->breaks + row) % SCROLLBACK_BREAKS];
+    }
+
+    // NOTE(naman): A line with more rows than the ring can hold is wrapped again as it is drawn.
+    const Char *prompt = scrollbackLineText(scrollback, line);
+    U32 prompt_length = scrollbackPromptLength(line);
+    F32 x = (row == 0) ? scrollbackMeasure(&scrollback->layout, prompt, prompt_length) : 0;
+    return scrollbackWrapRow(&scrollback->layout, prompt + prompt_length, line->text_length,
+                             start, x);
+}
+
+/**
+* @brief Function to add a line, dropping the oldest ones if there is no room
+*
+* @param scrollback Scrollback
+* @param prompt Prompt (NULL if the line has none)
+* @param prompt_length Length of @p prompt
+* @param text Text
+* @param text_length Length of @p text
+*/
+internal_function
+void scrollbackPush (Scrollback *scrollback,
+                     const Char *prompt, Size prompt_length,
+                     const Char *text, Size text_length)
+{
+    // NOTE(naman): A line that wouldn't fit in the arena even on its own is cut short.
+    if (prompt_length > scrollback->arena_size) {
+        prompt_length = scrollback->arena_size;
+    }
+    if (prompt_length + text_length > scrollback->arena_size) {
+        text_length = scrollback->arena_size - prompt_length;
+    }
+    U64 size = prompt_length + text_length;
+
+    // NOTE(naman): The text of a line is never split across the end of the arena.
+    U64 offset = scrollback->arena_head;
+    U64 physical = offset % scrollback->arena_size;
+    if (physical + size > scrollback->arena_size) {
+        offset += scrollback->arena_size - physical;
+    }
+
+    while ((scrollback->end - scrollback->first == scrollback->capacity) ||
+           ((scrollback->first < scrollback->end) &&
+            (offset + size > scrollbackLine(scrollback, scrollback->first)->offset +
+             scrollback->arena_size))) {
+        scrollback->first++;
+    }
+
+    Char *destination = scrollback->arena + (offset % scrollback->arena_size);
+    if (prompt != NULL) {
+        memcpy(destination, prompt, prompt_length);
+    }
+    memcpy(destination + prompt_length, text, text_length);
+    scrollback->arena_head = offset + size;
+
+    Scrollback_Line *line = scrollbackLine(scrollback, scrollback->end);
+    line->offset = offset;
+    line->prompt_length = (prompt != NULL) ? (U32)prompt_length : SCROLLBACK_NO_PROMPT;
+    line->text_length = (U32)text_length;
+    line->rows = 1;
+    line->epoch = 0;
+
+    scrollback->end++;
+    scrollback->generation++;
+}
+
+/**
+* @brief Function to remove the newest line
+*
+* @param scrollback Scrollback
+*/
+internal_function
+void scrollbackPop (Scrollback *scrollback)
+{
+    if (scrollback->end == scrollback->first) {
+        return;
+    }
+
+    scrollback->end--;
+    scrollback->arena_head = scrollbackLine(scrollback, scrollback->end)->offset;
+    scrollback->generation++;
+}
@@ -0,0 +1,322 @@
+/**
+ * These functions are called from Lua and are used to hook into the scrollback that is
+ * implemented in the engine. Every scrollback is a userdata owned by the Lua state that created
+ * it, and renders itself, so that only the rows that are on the screen are ever looked at.
+ *
+ * @file scrollback_script.c
+ * @author Team Octal
+ * @brief Lua functions for the scrollback of the terminal
+ */
+
+#define SCROLLBACK_SCRIPT_METATABLE "Engine.Scrollback"
+
+/**
+* @brief Function to get the scrollback passed as the first argument of a method
+*
+* @param l Lua context
+*
+* @return Scrollback
+*/
+internal_function
+Scrollback* scriptScrollbackCheck (lua_State *l)
+{
+    return luaL_checkudata(l, 1, SCROLLBACK_SCRIPT_METATABLE);
+}
+
+/**
+* @brief Lua method which adds a line
+*
+* Called as `scrollback:push(text, prompt)`, where `prompt` is optional.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptScrollbackPush (lua_State *l)
+{
+    Scrollback *scrollback = scriptScrollbackCheck(l);
+    Size text_length = 0;
+    const Char *text = luaL_checklstring(l, 2, &text_length);
+    Size prompt_length = 0;
+    const Char *prompt = luaL_optlstring(l, 3, NULL, &prompt_length);
+
+    scrollbackPush(scrollback, prompt, prompt_length, text, text_length);
+
+    return 0;
+}
+
+/**
+* @brief Lua method which removes the newest line
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptScrollbackPop (lua_State *l)
+{
+    Scrollback *scrollback = scriptScrollbackCheck(l);
+    scrollbackPop(scrollback);
+    return 0;
+}
+
+/**
+* @brief Lua method which returns the text and prompt (or nil) of the newest line
+*
+* Returns nothing if the scrollback is empty.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptScrollbackLast (lua_State *l)
+{
+    Scrollback *scrollback = scriptScrollbackCheck(l);
+    if (scrollback->end == scrollback->first) {
+        return 0;
+    }
+
+    Scrollback_Line *line = scrollbackLine(scrollback, scrollback->end - 1);
+    const Char *prompt = scrollbackLineText(scrollback, line);
+    U32 prompt_length = scrollbackPromptLength(line);
+
+    lua_pushlstring(l, prompt + prompt_length, line->text_length);
+    if (line->prompt_length == SCROLLBACK_NO_PROMPT) {
+        lua_pushnil(l);
+    } else {
+        lua_pushlstring(l, prompt, prompt_length);
+    }
+    return 2;
+}
+
+/**
+* @brief Lua method which returns the number of lines
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptScrollbackCount (lua_State *l)
+{
+    Scrollback *scrollback = scriptScrollbackCheck(l);
+    lua_pushnumber(l, (lua_Number)(scrollback->end - scrollback->first));
+    return 1;
+}
+
+/**
+* @brief Function to read a color argument
+*
+* @param l Lua context
+* @param index Stack index of the color
+* @param color Returns the color (left as is if the argument is nil)
+*/
+internal_function
+void scriptScrollbackColor (lua_State *l, Sint index, Vec3 *color)
+{
+    if (lua_isnoneornil(l, index)) {
+        return;
+    }
+
+    lua_getfield(l, index, "R");
+    color->x = (F32)luaL_checknumber(l, -1);
+    lua_getfield(l, index, "G");
+    color->y = (F32)luaL_checknumber(l, -1);
+    lua_getfield(l, index, "B");
+    color->z = (F32)luaL_checknumber(l, -1);
+    lua_pop(l, 3);
+}
+
+/**
+* @brief Function to render a row of text
+*
+* @param font Font
+* @param text Text
+* @param length Length of @p text
+* @param x Horizontal position in screen space
+* @param y Vertical position in screen space
+* @param color Color
+*/
+internal_function
+void scriptScrollbackRenderRow (Script_Font *font, const Char *text, Size length,
+                                F32 x, F32 y, Vec3 color)
+{
+    if (length == 0) {
+        return;
+    }
+
+    Vec3 screen_pos = {0};
+    screen_pos.x = x;
+    screen_pos.y = y;
+
+    F32 x_ret = 0, y_min = 0, y_max = 0;
+    renderText(font->vao, font->vbo, font->texture, font->program,
+               (Char)font->char_first, (Char)font->char_num,
+               font->bitmap_width, font->bitmap_height,
+               font->baked_char,
+               text, length,
+               screen_pos, color,
+               font->scaling_factor, font->x_scaling,
+               &x_ret, &y_min, &y_max);
+}
+
+/**
+* @brief Lua method which renders the rows that fit in a pane
+*
+* Called as `scrollback:render(font, left, right, rows, row_height, output_color,
+* prompt_color, input_color)`. The text is wrapped to the width between `left` and `right`,
+* and its newest `rows` rows are rendered from the top of the screen down. Lines with a prompt
+* are rendered with `prompt_color` and `input_color` (both default to `output_color`).
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptScrollbackRender (lua_State *l)
+{
+    Scrollback *scrollback = scriptScrollbackCheck(l);
+
+    Script_Font font = {0};
+    if (scriptRenderFont(l, 2, &font) == false) {
+        return luaL_argerror(l, 2, "not a loaded font");
+    }
+
+    F32 left = (F32)luaL_checknumber(l, 3);
+    F32 right = (F32)luaL_checknumber(l, 4);
+    U32 rows = (U32)luaL_checknumber(l, 5);
+    F32 row_height = (F32)luaL_checknumber(l, 6);
+
+    Vec3 output_color = {0};
+    scriptScrollbackColor(l, 7, &output_color);
+    Vec3 prompt_color = output_color;
+    scriptScrollbackColor(l, 8, &prompt_color);
+    Vec3 input_color = output_color;
+    scriptScrollbackColor(l, 9, &input_color);
+
+    // NOTE(naman): The window being resized changes XScaling (and so the scale), and a font
+    // being reloaded changes its character table.
+    F32 scale = font.scaling_factor * font.x_scaling;
+    F32 width = right - left;
+    if (scrollbackLayoutIs(scrollback, font.baked_char, scale, width) == false) {
+        Scrollback_Layout layout = {0};
+        layout.font = font.baked_char;
+        layout.scale = scale;
+        layout.width = width;
+        for (U32 c = 0; c < font.char_num; ++c) {
+            if (font.char_first + c < (sizeof(layout.advance) / sizeof(layout.advance[0]))) {
+                layout.advance[font.char_first + c] = font.baked_char[c].xadvance * scale;
+            }
+        }
+        scrollbackSetLayout(scrollback, &layout);
+    }
+
+    // NOTE(naman): Walk back from the newest line until the screen is full; nothing older
+    // than that is looked at (or wrapped).
+    U64 number = scrollback->end;
+    U32 total = 0;
+    while ((number > scrollback->first) && (total < rows)) {
+        number--;
+        Scrollback_Line *line = scrollbackLine(scrollback, number);
+        scrollbackLayoutLine(scrollback, line);
+        total += line->rows;
+    }
+    U32 skip = (total > rows) ? (total - rows) : 0;
+
+    U32 row = 0;
+    for (; number < scrollback->end; ++number) {
+        Scrollback_Line *line = scrollbackLine(scrollback, number);
+        const Char *prompt = scrollbackLineText(scrollback, line);
+        U32 prompt_length = scrollbackPromptLength(line);
+        const Char *text = prompt + prompt_length;
+        B32 has_prompt = (line->prompt_length != SCROLLBACK_NO_PROMPT);
+
+        // NOTE(naman): Lines wrapped after this one in the walk back may have written over its
+        // row starts.
+        scrollbackLayoutLine(scrollback, line);
+
+        F32 x = scrollbackMeasure(&scrollback->layout, prompt, prompt_length);
+        Size start = 0;
+        for (U32 line_row = 0; line_row < line->rows; ++line_row) {
+            Size next = scrollbackRowEnd(scrollback, line, line_row, start);
+
+            if (line_row >= skip) {
+                F32 y = 1.0f - (F32)(row + 1) * row_height;
+                if ((line_row == 0) && has_prompt) {
+                    scriptScrollbackRenderRow(&font, prompt, prompt_length, left, y,
+                                              prompt_color);
+                }
+                scriptScrollbackRenderRow(&font, text + start, next - start, left + x, y,
+                                          has_prompt ? input_color : output_color);
+                row++;
+            }
+
+            start = next;
+            x = 0;
+        }
+
+        skip = 0;
+    }
+
+    return 0;
+}
+
+/**
+* @brief Lua metamethod which frees a scrollback when it is garbage collected
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptScrollbackGc (lua_State *l)
+{
+    Scrollback *scrollback = scriptScrollbackCheck(l);
+    scrollbackFree(scrollback);
+    return 0;
+}
+
+/**
+* @brief Lua injected function which creates an empty scrollback
+*
+* This function is called from Lua with the maximum number of lines and the maximum number of
+* bytes of text to keep. Its methods are `push`, `pop`, `last`, `count` and `render`.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptScrollbackNew (lua_State *l)
+{
+    U32 capacity = (U32)luaL_checknumber(l, 1);
+    U64 arena_size = (U64)luaL_checknumber(l, 2);
+    luaL_argcheck(l, capacity > 0, 1, "must be positive");
+    luaL_argcheck(l, arena_size > 0, 2, "must be positive");
+
+    Scrollback *scrollback = lua_newuserdata(l, sizeof(*scrollback));
+    scrollbackInit(scrollback, capacity, arena_size);
+
+    if (luaL_newmetatable(l, SCROLLBACK_SCRIPT_METATABLE)) {
+        const luaL_Reg methods[] = {
+            {"push", scriptScrollbackPush},
+            {"pop", scriptScrollbackPop},
+            {"last", scriptScrollbackLast},
+            {"count", scriptScrollbackCount},
+            {"render", scriptScrollbackRender},
+            {NULL, NULL},
+        };
+
+        lua_newtable(l);
+        luaL_register(l, NULL, methods);
+        lua_setfield(l, -2, "__index");
+
+        lua_pushcfunction(l, scriptScrollbackGc);
+        lua_setfield(l, -2, "__gc");
+    }
+    lua_setmetatable(l, -2);
+
+    return 1;
+}
@@ -0,0 +1,1075 @@
+/**
+ * These functions save the state of a game session (the filesystem, the scrollbacks and the
+ * values the scripts keep, like the working directory or the line being typed in) to a file,
+ * and restore it when the game is started again.
+ *
+ * The file is a header (magic, version, size and checksum of the payload) followed by a list
+ * of sections, each of which is a tag and a length, so that sections of unknown kinds can be
+ * skipped. Numbers are varints (seven bits per byte, lowest first). Names and prompts are
+ * interned: each section starts with a table of the distinct strings it uses, and refers to
+ * them by index. The filesystem is stored as its inodes in pre-order, each with the index of
+ * its parent, so it can be rebuilt in one pass, in the order in which children were created.
+ *
+ * Saving is incremental: the encoding of every section is kept, along with the generation of
+ * the object it was made from, and a section is only encoded again once the object has
+ * changed. The file is written by a thread of its own, to which snapshots are handed over; a
+ * snapshot that hasn't been written yet when a newer one comes in is dropped.
+ *
+ * @file session.c
+ * @author Team Octal
+ * @brief Functions for saving and restoring game sessions
+ */
+
+#define SESSION_MAGIC   0x5353544FU /* "OTSS" */
+#define SESSION_VERSION 1U
+
+/**
+* @brief Enumeration of the kinds of sections (the numbers are stored in files)
+*/
+enum Session_Section {
+    SESSION_SECTION_VFS = 1, /**< Filesystem */
+    SESSION_SECTION_TEXT = 2, /**< Scrollback of the terminal */
+    SESSION_SECTION_TUTORIAL_TEXT = 3, /**< Scrollback of the tutorial */
+    SESSION_SECTION_STATE = 4, /**< Values kept by the scripts (encoded by them) */
+    SESSION_SECTION_COUNT,
+};
+
+/**
+* @brief Header stored at the beginning of the session file
+*/
+typedef struct Session_Header {
+    U32 magic; /**< Always @ref SESSION_MAGIC */
+    U32 version; /**< Always @ref SESSION_VERSION */
+    U64 size; /**< Size of the payload that follows the header */
+    U64 checksum; /**< Hash of the payload (see @ref cacheHash) */
+} Session_Header;
+
+/**
+* @brief Growable block of memory that data is encoded into
+*/
+typedef struct Session_Buffer {
+    Byte *data; /**< Bytes */
+    Size length; /**< Number of bytes written */
+    Size capacity; /**< Number of bytes in @ref data */
+} Session_Buffer;
+
+/**
+* @brief Position in a block of memory that data is decoded from
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Session_Reader {
+    const Byte *data; /**< Bytes */
+    Size length; /**< Number of bytes in @ref data */
+    Size position; /**< Offset of the next byte to read */
+    B32 failed; /**< Did a read go past the end, or find a malformed value? */
+} Session_Reader;
+#pragma clang diagnostic pop
+
+/**
+* @brief String in a table of interned strings
+*/
+typedef struct Session_String {
+    const Char *string; /**< String (not owned) */
+    Size length; /**< Length of @ref string */
+    U64 hash; /**< Hash of @ref string */
+} Session_String;
+
+/**
+* @brief Table of interned strings, in the order in which they were first seen
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Session_Intern {
+    Session_String *strings; /**< Strings, indexed by their index */
+    U32 count; /**< Number of strings */
+    U32 capacity; /**< Number of slots in @ref strings */
+    U32 *table; /**< Hash table of indices + 1 (0 for an empty slot) */
+    U32 table_capacity; /**< Number of slots in @ref table (a power of two) */
+} Session_Intern;
+#pragma clang diagnostic pop
+
+/**
+* @brief Encoding of a section, as it was last saved
+*/
+typedef struct Session_Cache {
+    const void *source; /**< Object the encoding was made from (NULL if there is none) */
+    U64 generation; /**< Generation of @ref source when the encoding was made */
+    Session_Buffer encoding; /**< Encoding */
+} Session_Cache;
+
+/**
+* @brief Session, saved in a file of its own
+*/
+typedef struct Session {
+    Char *path; /**< Path of the session file (NULL if sessions are turned off) */
+    Session_Cache caches[SESSION_SECTION_COUNT]; /**< Encoding of every section, by tag */
+} Session;
+
+/**
+* @brief Snapshot waiting to be written by the writer thread
+*/
+typedef struct Session_Write {
+    struct Session_Write *next; /**< Next snapshot in the queue */
+    Char *path; /**< Path of the file to write */
+    Byte *payload; /**< Payload (without the header) */
+    Size size; /**< Size of @ref payload */
+} Session_Write;
+
+/**
+* @brief State of the session subsystem
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+global_variable struct Session_State {
+    B32 enabled; /**< Should sessions be saved and restored? */
+    Session session; /**< Session of the game */
+    SDL_Thread *writer; /**< Thread writing the snapshots (NULL to write them synchronously) */
+    SDL_mutex *mutex; /**< Protects everything below */
+    SDL_cond *wake; /**< Signalled when a snapshot is queued, or the writer should quit */
+    Session_Write *queue; /**< Snapshots waiting to be written, at most one per file */
+    B32 quit; /**< Should the writer exit once the queue is empty? */
+} global_session = {true, {NULL, {{0}}}, NULL, NULL, NULL, NULL, false};
+#pragma clang diagnostic pop
+
+/**
+* @brief Function to make room in a buffer
+*
+* @param buffer Buffer
+* @param size Number of bytes that are about to be written
+*/
+internal_function
+void sessionBufferReserve (Session_Buffer *buffer, Size size)
+{
+    if (buffer->length + size > buffer->capacity) {
+        Size capacity = (buffer->capacity == 0) ? 256 : buffer->capacity;
+        while (buffer->length + size > capacity) {
+            capacity *= 2;
+        }
+        buffer->data = realloc(buffer->data, capacity);
+        buffer->capacity = capacity;
+    }
+}
+
+/**
+* @brief Function to free the memory of a buffer
+*
+* @param buffer Buffer
+*/
+internal_function
+void sessionBufferFree (Session_Buffer *buffer)
+{
+    free(buffer->data);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+/**
+* @brief Function to write bytes to a buffer
+*
+* @param buffer Buffer
+* @param data Bytes
+* @param length Number of bytes
+*/
+internal_function
+void sessionPutBytes (Session_Buffer *buffer, const void *data, Size length)
+{
+    if (length == 0) {
+        return;
+    }
+
+    sessionBufferReserve(buffer, length);
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+}
+
+/**
+* @brief Function to write a number to a buffer, as a varint
+*
+* @param buffer Buffer
+* @param value Number
+*/
+internal_function
+void sessionPutVarint (Session_Buffer *buffer, U64 value)
+{
+    sessionBufferReserve(buffer, 10);
+    while (value >= 0x80) {
+        buffer->data[buffer->length++] = (Byte)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    buffer->data[buffer->length++] = (Byte)value;
+}
+
+/**
+* @brief Function to write a string to a buffer, as its length and its bytes
+*
+* @param buffer Buffer
+* @param string String
+* @param length Length of @p string
+*/
+internal_function
+void sessionPutString (Session_Buffer *buffer, const Char *string, Size length)
+{
+    sessionPutVarint(buffer, length);
+    sessionPutBytes(buffer, string, length);
+}
+
+/**
+* @brief Function passed to @ref vfsContentRead which writes every span to a buffer
+*
+* @param userdata Buffer
+* @param data Span
+* @param length Length of @p data
+*
+* @return Should reading continue?
+*/
+internal_function
+B32 sessionPutSpan (void *userdata, const Byte *data, Size length)
+{
+    sessionPutBytes(userdata, data, length);
+    return true;
+}
+
+/**
+* @brief Function to read a varint
+*
+* @param reader Reader
+*
+* @return Number (0 if it couldn't be read)
+*/
+internal_function
+U64 sessionGetVarint (Session_Reader *reader)
+{
+    U64 value = 0;
+    for (U32 shift = 0; shift < 64; shift += 7) {
+        if (reader->position >= reader->length) {
+            break;
+        }
+
+        Byte byte = reader->data[reader->position++];
+        value |= (U64)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+
+    reader->failed = true;
+    return 0;
+}
+
+/**
+* @brief Function to read bytes
+*
+* @param reader Reader
+* @param length Number of bytes
+*
+* @return Bytes (NULL if there aren't that many left)
+*/
+internal_function
+const Byte* sessionGetBytes (Session_Reader *reader, U64 length)
+{
+    if (reader->failed || (length > reader->length - reader->position)) {
+        reader->failed = true;
+        return NULL;
+    }
+
+    const Byte *bytes = reader->data + reader->position;
+    reader->position += (Size)length;
+    return bytes;
+}
+
+/**
+* @brief Function to read a string written by @ref sessionPutString
+*
+* @param reader Reader
+* @param length Returns the length of the string
+*
+* @return String (not NUL-terminated; NULL if it couldn't be read)
+*/
+internal_function
+const Char* sessionGetString (Session_Reader *reader, Size *length)
+{
+    U64 string_length = sessionGetVarint(reader);
+    const Char *string = (const Char *)sessionGetBytes(reader, string_length);
+    *length = (string == NULL) ? 0 : (Size)string_length;
+    return string;
+}
+
+/**
+* @brief Function to intern a string
+*
+* @param intern Table of interned strings
+* @param string String (which has to outlive the table)
+* @param length Length of @p string
+*
+* @return Index of the string in the table
+*/
+internal_function
+U32 sessionIntern (Session_Intern *intern, const Char *string, Size length)
+{
+    U64 hash = cacheHash(string, length, CACHE_HASH_SEED);
+
+    if (2 * (intern->count + 1) > intern->table_capacity) {
+        free(intern->table);
+        intern->table_capacity = (intern->table_capacity == 0) ? 64 : (intern->table_capacity * 2);
+        intern->table = calloc(intern->table_capacity, sizeof(*intern->table));
+
+        for (U32 i = 0; i < intern->count; ++i) {
+            U32 slot = (U32)intern->strings[i].hash & (intern->table_capacity - 1);
+            while (intern->table[slot] != 0) {
+                slot = (slot + 1) & (intern->table_capacity - 1);
+            }
+            intern->table[slot] = i + 1;
+        }
+    }
+
+    U32 slot = (U32)hash & (intern->table_capacity - 1);
+    while (intern->table[slot] != 0) {
+        Session_String *entry = &intern->strings[intern->table[slot] - 1];
+        if ((entry->hash == hash) && (entry->length == length) &&
+            (memcmp(entry->string, string, length) == 0)) {
+            return intern->table[slot] - 1;
+        }
+        slot = (slot + 1) & (intern->table_capacity - 1);
+    }
+
+    if (intern->count == intern->capacity) {
+        intern->capacity = (intern->capacity == 0) ? 16 : (intern->capacity * 2);
+        intern->strings = realloc(intern->strings, sizeof(*intern->strings) * intern->capacity);
+    }
+
+    Session_String *entry = &intern->strings[intern->count];
+    entry->string = string;
+    entry->length = length;
+    entry->hash = hash;
+    intern->table[slot] = ++intern->count;
+
+    return intern->count - 1;
+}
+
+/**
+* @brief Function to free a table of interned strings
+*
+* @param intern Table of interned strings
+*/
+internal_function
+void sessionInternFree (Session_Intern *intern)
+{
+    free(intern->strings);
+    free(intern->table);
+    memset(intern, 0, sizeof(*intern));
+}
+
+/**
+* @brief Function to encode a filesystem
+*
+* The encoding is the number of distinct names and the names, followed by the number of inodes
+* (besides the root) and, for each of them in pre-order, its kind, the index of its name, the
+* index of its parent (0 for the root, and the position in the pre-order otherwise) and, for
+* files, the contents.
+*
+* @param vfs Filesystem
+* @param buffer Buffer to write the encoding to
+*/
+internal_function
+void sessionEncodeVfs (Vfs *vfs, Session_Buffer *buffer)
+{
+    U32 *order = malloc(sizeof(*order) * vfs->inode_count); // Position in the pre-order, by ID
+    U32 *names = calloc(vfs->atom_count, sizeof(*names)); // Index + 1 of every name, by atom
+    Session_Buffer name_table = {0};
+    Session_Buffer inodes = {0};
+    U32 name_count = 0;
+    U32 inode_count = 0;
+
+    order[VFS_ROOT] = 0;
+    U32 id = vfsInode(vfs, VFS_ROOT)->first_child;
+    while (id != 0) {
+        Vfs_Inode *inode = vfsInode(vfs, id);
+
+        if (names[inode->name] == 0) {
+            names[inode->name] = ++name_count;
+            sessionPutString(&name_table,
+                             vfs->atoms[inode->name].string, vfs->atoms[inode->name].length);
+        }
+
+        order[id] = ++inode_count;
+        sessionPutVarint(&inodes, (inode->kind == VFS_KIND_DIRECTORY) ? 1 : 0);
+        sessionPutVarint(&inodes, names[inode->name] - 1);
+        sessionPutVarint(&inodes, order[inode->parent]);
+        if (inode->kind == VFS_KIND_FILE) {
+            sessionPutVarint(&inodes, inode->content.size);
+            vfsContentRead(&inode->content, 0, inode->content.size, sessionPutSpan, &inodes);
+        }
+
+        if (inode->first_child != 0) {
+            id = inode->first_child;
+        } else {
+            while ((id != VFS_ROOT) && (vfs->inodes[id].next_sibling == 0)) {
+                id = vfs->inodes[id].parent;
+            }
+            id = (id == VFS_ROOT) ? 0 : vfs->inodes[id].next_sibling;
+        }
+    }
+
+    sessionPutVarint(buffer, name_count);
+    sessionPutBytes(buffer, name_table.data, name_table.length);
+    sessionPutVarint(buffer, inode_count);
+    sessionPutBytes(buffer, inodes.data, inodes.length);
+
+    sessionBufferFree(&inodes);
+    sessionBufferFree(&name_table);
+    free(names);
+    free(order);
+}
+
+/**
+* @brief Function to decode a filesystem encoded by @ref sessionEncodeVfs
+*
+* @param reader Reader
+* @param vfs Returns the filesystem (which is left empty on failure)
+*
+* @return success/failure
+*/
+internal_function
+B32 sessionDecodeVfs (Session_Reader *reader, Vfs *vfs)
+{
+    vfsInit(vfs);
+
+    // NOTE(naman): Every name and every inode takes up at least a byte, so counts larger than
+    // what is left of the section are rejected before anything is allocated for them.
+    U64 name_count = sessionGetVarint(reader);
+    if (name_count > reader->length - reader->position) {
+        reader->failed = true;
+    }
+
+    Session_String *names = malloc(sizeof(*names) * (reader->failed ? 1 : (Size)name_count + 1));
+    for (U64 i = 0; (i < name_count) && (reader->failed == false); ++i) {
+        names[i].string = sessionGetString(reader, &names[i].length);
+    }
+
+    U64 inode_count = sessionGetVarint(reader);
+    if (inode_count > reader->length - reader->position) {
+        reader->failed = true;
+    }
+
+    U32 *ids = malloc(sizeof(*ids) * (reader->failed ? 1 : (Size)inode_count + 1));
+    ids[0] = VFS_ROOT;
+    for (U64 i = 1; (i <= inode_count) && (reader->failed == false); ++i) {
+        U64 kind = sessionGetVarint(reader);
+        U64 name = sessionGetVarint(reader);
+        U64 parent = sessionGetVarint(reader);
+        if ((kind > 1) || (name >= name_count) || (parent >= i)) {
+            reader->failed = true;
+            break;
+        }
+
+        if (vfsCreate(vfs, ids[parent], names[name].string, names[name].length,
+                      (kind == 1) ? VFS_KIND_DIRECTORY : VFS_KIND_FILE, &ids[i]) != VFS_OK) {
+            reader->failed = true;
+            break;
+        }
+
+        if (kind == 0) {
+            U64 size = sessionGetVarint(reader);
+            const Byte *data = sessionGetBytes(reader, size);
+            if (data != NULL) {
+                vfsContentAppend(&vfsInode(vfs, ids[i])->content, data, (Size)size);
+            }
+        }
+    }
+
+    free(ids);
+    free(names);
+
+    if (reader->failed) {
+        vfsFree(vfs);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+* @brief Function to encode a scrollback
+*
+* The encoding is the number of distinct prompts and the prompts, followed by the number of
+* lines and, for each of them, the index of its prompt + 1 (0 if it has none) and its text.
+*
+* @param scrollback Scrollback
+* @param buffer Buffer to write the encoding to
+*/
+internal_function
+void sessionEncodeScrollback (Scrollback *scrollback, Session_Buffer *buffer)
+{
+    Session_Intern prompts = {0};
+    Session_Buffer lines = {0};
+
+    for (U64 number = scrollback->first; number < scrollback->end; ++number) {
+        Scrollback_Line *line = scrollbackLine(scrollback, number);
+        const Char *prompt = scrollbackLineText(scrollback, line);
+        U32 prompt_length = scrollbackPromptLength(line);
+
+        if (line->prompt_length == SCROLLBACK_NO_PROMPT) {
+            sessionPutVarint(&lines, 0);
+        } else {
+            sessionPutVarint(&lines, sessionIntern(&prompts, prompt, prompt_length) + 1);
+        }
+        sessionPutString(&lines, prompt + prompt_length, line->text_length);
+    }
+
+    sessionPutVarint(buffer, prompts.count);
+    for (U32 i = 0; i < prompts.count; ++i) {
+        sessionPutString(buffer, prompts.strings[i].string, prompts.strings[i].length);
+    }
+    sessionPutVarint(buffer, scrollback->end - scrollback->first);
+    sessionPutBytes(buffer, lines.data, lines.length);
+
+    sessionBufferFree(&lines);
+    sessionInternFree(&prompts);
+}
+
+/**
+* @brief Function to decode a scrollback encoded by @ref sessionEncodeScrollback
+*
+* @param reader Reader
+* @param scrollback Returns the scrollback (which is left empty on failure)
+* @param capacity Maximum number of lines of the scrollback
+* @param arena_size Maximum number of bytes of text of the scrollback
+*
+* @return success/failure
+*/
+internal_function
+B32 sessionDecodeScrollback (Session_Reader *reader, Scrollback *scrollback,
+                             U32 capacity, U64 arena_size)
+{
+    scrollbackInit(scrollback, capacity, arena_size);
+
+    U64 prompt_count = sessionGetVarint(reader);
+    if (prompt_count > reader->length - reader->position) {
+        reader->failed = true;
+    }
+
+    Session_String *prompts = malloc(sizeof(*prompts) *
+                                     (reader->failed ? 1 : (Size)prompt_count + 1));
+    for (U64 i = 0; (i < prompt_count) && (reader->failed == false); ++i) {
+        prompts[i].string = sessionGetString(reader, &prompts[i].length);
+    }
+
+    U64 line_count = sessionGetVarint(reader);
+    for (U64 i = 0; (i < line_count) && (reader->failed == false); ++i) {
+        U64 prompt = sessionGetVarint(reader);
+        Size text_length = 0;
+        const Char *text = sessionGetString(reader, &text_length);
+        if ((prompt > prompt_count) || (text == NULL)) {
+            reader->failed = true;
+            break;
+        }
+
+        if (prompt == 0) {
+            scrollbackPush(scrollback, NULL, 0, text, text_length);
+        } else {
+            scrollbackPush(scrollback, prompts[prompt - 1].string, prompts[prompt - 1].length,
+                           text, text_length);
+        }
+    }
+
+    free(prompts);
+
+    if (reader->failed) {
+        scrollbackFree(scrollback);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+* @brief Function to write a session file
+*
+* The file is first written to a temporary file which then replaces the old one, so that a
+* crash while writing never leaves a partially written session behind.
+*
+* @param path Path of the file
+* @param payload Payload
+* @param size Size of @p payload
+*
+* @return success/failure
+*/
+internal_function
+B32 sessionWriteFile (const Char *path, const Byte *payload, Size size)
+{
+    Size temp_length = strlen(path) + 32;
+    Char *temp_path = malloc(temp_length);
+    snprintf(temp_path, temp_length, "%s.%ld.tmp", path, (long)getpid());
+
+    B32 result = false;
+    SDL_RWops *rwops = SDL_RWFromFile(temp_path, "wb");
+    if (rwops != NULL) {
+        Session_Header header = {SESSION_MAGIC, SESSION_VERSION, size,
+                                 cacheHash(payload, size, CACHE_HASH_SEED)};
+
+        B32 written = ((SDL_RWwrite(rwops, &header, sizeof(header), 1) == 1) &&
+                       ((size == 0) || (SDL_RWwrite(rwops, payload, size, 1) == 1)));
+        SDL_RWclose(rwops);
+
+        if (written && (rename(temp_path, path) == 0)) {
+            result = true;
+        } else {
+            remove(temp_path);
+        }
+    }
+
+    if (result == false) {
+        logConsole(LOG_LEVEL_WARN,
+                   LOG_CHANNEL_FILE,
+                   "Couldn't write session %s",
+                   path);
+    }
+
+    free(temp_path);
+
+    return result;
+}
+
+/**
+* @brief Entry point of the writer thread
+*
+* @param data Unused
+*
+* @return Exit status of thread
+*/
+internal_function
+Sint sessionWriter (void *data)
+{
+    unused_variable(data);
+
+    SDL_LockMutex(global_session.mutex);
+    while (true) {
+        while ((global_session.queue == NULL) && (global_session.quit == false)) {
+            SDL_CondWait(global_session.wake, global_session.mutex);
+        }
+
+        Session_Write *queue = global_session.queue;
+        global_session.queue = NULL;
+        if ((queue == NULL) && global_session.quit) {
+            break;
+        }
+
+        SDL_UnlockMutex(global_session.mutex);
+        while (queue != NULL) {
+            Session_Write *next = queue->next;
+            sessionWriteFile(queue->path, queue->payload, queue->size);
+            free(queue->path);
+            free(queue->payload);
+            free(queue);
+            queue = next;
+        }
+        SDL_LockMutex(global_session.mutex);
+    }
+    SDL_UnlockMutex(global_session.mutex);
+
+    return 0;
+}
+
+/**
+* @brief Function to hand a snapshot over to the writer thread
+*
+* A snapshot of the same file that is still waiting to be written is replaced. If there is no
+* writer thread, the snapshot is written right away.
+*
+* @param path Path of the file
+* @param payload Payload (taken over by this function)
+* @param size Size of @p payload
+*/
+internal_function
+void sessionQueue (const Char *path, Byte *payload, Size size)
+{
+    if (global_session.writer == NULL) {
+        sessionWriteFile(path, payload, size);
+        free(payload);
+        return;
+    }
+
+    SDL_LockMutex(global_session.mutex);
+
+    Session_Write *write = global_session.queue;
+    while ((write != NULL) && (strcmp(write->path, path) != 0)) {
+        write = write->next;
+    }
+
+    if (write != NULL) {
+        free(write->payload);
+    } else {
+        write = malloc(sizeof(*write));
+        write->path = malloc(strlen(path) + 1);
+        strcpy(write->path, path);
+        write->next = global_session.queue;
+        global_session.queue = write;
+    }
+    write->payload = payload;
+    write->size = size;
+
+    SDL_CondSignal(global_session.wake);
+    SDL_UnlockMutex(global_session.mutex);
+}
+
+/**
+* @brief Function to check whether the cached encoding of a section is out of date
+*
+* An encoding that is out of date is emptied, and tagged with @p source and @p generation,
+* so that the caller can encode the section into it again.
+*
+* @param cache Cache of the section
+* @param source Object the section is encoded from
+* @param generation Generation of @p source
+*
+* @return Does the section have to be encoded again?
+*/
+internal_function
+B32 sessionCacheIsStale (Session_Cache *cache, const void *source, U64 generation)
+{
+    if ((cache->source == source) && (cache->generation == generation)) {
+        return false;
+    }
+
+    cache->source = source;
+    cache->generation = generation;
+    cache->encoding.length = 0;
+    return true;
+}
+
+/**
+* @brief Function to save a session
+*
+* Only the sections whose objects have changed since the last save are encoded again; if none
+* of them have (and neither has @p state), nothing is written. The snapshot is written by the
+* writer thread.
+*
+* @param session Session
+* @param vfs Filesystem
+* @param text Scrollback of the terminal
+* @param tutorial_text Scrollback of the tutorial
+* @param state Values kept by the scripts, as encoded by them
+* @param state_size Size of @p state
+*
+* @return Was a snapshot queued?
+*/
+internal_function
+B32 sessionSave (Session *session, Vfs *vfs, Scrollback *text, Scrollback *tutorial_text,
+                 const Byte *state, Size state_size)
+{
+    if (session->path == NULL) {
+        return false;
+    }
+
+    B32 changed = false;
+
+    Session_Cache *cache = &session->caches[SESSION_SECTION_VFS];
+    if (sessionCacheIsStale(cache, vfs, vfs->generation)) {
+        sessionEncodeVfs(vfs, &cache->encoding);
+        changed = true;
+    }
+
+    cache = &session->caches[SESSION_SECTION_TEXT];
+    if (sessionCacheIsStale(cache, text, text->generation)) {
+        sessionEncodeScrollback(text, &cache->encoding);
+        changed = true;
+    }
+
+    cache = &session->caches[SESSION_SECTION_TUTORIAL_TEXT];
+    if (sessionCacheIsStale(cache, tutorial_text, tutorial_text->generation)) {
+        sessionEncodeScrollback(tutorial_text, &cache->encoding);
+        changed = true;
+    }
+
+    cache = &session->caches[SESSION_SECTION_STATE];
+    if ((cache->source == NULL) || (cache->encoding.length != state_size) ||
+        (memcmp(cache->encoding.data, state, state_size) != 0)) {
+        cache->source = cache;
+        cache->encoding.length = 0;
+        sessionPutBytes(&cache->encoding, state, state_size);
+        changed = true;
+    }
+
+    if (changed == false) {
+        return false;
+    }
+
+    Session_Buffer payload = {0};
+    for (U32 tag = SESSION_SECTION_VFS; tag < SESSION_SECTION_COUNT; ++tag) {
+        sessionPutVarint(&payload, tag);
+        sessionPutVarint(&payload, session->caches[tag].encoding.length);
+        sessionPutBytes(&payload, session->caches[tag].encoding.data,
+                        session->caches[tag].encoding.length);
+    }
+
+    sessionQueue(session->path, payload.data, payload.length);
+
+    return true;
+}
+
+/**
+* @brief Function to read the payload of a session file
+*
+* Missing, corrupt and out-of-date files are all reported as there being no session.
+*
+* @param path Path of the file
+* @param size Returns the size of the payload
+*
+* @return Payload (to be freed by the caller), NULL if there is no session
+*/
+internal_function
+Byte* sessionReadFile (const Char *path, Size *size)
+{
+    SDL_RWops *rwops = SDL_RWFromFile(path, "rb");
+    if (rwops == NULL) {
+        return NULL;
+    }
+
+    Session_Header header = {0};
+    Byte *payload = NULL;
+
+    if ((SDL_RWread(rwops, &header, sizeof(header), 1) == 1) &&
+        (header.magic == SESSION_MAGIC) &&
+        (header.version == SESSION_VERSION) &&
+        ((U64)SDL_RWsize(rwops) == (sizeof(header) + header.size))) {
+        payload = malloc((Size)header.size + 1);
+        if (((header.size != 0) &&
+             (SDL_RWread(rwops, payload, (Size)header.size, 1) != 1)) ||
+            (cacheHash(payload, (Size)header.size, CACHE_HASH_SEED) != header.checksum)) {
+            free(payload);
+            payload = NULL;
+        }
+    }
+
+    SDL_RWclose(rwops);
+
+    if (payload == NULL) {
+        logConsole(LOG_LEVEL_WARN,
+                   LOG_CHANNEL_FILE,
+                   "Ignoring corrupt or out-of-date session %s",
+                   path);
+        return NULL;
+    }
+
+    *size = (Size)header.size;
+    return payload;
+}
+
+/**
+* @brief Function to restore a session
+*
+* The filesystem and the scrollbacks are replaced by the ones in the session file (each one
+* that the file has a section for), but only once the whole file has been decoded; if any of
+* it is malformed, nothing is changed. The scrollbacks keep their capacity.
+*
+* @param session Session
+* @param vfs Filesystem
+* @param text Scrollback of the terminal
+* @param tutorial_text Scrollback of the tutorial
+* @param state Returns a reader over the values kept by the scripts (empty if there are none)
+*
+* @return Payload of the session file, which @p state reads from (to be freed by the caller),
+*         NULL if there is no session to restore
+*/
+internal_function
+Byte* sessionLoad (Session *session, Vfs *vfs, Scrollback *text, Scrollback *tutorial_text,
+                   Session_Reader *state)
+{
+    if (session->path == NULL) {
+        return NULL;
+    }
+
+    U64 counter = SDL_GetPerformanceCounter();
+
+    Size size = 0;
+    Byte *payload = sessionReadFile(session->path, &size);
+    if (payload == NULL) {
+        return NULL;
+    }
+
+    Session_Reader reader = {payload, size, 0, false};
+    memset(state, 0, sizeof(*state));
+
+    Vfs loaded_vfs = {0};
+    Scrollback loaded_texts[2] = {0};
+    Scrollback *texts[2] = {text, tutorial_text};
+    B32 decoded[SESSION_SECTION_COUNT] = {0};
+
+    while ((reader.position < reader.length) && (reader.failed == false)) {
+        U64 tag = sessionGetVarint(&reader);
+        U64 length = sessionGetVarint(&reader);
+        const Byte *data = sessionGetBytes(&reader, length);
+        if (data == NULL) {
+            break;
+        }
+
+        // NOTE(naman): Sections of kinds that are unknown (written by a newer version) are
+        // skipped.
+        if ((tag == 0) || (tag >= SESSION_SECTION_COUNT)) {
+            continue;
+        }
+        if (decoded[tag]) {
+            reader.failed = true;
+            break;
+        }
+
+        Session_Reader section = {data, (Size)length, 0, false};
+        switch ((enum Session_Section)tag) {
+        case SESSION_SECTION_VFS: {
+            decoded[tag] = sessionDecodeVfs(&section, &loaded_vfs);
+        } break;
+        case SESSION_SECTION_TEXT:
+        case SESSION_SECTION_TUTORIAL_TEXT: {
+            U32 index = (tag == SESSION_SECTION_TEXT) ? 0 : 1;
+            decoded[tag] = sessionDecodeScrollback(&section, &loaded_texts[index],
+                                                   texts[index]->capacity,
+                                                   texts[index]->arena_size);
+        } break;
+        case SESSION_SECTION_STATE: {
+            *state = section;
+            decoded[tag] = true;
+        } break;
+        case SESSION_SECTION_COUNT:
+            break;
+        }
+
+        if (decoded[tag] == false) {
+            reader.failed = true;
+        }
+    }
+
+    if (reader.failed) {
+        if (decoded[SESSION_SECTION_VFS]) {
+            vfsFree(&loaded_vfs);
+        }
+        for (U32 i = 0; i < 2; ++i) {
+            if (decoded[SESSION_SECTION_TEXT + i]) {
+                scrollbackFree(&loaded_texts[i]);
+            }
+        }
+        free(payload);
+        memset(state, 0, sizeof(*state));
+
+        logConsole(LOG_LEVEL_WARN,
+                   LOG_CHANNEL_FILE,
+                   "Ignoring malformed session %s",
+                   session->path);
+        return NULL;
+    }
+
+    if (decoded[SESSION_SECTION_VFS]) {
+        vfsFree(vfs);
+        *vfs = loaded_vfs;
+    }
+    for (U32 i = 0; i < 2; ++i) {
+        if (decoded[SESSION_SECTION_TEXT + i]) {
+            scrollbackFree(texts[i]);
+            *texts[i] = loaded_texts[i];
+        }
+    }
+
+    // NOTE(naman): The objects were replaced in place, so their addresses say nothing about
+    // whether the cached encodings are still good.
+    for (U32 i = 0; i < SESSION_SECTION_COUNT; ++i) {
+        session->caches[i].source = NULL;
+    }
+
+    logConsole(LOG_LEVEL_INFO,
+               LOG_CHANNEL_FILE,
+               "Restored session %s (%llu bytes) in %.3f ms",
+               session->path, (unsigned long long)size, timeMicrosecondsElapsed(&counter) / 1000.0);
+
+    return payload;
+}
+
+/**
+* @brief Function to free the cached encodings of a session
+*
+* @param session Session
+*/
+internal_function
+void sessionFree (Session *session)
+{
+    for (U32 i = 0; i < SESSION_SECTION_COUNT; ++i) {
+        sessionBufferFree(&session->caches[i].encoding);
+    }
+    free(session->path);
+    memset(session, 0, sizeof(*session));
+}
+
+/**
+* @brief Function to initialize the session subsystem
+*
+* This finds the file the game's session is kept in and starts the writer thread. If there is
+* no writable directory, sessions get turned off.
+*
+* @return success/failure
+*/
+internal_function
+B32 sessionInit (void)
+{
+    if (global_session.enabled == false) {
+        return true;
+    }
+
+    Char *pref_path = SDL_GetPrefPath("Octal", "CS699");
+    if (pref_path == NULL) {
+        logConsole(LOG_LEVEL_WARN,
+                   LOG_CHANNEL_FILE,
+                   "Sessions disabled, no writable directory: %s",
+                   SDL_GetError());
+        global_session.enabled = false;
+        return false;
+    }
+
+    Size length = strlen(pref_path) + strlen("session.bin") + 1;
+    global_session.session.path = malloc(length);
+    strcpy(global_session.session.path, pref_path);
+    strcat(global_session.session.path, "session.bin");
+    SDL_free(pref_path);
+
+    global_session.mutex = SDL_CreateMutex();
+    global_session.wake = SDL_CreateCond();
+    global_session.writer = SDL_CreateThread(sessionWriter, "Session Writer", NULL);
+    if (global_session.writer == NULL) {
+        logConsole(LOG_LEVEL_WARN,
+                   LOG_CHANNEL_FILE,
+                   "Couldn't create session writer thread, writing synchronously: %s",
+                   SDL_GetError());
+    }
+
+    logConsole(LOG_LEVEL_INFO,
+               LOG_CHANNEL_FILE,
+               "Session file: %s",
+               global_session.session.path);
+
+    return true;
+}
+
+/**
+* @brief Function to stop the session subsystem
+*
+* This writes out the snapshots still waiting in the queue before returning.
+*/
+internal_function
+void sessionShutdown (void)
+{
+    if (global_session.writer != NULL) {
+        SDL_LockMutex(global_session.mutex);
+        global_session.quit = true;
+        SDL_CondSignal(global_session.wake);
+        SDL_UnlockMutex(global_session.mutex);
+
+        SDL_WaitThread(global_session.writer, NULL);
+        global_session.writer = NULL;
+    }
+
+    if (global_session.mutex != NULL) {
+        SDL_DestroyCond(global_session.wake);
+        SDL_DestroyMutex(global_session.mutex);
+        global_session.wake = NULL;
+        global_session.mutex = NULL;
+    }
+
+    sessionFree(&global_session.session);
+}
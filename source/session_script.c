@@ -0,0 +1,243 @@
+/**
+ * These functions are called from Lua and are used to save the game's session and restore it
+ * when the game is started again. The values the scripts keep are passed as a flat table,
+ * whose keys are strings and whose values are strings, numbers or booleans; it is encoded
+ * here, into the state section of the session.
+ *
+ * A Lua state saves to the game's session, unless it was given a session of its own with
+ * @ref scriptSessionSet (as the sessions run by the headless host are).
+ *
+ * @file session_script.c
+ * @author Team Octal
+ * @brief Lua functions for saving and restoring game sessions
+ */
+
+global_variable Char script_session_key; /* Address used as the registry key of the session */
+global_variable Char script_session_sources_key; /* Address used as the registry key of the
+                                                    objects the last save was made from */
+
+/**
+* @brief Enumeration of the kinds of values in the state section (the numbers are stored in
+* files)
+*/
+enum Session_Value {
+    SESSION_VALUE_STRING = 1,
+    SESSION_VALUE_NUMBER = 2,
+    SESSION_VALUE_BOOLEAN = 3,
+};
+
+/**
+* @brief Function to give a Lua state a session of its own
+*
+* @param l Lua context
+* @param session Session (which has to outlive @p l)
+*/
+internal_function
+void scriptSessionSet (lua_State *l, Session *session)
+{
+    lua_pushlightuserdata(l, &script_session_key);
+    lua_pushlightuserdata(l, session);
+    lua_rawset(l, LUA_REGISTRYINDEX);
+}
+
+/**
+* @brief Function to get the session of a Lua state
+*
+* @param l Lua context
+*
+* @return Session (the game's, if the state wasn't given one of its own)
+*/
+internal_function
+Session* scriptSessionGet (lua_State *l)
+{
+    lua_pushlightuserdata(l, &script_session_key);
+    lua_rawget(l, LUA_REGISTRYINDEX);
+    Session *session = lua_touserdata(l, -1);
+    lua_pop(l, 1);
+    return (session != NULL) ? session : &global_session.session;
+}
+
+/**
+* @brief Function to encode the table of values kept by the scripts
+*
+* @param l Lua context
+* @param index Stack index of the table
+* @param buffer Buffer to write the encoding to
+*/
+internal_function
+void scriptSessionEncodeState (lua_State *l, Sint index, Session_Buffer *buffer)
+{
+    U64 count = 0;
+    Session_Buffer entries = {0};
+
+    lua_pushnil(l);
+    while (lua_next(l, index) != 0) {
+        if (lua_type(l, -2) != LUA_TSTRING) {
+            sessionBufferFree(&entries);
+            luaL_argerror(l, index, "keys must be strings");
+        }
+
+        Size length = 0;
+        const Char *key = lua_tolstring(l, -2, &length);
+        sessionPutString(&entries, key, length);
+
+        switch (lua_type(l, -1)) {
+        case LUA_TSTRING: {
+            const Char *string = lua_tolstring(l, -1, &length);
+            sessionPutVarint(&entries, SESSION_VALUE_STRING);
+            sessionPutString(&entries, string, length);
+        } break;
+        case LUA_TNUMBER: {
+            F64 number = (F64)lua_tonumber(l, -1);
+            sessionPutVarint(&entries, SESSION_VALUE_NUMBER);
+            sessionPutBytes(&entries, &number, sizeof(number));
+        } break;
+        case LUA_TBOOLEAN: {
+            sessionPutVarint(&entries, SESSION_VALUE_BOOLEAN);
+            sessionPutVarint(&entries, (U64)lua_toboolean(l, -1));
+        } break;
+        default: {
+            sessionBufferFree(&entries);
+            luaL_argerror(l, index, "values must be strings, numbers or booleans");
+        } break;
+        }
+
+        count++;
+        lua_pop(l, 1);
+    }
+
+    sessionPutVarint(buffer, count);
+    sessionPutBytes(buffer, entries.data, entries.length);
+    sessionBufferFree(&entries);
+}
+
+/**
+* @brief Function to push the table of values kept by the scripts
+*
+* @param l Lua context
+* @param reader Reader over the state section
+*
+* @return success/failure (nothing is pushed on failure)
+*/
+internal_function
+B32 scriptSessionDecodeState (lua_State *l, Session_Reader *reader)
+{
+    lua_newtable(l);
+
+    U64 count = (reader->length == 0) ? 0 : sessionGetVarint(reader);
+    for (U64 i = 0; (i < count) && (reader->failed == false); ++i) {
+        Size length = 0;
+        const Char *key = sessionGetString(reader, &length);
+        if (key == NULL) {
+            break;
+        }
+        lua_pushlstring(l, key, length);
+
+        switch (sessionGetVarint(reader)) {
+        case SESSION_VALUE_STRING: {
+            const Char *string = sessionGetString(reader, &length);
+            lua_pushlstring(l, (string == NULL) ? "" : string, length);
+        } break;
+        case SESSION_VALUE_NUMBER: {
+            F64 number = 0;
+            const Byte *bytes = sessionGetBytes(reader, sizeof(number));
+            if (bytes != NULL) {
+                memcpy(&number, bytes, sizeof(number));
+            }
+            lua_pushnumber(l, (lua_Number)number);
+        } break;
+        case SESSION_VALUE_BOOLEAN: {
+            lua_pushboolean(l, sessionGetVarint(reader) != 0);
+        } break;
+        default: {
+            reader->failed = true;
+            lua_pushnil(l);
+        } break;
+        }
+
+        lua_rawset(l, -3);
+    }
+
+    if (reader->failed) {
+        lua_pop(l, 1);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+* @brief Lua injected function which saves the session
+*
+* This function is called from Lua with the filesystem, the scrollback of the terminal, the
+* scrollback of the tutorial and the table of values to keep. It returns whether a snapshot
+* was queued, which it isn't if nothing changed since the last save (or sessions are off).
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptSessionSave (lua_State *l)
+{
+    Vfs *vfs = luaL_checkudata(l, 1, VFS_SCRIPT_METATABLE);
+    Scrollback *text = luaL_checkudata(l, 2, SCROLLBACK_SCRIPT_METATABLE);
+    Scrollback *tutorial_text = luaL_checkudata(l, 3, SCROLLBACK_SCRIPT_METATABLE);
+    luaL_checktype(l, 4, LUA_TTABLE);
+
+    Session_Buffer state = {0};
+    scriptSessionEncodeState(l, 4, &state);
+
+    B32 queued = sessionSave(scriptSessionGet(l), vfs, text, tutorial_text,
+                             state.data, state.length);
+    sessionBufferFree(&state);
+
+    // NOTE(naman): The cached encodings are keyed by the address of the objects, so those are
+    // kept alive (and their addresses from being reused) until the next save.
+    lua_pushlightuserdata(l, &script_session_sources_key);
+    lua_createtable(l, 3, 0);
+    for (Sint i = 1; i <= 3; ++i) {
+        lua_pushvalue(l, i);
+        lua_rawseti(l, -2, i);
+    }
+    lua_rawset(l, LUA_REGISTRYINDEX);
+
+    lua_pushboolean(l, queued);
+    return 1;
+}
+
+/**
+* @brief Lua injected function which restores the session saved when the game was last closed
+*
+* This function is called from Lua with the filesystem, the scrollback of the terminal and the
+* scrollback of the tutorial, which are replaced in place by the saved ones. It returns the
+* table of values that was passed to the last save, or nil if there is no session to restore
+* (in which case nothing is changed).
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptSessionLoad (lua_State *l)
+{
+    Vfs *vfs = luaL_checkudata(l, 1, VFS_SCRIPT_METATABLE);
+    Scrollback *text = luaL_checkudata(l, 2, SCROLLBACK_SCRIPT_METATABLE);
+    Scrollback *tutorial_text = luaL_checkudata(l, 3, SCROLLBACK_SCRIPT_METATABLE);
+
+    Session_Reader state = {0};
+    Byte *payload = sessionLoad(scriptSessionGet(l), vfs, text, tutorial_text, &state);
+    if (payload == NULL) {
+        lua_pushnil(l);
+        return 1;
+    }
+
+    // NOTE(naman): By now the filesystem and the scrollbacks have been replaced, so a
+    // malformed state section only loses the values in it.
+    if (scriptSessionDecodeState(l, &state) == false) {
+        lua_newtable(l);
+    }
+    free(payload);
+
+    return 1;
+}
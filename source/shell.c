@@ -0,0 +1,315 @@
+/**
+ * These functions parse the command lines typed into the terminal: a tokenizer that splits a
+ * line into words and operators, and a POSIX style option parser for the words of a command.
+ * Both make a single pass over their input, writing into arrays supplied by the caller.
+ *
+ * @file shell.c
+ * @author Team Octal
+ * @brief Functions for parsing command lines
+ */
+
+/**
+* @brief Enumeration of the kinds of tokens
+*/
+enum Shell_Token_Kind {
+    SHELL_TOKEN_WORD,
+    SHELL_TOKEN_BACKGROUND, /**< & */
+    SHELL_TOKEN_SEQUENCE, /**< && */
+    SHELL_TOKEN_OUTPUT, /**< > */
+    SHELL_TOKEN_APPEND, /**< >> */
+    SHELL_TOKEN_INPUT, /**< < */
+    SHELL_TOKEN_HEREDOC, /**< << */
+    SHELL_TOKEN_PIPE, /**< | */
+};
+
+/**
+* @brief Token of a command line
+*/
+typedef struct Shell_Token {
+    enum Shell_Token_Kind kind; /**< Kind of token */
+    U32 offset; /**< Offset of the token's text (with quotes and escapes removed) */
+    U32 length; /**< Length of the token's text */
+    B32 glob; /**< Does the word have wildcards? (If so, its text keeps escapes; see below) */
+} Shell_Token;
+
+/**
+* @brief Enumeration of the errors of the option parser
+*/
+enum Shell_GetOpt_Error {
+    SHELL_GETOPT_OK,
+    SHELL_GETOPT_ERROR_INVALID, /**< An option isn't a letter or digit */
+    SHELL_GETOPT_ERROR_NO_VALUE, /**< An option that takes a value wasn't given one */
+};
+
+/**
+* @brief Option found by the option parser
+*/
+typedef struct Shell_Option {
+    const Char *name; /**< Name (pointing into the words) */
+    Size name_length; /**< Length of @ref name */
+    const Char *value; /**< Value (pointing into the words; NULL for options without one) */
+    Size value_length; /**< Length of @ref value */
+} Shell_Option;
+
+/**
+* @brief Function to check whether a character separates tokens
+*
+* @param c Character
+*
+* @return Is the character whitespace?
+*/
+internal_function
+B32 shellIsSpace (Char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r') || (c == '\f');
+}
+
+/**
+* @brief Function to check whether a character starts an operator
+*
+* @param c Character
+*
+* @return Is the character an operator?
+*/
+internal_function
+B32 shellIsOperator (Char c)
+{
+    return (c == '&') || (c == '>') || (c == '<') || (c == '|');
+}
+
+/**
+* @brief Function to check whether a character means something in a glob pattern
+*
+* @param c Character
+*
+* @return Is the character a wildcard (or a backslash, which escapes one)?
+*/
+internal_function
+B32 shellIsGlob (Char c)
+{
+    return (c == '*') || (c == '?') || (c == '[') || (c == ']') || (c == '\\');
+}
+
+/**
+* @brief Function to split a command line into tokens
+*
+* Words are separated by whitespace and operators. Inside a word, a backslash escapes the next
+* character and double quotes group characters (including whitespace and operators) into it.
+* The operators are &, &&, >, >>, <, << and |.
+*
+* A word with a wildcard (*, ? or [) that is neither quoted nor escaped is a glob pattern. Its
+* text keeps a backslash in front of every quoted or escaped character that means something in
+* a pattern, so that the pattern matches them literally.
+*
+* @param line Command line
+* @param length Length of @p line
+* @param tokens Returns the tokens (must have room for @p length tokens)
+* @param text Returns the text of the tokens (must have room for 2 * @p length characters)
+*
+* @return Number of tokens
+*/
+internal_function
+Size shellTokenize (const Char *line, Size length, Shell_Token *tokens, Char *text)
+{
+    Size count = 0;
+    Size written = 0;
+    Size i = 0;
+
+    while (true) {
+        while ((i < length) && shellIsSpace(line[i])) {
+            i++;
+        }
+        if (i >= length) {
+            break;
+        }
+
+        Shell_Token *token = &tokens[count++];
+        token->offset = (U32)written;
+        token->glob = false;
+
+        if (shellIsOperator(line[i])) {
+            Char c = line[i];
+            B32 doubled = (c != '|') && (i + 1 < length) && (line[i + 1] == c);
+
+            switch (c) {
+            case '&':
+                token->kind = doubled ? SHELL_TOKEN_SEQUENCE : SHELL_TOKEN_BACKGROUND;
+                break;
+            case '>':
+                token->kind = doubled ? SHELL_TOKEN_APPEND : SHELL_TOKEN_OUTPUT;
+                break;
+            case '|':
+                token->kind = SHELL_TOKEN_PIPE;
+                break;
+            default:
+                token->kind = doubled ? SHELL_TOKEN_HEREDOC : SHELL_TOKEN_INPUT;
+                break;
+            }
+
+            text[written++] = c;
+            i++;
+            if (doubled) {
+                text[written++] = c;
+                i++;
+            }
+        } else {
+            token->kind = SHELL_TOKEN_WORD;
+            B32 escaped = false;
+
+            // NOTE(naman): Quoted and escaped characters that mean something in a pattern are
+            // written with a backslash in front, which is taken out again at the end if the
+            // word turns out not to be a pattern.
+            while ((i < length) && !shellIsSpace(line[i]) && !shellIsOperator(line[i])) {
+                if (line[i] == '"') {
+                    i++;
+                    while ((i < length) && (line[i] != '"')) {
+                        if ((line[i] == '\\') && (i + 1 < length)) {
+                            i++;
+                        }
+                        if (shellIsGlob(line[i])) {
+                            text[written++] = '\\';
+                            escaped = true;
+                        }
+                        text[written++] = line[i++];
+                    }
+                    i++; // NOTE(naman): Skip the closing quote (or go past the end, if missing)
+                } else if (line[i] == '\\') {
+                    i++;
+                    if (i < length) {
+                        if (shellIsGlob(line[i])) {
+                            text[written++] = '\\';
+                            escaped = true;
+                        }
+                        text[written++] = line[i++];
+                    }
+                } else {
+                    if ((line[i] == '*') || (line[i] == '?') || (line[i] == '[')) {
+                        token->glob = true;
+                    }
+                    text[written++] = line[i++];
+                }
+            }
+
+            if (escaped && (token->glob == false)) {
+                Size end = written;
+                written = token->offset;
+                for (Size j = token->offset; j < end; ++j) {
+                    if (text[j] == '\\') {
+                        j++;
+                    }
+                    text[written++] = text[j];
+                }
+            }
+        }
+
+        token->length = (U32)written - token->offset;
+    }
+
+    return count;
+}
+
+/**
+* @brief Function to check whether a character can be a short option
+*
+* @param c Character
+*
+* @return Is the character a letter or digit?
+*/
+internal_function
+B32 shellIsOptionName (Char c)
+{
+    return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || ((c >= '0') && (c <= '9'));
+}
+
+/**
+* @brief Function to parse the options of a command
+*
+* The first word is the command. The rest are options and arguments, in the styles:
+*   -a one  ==> a = "one" (if 'a' is in @p spec)
+*   -aone   ==> a = "one" (if 'a' is in @p spec)
+*   -cd     ==> c, d
+*   --c=one ==> c = "one"
+*   --c     ==> c
+*   --      ==> everything after is an argument
+*
+* @param count Number of words
+* @param words Words
+* @param lengths Lengths of @p words
+* @param spec Letters of the options that take a value
+* @param options Returns the options (must have room for as many as there are characters)
+* @param option_count Returns the number of options
+* @param arguments Returns the indices of the arguments (must have room for @p count)
+* @param argument_count Returns the number of arguments
+* @param culprit Returns the option that caused an error
+*
+* @return Error
+*/
+internal_function
+enum Shell_GetOpt_Error shellGetOpt (Size count, const Char **words, const Size *lengths,
+                                     const Char *spec,
+                                     Shell_Option *options, Size *option_count,
+                                     Size *arguments, Size *argument_count,
+                                     Char *culprit)
+{
+    *option_count = 0;
+    *argument_count = 0;
+    B32 only_arguments = false;
+
+    for (Size i = 1; i < count; ++i) {
+        const Char *word = words[i];
+        Size length = lengths[i];
+
+        if (only_arguments || (length < 2) || (word[0] != '-')) {
+            arguments[(*argument_count)++] = i;
+        } else if (word[1] == '-') {
+            if (length == 2) {
+                only_arguments = true;
+                continue;
+            }
+
+            Shell_Option *option = &options[(*option_count)++];
+            option->name = word + 2;
+            option->value = NULL;
+            option->value_length = 0;
+
+            const Char *equals = memchr(word + 2, '=', length - 2);
+            if (equals != NULL) {
+                option->name_length = (Size)(equals - option->name);
+                option->value = equals + 1;
+                option->value_length = length - (Size)(option->value - word);
+            } else {
+                option->name_length = length - 2;
+            }
+        } else {
+            for (Size j = 1; j < length; ++j) {
+                if (shellIsOptionName(word[j]) == false) {
+                    *culprit = word[j];
+                    return SHELL_GETOPT_ERROR_INVALID;
+                }
+
+                Shell_Option *option = &options[(*option_count)++];
+                option->name = word + j;
+                option->name_length = 1;
+                option->value = NULL;
+                option->value_length = 0;
+
+                if (strchr(spec, word[j]) != NULL) {
+                    if (j + 1 < length) {
+                        option->value = word + j + 1;
+                        option->value_length = length - j - 1;
+                    } else if ((i + 1 < count) && (words[i + 1][0] != '-')) {
+                        i++;
+                        option->value = words[i];
+                        option->value_length = lengths[i];
+                    } else {
+                        *culprit = word[j];
+                        return SHELL_GETOPT_ERROR_NO_VALUE;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    return SHELL_GETOPT_OK;
+}
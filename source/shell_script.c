@@ -0,0 +1,138 @@
+/**
+ * These functions are called from Lua and are used to parse the command lines typed into the
+ * terminal with the parsers implemented in the engine.
+ *
+ * @file shell_script.c
+ * @author Team Octal
+ * @brief Lua functions for parsing command lines
+ */
+
+/**
+* @brief Lua injected function which splits a command line into tokens
+*
+* This function is called from Lua with a command line, and returns two arrays: the text of
+* every token, and its kind ("word", "glob", "&", "&&", ">", ">>", "<", "<<" or "|"). An
+* operator in quotes is a word, not an operator. A "glob" is a word with wildcards, to be
+* expanded (see @ref shellTokenize).
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptShellTokenize (lua_State *l)
+{
+    Size length = 0;
+    const Char *line = luaL_checklstring(l, 1, &length);
+
+    // NOTE(naman): Every token takes up at least one character of the line, and the text of a
+    // token is at most twice as long as the characters it came from (when every one of them
+    // gets a backslash); so neither array can overflow.
+    Shell_Token *tokens = lua_newuserdata(l, (length * sizeof(*tokens)) + (2 * length));
+    Char *text = (Char *)(tokens + length);
+    Size count = shellTokenize(line, length, tokens, text);
+
+    lua_createtable(l, (Sint)count, 0);
+    lua_createtable(l, (Sint)count, 0);
+    for (Size i = 0; i < count; ++i) {
+        lua_pushlstring(l, text + tokens[i].offset, tokens[i].length);
+        lua_rawseti(l, -3, (Sint)i + 1);
+
+        if ((tokens[i].kind == SHELL_TOKEN_WORD) && tokens[i].glob) {
+            lua_pushliteral(l, "glob");
+        } else if (tokens[i].kind == SHELL_TOKEN_WORD) {
+            lua_pushliteral(l, "word");
+        } else {
+            lua_pushlstring(l, text + tokens[i].offset, tokens[i].length);
+        }
+        lua_rawseti(l, -2, (Sint)i + 1);
+    }
+
+    return 2;
+}
+
+/**
+* @brief Lua injected function which parses the options of a command
+*
+* This function is called from Lua with an array of words (the first being the command) and
+* optionally a string of the letters of the options that take a value. It returns a table like
+*   {command = "ls", pars = {["a"] = true, ["sort"] = "size"}, args = {"/home"}}
+* or nil and an error message.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptShellGetOpt (lua_State *l)
+{
+    luaL_checktype(l, 1, LUA_TTABLE);
+    const Char *spec = luaL_optstring(l, 2, "");
+
+    Size count = lua_objlen(l, 1);
+    const Char **words = lua_newuserdata(l, count * sizeof(*words));
+    Size *lengths = lua_newuserdata(l, count * sizeof(*lengths));
+    Size *arguments = lua_newuserdata(l, count * sizeof(*arguments));
+
+    Size characters = 0;
+    for (Size i = 0; i < count; ++i) {
+        lua_rawgeti(l, 1, (Sint)i + 1);
+        if (lua_type(l, -1) != LUA_TSTRING) {
+            return luaL_argerror(l, 1, "words must be strings");
+        }
+        // NOTE(naman): The string stays alive after being popped, since the table refers to it.
+        words[i] = lua_tolstring(l, -1, &lengths[i]);
+        characters += lengths[i];
+        lua_pop(l, 1);
+    }
+
+    Shell_Option *options = lua_newuserdata(l, characters * sizeof(*options));
+    Size option_count = 0;
+    Size argument_count = 0;
+    Char culprit = 0;
+
+    enum Shell_GetOpt_Error error = shellGetOpt(count, words, lengths, spec,
+                                                options, &option_count,
+                                                arguments, &argument_count,
+                                                &culprit);
+    switch (error) {
+    case SHELL_GETOPT_ERROR_INVALID:
+        lua_pushnil(l);
+        lua_pushfstring(l, "Wrong parameter \"%c\" used", culprit);
+        return 2;
+    case SHELL_GETOPT_ERROR_NO_VALUE:
+        lua_pushnil(l);
+        lua_pushfstring(l, "No arguments provided for %c", culprit);
+        return 2;
+    case SHELL_GETOPT_OK:
+        break;
+    }
+
+    lua_createtable(l, 0, 3);
+
+    if (count > 0) {
+        lua_pushlstring(l, words[0], lengths[0]);
+        lua_setfield(l, -2, "command");
+    }
+
+    lua_createtable(l, 0, (Sint)option_count);
+    for (Size i = 0; i < option_count; ++i) {
+        lua_pushlstring(l, options[i].name, options[i].name_length);
+        if (options[i].value != NULL) {
+            lua_pushlstring(l, options[i].value, options[i].value_length);
+        } else {
+            lua_pushboolean(l, true);
+        }
+        lua_rawset(l, -3);
+    }
+    lua_setfield(l, -2, "pars");
+
+    lua_createtable(l, (Sint)argument_count, 0);
+    for (Size i = 0; i < argument_count; ++i) {
+        lua_pushlstring(l, words[arguments[i]], lengths[arguments[i]]);
+        lua_rawseti(l, -2, (Sint)i + 1);
+    }
+    lua_setfield(l, -2, "args");
+
+    return 1;
+}
@@ -3,11 +3,24 @@
  * then used in various synchronized actrivities such as animation. In the current program,
  * the only place we make use of timing is during the blinking of cursor.
  *
+ * Frames are paced by a scheduler which sleeps until just before each frame's deadline, as
+ * estimated from how long the recent frames took, so that input is sampled as late as possible.
+ *
+ * The game is simulated at a fixed tick, independent of the frame rate: the real time that
+ * passes is accumulated, and as many updates are run each frame as there are whole ticks in it.
+ * Rendering is skipped when the simulation falls behind, so that input is still processed on
+ * time on a slow GPU.
+ *
  * @file time.c
  * @author Team Octal
  * @brief Functions for timing
  */
 
+#define TIME_FRAME_MARGIN 1500.0 /* Microseconds of slack left before each frame deadline */
+#define TIME_TICK_MAX_PER_FRAME 8 /* Most updates run in a single frame */
+#define TIME_TICK_MAX_BACKLOG 250000.0 /* Most microseconds of simulation that can be owed */
+#define TIME_MAX_RENDER_SKIPS 3 /* Most consecutive frames that can be left unrendered */
+
 /**
 * @brief Function to compute elapsed time
 *
@@ -27,3 +40,262 @@ F64 timeMicrosecondsElapsed (U64 *last_counter)
     *last_counter = new_counter;
     return time_gap;
 }
+
+/**
+* @brief Function to sleep until a given time
+*
+* It sleeps through the OS for as long as it safely can, and then yields until the time
+* comes, since the OS sleep can overshoot by a millisecond or more.
+*
+* @param counter Performance counter value to wake up at
+*/
+internal_function
+void timeSleepUntil (U64 counter)
+{
+    U64 freq = SDL_GetPerformanceFrequency();
+
+    while (true) {
+        U64 now = SDL_GetPerformanceCounter();
+        if (now >= counter) {
+            break;
+        }
+
+        F64 remaining_ms = (1000.0 * (F64)(counter - now)) / (F64)freq;
+        if (remaining_ms > 2.0) {
+            SDL_Delay((U32)(remaining_ms - 1.5));
+        } else {
+            SDL_Delay(0);
+        }
+    }
+}
+
+/**
+* @brief Function to set up the frame scheduler
+*
+* The frame period is the longer of the display's refresh period (if V-Sync is on) and the
+* period of the FPS cap (if any). With neither, frames are not paced at all.
+*
+* @param time Timing state
+* @param refresh_rate Refresh rate of the display (0 if unknown)
+* @param vsync Is V-Sync on?
+* @param fps_cap Maximum frames per second (0 for no cap)
+*/
+internal_function
+void timeFrameInit (System_Time *time, S32 refresh_rate, B32 vsync, U32 fps_cap)
+{
+    time->frame_period = 0;
+
+    if (vsync) {
+        time->frame_period = 1000000.0 / ((refresh_rate > 0) ? (F64)refresh_rate : 60.0);
+    }
+
+    if (fps_cap > 0) {
+        F64 cap_period = 1000000.0 / (F64)fps_cap;
+        if (cap_period > time->frame_period) {
+            time->frame_period = cap_period;
+        }
+    }
+
+    // NOTE(naman): Start pessimistic, the estimate comes down as real frames get measured
+    for (U32 i = 0; i < TIME_FRAME_HISTORY; ++i) {
+        time->frame_work[i] = time->frame_period / 2;
+    }
+    time->frame_work_index = 0;
+
+    time->frame_deadline = 0;
+    time->frame_start = SDL_GetPerformanceCounter();
+
+    logConsole(LOG_LEVEL_INFO,
+               LOG_CHANNEL_TIME,
+               "Frame pacing: %s, V-Sync %s, FPS cap %u",
+               (time->frame_period > 0) ? "on" : "off",
+               vsync ? "on" : "off",
+               fps_cap);
+}
+
+/**
+* @brief Function to wait for the right time to start working on the next frame
+*
+* The work on a frame starts as late as possible so that it still finishes by the frame's
+* deadline. The work is estimated as the slowest of the recent frames, plus a safety margin.
+* Since input is sampled at the start of the frame, this keeps the input latency low.
+*
+* @param time Timing state
+*/
+internal_function
+void timeFrameBegin (System_Time *time)
+{
+    if ((time->frame_period > 0) && (time->frame_deadline != 0)) {
+        F64 estimate = 0;
+        for (U32 i = 0; i < TIME_FRAME_HISTORY; ++i) {
+            if (time->frame_work[i] > estimate) {
+                estimate = time->frame_work[i];
+            }
+        }
+        estimate += TIME_FRAME_MARGIN;
+
+        U64 freq = SDL_GetPerformanceFrequency();
+        U64 estimate_counter = (U64)((estimate * (F64)freq) / 1000000.0);
+
+        if (time->frame_deadline > estimate_counter) {
+            U64 wake_up = time->frame_deadline - estimate_counter;
+            U64 now = SDL_GetPerformanceCounter();
+            if (wake_up > now) {
+                timeSleepUntil(wake_up);
+                profileRecord(PROFILE_FRAME_SLEEP, timeMicrosecondsElapsed(&now));
+            }
+        }
+    }
+
+    time->frame_start = SDL_GetPerformanceCounter();
+}
+
+/**
+* @brief Function to mark the end of work on a frame (right before it is presented)
+*
+* @param time Timing state
+*/
+internal_function
+void timeFrameEnd (System_Time *time)
+{
+    U64 now = SDL_GetPerformanceCounter();
+    U64 start = time->frame_start;
+    F64 work = timeMicrosecondsElapsed(&start);
+
+    time->frame_work[time->frame_work_index] = work;
+    time->frame_work_index = (time->frame_work_index + 1) % TIME_FRAME_HISTORY;
+    profileRecord(PROFILE_FRAME_WORK, work);
+
+    if ((time->frame_period > 0) && (time->frame_deadline != 0) && (now > time->frame_deadline)) {
+        U64 deadline = time->frame_deadline;
+        F64 late = timeMicrosecondsElapsed(&deadline);
+        profileRecord(PROFILE_DEADLINE_MISSED, late);
+    }
+}
+
+/**
+* @brief Function to compute the deadline of the next frame (right after one is presented)
+*
+* @param time Timing state
+*/
+internal_function
+void timeFramePresented (System_Time *time)
+{
+    if (time->frame_period <= 0) {
+        return;
+    }
+
+    U64 now = SDL_GetPerformanceCounter();
+    U64 period = (U64)((time->frame_period * (F64)SDL_GetPerformanceFrequency()) / 1000000.0);
+
+    // NOTE(naman): After a missed frame (or on the first one), the schedule is restarted
+    // from the present moment instead of trying to catch up.
+    time->frame_deadline += period;
+    if (time->frame_deadline <= now) {
+        time->frame_deadline = now + period;
+    }
+}
+
+/**
+* @brief Function to set up the fixed simulation tick
+*
+* @param time Timing state
+* @param tick_rate Updates per second
+*/
+internal_function
+void timeTickInit (System_Time *time, U32 tick_rate)
+{
+    time->tick_period = 1000000.0 / (F64)tick_rate;
+    time->tick_accumulator = 0;
+    time->tick_count = 0;
+    time->render_skips = 0;
+
+    logConsole(LOG_LEVEL_INFO,
+               LOG_CHANNEL_TIME,
+               "Simulation tick: %u Hz", tick_rate);
+}
+
+/**
+* @brief Function to find how many updates are to be run this frame
+*
+* If the simulation has fallen so far behind that it can't hope to catch up (e.g. after the
+* program was suspended), the excess time is dropped instead of being simulated.
+*
+* @param time Timing state
+* @param elapsed Microseconds passed since the last frame
+*
+* @return Number of updates to run
+*/
+internal_function
+U32 timeTicksDue (System_Time *time, F64 elapsed)
+{
+    time->tick_accumulator += elapsed;
+
+    if (time->tick_accumulator > TIME_TICK_MAX_BACKLOG) {
+        profileRecord(PROFILE_TICK_DROPPED, time->tick_accumulator - TIME_TICK_MAX_BACKLOG);
+        time->tick_accumulator = TIME_TICK_MAX_BACKLOG;
+    }
+
+    U32 ticks = (U32)(time->tick_accumulator / time->tick_period);
+    if (ticks > TIME_TICK_MAX_PER_FRAME) {
+        ticks = TIME_TICK_MAX_PER_FRAME;
+    }
+
+    time->tick_accumulator -= (F64)ticks * time->tick_period;
+    time->tick_count += ticks;
+    profileRecord(PROFILE_TICKS_PER_FRAME, (F64)ticks);
+
+    return ticks;
+}
+
+/**
+* @brief Function to decide whether to render this frame, after the updates have been run
+*
+* A frame is not rendered if the simulation is still more than a tick behind, so that the time
+* can instead be spent catching up. Only a few frames in a row are skipped though, so that
+* something is shown even if updates are always slower than the tick.
+*
+* @param time Timing state
+*
+* @return Should the frame be rendered?
+*/
+internal_function
+B32 timeShouldRender (System_Time *time)
+{
+    if ((time->tick_accumulator >= time->tick_period) &&
+        (time->render_skips < TIME_MAX_RENDER_SKIPS)) {
+        time->render_skips++;
+        profileRecord(PROFILE_RENDER_SKIPPED, 1);
+        return false;
+    }
+
+    time->render_skips = 0;
+    return true;
+}
+
+/**
+* @brief Function to get how far between the last update and the next one the present is
+*
+* @param time Timing state
+*
+* @return Interpolation factor (in [0, 1])
+*/
+internal_function
+F64 timeTickAlpha (System_Time *time)
+{
+    F64 alpha = time->tick_accumulator / time->tick_period;
+    return (alpha < 1.0) ? alpha : 1.0;
+}
+
+/**
+* @brief Function to get the time that has been simulated, including the interpolation
+*
+* @param time Timing state
+*
+* @return Microseconds simulated since the start
+*/
+internal_function
+F64 timeSimulated (System_Time *time)
+{
+    return ((F64)time->tick_count + timeTickAlpha(time)) * time->tick_period;
+}
@@ -0,0 +1,1385 @@
+/**
+ * These functions implement the simulated filesystem that the player explores through the
+ * terminal. Inodes live in a pool and are referred to by their index in it. Names are interned
+ * into atoms, so that every directory can keep its children in a hash table keyed by atom, and
+ * looking up a path costs one probe per component. The path of every inode is cached, and the
+ * cache is invalidated (for all inodes at once) only when something is moved.
+ *
+ * Besides the hash table, every directory keeps its children in a list, so that they can be
+ * listed in the order in which they were created, and in an array sorted by name, so that the
+ * children whose names start with a prefix (for completion) can be found by binary search. Both
+ * are kept up to date as children are added, moved and removed.
+ *
+ * The contents of files are piece tables: lists of pieces, each of which is a range of bytes
+ * in a chunk. Chunks are reference counted and the bytes in them never change once written, so
+ * copying a file only copies its list of pieces. Appending writes into the free space at the
+ * end of the last chunk when the file's last piece ends there, and into a new chunk otherwise.
+ *
+ * Checkpoints let the whole filesystem be put back the way it was. Taking one only records the
+ * size of the pool and of the journal. After that, the first change to every inode saves the
+ * inode as it was into the journal (with its contents shared, as when a file is copied), so
+ * the cost of a change doesn't depend on the size of the tree; and restoring a checkpoint puts
+ * the saved inodes back, newest first, and drops the inodes created since.
+ *
+ * @file vfs.c
+ * @author Team Octal
+ * @brief Functions for the simulated filesystem
+ */
+
+#define VFS_ROOT 1 /* ID of the root directory (0 is never a valid ID) */
+#define VFS_TOMBSTONE UINT32_MAX /* Marks a removed entry in a directory's hash table */
+#define VFS_CHUNK_SIZE_MIN 64 /* Capacity of the first chunk of a file */
+#define VFS_CHUNK_SIZE_MAX 65536 /* Capacity beyond which chunks stop growing */
+
+/**
+* @brief Enumeration of the kinds of inodes
+*/
+enum Vfs_Kind {
+    VFS_KIND_FREE, /**< Unused slot of the pool */
+    VFS_KIND_FILE,
+    VFS_KIND_DIRECTORY,
+};
+
+/**
+* @brief Enumeration of the errors of filesystem operations
+*/
+enum Vfs_Error {
+    VFS_OK,
+    VFS_ERROR_NOT_FOUND, /**< A component of the path doesn't exist */
+    VFS_ERROR_NOT_DIRECTORY, /**< A component of the path is not a directory */
+    VFS_ERROR_EXISTS, /**< The name is already taken */
+    VFS_ERROR_NOT_EMPTY, /**< The directory has children */
+    VFS_ERROR_INVALID, /**< The path or name is malformed */
+    VFS_ERROR_CYCLE, /**< A directory can't be moved into itself */
+    VFS_ERROR_IS_DIRECTORY, /**< Directories have no contents */
+};
+
+/**
+* @brief Interned name
+*/
+typedef struct Vfs_Atom {
+    Char *string; /**< Name (NUL-terminated) */
+    U32 length; /**< Length of @ref string */
+    U32 hash; /**< Hash of @ref string */
+} Vfs_Atom;
+
+/**
+* @brief Block of file contents, shared between all the pieces that refer to it
+*/
+typedef struct Vfs_Chunk {
+    U32 refcount; /**< Number of pieces referring to the chunk */
+    U32 length; /**< Number of bytes written (these never change) */
+    U32 capacity; /**< Number of bytes in @ref data */
+    Byte data[]; /**< Bytes */
+} Vfs_Chunk;
+
+/**
+* @brief Range of bytes of a chunk, making up part of a file
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Vfs_Piece {
+    Vfs_Chunk *chunk; /**< Chunk holding the bytes */
+    U32 offset; /**< Offset of the first byte in @ref chunk */
+    U32 length; /**< Number of bytes */
+    U64 start; /**< Offset of the first byte in the file */
+} Vfs_Piece;
+#pragma clang diagnostic pop
+
+/**
+* @brief Contents of a file
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Vfs_Content {
+    Vfs_Piece *pieces; /**< Pieces, in order */
+    U32 piece_count; /**< Number of pieces */
+    U32 piece_capacity; /**< Number of slots in @ref pieces */
+    U64 size; /**< Number of bytes */
+} Vfs_Content;
+#pragma clang diagnostic pop
+
+/**
+* @brief File or directory
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Vfs_Inode {
+    enum Vfs_Kind kind; /**< Kind of inode */
+    U32 name; /**< Atom of the name */
+    U32 parent; /**< ID of the parent directory (the root is its own parent) */
+
+    U32 first_child; /**< ID of the oldest child (directories only) */
+    U32 last_child; /**< ID of the newest child (directories only) */
+    U32 next_sibling; /**< ID of the next child of the parent (next free slot, if free) */
+    U32 prev_sibling; /**< ID of the previous child of the parent */
+
+    U32 *children; /**< Hash table of the IDs of the children, keyed by name atom */
+    U32 children_capacity; /**< Number of slots in @ref children (a power of two) */
+    U32 children_used; /**< Number of filled slots in @ref children, tombstones included */
+    U32 child_count; /**< Number of children */
+    U32 *sorted; /**< IDs of the children, sorted by name */
+    U32 sorted_capacity; /**< Number of slots in @ref sorted */
+
+    Char *path; /**< Cached path */
+    U32 path_epoch; /**< Value of @ref Vfs.epoch when @ref path was cached */
+    U32 journal_serial; /**< Serial number of the checkpoint after which the inode was last
+                             saved in the journal */
+
+    Vfs_Content content; /**< Contents (files only) */
+} Vfs_Inode;
+#pragma clang diagnostic pop
+
+/**
+* @brief Inode as it was before it was changed after a checkpoint
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Vfs_Journal_Entry {
+    U32 id; /**< ID of the inode */
+    Vfs_Inode inode; /**< Saved inode (which owns its own tables and contents) */
+} Vfs_Journal_Entry;
+#pragma clang diagnostic pop
+
+/**
+* @brief State of the filesystem that can be restored
+*/
+typedef struct Vfs_Checkpoint {
+    U32 serial; /**< Serial number (never reused, unlike the position in the stack) */
+    U32 journal_count; /**< Number of entries in the journal when the checkpoint was taken */
+    U32 inode_count; /**< Value of @ref Vfs.inode_count when the checkpoint was taken */
+    U32 free_inode; /**< Value of @ref Vfs.free_inode when the checkpoint was taken */
+} Vfs_Checkpoint;
+
+/**
+* @brief Filesystem
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Vfs {
+    Vfs_Inode *inodes; /**< Pool of inodes, indexed by ID */
+    U32 inode_count; /**< Number of slots of @ref inodes in use (free or not) */
+    U32 inode_capacity; /**< Number of slots in @ref inodes */
+    U32 free_inode; /**< First free slot (0 if none) */
+
+    Vfs_Atom *atoms; /**< Interned names, indexed by atom */
+    U32 atom_count; /**< Number of atoms */
+    U32 atom_capacity; /**< Number of slots in @ref atoms */
+    U32 *atom_table; /**< Hash table of atoms + 1 (0 for an empty slot) */
+    U32 atom_table_capacity; /**< Number of slots in @ref atom_table (a power of two) */
+
+    U32 epoch; /**< Incremented whenever cached paths become invalid */
+    U64 generation; /**< Incremented whenever an inode is changed, created or freed */
+
+    Vfs_Journal_Entry *journal; /**< Saved inodes, oldest first */
+    U32 journal_count; /**< Number of entries in @ref journal */
+    U32 journal_capacity; /**< Number of slots in @ref journal */
+    Vfs_Checkpoint *checkpoints; /**< Stack of checkpoints, oldest first */
+    U32 checkpoint_count; /**< Number of checkpoints */
+    U32 checkpoint_capacity; /**< Number of slots in @ref checkpoints */
+    U32 checkpoint_serial; /**< Serial number of the newest checkpoint ever taken */
+} Vfs;
+#pragma clang diagnostic pop
+
+/**
+* @brief Function to hash a string (FNV-1a)
+*
+* @param string String
+* @param length Length of @p string
+*
+* @return Hash
+*/
+internal_function
+U32 vfsHash (const Char *string, Size length)
+{
+    U32 hash = 2166136261u;
+    for (Size i = 0; i < length; ++i) {
+        hash ^= (U8)string[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+* @brief Function to find the atom of a name, without interning it
+*
+* @param vfs Filesystem
+* @param string Name
+* @param length Length of @p string
+* @param atom Returns the atom
+*
+* @return Was the name interned?
+*/
+internal_function
+B32 vfsAtomFind (Vfs *vfs, const Char *string, Size length, U32 *atom)
+{
+    U32 hash = vfsHash(string, length);
+    U32 mask = vfs->atom_table_capacity - 1;
+
+    for (U32 slot = hash & mask; vfs->atom_table[slot] != 0; slot = (slot + 1) & mask) {
+        Vfs_Atom *candidate = &vfs->atoms[vfs->atom_table[slot] - 1];
+        if ((candidate->hash == hash) && (candidate->length == length) &&
+            (memcmp(candidate->string, string, length) == 0)) {
+            *atom = vfs->atom_table[slot] - 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+* @brief Function to intern a name
+*
+* @param vfs Filesystem
+* @param string Name
+* @param length Length of @p string
+*
+* @return Atom
+*/
+internal_function
+U32 vfsAtom (Vfs *vfs, const Char *string, Size length)
+{
+    U32 atom = 0;
+    if (vfsAtomFind(vfs, string, length, &atom)) {
+        return atom;
+    }
+
+    if (vfs->atom_count == vfs->atom_capacity) {
+        vfs->atom_capacity *= 2;
+        vfs->atoms = realloc(vfs->atoms, sizeof(*vfs->atoms) * vfs->atom_capacity);
+    }
+
+    if ((vfs->atom_count + 1) * 2 > vfs->atom_table_capacity) {
+        U32 capacity = vfs->atom_table_capacity * 2;
+        free(vfs->atom_table);
+        vfs->atom_table = calloc(capacity, sizeof(*vfs->atom_table));
+        vfs->atom_table_capacity = capacity;
+
+        for (U32 i = 0; i < vfs->atom_count; ++i) {
+            U32 slot = vfs->atoms[i].hash & (capacity - 1);
+            while (vfs->atom_table[slot] != 0) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            vfs->atom_table[slot] = i + 1;
+        }
+    }
+
+    atom = vfs->atom_count++;
+    Vfs_Atom *new_atom = &vfs->atoms[atom];
+    new_atom->string = malloc(length + 1);
+    memcpy(new_atom->string, string, length);
+    new_atom->string[length] = '\0';
+    new_atom->length = (U32)length;
+    new_atom->hash = vfsHash(string, length);
+
+    U32 slot = new_atom->hash & (vfs->atom_table_capacity - 1);
+    while (vfs->atom_table[slot] != 0) {
+        slot = (slot + 1) & (vfs->atom_table_capacity - 1);
+    }
+    vfs->atom_table[slot] = atom + 1;
+
+    return atom;
+}
+
+/**
+* @brief Function to drop every piece of a file's contents
+*
+* @param content Contents
+*/
+internal_function
+void vfsContentClear (Vfs_Content *content)
+{
+    for (U32 i = 0; i < content->piece_count; ++i) {
+        Vfs_Chunk *chunk = content->pieces[i].chunk;
+        chunk->refcount--;
+        if (chunk->refcount == 0) {
+            free(chunk);
+        }
+    }
+
+    content->piece_count = 0;
+    content->size = 0;
+}
+
+/**
+* @brief Function to free a file's contents
+*
+* @param content Contents
+*/
+internal_function
+void vfsContentFree (Vfs_Content *content)
+{
+    vfsContentClear(content);
+    free(content->pieces);
+    memset(content, 0, sizeof(*content));
+}
+
+/**
+* @brief Function to add a piece at the end of a file's contents
+*
+* @param content Contents
+* @param chunk Chunk (whose reference count is taken over by the piece)
+* @param offset Offset of the piece in @p chunk
+* @param length Length of the piece
+*/
+internal_function
+void vfsContentPush (Vfs_Content *content, Vfs_Chunk *chunk, U32 offset, U32 length)
+{
+    if (content->piece_count == content->piece_capacity) {
+        content->piece_capacity = (content->piece_capacity == 0) ? 4 : content->piece_capacity * 2;
+        content->pieces = realloc(content->pieces,
+                                  sizeof(*content->pieces) * content->piece_capacity);
+    }
+
+    Vfs_Piece *piece = &content->pieces[content->piece_count++];
+    piece->chunk = chunk;
+    piece->offset = offset;
+    piece->length = length;
+    piece->start = content->size;
+
+    content->size += length;
+}
+
+/**
+* @brief Function to append bytes to a file's contents
+*
+* @param content Contents
+* @param data Bytes
+* @param length Number of bytes
+*/
+internal_function
+void vfsContentAppend (Vfs_Content *content, const Byte *data, Size length)
+{
+    while (length > 0) {
+        Vfs_Piece *last = (content->piece_count > 0) ?
+            &content->pieces[content->piece_count - 1] : NULL;
+
+        // NOTE(naman): The written bytes of a chunk never change, so it is safe to append to
+        // the end of a chunk even if other files share it; but only the file whose last piece
+        // ends exactly where the chunk does can extend that piece.
+        if ((last != NULL) &&
+            (last->offset + last->length == last->chunk->length) &&
+            (last->chunk->length < last->chunk->capacity)) {
+            Vfs_Chunk *chunk = last->chunk;
+            U32 count = chunk->capacity - chunk->length;
+            if (count > length) {
+                count = (U32)length;
+            }
+
+            memcpy(chunk->data + chunk->length, data, count);
+            chunk->length += count;
+            last->length += count;
+            content->size += count;
+
+            data += count;
+            length -= count;
+            continue;
+        }
+
+        // NOTE(naman): Chunks grow geometrically, so that small files stay small but large
+        // files aren't split into too many pieces.
+        U32 capacity = (last != NULL) ? last->chunk->capacity * 2 : VFS_CHUNK_SIZE_MIN;
+        while ((capacity < length) && (capacity < VFS_CHUNK_SIZE_MAX)) {
+            capacity *= 2;
+        }
+        if (capacity > VFS_CHUNK_SIZE_MAX) {
+            capacity = VFS_CHUNK_SIZE_MAX;
+        }
+
+        Vfs_Chunk *chunk = malloc(sizeof(*chunk) + capacity);
+        chunk->refcount = 1;
+        chunk->length = 0;
+        chunk->capacity = capacity;
+
+        vfsContentPush(content, chunk, 0, 0);
+    }
+}
+
+/**
+* @brief Function to make a file's contents the same as another's, sharing all the chunks
+*
+* @param destination Contents to replace
+* @param source Contents to copy
+*/
+internal_function
+void vfsContentCopy (Vfs_Content *destination, Vfs_Content *source)
+{
+    if (destination == source) {
+        return;
+    }
+
+    vfsContentClear(destination);
+
+    for (U32 i = 0; i < source->piece_count; ++i) {
+        Vfs_Piece *piece = &source->pieces[i];
+        piece->chunk->refcount++;
+        vfsContentPush(destination, piece->chunk, piece->offset, piece->length);
+    }
+}
+
+/**
+* @brief Function to find the piece holding a byte of a file's contents
+*
+* @param content Contents
+* @param offset Offset of the byte (must be less than the size)
+*
+* @return Index of the piece
+*/
+internal_function
+U32 vfsContentFind (Vfs_Content *content, U64 offset)
+{
+    U32 low = 0;
+    U32 high = content->piece_count - 1;
+
+    while (low < high) {
+        U32 middle = low + (high - low + 1) / 2;
+        if (content->pieces[middle].start <= offset) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    return low;
+}
+
+/**
+* @brief Function to go through a range of a file's contents without copying it
+*
+* The range is handed to @p callback as a series of contiguous spans.
+*
+* @param content Contents
+* @param offset Offset of the first byte
+* @param length Maximum number of bytes
+* @param callback Function called with each span, which returns false to stop
+* @param userdata Passed to @p callback
+*/
+internal_function
+void vfsContentRead (Vfs_Content *content, U64 offset, U64 length,
+                     B32 (*callback)(void *userdata, const Byte *data, Size length),
+                     void *userdata)
+{
+    if (offset >= content->size) {
+        return;
+    }
+    if (length > content->size - offset) {
+        length = content->size - offset;
+    }
+
+    for (U32 i = vfsContentFind(content, offset); (i < content->piece_count) && (length > 0); ++i) {
+        Vfs_Piece *piece = &content->pieces[i];
+        U64 skip = offset - piece->start;
+        U64 count = piece->length - skip;
+        if (count > length) {
+            count = length;
+        }
+
+        if (callback(userdata, piece->chunk->data + piece->offset + skip, (Size)count) == false) {
+            return;
+        }
+
+        offset += count;
+        length -= count;
+    }
+}
+
+/**
+* @brief Function to check whether an ID refers to an inode in use
+*
+* @param vfs Filesystem
+* @param id ID
+*
+* @return Is the ID valid?
+*/
+internal_function
+B32 vfsIsValid (Vfs *vfs, U32 id)
+{
+    return (id != 0) && (id < vfs->inode_count) && (vfs->inodes[id].kind != VFS_KIND_FREE);
+}
+
+/**
+* @brief Function to get an inode from its ID
+*
+* The pointer is only valid until the next inode is allocated.
+*
+* @param vfs Filesystem
+* @param id ID (must be valid)
+*
+* @return Inode
+*/
+internal_function
+Vfs_Inode* vfsInode (Vfs *vfs, U32 id)
+{
+    return &vfs->inodes[id];
+}
+
+/**
+* @brief Function to free what an inode holds
+*
+* @param inode Inode
+*/
+internal_function
+void vfsInodeRelease (Vfs_Inode *inode)
+{
+    free(inode->children);
+    free(inode->sorted);
+    free(inode->path);
+    vfsContentFree(&inode->content);
+}
+
+/**
+* @brief Function to check whether an inode has to be saved in the journal before it is changed
+*
+* @param vfs Filesystem
+* @param id ID of the inode
+*
+* @return Has the inode been left alone since the newest checkpoint (and did it exist then)?
+*/
+internal_function
+B32 vfsJournalIsNeeded (Vfs *vfs, U32 id)
+{
+    if (vfs->checkpoint_count == 0) {
+        return false;
+    }
+
+    Vfs_Checkpoint *checkpoint = &vfs->checkpoints[vfs->checkpoint_count - 1];
+    return (id < checkpoint->inode_count) &&
+        (vfs->inodes[id].journal_serial != checkpoint->serial);
+}
+
+/**
+* @brief Function to save an inode in the journal
+*
+* @param vfs Filesystem
+* @param id ID of the inode
+* @param take Should the journal take over what the inode holds (since it is about to be
+*             freed), rather than copy it?
+*/
+internal_function
+void vfsJournalSave (Vfs *vfs, U32 id, B32 take)
+{
+    if (vfs->journal_count == vfs->journal_capacity) {
+        vfs->journal_capacity = (vfs->journal_capacity == 0) ? 64 : (vfs->journal_capacity * 2);
+        vfs->journal = realloc(vfs->journal, sizeof(*vfs->journal) * vfs->journal_capacity);
+    }
+
+    Vfs_Inode *inode = &vfs->inodes[id];
+    Vfs_Journal_Entry *entry = &vfs->journal[vfs->journal_count++];
+    entry->id = id;
+    entry->inode = *inode;
+    entry->inode.path = NULL; // NOTE(naman): Paths are only a cache, so they aren't saved
+
+    if (take) {
+        free(inode->path);
+        inode->path = NULL;
+    } else {
+        if (inode->children != NULL) {
+            Size size = sizeof(*inode->children) * inode->children_capacity;
+            entry->inode.children = malloc(size);
+            memcpy(entry->inode.children, inode->children, size);
+        }
+        if (inode->sorted != NULL) {
+            entry->inode.sorted = malloc(sizeof(*inode->sorted) * inode->sorted_capacity);
+            memcpy(entry->inode.sorted, inode->sorted, sizeof(*inode->sorted) * inode->child_count);
+        }
+        memset(&entry->inode.content, 0, sizeof(entry->inode.content));
+        vfsContentCopy(&entry->inode.content, &inode->content);
+    }
+
+    inode->journal_serial = vfs->checkpoints[vfs->checkpoint_count - 1].serial;
+}
+
+/**
+* @brief Function to get an inode that is about to be changed
+*
+* This saves it in the journal first, if there is a checkpoint it has to be restored for.
+*
+* @param vfs Filesystem
+* @param id ID (must be valid)
+*
+* @return Inode
+*/
+internal_function
+Vfs_Inode* vfsInodeWrite (Vfs *vfs, U32 id)
+{
+    if (vfsJournalIsNeeded(vfs, id)) {
+        vfsJournalSave(vfs, id, false);
+    }
+    vfs->generation++;
+    return &vfs->inodes[id];
+}
+
+/**
+* @brief Function to allocate an inode from the pool
+*
+* @param vfs Filesystem
+* @param kind Kind of inode
+* @param name Atom of the name
+*
+* @return ID of the inode
+*/
+internal_function
+U32 vfsInodeAlloc (Vfs *vfs, enum Vfs_Kind kind, U32 name)
+{
+    U32 id = vfs->free_inode;
+    if (id != 0) {
+        vfsInodeWrite(vfs, id);
+        vfs->free_inode = vfs->inodes[id].next_sibling;
+    } else {
+        if (vfs->inode_count == vfs->inode_capacity) {
+            vfs->inode_capacity *= 2;
+            vfs->inodes = realloc(vfs->inodes, sizeof(*vfs->inodes) * vfs->inode_capacity);
+        }
+        id = vfs->inode_count++;
+    }
+
+    Vfs_Inode *inode = &vfs->inodes[id];
+    U32 journal_serial = inode->journal_serial;
+    memset(inode, 0, sizeof(*inode));
+    inode->journal_serial = journal_serial;
+    inode->kind = kind;
+    inode->name = name;
+    inode->parent = id;
+    vfs->generation++;
+
+    return id;
+}
+
+/**
+* @brief Function to return an inode to the pool
+*
+* @param vfs Filesystem
+* @param id ID of the inode (must not have children or a parent)
+*/
+internal_function
+void vfsInodeFree (Vfs *vfs, U32 id)
+{
+    Vfs_Inode *inode = &vfs->inodes[id];
+    if (vfsJournalIsNeeded(vfs, id)) {
+        vfsJournalSave(vfs, id, true);
+    } else {
+        vfsInodeRelease(inode);
+    }
+
+    U32 journal_serial = inode->journal_serial;
+    memset(inode, 0, sizeof(*inode));
+    inode->journal_serial = journal_serial;
+    inode->kind = VFS_KIND_FREE;
+    inode->next_sibling = vfs->free_inode;
+    vfs->free_inode = id;
+    vfs->generation++;
+}
+
+/**
+* @brief Function to set up a filesystem with nothing but the root directory
+*
+* @param vfs Filesystem
+*/
+internal_function
+void vfsInit (Vfs *vfs)
+{
+    memset(vfs, 0, sizeof(*vfs));
+
+    vfs->inode_capacity = 64;
+    vfs->inodes = malloc(sizeof(*vfs->inodes) * vfs->inode_capacity);
+    vfs->inode_count = 1; // NOTE(naman): Slot 0 is never used, so that 0 can mean "no inode"
+    memset(&vfs->inodes[0], 0, sizeof(vfs->inodes[0]));
+
+    vfs->atom_capacity = 64;
+    vfs->atoms = malloc(sizeof(*vfs->atoms) * vfs->atom_capacity);
+    vfs->atom_table_capacity = 128;
+    vfs->atom_table = calloc(vfs->atom_table_capacity, sizeof(*vfs->atom_table));
+
+    vfsInodeAlloc(vfs, VFS_KIND_DIRECTORY, vfsAtom(vfs, "", 0));
+}
+
+/**
+* @brief Function to free everything a filesystem holds
+*
+* @param vfs Filesystem
+*/
+internal_function
+void vfsFree (Vfs *vfs)
+{
+    for (U32 i = 1; i < vfs->inode_count; ++i) {
+        vfsInodeRelease(&vfs->inodes[i]);
+    }
+    free(vfs->inodes);
+
+    for (U32 i = 0; i < vfs->journal_count; ++i) {
+        vfsInodeRelease(&vfs->journal[i].inode);
+    }
+    free(vfs->journal);
+    free(vfs->checkpoints);
+
+    for (U32 i = 0; i < vfs->atom_count; ++i) {
+        free(vfs->atoms[i].string);
+    }
+    free(vfs->atoms);
+    free(vfs->atom_table);
+
+    memset(vfs, 0, sizeof(*vfs));
+}
+
+/**
+* @brief Function to find the child of a directory with a given name
+*
+* @param vfs Filesystem
+* @param directory ID of the directory
+* @param name Atom of the name
+*
+* @return ID of the child (0 if there is none)
+*/
+internal_function
+U32 vfsChildFind (Vfs *vfs, U32 directory, U32 name)
+{
+    Vfs_Inode *dir = vfsInode(vfs, directory);
+    if (dir->children_capacity == 0) {
+        return 0;
+    }
+
+    U32 mask = dir->children_capacity - 1;
+    for (U32 slot = vfs->atoms[name].hash & mask; dir->children[slot] != 0; slot = (slot + 1) & mask) {
+        U32 child = dir->children[slot];
+        if ((child != VFS_TOMBSTONE) && (vfs->inodes[child].name == name)) {
+            return child;
+        }
+    }
+
+    return 0;
+}
+
+/**
+* @brief Function to put an inode in the hash table of a directory
+*
+* @param vfs Filesystem
+* @param dir Directory (with room in its table)
+* @param id ID of the inode
+*/
+internal_function
+void vfsChildTableInsert (Vfs *vfs, Vfs_Inode *dir, U32 id)
+{
+    U32 mask = dir->children_capacity - 1;
+    U32 slot = vfs->atoms[vfs->inodes[id].name].hash & mask;
+    while ((dir->children[slot] != 0) && (dir->children[slot] != VFS_TOMBSTONE)) {
+        slot = (slot + 1) & mask;
+    }
+    if (dir->children[slot] == 0) {
+        dir->children_used++;
+    }
+    dir->children[slot] = id;
+}
+
+/**
+* @brief Function to compare the name of an inode with a name
+*
+* @param vfs Filesystem
+* @param id ID of the inode
+* @param name Name
+* @param length Length of @p name
+* @param truncate Should only the first @p length characters of the inode's name be compared?
+*
+* @return Negative, zero or positive as the inode's name sorts before, with or after @p name
+*/
+internal_function
+Sint vfsNameCompare (Vfs *vfs, U32 id, const Char *name, Size length, B32 truncate)
+{
+    Vfs_Atom *atom = &vfs->atoms[vfs->inodes[id].name];
+    Size atom_length = atom->length;
+    if (truncate && (atom_length > length)) {
+        atom_length = length;
+    }
+
+    Size common = (atom_length < length) ? atom_length : length;
+    Sint order = memcmp(atom->string, name, common);
+    if (order != 0) {
+        return order;
+    }
+
+    return (Sint)(atom_length > length) - (Sint)(atom_length < length);
+}
+
+/**
+* @brief Function to search the children of a directory sorted by name
+*
+* @param vfs Filesystem
+* @param dir Directory
+* @param name Name
+* @param length Length of @p name
+* @param past_prefix Should the children whose names start with @p name be skipped over?
+*
+* @return Index in @ref Vfs_Inode.sorted of the first child whose name doesn't sort before
+*         @p name (or, with @p past_prefix, the first one after those that start with it)
+*/
+internal_function
+U32 vfsSortedSearch (Vfs *vfs, Vfs_Inode *dir, const Char *name, Size length, B32 past_prefix)
+{
+    U32 low = 0;
+    U32 high = dir->child_count;
+
+    while (low < high) {
+        U32 middle = low + ((high - low) / 2);
+        Sint order = vfsNameCompare(vfs, dir->sorted[middle], name, length, past_prefix);
+        if ((order < 0) || (past_prefix && (order == 0))) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/**
+* @brief Function to find the children of a directory whose names start with a prefix
+*
+* @param vfs Filesystem
+* @param directory ID of the directory
+* @param prefix Prefix
+* @param length Length of @p prefix
+* @param first Returns the index in @ref Vfs_Inode.sorted of the first child that matches
+*
+* @return Number of children that match (they follow each other in @ref Vfs_Inode.sorted)
+*/
+internal_function
+U32 vfsComplete (Vfs *vfs, U32 directory, const Char *prefix, Size length, U32 *first)
+{
+    Vfs_Inode *dir = vfsInode(vfs, directory);
+
+    *first = vfsSortedSearch(vfs, dir, prefix, length, false);
+    U32 end = vfsSortedSearch(vfs, dir, prefix, length, true);
+
+    return end - *first;
+}
+
+/**
+* @brief Function to make an inode a child of a directory
+*
+* @param vfs Filesystem
+* @param directory ID of the directory
+* @param id ID of the inode (which must not have a parent)
+*/
+internal_function
+void vfsChildAdd (Vfs *vfs, U32 directory, U32 id)
+{
+    Vfs_Inode *dir = vfsInodeWrite(vfs, directory);
+
+    if ((dir->children_used + 1) * 2 > dir->children_capacity) {
+        U32 *old_children = dir->children;
+        U32 old_capacity = dir->children_capacity;
+
+        // NOTE(naman): Rehashing also clears out the tombstones, so the table only grows if
+        // it is really full of children.
+        U32 capacity = (old_capacity == 0) ? 8 : old_capacity;
+        while ((dir->child_count + 1) * 2 > capacity) {
+            capacity *= 2;
+        }
+
+        dir->children = calloc(capacity, sizeof(*dir->children));
+        dir->children_capacity = capacity;
+        dir->children_used = 0;
+        for (U32 i = 0; i < old_capacity; ++i) {
+            if ((old_children[i] != 0) && (old_children[i] != VFS_TOMBSTONE)) {
+                vfsChildTableInsert(vfs, dir, old_children[i]);
+            }
+        }
+        free(old_children);
+    }
+
+    vfsChildTableInsert(vfs, dir, id);
+
+    if (dir->child_count == dir->sorted_capacity) {
+        dir->sorted_capacity = (dir->sorted_capacity == 0) ? 8 : (dir->sorted_capacity * 2);
+        dir->sorted = realloc(dir->sorted, sizeof(*dir->sorted) * dir->sorted_capacity);
+    }
+    Vfs_Atom *atom = &vfs->atoms[vfs->inodes[id].name];
+    U32 position = vfsSortedSearch(vfs, dir, atom->string, atom->length, false);
+    memmove(dir->sorted + position + 1, dir->sorted + position,
+            sizeof(*dir->sorted) * (dir->child_count - position));
+    dir->sorted[position] = id;
+    dir->child_count++;
+
+    Vfs_Inode *inode = vfsInodeWrite(vfs, id);
+    inode->parent = directory;
+    inode->next_sibling = 0;
+    inode->prev_sibling = dir->last_child;
+    if (dir->last_child != 0) {
+        vfsInodeWrite(vfs, dir->last_child)->next_sibling = id;
+    } else {
+        dir->first_child = id;
+    }
+    dir->last_child = id;
+}
+
+/**
+* @brief Function to detach an inode from its parent
+*
+* @param vfs Filesystem
+* @param id ID of the inode
+*/
+internal_function
+void vfsChildRemove (Vfs *vfs, U32 id)
+{
+    Vfs_Inode *inode = vfsInodeWrite(vfs, id);
+    Vfs_Inode *dir = vfsInodeWrite(vfs, inode->parent);
+
+    U32 mask = dir->children_capacity - 1;
+    U32 slot = vfs->atoms[inode->name].hash & mask;
+    while (dir->children[slot] != id) {
+        slot = (slot + 1) & mask;
+    }
+    dir->children[slot] = VFS_TOMBSTONE;
+
+    Vfs_Atom *atom = &vfs->atoms[inode->name];
+    U32 position = vfsSortedSearch(vfs, dir, atom->string, atom->length, false);
+    memmove(dir->sorted + position, dir->sorted + position + 1,
+            sizeof(*dir->sorted) * (dir->child_count - position - 1));
+    dir->child_count--;
+
+    if (inode->prev_sibling != 0) {
+        vfsInodeWrite(vfs, inode->prev_sibling)->next_sibling = inode->next_sibling;
+    } else {
+        dir->first_child = inode->next_sibling;
+    }
+    if (inode->next_sibling != 0) {
+        vfsInodeWrite(vfs, inode->next_sibling)->prev_sibling = inode->prev_sibling;
+    } else {
+        dir->last_child = inode->prev_sibling;
+    }
+
+    inode->parent = id;
+    inode->next_sibling = 0;
+    inode->prev_sibling = 0;
+}
+
+/**
+* @brief Function to check whether a name can be given to an inode
+*
+* @param name Name
+* @param length Length of @p name
+*
+* @return Is the name valid?
+*/
+internal_function
+B32 vfsNameIsValid (const Char *name, Size length)
+{
+    if ((length == 0) ||
+        ((length == 1) && (name[0] == '.')) ||
+        ((length == 2) && (name[0] == '.') && (name[1] == '.'))) {
+        return false;
+    }
+
+    return memchr(name, '/', length) == NULL;
+}
+
+/**
+* @brief Function to find the inode at a path
+*
+* @param vfs Filesystem
+* @param cwd ID of the directory that relative paths start from
+* @param path Path
+* @param length Length of @p path
+* @param result Returns the ID of the inode
+*
+* @return Error
+*/
+internal_function
+enum Vfs_Error vfsResolve (Vfs *vfs, U32 cwd, const Char *path, Size length, U32 *result)
+{
+    U32 current = ((length > 0) && (path[0] == '/')) ? VFS_ROOT : cwd;
+
+    Size start = 0;
+    while (start < length) {
+        Size end = start;
+        while ((end < length) && (path[end] != '/')) {
+            end++;
+        }
+
+        const Char *component = path + start;
+        Size component_length = end - start;
+        start = end + 1;
+
+        if ((component_length == 0) ||
+            ((component_length == 1) && (component[0] == '.'))) {
+            continue;
+        }
+
+        if (vfs->inodes[current].kind != VFS_KIND_DIRECTORY) {
+            return VFS_ERROR_NOT_DIRECTORY;
+        }
+
+        if ((component_length == 2) && (component[0] == '.') && (component[1] == '.')) {
+            current = vfs->inodes[current].parent;
+            continue;
+        }
+
+        U32 name = 0;
+        if (vfsAtomFind(vfs, component, component_length, &name) == false) {
+            return VFS_ERROR_NOT_FOUND;
+        }
+
+        current = vfsChildFind(vfs, current, name);
+        if (current == 0) {
+            return VFS_ERROR_NOT_FOUND;
+        }
+    }
+
+    *result = current;
+    return VFS_OK;
+}
+
+/**
+* @brief Function to split a path into the directory that contains it and its last component
+*
+* @param vfs Filesystem
+* @param cwd ID of the directory that relative paths start from
+* @param path Path
+* @param length Length of @p path
+* @param directory Returns the ID of the directory
+* @param name Returns the last component (pointing into @p path)
+* @param name_length Returns the length of @p name
+*
+* @return Error
+*/
+internal_function
+enum Vfs_Error vfsResolveParent (Vfs *vfs, U32 cwd, const Char *path, Size length,
+                                 U32 *directory, const Char **name, Size *name_length)
+{
+    while ((length > 1) && (path[length - 1] == '/')) {
+        length--;
+    }
+
+    Size start = length;
+    while ((start > 0) && (path[start - 1] != '/')) {
+        start--;
+    }
+
+    if (vfsNameIsValid(path + start, length - start) == false) {
+        return VFS_ERROR_INVALID;
+    }
+
+    enum Vfs_Error error = vfsResolve(vfs, cwd, path, start, directory);
+    if (error != VFS_OK) {
+        return error;
+    }
+    if (vfs->inodes[*directory].kind != VFS_KIND_DIRECTORY) {
+        return VFS_ERROR_NOT_DIRECTORY;
+    }
+
+    *name = path + start;
+    *name_length = length - start;
+
+    return VFS_OK;
+}
+
+/**
+* @brief Function to create an inode
+*
+* @param vfs Filesystem
+* @param directory ID of the directory to create it in
+* @param name Name
+* @param length Length of @p name
+* @param kind Kind of inode
+* @param result Returns the ID of the new inode
+*
+* @return Error
+*/
+internal_function
+enum Vfs_Error vfsCreate (Vfs *vfs, U32 directory, const Char *name, Size length,
+                          enum Vfs_Kind kind, U32 *result)
+{
+    if (vfs->inodes[directory].kind != VFS_KIND_DIRECTORY) {
+        return VFS_ERROR_NOT_DIRECTORY;
+    }
+    if (vfsNameIsValid(name, length) == false) {
+        return VFS_ERROR_INVALID;
+    }
+
+    U32 atom = vfsAtom(vfs, name, length);
+    if (vfsChildFind(vfs, directory, atom) != 0) {
+        return VFS_ERROR_EXISTS;
+    }
+
+    U32 id = vfsInodeAlloc(vfs, kind, atom);
+    vfsChildAdd(vfs, directory, id);
+
+    *result = id;
+    return VFS_OK;
+}
+
+/**
+* @brief Function to move (and/or rename) an inode
+*
+* @param vfs Filesystem
+* @param id ID of the inode
+* @param directory ID of the directory to move it into
+* @param name New name
+* @param length Length of @p name
+*
+* @return Error
+*/
+internal_function
+enum Vfs_Error vfsMove (Vfs *vfs, U32 id, U32 directory, const Char *name, Size length)
+{
+    if (id == VFS_ROOT) {
+        return VFS_ERROR_INVALID;
+    }
+    if (vfs->inodes[directory].kind != VFS_KIND_DIRECTORY) {
+        return VFS_ERROR_NOT_DIRECTORY;
+    }
+    if (vfsNameIsValid(name, length) == false) {
+        return VFS_ERROR_INVALID;
+    }
+
+    for (U32 ancestor = directory; ancestor != VFS_ROOT; ancestor = vfs->inodes[ancestor].parent) {
+        if (ancestor == id) {
+            return VFS_ERROR_CYCLE;
+        }
+    }
+
+    U32 atom = vfsAtom(vfs, name, length);
+    U32 existing = vfsChildFind(vfs, directory, atom);
+    if (existing == id) {
+        return VFS_OK;
+    } else if (existing != 0) {
+        return VFS_ERROR_EXISTS;
+    }
+
+    vfsChildRemove(vfs, id);
+    vfsInodeWrite(vfs, id)->name = atom;
+    vfsChildAdd(vfs, directory, id);
+
+    vfs->epoch++;
+
+    return VFS_OK;
+}
+
+/**
+* @brief Function to free an inode and everything under it
+*
+* @param vfs Filesystem
+* @param id ID of the inode (already detached from its parent)
+*/
+internal_function
+void vfsRemoveTree (Vfs *vfs, U32 id)
+{
+    U32 child = vfs->inodes[id].first_child;
+    while (child != 0) {
+        U32 next = vfs->inodes[child].next_sibling;
+        vfsRemoveTree(vfs, child);
+        child = next;
+    }
+
+    vfsInodeFree(vfs, id);
+}
+
+/**
+* @brief Function to remove an inode
+*
+* @param vfs Filesystem
+* @param id ID of the inode
+* @param recursive Should a directory's contents be removed too?
+*
+* @return Error
+*/
+internal_function
+enum Vfs_Error vfsRemove (Vfs *vfs, U32 id, B32 recursive)
+{
+    if (id == VFS_ROOT) {
+        return VFS_ERROR_INVALID;
+    }
+    if ((vfs->inodes[id].child_count > 0) && (recursive == false)) {
+        return VFS_ERROR_NOT_EMPTY;
+    }
+
+    vfsChildRemove(vfs, id);
+    vfsRemoveTree(vfs, id);
+
+    return VFS_OK;
+}
+
+/**
+* @brief Function to get the path of an inode
+*
+* The paths of directories end with a '/'.
+*
+* @param vfs Filesystem
+* @param id ID of the inode
+*
+* @return Path (owned by the filesystem, valid until the next move or removal)
+*/
+internal_function
+const Char* vfsPath (Vfs *vfs, U32 id)
+{
+    Vfs_Inode *inode = vfsInode(vfs, id);
+    if ((inode->path != NULL) && (inode->path_epoch == vfs->epoch)) {
+        return inode->path;
+    }
+
+    Char *path = NULL;
+    if (id == VFS_ROOT) {
+        path = malloc(2);
+        strcpy(path, "/");
+    } else {
+        const Char *parent_path = vfsPath(vfs, inode->parent);
+        Size parent_length = strlen(parent_path);
+        Vfs_Atom *name = &vfs->atoms[inode->name];
+        B32 directory = (inode->kind == VFS_KIND_DIRECTORY);
+
+        path = malloc(parent_length + name->length + (directory ? 1 : 0) + 1);
+        memcpy(path, parent_path, parent_length);
+        memcpy(path + parent_length, name->string, name->length);
+        if (directory) {
+            path[parent_length + name->length] = '/';
+        }
+        path[parent_length + name->length + (directory ? 1 : 0)] = '\0';
+    }
+
+    free(inode->path);
+    inode->path = path;
+    inode->path_epoch = vfs->epoch;
+
+    return path;
+}
+
+/**
+* @brief Function to take a checkpoint
+*
+* @param vfs Filesystem
+*
+* @return Number of the checkpoint (its position in the stack, counting from 1)
+*/
+internal_function
+U32 vfsCheckpoint (Vfs *vfs)
+{
+    if (vfs->checkpoint_count == vfs->checkpoint_capacity) {
+        vfs->checkpoint_capacity = (vfs->checkpoint_capacity == 0) ?
+            8 : (vfs->checkpoint_capacity * 2);
+        vfs->checkpoints = realloc(vfs->checkpoints,
+                                   sizeof(*vfs->checkpoints) * vfs->checkpoint_capacity);
+    }
+
+    Vfs_Checkpoint *checkpoint = &vfs->checkpoints[vfs->checkpoint_count++];
+    checkpoint->serial = ++vfs->checkpoint_serial;
+    checkpoint->journal_count = vfs->journal_count;
+    checkpoint->inode_count = vfs->inode_count;
+    checkpoint->free_inode = vfs->free_inode;
+
+    return vfs->checkpoint_count;
+}
+
+/**
+* @brief Function to put the filesystem back the way it was when a checkpoint was taken
+*
+* The checkpoint stays (so it can be restored again), and the ones after it are dropped.
+*
+* @param vfs Filesystem
+* @param number Number of the checkpoint (must exist)
+*/
+internal_function
+void vfsRestore (Vfs *vfs, U32 number)
+{
+    Vfs_Checkpoint *checkpoint = &vfs->checkpoints[number - 1];
+
+    // NOTE(naman): An inode saved more than once goes back to its oldest copy, which is put
+    // back last.
+    while (vfs->journal_count > checkpoint->journal_count) {
+        Vfs_Journal_Entry *entry = &vfs->journal[--vfs->journal_count];
+        Vfs_Inode *inode = &vfs->inodes[entry->id];
+        vfsInodeRelease(inode);
+        *inode = entry->inode;
+    }
+
+    for (U32 i = checkpoint->inode_count; i < vfs->inode_count; ++i) {
+        vfsInodeRelease(&vfs->inodes[i]);
+    }
+    vfs->inode_count = checkpoint->inode_count;
+    vfs->free_inode = checkpoint->free_inode;
+
+    vfs->checkpoint_count = number;
+    vfs->epoch++;
+    vfs->generation++;
+}
+
+/**
+* @brief Function to drop a checkpoint (and the ones after it), keeping the changes since
+*
+* @param vfs Filesystem
+* @param number Number of the checkpoint (must exist)
+*/
+internal_function
+void vfsRelease (Vfs *vfs, U32 number)
+{
+    vfs->checkpoint_count = number - 1;
+
+    // NOTE(naman): The entries saved for the dropped checkpoints are still needed by the ones
+    // before them, unless there are none.
+    if (vfs->checkpoint_count == 0) {
+        for (U32 i = 0; i < vfs->journal_count; ++i) {
+            vfsInodeRelease(&vfs->journal[i].inode);
+        }
+        vfs->journal_count = 0;
+    }
+}
+
+/**
+* @brief Function to count the bytes allocated by an inode
+*
+* @param inode Inode
+*
+* @return Number of bytes (besides the inode itself)
+*/
+internal_function
+U64 vfsInodeMemory (Vfs_Inode *inode)
+{
+    U64 bytes = 0;
+    bytes += (U64)inode->children_capacity * sizeof(*inode->children);
+    bytes += (U64)inode->sorted_capacity * sizeof(*inode->sorted);
+    if (inode->path != NULL) {
+        bytes += strlen(inode->path) + 1;
+    }
+
+    bytes += (U64)inode->content.piece_capacity * sizeof(*inode->content.pieces);
+    for (U32 j = 0; j < inode->content.piece_count; ++j) {
+        Vfs_Chunk *chunk = inode->content.pieces[j].chunk;
+        bytes += (sizeof(*chunk) + chunk->capacity) / chunk->refcount;
+    }
+
+    return bytes;
+}
+
+/**
+* @brief Function to count the bytes allocated by a filesystem
+*
+* Chunks shared between files (and the journal) are split between the pieces referring to
+* them, so that every chunk is counted once in total.
+*
+* @param vfs Filesystem
+*
+* @return Number of bytes
+*/
+internal_function
+U64 vfsMemory (Vfs *vfs)
+{
+    U64 bytes = sizeof(*vfs);
+    bytes += (U64)vfs->inode_capacity * sizeof(*vfs->inodes);
+    bytes += (U64)vfs->atom_capacity * sizeof(*vfs->atoms);
+    bytes += (U64)vfs->atom_table_capacity * sizeof(*vfs->atom_table);
+
+    for (U32 i = 0; i < vfs->atom_count; ++i) {
+        bytes += vfs->atoms[i].length + 1;
+    }
+
+    for (U32 i = 1; i < vfs->inode_count; ++i) {
+        bytes += vfsInodeMemory(&vfs->inodes[i]);
+    }
+
+    bytes += (U64)vfs->journal_capacity * sizeof(*vfs->journal);
+    for (U32 i = 0; i < vfs->journal_count; ++i) {
+        bytes += vfsInodeMemory(&vfs->journal[i].inode);
+    }
+    bytes += (U64)vfs->checkpoint_capacity * sizeof(*vfs->checkpoints);
+
+    return bytes;
+}
@@ -0,0 +1,910 @@
+/**
+ * These functions are called from Lua and are used to hook into the simulated filesystem that
+ * is implemented in the engine. Every filesystem is a userdata owned by the Lua state that
+ * created it, whose methods take and return inode IDs.
+ *
+ * @file vfs_script.c
+ * @author Team Octal
+ * @brief Lua functions for the simulated filesystem
+ */
+
+#define VFS_SCRIPT_METATABLE "Engine.VFS"
+
+/**
+* @brief Function to get the filesystem passed as the first argument of a method
+*
+* @param l Lua context
+*
+* @return Filesystem
+*/
+internal_function
+Vfs* scriptVFSCheck (lua_State *l)
+{
+    return luaL_checkudata(l, 1, VFS_SCRIPT_METATABLE);
+}
+
+/**
+* @brief Function to get an inode ID argument
+*
+* @param l Lua context
+* @param vfs Filesystem
+* @param arg Index of the argument
+*
+* @return ID of the inode
+*/
+internal_function
+U32 scriptVFSCheckInode (lua_State *l, Vfs *vfs, Sint arg)
+{
+    U32 id = (U32)luaL_checknumber(l, arg);
+    if (vfsIsValid(vfs, id) == false) {
+        luaL_argerror(l, arg, "invalid inode");
+    }
+    return id;
+}
+
+/**
+* @brief Function to return an error from a method, as nil and a message
+*
+* @param l Lua context
+* @param error Error
+* @param path Path (or name) that the error is about
+*
+* @return Number of values returned
+*/
+internal_function
+Sint scriptVFSError (lua_State *l, enum Vfs_Error error, const Char *path)
+{
+    lua_pushnil(l);
+
+    switch (error) {
+    case VFS_ERROR_NOT_FOUND:
+        lua_pushfstring(l, "Path \"%s\" doesn't exist", path);
+        break;
+    case VFS_ERROR_NOT_DIRECTORY:
+        lua_pushfstring(l, "\"%s\" is not a directory", path);
+        break;
+    case VFS_ERROR_EXISTS:
+        lua_pushfstring(l, "\"%s\" already exists", path);
+        break;
+    case VFS_ERROR_NOT_EMPTY:
+        lua_pushfstring(l, "\"%s\" is not empty", path);
+        break;
+    case VFS_ERROR_INVALID:
+        lua_pushfstring(l, "Invalid path \"%s\"", path);
+        break;
+    case VFS_ERROR_CYCLE:
+        lua_pushfstring(l, "Can't move \"%s\" into itself", path);
+        break;
+    case VFS_ERROR_IS_DIRECTORY:
+        lua_pushfstring(l, "\"%s\" is a directory", path);
+        break;
+    case VFS_OK:
+        lua_pushstring(l, "");
+        break;
+    }
+
+    return 2;
+}
+
+/**
+* @brief Lua method which returns the ID of the root directory
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSRoot (lua_State *l)
+{
+    scriptVFSCheck(l);
+    lua_pushnumber(l, VFS_ROOT);
+    return 1;
+}
+
+/**
+* @brief Lua method which finds the inode at a path
+*
+* Called as `vfs:lookup(path, cwd)`, where `cwd` is the directory that relative paths start
+* from (the root by default). Returns the ID of the inode, or nil and an error message.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSLookup (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    Size length = 0;
+    const Char *path = luaL_checklstring(l, 2, &length);
+    U32 cwd = lua_isnoneornil(l, 3) ? VFS_ROOT : scriptVFSCheckInode(l, vfs, 3);
+
+    U32 id = 0;
+    enum Vfs_Error error = vfsResolve(vfs, cwd, path, length, &id);
+    if (error != VFS_OK) {
+        return scriptVFSError(l, error, path);
+    }
+
+    lua_pushnumber(l, id);
+    return 1;
+}
+
+/**
+* @brief Lua method which splits a path into its directory and its last component
+*
+* Called as `vfs:split(path, cwd)`. Returns the ID of the directory and the name, or nil and
+* an error message. The name itself need not exist.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSSplit (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    Size length = 0;
+    const Char *path = luaL_checklstring(l, 2, &length);
+    U32 cwd = lua_isnoneornil(l, 3) ? VFS_ROOT : scriptVFSCheckInode(l, vfs, 3);
+
+    U32 directory = 0;
+    const Char *name = NULL;
+    Size name_length = 0;
+    enum Vfs_Error error = vfsResolveParent(vfs, cwd, path, length,
+                                            &directory, &name, &name_length);
+    if (error != VFS_OK) {
+        return scriptVFSError(l, error, path);
+    }
+
+    lua_pushnumber(l, directory);
+    lua_pushlstring(l, name, name_length);
+    return 2;
+}
+
+/**
+* @brief Lua method which creates an inode
+*
+* Called as `vfs:insert(directory, name, kind)`, where `kind` is "f" or "d". Returns the ID of
+* the new inode, or nil and an error message.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSInsert (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    U32 directory = scriptVFSCheckInode(l, vfs, 2);
+    Size length = 0;
+    const Char *name = luaL_checklstring(l, 3, &length);
+    const Char *kind = luaL_checkstring(l, 4);
+
+    U32 id = 0;
+    enum Vfs_Error error = vfsCreate(vfs, directory, name, length,
+                                     (strcmp(kind, "d") == 0) ? VFS_KIND_DIRECTORY : VFS_KIND_FILE,
+                                     &id);
+    if (error != VFS_OK) {
+        return scriptVFSError(l, error, name);
+    }
+
+    lua_pushnumber(l, id);
+    return 1;
+}
+
+/**
+* @brief Lua method which moves (and/or renames) an inode
+*
+* Called as `vfs:move(inode, directory, name)`. Returns true, or nil and an error message.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSMove (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    U32 id = scriptVFSCheckInode(l, vfs, 2);
+    U32 directory = scriptVFSCheckInode(l, vfs, 3);
+    Size length = 0;
+    const Char *name = luaL_checklstring(l, 4, &length);
+
+    enum Vfs_Error error = vfsMove(vfs, id, directory, name, length);
+    if (error != VFS_OK) {
+        return scriptVFSError(l, error, (error == VFS_ERROR_CYCLE) ? vfsPath(vfs, id) : name);
+    }
+
+    lua_pushboolean(l, true);
+    return 1;
+}
+
+/**
+* @brief Lua method which removes an inode
+*
+* Called as `vfs:remove(inode, recursive)`. A directory with children is only removed if
+* `recursive` is true. Returns true, or nil and an error message.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSRemove (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    U32 id = scriptVFSCheckInode(l, vfs, 2);
+    B32 recursive = (B32)lua_toboolean(l, 3);
+
+    enum Vfs_Error error = vfsRemove(vfs, id, recursive);
+    if (error != VFS_OK) {
+        return scriptVFSError(l, error, vfsPath(vfs, id));
+    }
+
+    lua_pushboolean(l, true);
+    return 1;
+}
+
+/**
+* @brief Iterator returned by @ref scriptVFSChildren
+*
+* The filesystem and the next child are its upvalues.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSChildrenNext (lua_State *l)
+{
+    Vfs *vfs = lua_touserdata(l, lua_upvalueindex(1));
+    U32 id = (U32)lua_tonumber(l, lua_upvalueindex(2));
+
+    if ((id == 0) || (vfsIsValid(vfs, id) == false)) {
+        return 0;
+    }
+
+    Vfs_Inode *inode = vfsInode(vfs, id);
+    lua_pushnumber(l, inode->next_sibling);
+    lua_replace(l, lua_upvalueindex(2));
+
+    lua_pushnumber(l, id);
+    lua_pushlstring(l, vfs->atoms[inode->name].string, vfs->atoms[inode->name].length);
+    lua_pushstring(l, (inode->kind == VFS_KIND_DIRECTORY) ? "d" : "f");
+    return 3;
+}
+
+/**
+* @brief Lua method which iterates over the children of a directory
+*
+* Called as `for id, name, kind in vfs:children(directory) do ... end`. The children come in
+* the order in which they were created (or moved in). The directory must not be changed
+* during the iteration.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSChildren (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    U32 directory = scriptVFSCheckInode(l, vfs, 2);
+
+    lua_pushvalue(l, 1);
+    lua_pushnumber(l, vfs->inodes[directory].first_child);
+    lua_pushcclosure(l, scriptVFSChildrenNext, 2);
+    return 1;
+}
+
+/**
+* @brief Lua method which finds the children of a directory whose names start with a prefix
+*
+* Called as `vfs:complete(directory, prefix, limit)`. Returns an array of the names of the
+* first `limit` children that match, in sorted order and with a '/' after the names of
+* directories; the number of children that match; and the longest prefix that all of their
+* names start with. The cost depends on the length of the prefix and the number of names
+* returned, not on the size of the directory.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSComplete (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    U32 directory = scriptVFSCheckInode(l, vfs, 2);
+    Size length = 0;
+    const Char *prefix = luaL_checklstring(l, 3, &length);
+    U32 limit = (U32)luaL_optnumber(l, 4, UINT32_MAX);
+
+    U32 first = 0;
+    U32 count = 0;
+    if (vfs->inodes[directory].kind == VFS_KIND_DIRECTORY) {
+        count = vfsComplete(vfs, directory, prefix, length, &first);
+    }
+
+    Vfs_Inode *dir = vfsInode(vfs, directory);
+    U32 returned = (count < limit) ? count : limit;
+    lua_createtable(l, (Sint)returned, 0);
+    for (U32 i = 0; i < returned; ++i) {
+        Vfs_Inode *child = vfsInode(vfs, dir->sorted[first + i]);
+        Vfs_Atom *atom = &vfs->atoms[child->name];
+        lua_pushlstring(l, atom->string, atom->length);
+        if (child->kind == VFS_KIND_DIRECTORY) {
+            lua_pushliteral(l, "/");
+            lua_concat(l, 2);
+        }
+        lua_rawseti(l, -2, (Sint)i + 1);
+    }
+
+    lua_pushnumber(l, count);
+
+    // NOTE(naman): Since the names are sorted, the prefix common to all of them is the one
+    // common to the first and the last.
+    if (count == 0) {
+        lua_pushlstring(l, prefix, length);
+    } else {
+        Vfs_Atom *low = &vfs->atoms[vfs->inodes[dir->sorted[first]].name];
+        Vfs_Atom *high = &vfs->atoms[vfs->inodes[dir->sorted[first + count - 1]].name];
+        U32 common = 0;
+        while ((common < low->length) && (common < high->length) &&
+               (low->string[common] == high->string[common])) {
+            common++;
+        }
+        lua_pushlstring(l, low->string, common);
+    }
+
+    return 3;
+}
+
+/**
+* @brief State of @ref scriptVFSGlob, passed to @ref scriptVFSGlobAdd
+*/
+typedef struct Script_VFS_Glob {
+    lua_State *l; /**< Lua context (with the array of paths on top of its stack) */
+    U32 count; /**< Number of paths in the array */
+    U32 limit; /**< Maximum number of paths */
+} Script_VFS_Glob;
+
+/**
+* @brief Function to add a path that matches a pattern to the array of paths
+*
+* @param userdata State of the expansion
+* @param path Path
+* @param length Length of @p path
+*
+* @return Is there room for more paths?
+*/
+internal_function
+B32 scriptVFSGlobAdd (void *userdata, const Char *path, Size length)
+{
+    Script_VFS_Glob *state = userdata;
+    lua_pushlstring(state->l, path, length);
+    lua_rawseti(state->l, -2, (Sint)++state->count);
+    return state->count < state->limit;
+}
+
+/**
+* @brief Lua method which finds the paths that match a glob pattern
+*
+* Called as `vfs:glob(pattern, cwd, limit)`, where `cwd` is the directory that relative
+* patterns start from (the root by default). Returns an array of the first `limit` paths that
+* match, in sorted order (empty if none do). See glob.c for the syntax of patterns.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSGlob (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    Size length = 0;
+    const Char *pattern = luaL_checklstring(l, 2, &length);
+    U32 cwd = lua_isnoneornil(l, 3) ? VFS_ROOT : scriptVFSCheckInode(l, vfs, 3);
+    U32 limit = (U32)luaL_optnumber(l, 4, UINT32_MAX);
+
+    Script_VFS_Glob state = {0};
+    state.l = l;
+    state.limit = limit;
+
+    lua_newtable(l);
+    if (limit > 0) {
+        Glob glob = {0};
+        globCompile(&glob, pattern, length);
+        globExpand(vfs, cwd, &glob, scriptVFSGlobAdd, &state);
+        globFree(&glob);
+    }
+
+    return 1;
+}
+
+/**
+* @brief Lua method which returns the name, kind ("f" or "d") and parent of an inode
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSStat (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    U32 id = scriptVFSCheckInode(l, vfs, 2);
+    Vfs_Inode *inode = vfsInode(vfs, id);
+
+    lua_pushlstring(l, vfs->atoms[inode->name].string, vfs->atoms[inode->name].length);
+    lua_pushstring(l, (inode->kind == VFS_KIND_DIRECTORY) ? "d" : "f");
+    lua_pushnumber(l, inode->parent);
+    return 3;
+}
+
+/**
+* @brief Lua method which returns the path of an inode (directories' paths end with '/')
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSPath (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    U32 id = scriptVFSCheckInode(l, vfs, 2);
+
+    lua_pushstring(l, vfsPath(vfs, id));
+    return 1;
+}
+
+/**
+* @brief Lua method which checks whether an inode ID is (still) valid
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSValid (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    U32 id = (U32)luaL_checknumber(l, 2);
+
+    lua_pushboolean(l, vfsIsValid(vfs, id));
+    return 1;
+}
+
+/**
+* @brief Lua method which takes a checkpoint
+*
+* Called as `vfs:checkpoint()`. Returns the number of the checkpoint, which stays valid until
+* it (or one before it) is released, or one before it is restored. Taking a checkpoint costs
+* the same whatever the size of the tree.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSCheckpoint (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    lua_pushnumber(l, vfsCheckpoint(vfs));
+    return 1;
+}
+
+/**
+* @brief Function to get a checkpoint argument
+*
+* @param l Lua context
+* @param vfs Filesystem
+* @param arg Index of the argument
+*
+* @return Number of the checkpoint
+*/
+internal_function
+U32 scriptVFSCheckCheckpoint (lua_State *l, Vfs *vfs, Sint arg)
+{
+    U32 number = (U32)luaL_checknumber(l, arg);
+    luaL_argcheck(l, (number >= 1) && (number <= vfs->checkpoint_count), arg,
+                  "invalid checkpoint");
+    return number;
+}
+
+/**
+* @brief Lua method which puts the filesystem back the way it was at a checkpoint
+*
+* Called as `vfs:restore(checkpoint)`. The checkpoint can be restored again later; the ones
+* taken after it are released. The cost depends on the number of inodes changed since the
+* checkpoint, not on the size of the tree.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSRestore (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    vfsRestore(vfs, scriptVFSCheckCheckpoint(l, vfs, 2));
+    return 0;
+}
+
+/**
+* @brief Lua method which releases a checkpoint (and the ones taken after it)
+*
+* Called as `vfs:release(checkpoint)`. The changes made since are kept.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSRelease (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    vfsRelease(vfs, scriptVFSCheckCheckpoint(l, vfs, 2));
+    return 0;
+}
+
+/**
+* @brief Lua method which returns the number of bytes allocated by the filesystem
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSMemory (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    lua_pushnumber(l, (lua_Number)vfsMemory(vfs));
+    return 1;
+}
+
+/**
+* @brief Function to get a file argument of a method
+*
+* @param l Lua context
+* @param vfs Filesystem
+* @param arg Index of the argument
+*
+* @return ID of the file (0 if the inode is a directory)
+*/
+internal_function
+U32 scriptVFSCheckFile (lua_State *l, Vfs *vfs, Sint arg)
+{
+    U32 id = scriptVFSCheckInode(l, vfs, arg);
+    if (vfs->inodes[id].kind != VFS_KIND_FILE) {
+        return 0;
+    }
+    return id;
+}
+
+/**
+* @brief Lua method which returns the size of a file in bytes
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSSize (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    U32 id = scriptVFSCheckFile(l, vfs, 2);
+    if (id == 0) {
+        return scriptVFSError(l, VFS_ERROR_IS_DIRECTORY, vfsPath(vfs, (U32)lua_tonumber(l, 2)));
+    }
+
+    lua_pushnumber(l, (lua_Number)vfs->inodes[id].content.size);
+    return 1;
+}
+
+/**
+* @brief Lua method which empties a file
+*
+* Called as `vfs:truncate(inode)`. Returns true, or nil and an error message.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSTruncate (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    U32 id = scriptVFSCheckFile(l, vfs, 2);
+    if (id == 0) {
+        return scriptVFSError(l, VFS_ERROR_IS_DIRECTORY, vfsPath(vfs, (U32)lua_tonumber(l, 2)));
+    }
+
+    vfsContentClear(&vfsInodeWrite(vfs, id)->content);
+
+    lua_pushboolean(l, true);
+    return 1;
+}
+
+/**
+* @brief Lua method which appends strings to a file
+*
+* Called as `vfs:append(inode, ...)`, so that a line and its newline can be appended without
+* joining them first. Returns true, or nil and an error message.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSAppend (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    U32 id = scriptVFSCheckFile(l, vfs, 2);
+    if (id == 0) {
+        return scriptVFSError(l, VFS_ERROR_IS_DIRECTORY, vfsPath(vfs, (U32)lua_tonumber(l, 2)));
+    }
+
+    Vfs_Content *content = &vfsInodeWrite(vfs, id)->content;
+    Sint top = lua_gettop(l);
+    for (Sint i = 3; i <= top; ++i) {
+        Size length = 0;
+        const Char *string = luaL_checklstring(l, i, &length);
+        vfsContentAppend(content, (const Byte *)string, length);
+    }
+
+    lua_pushboolean(l, true);
+    return 1;
+}
+
+/**
+* @brief Lua method which copies the contents of a file into another
+*
+* Called as `vfs:copy(source, destination)`. The two files share the copied contents until
+* either is written to. Returns true, or nil and an error message.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSCopy (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    U32 source = scriptVFSCheckFile(l, vfs, 2);
+    if (source == 0) {
+        return scriptVFSError(l, VFS_ERROR_IS_DIRECTORY, vfsPath(vfs, (U32)lua_tonumber(l, 2)));
+    }
+    U32 destination = scriptVFSCheckFile(l, vfs, 3);
+    if (destination == 0) {
+        return scriptVFSError(l, VFS_ERROR_IS_DIRECTORY, vfsPath(vfs, (U32)lua_tonumber(l, 3)));
+    }
+
+    vfsContentCopy(&vfsInodeWrite(vfs, destination)->content, &vfs->inodes[source].content);
+
+    lua_pushboolean(l, true);
+    return 1;
+}
+
+/**
+* @brief Function passed to @ref vfsContentRead which adds every span to a Lua buffer
+*
+* @param userdata Lua buffer
+* @param data Span
+* @param length Length of @p data
+*
+* @return Should reading continue?
+*/
+internal_function
+B32 scriptVFSReadSpan (void *userdata, const Byte *data, Size length)
+{
+    luaL_addlstring(userdata, (const Char *)data, length);
+    return true;
+}
+
+/**
+* @brief Lua method which reads a range of a file
+*
+* Called as `vfs:read(inode, offset, length)`, where `offset` starts at 0 and both are in bytes
+* (by default, the whole file is read). Returns the string, or nil and an error message.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSRead (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    U32 id = scriptVFSCheckFile(l, vfs, 2);
+    if (id == 0) {
+        return scriptVFSError(l, VFS_ERROR_IS_DIRECTORY, vfsPath(vfs, (U32)lua_tonumber(l, 2)));
+    }
+    Vfs_Content *content = &vfs->inodes[id].content;
+    F64 offset = luaL_optnumber(l, 3, 0);
+    F64 length = luaL_optnumber(l, 4, (lua_Number)content->size);
+
+    luaL_Buffer buffer;
+    luaL_buffinit(l, &buffer);
+    if ((offset >= 0) && (length > 0)) {
+        vfsContentRead(content, (U64)offset, (U64)length, scriptVFSReadSpan, &buffer);
+    }
+    luaL_pushresult(&buffer);
+
+    return 1;
+}
+
+/**
+* @brief State of the reading of a line, for @ref scriptVFSLineSpan
+*/
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+typedef struct Script_VFS_Line {
+    luaL_Buffer *buffer; /**< Buffer into which the line is read */
+    U64 consumed; /**< Number of bytes read, including the newline */
+    B32 complete; /**< Has the newline been reached? */
+} Script_VFS_Line;
+#pragma clang diagnostic pop
+
+/**
+* @brief Function passed to @ref vfsContentRead which reads up to the end of a line
+*
+* @param userdata State of the line
+* @param data Span
+* @param length Length of @p data
+*
+* @return Should reading continue?
+*/
+internal_function
+B32 scriptVFSLineSpan (void *userdata, const Byte *data, Size length)
+{
+    Script_VFS_Line *line = userdata;
+
+    const Byte *newline = memchr(data, '\n', length);
+    if (newline != NULL) {
+        length = (Size)(newline - data);
+    }
+
+    luaL_addlstring(line->buffer, (const Char *)data, length);
+    line->consumed += length;
+
+    if (newline != NULL) {
+        line->consumed++;
+        line->complete = true;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+* @brief Iterator returned by @ref scriptVFSLines
+*
+* The filesystem, the file and the offset of the next line are its upvalues.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSLinesNext (lua_State *l)
+{
+    Vfs *vfs = lua_touserdata(l, lua_upvalueindex(1));
+    U32 id = (U32)lua_tonumber(l, lua_upvalueindex(2));
+    U64 offset = (U64)lua_tonumber(l, lua_upvalueindex(3));
+
+    if ((vfsIsValid(vfs, id) == false) || (vfs->inodes[id].kind != VFS_KIND_FILE) ||
+        (offset >= vfs->inodes[id].content.size)) {
+        return 0;
+    }
+
+    luaL_Buffer buffer;
+    Script_VFS_Line line = {.buffer = &buffer};
+    luaL_buffinit(l, &buffer);
+    vfsContentRead(&vfs->inodes[id].content, offset, UINT64_MAX, scriptVFSLineSpan, &line);
+    luaL_pushresult(&buffer);
+
+    lua_pushnumber(l, (lua_Number)(offset + line.consumed));
+    lua_replace(l, lua_upvalueindex(3));
+
+    return 1;
+}
+
+/**
+* @brief Lua method which iterates over the lines of a file
+*
+* Called as `for line in vfs:lines(inode) do ... end`. The lines don't include their newlines,
+* and are read one at a time, so the file is never joined into a single string.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSLines (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    U32 id = scriptVFSCheckFile(l, vfs, 2);
+    if (id == 0) {
+        return scriptVFSError(l, VFS_ERROR_IS_DIRECTORY, vfsPath(vfs, (U32)lua_tonumber(l, 2)));
+    }
+
+    lua_pushvalue(l, 1);
+    lua_pushnumber(l, id);
+    lua_pushnumber(l, 0);
+    lua_pushcclosure(l, scriptVFSLinesNext, 3);
+    return 1;
+}
+
+/**
+* @brief Lua metamethod which frees a filesystem when it is garbage collected
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSGc (lua_State *l)
+{
+    Vfs *vfs = scriptVFSCheck(l);
+    vfsFree(vfs);
+    return 0;
+}
+
+/**
+* @brief Lua injected function which creates an empty filesystem
+*
+* This function is called from Lua and returns a filesystem with nothing but a root directory.
+* Its methods are `root`, `lookup`, `split`, `insert`, `move`, `remove`, `children`,
+* `complete`, `glob`, `stat`, `path` and `valid` for the tree, `size`, `truncate`, `append`,
+* `copy`, `read` and `lines` for the contents of files, `checkpoint`, `restore` and `release`
+* for putting it back the way it was, and `memory` for the bytes it uses.
+*
+* @param l Lua context
+*
+* @return Execution status
+*/
+internal_function
+Sint scriptVFSNew (lua_State *l)
+{
+    Vfs *vfs = lua_newuserdata(l, sizeof(*vfs));
+    vfsInit(vfs);
+
+    if (luaL_newmetatable(l, VFS_SCRIPT_METATABLE)) {
+        const luaL_Reg methods[] = {
+            {"root", scriptVFSRoot},
+            {"lookup", scriptVFSLookup},
+            {"split", scriptVFSSplit},
+            {"insert", scriptVFSInsert},
+            {"move", scriptVFSMove},
+            {"remove", scriptVFSRemove},
+            {"children", scriptVFSChildren},
+            {"complete", scriptVFSComplete},
+            {"glob", scriptVFSGlob},
+            {"stat", scriptVFSStat},
+            {"path", scriptVFSPath},
+            {"valid", scriptVFSValid},
+            {"checkpoint", scriptVFSCheckpoint},
+            {"restore", scriptVFSRestore},
+            {"release", scriptVFSRelease},
+            {"memory", scriptVFSMemory},
+            {"size", scriptVFSSize},
+            {"truncate", scriptVFSTruncate},
+            {"append", scriptVFSAppend},
+            {"copy", scriptVFSCopy},
+            {"read", scriptVFSRead},
+            {"lines", scriptVFSLines},
+            {NULL, NULL},
+        };
+
+        lua_newtable(l);
+        luaL_register(l, NULL, methods);
+        lua_setfield(l, -2, "__index");
+
+        lua_pushcfunction(l, scriptVFSGc);
+        lua_setfield(l, -2, "__gc");
+    }
+    lua_setmetatable(l, -2);
+
+    return 1;
+}